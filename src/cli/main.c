@@ -97,6 +97,9 @@ fprintf(stderr, "darktable %s\n"
                 "                    instead of XMP sidecar files\n"
                 "                    using ':memory:' for an empty in-memory library\n"
                 "                    is useless for darktable cli export\n"
+                "                    add --core --library-readonly to share a library\n"
+                "                    that is in use by a running darktable, the inputs\n"
+                "                    must then be in the library and --xmp can't be used\n"
                 "   --icc-type <type> specify icc type, default to NONE\n"
                 "                     use --help icc-type for list of supported types\n"
                 "   --icc-file <file> specify icc filename, default to NONE\n"
@@ -111,6 +114,21 @@ fprintf(stderr, "darktable %s\n"
   // FS TODO: to add instructions for DARKTABLE_OPTIONS
 }
 
+// a read-only library can't take new images: the inputs must already be
+// in it
+static dt_imgid_t _library_image(const gchar *filename)
+{
+  gchar *normalized = dt_util_normalize_path(filename);
+  const dt_imgid_t imgid = normalized ? dt_image_get_id_full_path(normalized) : NO_IMGID;
+  g_free(normalized);
+  if(!dt_is_valid_imgid(imgid))
+  {
+    fprintf(stderr, _("error: %s is not in the read-only library, it can't be imported"), filename);
+    fprintf(stderr, "\n");
+  }
+  return imgid;
+}
+
 static void icc_types()
 {
   // TODO: Can this be automated to keep in sync with colorspaces.h?
@@ -587,13 +605,59 @@ int main(int argc, char *arg[])
   // When --library was provided, use the DB history; otherwise keep XMP override mode.
   darktable.prefer_library_history = (library != NULL);
 
+  // nothing can be written to a read-only library, neither the history
+  // of an XMP file nor new images
+  const gboolean library_readonly = dt_database_is_read_only(darktable.db);
+  if(library_readonly && xmp_filename)
+  {
+    fprintf(stderr, "%s\n", _("error: --xmp can't be applied to a read-only library"));
+    free(m_arg);
+    g_free(output_filename);
+    if(output_ext)
+      g_free(output_ext);
+    if(inputs)
+      g_list_free_full(inputs, g_free);
+    dt_cleanup();
+    exit(1);
+  }
+
   GList *id_list = NULL;
 
   for(GList *l = inputs; l != NULL; l=g_list_next(l))
   {
     gchar* input = l->data;
 
-    if(g_file_test(input, G_FILE_TEST_IS_DIR))
+    if(library_readonly && g_file_test(input, G_FILE_TEST_IS_DIR))
+    {
+      GDir *cdir = g_dir_open(input, 0, NULL);
+      if(!cdir)
+      {
+        fprintf(stderr, _("error: can't open folder %s"), input);
+        fprintf(stderr, "\n");
+        continue;
+      }
+      const gchar *fname;
+      while((fname = g_dir_read_name(cdir)) != NULL)
+      {
+        if(fname[0] == '.') continue;  // skip hidden files
+        gchar *fullname = g_build_filename(input, fname, NULL);
+        if(!g_file_test(fullname, G_FILE_TEST_IS_DIR) && dt_supported_image(fname))
+        {
+          const dt_imgid_t imgid = _library_image(fullname);
+          if(dt_is_valid_imgid(imgid))
+            id_list = g_list_append(id_list, GINT_TO_POINTER(imgid));
+        }
+        g_free(fullname);
+      }
+      g_dir_close(cdir);
+    }
+    else if(library_readonly)
+    {
+      const dt_imgid_t id = _library_image(input);
+      if(dt_is_valid_imgid(id))
+        id_list = g_list_append(id_list, GINT_TO_POINTER(id));
+    }
+    else if(g_file_test(input, G_FILE_TEST_IS_DIR))
     {
       //const dt_filmid_t filmid = dt_film_import(input);
       dt_film_t film;
@@ -634,7 +698,7 @@ int main(int argc, char *arg[])
       }
       else
       {
-        fprintf(stderr, _("error: can't read directory %s"), input);
+        fprintf(stderr, _("error: can't open folder %s"), input);
         fprintf(stderr, "\n");
         continue;
       }
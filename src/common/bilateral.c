@@ -135,39 +135,44 @@ size_t dt_bilateral_singlebuffer_size2(const int width,
 }
 #endif /* !HAVE_OPENCL */
 
-static size_t image_to_grid(const dt_bilateral_t *const b,
-                            const int i,
-                            const int j,
-                            const float L,
-                            float *xf,
-                            float *yf,
-                            float *zf)
+static inline int _grid_z(const dt_bilateral_t *const b,
+                           const float L,
+                           float *zf)
 {
-  float x = CLAMPS(i * b->sigma_s_inv, 0, b->size_x - 1);
-  float y = CLAMPS(j * b->sigma_s_inv, 0, b->size_y - 1);
-  float z = CLAMPS(L * b->sigma_r_inv, 0, b->size_z - 1);
-  const int xi = MIN((int)x, b->size_x - 2);
-  const int yi = MIN((int)y, b->size_y - 2);
+  const float z = CLAMPS(L * b->sigma_r_inv, 0, b->size_z - 1);
   const int zi = MIN((int)z, b->size_z - 2);
-  *xf = x - xi;
-  *yf = y - yi;
   *zf = z - zi;
-  return ((xi + yi * b->size_x) * b->size_z) + zi;
+  return zi;
 }
 
-static size_t image_to_relgrid(const dt_bilateral_t *const b,
-                               const int i,
-                               const float L,
-                               float *xf,
-                               float *zf)
+static inline int _grid_y(const dt_bilateral_t *const b,
+                          const int j,
+                          float *yf)
 {
-  float x = CLAMPS(i * b->sigma_s_inv, 0, b->size_x - 1);
-  float z = CLAMPS(L * b->sigma_r_inv, 0, b->size_z - 1);
-  const int xi = MIN((int)x, b->size_x - 2);
-  const int zi = MIN((int)z, b->size_z - 2);
-  *xf = x - xi;
-  *zf = z - zi;
-  return (xi * b->size_z) + zi;
+  const float y = CLAMPS(j * b->sigma_s_inv, 0, b->size_y - 1);
+  const int yi = MIN((int)y, b->size_y - 2);
+  *yf = y - yi;
+  return yi;
+}
+
+// trilinear interpolation of the grid around the cell at gi
+static inline float _grid_lookup(const float *const buf,
+                                 const size_t gi,
+                                 const int ox,
+                                 const int oy,
+                                 const float xf,
+                                 const float yf,
+                                 const float zf)
+{
+  const int oz = 1;
+  return buf[gi] * (1.0f - xf) * (1.0f - yf) * (1.0f - zf)
+    + buf[gi + ox] * (xf) * (1.0f - yf) * (1.0f - zf)
+    + buf[gi + oy] * (1.0f - xf) * (yf) * (1.0f - zf)
+    + buf[gi + ox + oy] * (xf) * (yf) * (1.0f - zf)
+    + buf[gi + oz] * (1.0f - xf) * (1.0f - yf) * (zf)
+    + buf[gi + ox + oz] * (xf) * (1.0f - yf) * (zf)
+    + buf[gi + oy + oz] * (1.0f - xf) * (yf) * (zf)
+    + buf[gi + ox + oy + oz] * (xf) * (yf) * (zf);
 }
 
 dt_bilateral_t *dt_bilateral_init(const int width,     // width of input image
@@ -184,14 +189,26 @@ dt_bilateral_t *dt_bilateral_init(const int width,     // width of input image
   b->sliceheight = (height + b->numslices - 1) / b->numslices;
   b->slicerows = (b->size_y + b->numslices - 1) / b->numslices + 2;
   b->buf = dt_calloc_align_float(b->size_x * b->size_z * b->numslices * b->slicerows);
-  if(!b->buf)
+  b->columns = dt_alloc_align(sizeof(dt_bilateral_column_t) * width);
+  if(!b->buf || !b->columns)
   {
     dt_print(DT_DEBUG_ALWAYS,
              "[bilateral] unable to allocate buffer for %zux%zux%zu grid",
              b->size_x,b->size_y,b->size_z);
+    dt_free_align(b->buf);
+    dt_free_align(b->columns);
     free(b);
     return NULL;
   }
+  // the grid position along x is the same for every row, keep it
+  // out of the per-pixel work of splat and slice
+  for(int i = 0; i < width; i++)
+  {
+    const float x = CLAMPS(i * b->sigma_s_inv, 0, b->size_x - 1);
+    const int xi = MIN((int)x, b->size_x - 2);
+    b->columns[i].offset = xi * b->size_z;
+    b->columns[i].frac = x - xi;
+  }
   dt_print(DT_DEBUG_DEV,
            "[bilateral] created grid [%ld %ld %ld] with sigma (%f %f) (%f %f)",
            b->size_x, b->size_y, b->size_z, b->sigma_s, sigma_s, b->sigma_r, sigma_r);
@@ -208,9 +225,9 @@ void dt_bilateral_splat(const dt_bilateral_t *b, const float *const in)
   const int oz = 1;
   const float sigma_s = b->sigma_s * b->sigma_s;
   float *const buf = b->buf;
+  const dt_bilateral_column_t *const columns = b->columns;
 
   // splat into downsampled grid
-  const int nthreads = dt_get_num_threads();
   const size_t offsets[8] =
   {
     0,
@@ -223,6 +240,8 @@ void dt_bilateral_splat(const dt_bilateral_t *b, const float *const in)
     oz + oy + ox
   };
 
+  // each slice of rows splats into its own slab of grid rows, so that
+  // the threads never write to the same memory
   DT_OMP_FOR()
   for(int slice = 0; slice < b->numslices; slice++)
   {
@@ -235,17 +254,17 @@ void dt_bilateral_splat(const dt_bilateral_t *b, const float *const in)
     // now iterate over the rows of the current horizontal slice
     for(int j = firstrow; j < lastrow; j++)
     {
-      float y = CLAMPS(j * b->sigma_s_inv, 0, b->size_y - 1);
-      const int yi = MIN((int)y, b->size_y - 2);
-      const float yf = y - yi;
-      const size_t base = (size_t)(yi + slice_offset) * oy;
+      float yf;
+      const int yi = _grid_y(b, j, &yf);
+      float *const base = buf + (size_t)(yi + slice_offset) * oy;
+      const float *const row = in + (size_t)4 * j * b->width;
       for(int i = 0; i < b->width; i++)
       {
-        size_t index = 4 * (j * b->width + i);
-        float xf, zf;
-        const float L = in[index];
+        float zf;
+        const float L = row[4 * i];
+        const float xf = columns[i].frac;
         // nearest neighbour splatting:
-        const size_t grid_index = base + image_to_relgrid(b, i, L, &xf, &zf);
+        const size_t grid_index = columns[i].offset + _grid_z(b, L, &zf);
         // sum up payload here
         const dt_aligned_pixel_t contrib =
         {
@@ -258,33 +277,43 @@ void dt_bilateral_splat(const dt_bilateral_t *b, const float *const in)
         DT_OMP_SIMD(aligned(buf:64))
         for(int k = 0; k < 4; k++)
         {
-          buf[grid_index + offsets[k]] += (contrib[k] * (1.0f - zf));
-          buf[grid_index + offsets[k+4]] += (contrib[k] * zf);
+          base[grid_index + offsets[k]] += (contrib[k] * (1.0f - zf));
+          base[grid_index + offsets[k+4]] += (contrib[k] * zf);
         }
       }
     }
   }
 
-  // merge the per-thread results into the final result
-  for(int slice = 1 ; slice < nthreads; slice++)
+  // merge the per-thread slabs into the final result. The slabs of
+  // consecutive slices overlap by a few grid rows, so the slices are
+  // merged in order, but every grid element is independent: split
+  // the rows into chunks of columns merged in parallel.
+  const size_t chunk = 1024;
+  const size_t nchunks = (oy + chunk - 1) / chunk;
+  DT_OMP_FOR()
+  for(size_t c = 0; c < nchunks; c++)
   {
-    // compute the first row of the final grid which this slice splats
-    const int destrow = (int)(slice * b->sliceheight * b->sigma_s_inv);
-    float *dest = buf + destrow * oy;
-    // now iterate over the grid rows splatted for this slice
-    for(int j = slice * b->slicerows; j < (slice+1)*b->slicerows; j++)
+    const size_t start = c * chunk;
+    const size_t count = MIN(chunk, oy - start);
+    for(int slice = 1 ; slice < b->numslices; slice++)
     {
-      float *src = buf + j * oy;
-      for(int i = 0; i < oy; i++)
+      // compute the first row of the final grid which this slice splats
+      const int destrow = (int)(slice * b->sliceheight * b->sigma_s_inv);
+      float *dest = buf + (size_t)destrow * oy + start;
+      // now iterate over the grid rows splatted for this slice
+      for(int j = slice * b->slicerows; j < (slice+1)*b->slicerows; j++)
       {
-        dest[i] += src[i];
+        float *const src = buf + (size_t)j * oy + start;
+        DT_OMP_SIMD()
+        for(size_t i = 0; i < count; i++)
+          dest[i] += src[i];
+        dest += oy;
+        // clear elements in the part of the buffer which holds the
+        // final result now that we've read the partial result, since
+        // we'll be adding to those locations later
+        if(j < b->size_y)
+          memset(src, '\0', sizeof(float) * count);
       }
-      dest += oy;
-      // clear elements in the part of the buffer which holds the
-      // final result now that we've read the partial result, since
-      // we'll be adding to those locations later
-      if(j < b->size_y)
-        memset(buf + j*oy, '\0', sizeof(float) * oy);
     }
   }
 }
@@ -331,52 +360,65 @@ static void blur_line_z(float *buf,
   }
 }
 
-DT_OMP_DECLARE_SIMD(aligned(buf:64))
-static void blur_line(float *buf,
-                      const int offset1,
-                      const int offset2,
-                      const int offset3,
-                      const int size1,
-                      const int size2,
-                      const int size3)
+// gaussian up to 3 sigma along a line of n vectors of m contiguous
+// floats, spaced by stride. The m lanes are independent and the inner
+// loops vectorize, the previous values of the line are kept in the
+// scratch buffers prev1 and prev2 of m floats.
+static inline void _blur_vectors(float *const restrict v,
+                                 const int n,
+                                 const size_t stride,
+                                 const int m,
+                                 float *restrict prev1,
+                                 float *restrict prev2)
 {
   const float w0 = 6.f / 16.f;
   const float w1 = 4.f / 16.f;
   const float w2 = 1.f / 16.f;
-  DT_OMP_FOR()
-  for(int k = 0; k < size1; k++)
+  memset(prev1, 0, sizeof(float) * m);
+  memset(prev2, 0, sizeof(float) * m);
+  for(int i = 0; i < n; i++)
   {
-    size_t index = (size_t)k * offset1;
-    for(int j = 0; j < size2; j++)
+    float *const restrict cur = v + i * stride;
+    if(i + 2 < n)
     {
-      float tmp1 = buf[index];
-      buf[index] = buf[index] * w0 + w1 * buf[index + offset3]
-        + w2 * buf[index + 2 * offset3];
-      index += offset3;
-      float tmp2 = buf[index];
-      buf[index] = buf[index] * w0 + w1 * (buf[index + offset3] + tmp1)
-        + w2 * buf[index + 2 * offset3];
-      index += offset3;
-      for(int i = 2; i < size3 - 2; i++)
+      const float *const restrict next1 = cur + stride;
+      const float *const restrict next2 = cur + 2 * stride;
+      DT_OMP_SIMD()
+      for(int k = 0; k < m; k++)
       {
-        const float tmp3 = buf[index];
-        buf[index]
-            = buf[index] * w0 + w1 * (buf[index + offset3] + tmp2)
-          + w2 * (buf[index + 2 * offset3] + tmp1);
-        index += offset3;
-        tmp1 = tmp2;
-        tmp2 = tmp3;
+        const float c = cur[k];
+        cur[k] = c * w0 + w1 * (next1[k] + prev1[k]) + w2 * (next2[k] + prev2[k]);
+        prev2[k] = c;
       }
-      const float tmp3 = buf[index];
-      buf[index] = buf[index] * w0 + w1 * (buf[index + offset3] + tmp2) + w2 * tmp1;
-      index += offset3;
-      buf[index] = buf[index] * w0 + w1 * tmp3 + w2 * tmp2;
-      index += offset3;
-      index += offset2 - offset3 * size3;
     }
+    else if(i + 1 < n)
+    {
+      const float *const restrict next1 = cur + stride;
+      DT_OMP_SIMD()
+      for(int k = 0; k < m; k++)
+      {
+        const float c = cur[k];
+        cur[k] = c * w0 + w1 * (next1[k] + prev1[k]) + w2 * prev2[k];
+        prev2[k] = c;
+      }
+    }
+    else
+    {
+      DT_OMP_SIMD()
+      for(int k = 0; k < m; k++)
+        cur[k] = cur[k] * w0 + w1 * prev1[k] + w2 * prev2[k];
+    }
+    // prev2 now holds the value at i, which is the previous one of i+1
+    float *const tmp = prev1;
+    prev1 = prev2;
+    prev2 = tmp;
   }
 }
 
+// number of grid columns blurred together along y
+#define DT_COMMON_BILATERAL_BLUR_COLUMNS 16
+// bound of size_z, see dt_bilateral_grid_size()
+#define DT_COMMON_BILATERAL_MAX_SIZE_Z (DT_COMMON_BILATERAL_MAX_RES_R + 2)
 
 void dt_bilateral_blur(const dt_bilateral_t *b)
 {
@@ -385,10 +427,34 @@ void dt_bilateral_blur(const dt_bilateral_t *b)
   const int ox = b->size_z;
   const int oy = b->size_x * b->size_z;
   const int oz = 1;
-  // gaussian up to 3 sigma
-  blur_line(b->buf, oz, oy, ox, b->size_z, b->size_y, b->size_x);
-  // gaussian up to 3 sigma
-  blur_line(b->buf, oz, ox, oy, b->size_z, b->size_x, b->size_y);
+  float *const buf = b->buf;
+  const int size_x = b->size_x;
+  const int size_y = b->size_y;
+  const int size_z = b->size_z;
+
+  // the z axis is contiguous in the grid: blur along x and y whole
+  // z-columns at a time rather than one z value at a time, so that
+  // the memory is read linearly and the lanes vectorize.
+
+  // gaussian up to 3 sigma along x, one grid row per task
+  DT_OMP_FOR()
+  for(int y = 0; y < size_y; y++)
+  {
+    float prev[2][DT_COMMON_BILATERAL_MAX_SIZE_Z];
+    _blur_vectors(buf + (size_t)y * oy, size_x, ox, size_z, prev[0], prev[1]);
+  }
+
+  // gaussian up to 3 sigma along y, a band of grid columns per task
+  const int bands = (size_x + DT_COMMON_BILATERAL_BLUR_COLUMNS - 1) / DT_COMMON_BILATERAL_BLUR_COLUMNS;
+  DT_OMP_FOR()
+  for(int band = 0; band < bands; band++)
+  {
+    float prev[2][DT_COMMON_BILATERAL_BLUR_COLUMNS * DT_COMMON_BILATERAL_MAX_SIZE_Z];
+    const int x = band * DT_COMMON_BILATERAL_BLUR_COLUMNS;
+    const int columns = MIN(DT_COMMON_BILATERAL_BLUR_COLUMNS, size_x - x);
+    _blur_vectors(buf + (size_t)x * ox, size_y, oy, columns * size_z, prev[0], prev[1]);
+  }
+
   // -2 derivative of the gaussian up to 3 sigma: x*exp(-x*x)
   blur_line_z(b->buf, ox, oy, oz, b->size_x, b->size_y, b->size_z);
 }
@@ -406,30 +472,25 @@ void dt_bilateral_slice(const dt_bilateral_t *const b,
   const float norm = -detail * b->sigma_r * 0.04f;
   const int ox = b->size_z;
   const int oy = b->size_x * b->size_z;
-  const int oz = 1;
-  float *const buf = b->buf;
+  const float *const buf = b->buf;
+  const dt_bilateral_column_t *const columns = b->columns;
   const int width = b->width;
   const int height = b->height;
 
-  DT_OMP_FOR(collapse(2))
+  DT_OMP_FOR()
   for(int j = 0; j < height; j++)
   {
+    float yf;
+    const float *const grid_row = buf + (size_t)_grid_y(b, j, &yf) * oy;
     for(int i = 0; i < width; i++)
     {
-      size_t index = 4 * (j * width + i);
-      float xf, yf, zf;
+      const size_t index = 4 * ((size_t)j * width + i);
+      float zf;
       const float L = in[index];
       // trilinear lookup:
-      const size_t gi = image_to_grid(b, i, j, L, &xf, &yf, &zf);
-      const float Lout = fmaxf( 0.0f, L
-                         + norm * (buf[gi] * (1.0f - xf) * (1.0f - yf) * (1.0f - zf)
-                                   + buf[gi + ox] * (xf) * (1.0f - yf) * (1.0f - zf)
-                                   + buf[gi + oy] * (1.0f - xf) * (yf) * (1.0f - zf)
-                                   + buf[gi + ox + oy] * (xf) * (yf) * (1.0f - zf)
-                                   + buf[gi + oz] * (1.0f - xf) * (1.0f - yf) * (zf)
-                                   + buf[gi + ox + oz] * (xf) * (1.0f - yf) * (zf)
-                                   + buf[gi + oy + oz] * (1.0f - xf) * (yf) * (zf)
-                                   + buf[gi + ox + oy + oz] * (xf) * (yf) * (zf)));
+      const size_t gi = columns[i].offset + _grid_z(b, L, &zf);
+      const float Lout =
+        fmaxf(0.0f, L + norm * _grid_lookup(grid_row, gi, ox, oy, columns[i].frac, yf, zf));
       // copy color and mask, then update L
       copy_pixel(out + index, in + index);
       out[index] = Lout;
@@ -449,29 +510,24 @@ void dt_bilateral_slice_to_output(const dt_bilateral_t *const b,
   const float norm = -detail * b->sigma_r * 0.04f;
   const int ox = b->size_z;
   const int oy = b->size_x * b->size_z;
-  const int oz = 1;
-  float *const buf = b->buf;
+  const float *const buf = b->buf;
+  const dt_bilateral_column_t *const columns = b->columns;
   const int width = b->width;
   const int height = b->height;
 
-  DT_OMP_FOR(collapse(2))
+  DT_OMP_FOR()
   for(int j = 0; j < height; j++)
   {
+    float yf;
+    const float *const grid_row = buf + (size_t)_grid_y(b, j, &yf) * oy;
     for(int i = 0; i < width; i++)
     {
-      size_t index = 4 * (j * width + i);
-      float xf, yf, zf;
+      const size_t index = 4 * ((size_t)j * width + i);
+      float zf;
       const float L = in[index];
       // trilinear lookup:
-      const size_t gi = image_to_grid(b, i, j, L, &xf, &yf, &zf);
-      const float Lout = norm * (buf[gi] * (1.0f - xf) * (1.0f - yf) * (1.0f - zf)
-                                 + buf[gi + ox] * (xf) * (1.0f - yf) * (1.0f - zf)
-                                 + buf[gi + oy] * (1.0f - xf) * (yf) * (1.0f - zf)
-                                 + buf[gi + ox + oy] * (xf) * (yf) * (1.0f - zf)
-                                 + buf[gi + oz] * (1.0f - xf) * (1.0f - yf) * (zf)
-                                 + buf[gi + ox + oz] * (xf) * (1.0f - yf) * (zf)
-                                 + buf[gi + oy + oz] * (1.0f - xf) * (yf) * (zf)
-                                 + buf[gi + ox + oy + oz] * (xf) * (yf) * (zf));
+      const size_t gi = columns[i].offset + _grid_z(b, L, &zf);
+      const float Lout = norm * _grid_lookup(grid_row, gi, ox, oy, columns[i].frac, yf, zf);
       out[index] = MAX(0.0f, out[index] + Lout);
     }
   }
@@ -481,11 +537,14 @@ void dt_bilateral_free(dt_bilateral_t *b)
 {
   if(!b) return;
   dt_free_align(b->buf);
+  dt_free_align(b->columns);
   free(b);
 }
 
 #undef DT_COMMON_BILATERAL_MAX_RES_S
 #undef DT_COMMON_BILATERAL_MAX_RES_R
+#undef DT_COMMON_BILATERAL_MAX_SIZE_Z
+#undef DT_COMMON_BILATERAL_BLUR_COLUMNS
 
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
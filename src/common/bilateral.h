@@ -20,6 +20,13 @@
 
 #include <stddef.h> // for size_t
 
+// position of an image column in the grid, shared by all rows
+typedef struct dt_bilateral_column_t
+{
+  int offset;  // offset of the grid cell to the left of the column
+  float frac;  // distance to that cell, in cells
+} dt_bilateral_column_t;
+
 typedef struct dt_bilateral_t
 {
   size_t size_x, size_y, size_z;
@@ -27,6 +34,7 @@ typedef struct dt_bilateral_t
   int numslices, sliceheight, slicerows; //height--in input image, rows--in grid
   float sigma_s, sigma_r;
   float sigma_s_inv, sigma_r_inv;  // reciprocals of sigma_s and sigma_r to avoid divisions
+  dt_bilateral_column_t *columns;  // width entries
   float *buf __attribute__((aligned(64)));
 } __attribute__((packed)) dt_bilateral_t;
 
@@ -599,6 +599,387 @@ static void _box_min_1ch(float *const buf,
   dt_free_align(scratch_buffers);
 }
 
+// Streaming guided filter.
+//
+// The guided filter needs the box means of a set of per-pixel statistics of the guide and the
+// input, solves a small linear model per pixel from them, then needs the box means of the
+// coefficients of these models.  Rather than box filtering full-size planes of statistics (and
+// tiling the image with overlapping margins to bound their memory), the image is cut into
+// horizontal strips, one per thread but no less than 4*radius rows high, and each strip is
+// streamed row by row:
+//  - the vertical running sums of the statistics are updated for the whole row at once by adding
+//    the row entering the window and removing the one leaving it, a contiguous loop over the row
+//    which vectorizes across the columns,
+//  - a single horizontal sweep over these sums yields the box means of all statistics at once,
+//    from which the coefficients of the row are solved,
+//  - the coefficient rows are kept in a ring buffer of 2*radius+2 rows and the same two passes
+//    over them give their box means, from which the output row is computed.
+// Every pass costs O(1) per pixel whatever the radius, and the only redundant work is the
+// 2*radius coefficient rows a strip shares with its neighbours.  The running sums are kept in
+// double precision so that they don't drift along large images.  The workspace of all strips,
+// dt_box_guided_*_memory(), is allocated up front and the filter fails without touching the
+// output if it can't be.
+//
+// A model provides the number of statistics NS and of coefficients NC per pixel, and
+//   stats(row, s)     writes the NS statistics of each pixel of a row, interleaved
+//   solve(m, c)       the NC coefficients of a pixel from the box means m of its statistics
+//   output(row, x, m) the result of a pixel from the box means m of its coefficients
+
+// vs += add - sub, either of add and sub may be NULL
+static void _update_sums(double *const __restrict__ vs,
+                         const float *const __restrict__ add,
+                         const float *const __restrict__ sub,
+                         const size_t n)
+{
+  if(add && sub)
+  {
+    DT_OMP_SIMD(aligned(vs : 64))
+    for(size_t k = 0; k < n; k++)
+      vs[k] += (double)add[k] - (double)sub[k];
+  }
+  else if(add)
+  {
+    DT_OMP_SIMD(aligned(vs : 64))
+    for(size_t k = 0; k < n; k++)
+      vs[k] += (double)add[k];
+  }
+  else if(sub)
+  {
+    DT_OMP_SIMD(aligned(vs : 64))
+    for(size_t k = 0; k < n; k++)
+      vs[k] -= (double)sub[k];
+  }
+}
+
+// number of rows or columns in the window of index i
+static inline size_t _window_size(const size_t i, const size_t n, const size_t radius)
+{
+  return MIN(i + radius, n - 1) + 1 - (i > radius ? i - radius : 0);
+}
+
+// horizontal box means of a row of N interleaved vertical sums over windows of ny rows,
+// handed over to f(x, means) pixel by pixel
+template <size_t N, typename F>
+static inline void _sweep_row(const double *const __restrict__ vs,
+                              const size_t width,
+                              const size_t radius,
+                              const size_t ny,
+                              F f)
+{
+  double hs[N] = { 0.0 };
+  for(size_t x = 0; x < MIN(radius, width); x++)
+    for(size_t c = 0; c < N; c++)
+      hs[c] += vs[N * x + c];
+
+  // the window is full size between the two borders, with nothing to test
+  const size_t inner_begin = MIN(radius + 1, width);
+  const size_t inner_end = MAX(inner_begin, width > radius ? width - radius : 0);
+  const double inner_norm = 1.0 / (double)((2 * radius + 1) * ny);
+  double m[N];
+  for(size_t x = 0; x < width; x++)
+  {
+    if(x >= inner_begin && x < inner_end)
+    {
+      for(; x < inner_end; x++)
+      {
+        for(size_t c = 0; c < N; c++)
+        {
+          hs[c] += vs[N * (x + radius) + c] - vs[N * (x - radius - 1) + c];
+          m[c] = hs[c] * inner_norm;
+        }
+        f(x, m);
+      }
+      if(x == width) break;
+    }
+    if(x + radius < width)
+      for(size_t c = 0; c < N; c++)
+        hs[c] += vs[N * (x + radius) + c];
+    if(x > radius)
+      for(size_t c = 0; c < N; c++)
+        hs[c] -= vs[N * (x - radius - 1) + c];
+    const double norm = 1.0 / (double)(_window_size(x, width, radius) * ny);
+    for(size_t c = 0; c < N; c++)
+      m[c] = hs[c] * norm;
+    f(x, m);
+  }
+}
+
+// produce the output rows y0 to y1-1
+template <class P>
+static void _guided_strip(const P &p,
+                          const size_t width,
+                          const size_t height,
+                          const size_t radius,
+                          const size_t y0,
+                          const size_t y1,
+                          double *const __restrict__ vs,
+                          double *const __restrict__ vc,
+                          float *const __restrict__ s_add,
+                          float *const __restrict__ s_sub,
+                          float *const __restrict__ ring,
+                          const size_t ring_rows)
+{
+  const size_t ns = P::NS * width;
+  const size_t nc = P::NC * width;
+  // vertical sums of the statistics for the first coefficient row needed
+  const size_t c0 = y0 > radius ? y0 - radius : 0;
+  for(size_t row = c0 > radius ? c0 - radius : 0; row <= MIN(c0 + radius, height - 1); row++)
+  {
+    p.stats(row, s_add);
+    _update_sums(vs, s_add, NULL, ns);
+  }
+
+  size_t next = c0;
+  for(size_t y = y0; y < y1; y++)
+  {
+    // solve the coefficient rows entering the window of row y
+    for(; next <= MIN(y + radius, height - 1); next++)
+    {
+      float *const __restrict__ coef = ring + nc * (next % ring_rows);
+      _sweep_row<P::NS>(vs, width, radius, _window_size(next, height, radius),
+                        [&](const size_t x, const double *const m) { p.solve(m, coef + P::NC * x); });
+      _update_sums(vc, coef, NULL, nc);
+
+      // move the window of the statistics down by one row
+      const bool enter = next + radius + 1 < height;
+      const bool leave = next >= radius;
+      if(enter) p.stats(next + radius + 1, s_add);
+      if(leave) p.stats(next - radius, s_sub);
+      _update_sums(vs, enter ? s_add : NULL, leave ? s_sub : NULL, ns);
+    }
+    // and drop the one leaving it
+    if(y > y0 && y > radius)
+      _update_sums(vc, NULL, ring + nc * ((y - radius - 1) % ring_rows), nc);
+
+    _sweep_row<P::NC>(vc, width, radius, _window_size(y, height, radius),
+                      [&](const size_t x, const double *const m) { p.output(y, x, m); });
+  }
+}
+
+// the strips of a streaming guided filter and the workspace of each of them
+struct _guided_layout
+{
+  size_t nstrips;
+  size_t strip_height;
+  size_t ring_rows;
+  size_t strip_bytes;
+};
+
+template <class P>
+static _guided_layout _guided_strips(const size_t width, const size_t height, const size_t radius)
+{
+  _guided_layout l;
+  // a strip solves the 2*radius coefficient rows it shares with its
+  // neighbours again, strips of at least 4*radius rows bound this to half of
+  // the work, small images or large radii get fewer strips than threads
+  const size_t per_thread = (height + dt_get_num_threads() - 1) / dt_get_num_threads();
+  l.strip_height = MIN(height, MAX(per_thread, 4 * radius));
+  l.nstrips = (height + l.strip_height - 1) / l.strip_height;
+  // a strip never holds more coefficient rows than its own and its margins
+  l.ring_rows = MIN(2 * radius + 2, l.strip_height + 2 * radius);
+  // running sums, two rows of statistics and the ring of coefficient rows,
+  // each of them padded to whole cache lines as dt_alloc_aligned() does
+  const size_t ns = dt_round_size(P::NS * width, 16);
+  const size_t nc = dt_round_size(P::NC * width, 16);
+  l.strip_bytes = (ns + nc) * sizeof(double) + 2 * ns * sizeof(float)
+                  + dt_round_size(P::NC * width * l.ring_rows, 16) * sizeof(float);
+  return l;
+}
+
+template <class P>
+static size_t _guided_memory(const size_t width, const size_t height, const size_t radius)
+{
+  const _guided_layout l = _guided_strips<P>(width, height, radius);
+  return l.nstrips * l.strip_bytes;
+}
+
+// returns false, leaving the output untouched, if the workspace can't be
+// allocated
+template <class P>
+static bool _guided_filter(const P p,
+                           const size_t width,
+                           const size_t height,
+                           const size_t radius)
+{
+  const _guided_layout l = _guided_strips<P>(width, height, radius);
+  const size_t ns = dt_round_size(P::NS * width, 16);
+  const size_t nc = dt_round_size(P::NC * width, 16);
+  const size_t nring = dt_round_size(P::NC * width * l.ring_rows, 16);
+
+  // the workspaces of all strips are allocated before any output is written
+  double *const sums = dt_alloc_align_type(double, l.nstrips * (ns + nc));
+  float *const rows = dt_alloc_align_float(l.nstrips * (2 * ns + nring));
+  if(!sums || !rows)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[guided filter] unable to allocate %zu bytes of working memory",
+             l.nstrips * l.strip_bytes);
+    dt_free_align(sums);
+    dt_free_align(rows);
+    return false;
+  }
+
+  DT_OMP_FOR()
+  for(size_t s = 0; s < l.nstrips; s++)
+  {
+    const size_t y0 = s * l.strip_height;
+    const size_t y1 = MIN(y0 + l.strip_height, height);
+
+    double *const __restrict__ vs = sums + s * (ns + nc);
+    double *const __restrict__ vc = vs + ns;
+    float *const __restrict__ s_add = rows + s * (2 * ns + nring);
+    float *const __restrict__ s_sub = s_add + ns;
+    float *const __restrict__ ring = s_sub + ns;
+    memset(vs, 0, sizeof(double) * (ns + nc));
+    _guided_strip(p, width, height, radius, y0, y1, vs, vc, s_add, s_sub, ring, l.ring_rows);
+  }
+
+  dt_free_align(sums);
+  dt_free_align(rows);
+  return true;
+}
+
+// single-channel input guided by the first three channels of a color image
+// statistics: input, guide (r, g, b), guide * input (r, g, b), guide * guide (rr, rg, rb, gg, gb, bb)
+// coefficients: a_r, a_g, a_b, b
+struct _guided_rgb_model
+{
+  static constexpr size_t NS = 13;
+  static constexpr size_t NC = 4;
+
+  const float *guide;
+  const float *in;
+  float *out;
+  size_t ch;
+  size_t width;
+  float eps;
+  float guide_weight;
+  float min;
+  float max;
+
+  void stats(const size_t row, float *const __restrict__ s) const
+  {
+    const float *const __restrict__ g = guide + ch * width * row;
+    const float *const __restrict__ v = in + width * row;
+    for(size_t x = 0; x < width; x++)
+    {
+      const float r = g[ch * x] * guide_weight;
+      const float gr = g[ch * x + 1] * guide_weight;
+      const float b = g[ch * x + 2] * guide_weight;
+      const float inp = v[x];
+      float *const __restrict__ px = s + NS * x;
+      px[0] = inp;
+      px[1] = r;
+      px[2] = gr;
+      px[3] = b;
+      px[4] = r * inp;
+      px[5] = gr * inp;
+      px[6] = b * inp;
+      px[7] = r * r;
+      px[8] = r * gr;
+      px[9] = r * b;
+      px[10] = gr * gr;
+      px[11] = gr * b;
+      px[12] = b * b;
+    }
+  }
+
+  void solve(const double *const m, float *const c) const
+  {
+    const double inp_mean = m[0];
+    const double guide_r = m[1];
+    const double guide_g = m[2];
+    const double guide_b = m[3];
+    // solve linear system of equations of size 3x3 via Cramer's rule
+    // symmetric coefficient matrix
+    const float Sigma_0_0 = m[7] - guide_r * guide_r + eps;
+    const float Sigma_0_1 = m[8] - guide_r * guide_g;
+    const float Sigma_0_2 = m[9] - guide_r * guide_b;
+    const float Sigma_1_1 = m[10] - guide_g * guide_g + eps;
+    const float Sigma_1_2 = m[11] - guide_g * guide_b;
+    const float Sigma_2_2 = m[12] - guide_b * guide_b + eps;
+    const float det0 = Sigma_0_0 * (Sigma_1_1 * Sigma_2_2 - Sigma_1_2 * Sigma_1_2)
+      - Sigma_0_1 * (Sigma_0_1 * Sigma_2_2 - Sigma_0_2 * Sigma_1_2)
+      + Sigma_0_2 * (Sigma_0_1 * Sigma_1_2 - Sigma_0_2 * Sigma_1_1);
+    if(fabsf(det0) > 4.f * FLT_EPSILON)
+    {
+      const float cov_r = m[4] - guide_r * inp_mean;
+      const float cov_g = m[5] - guide_g * inp_mean;
+      const float cov_b = m[6] - guide_b * inp_mean;
+      const float det1 = cov_r * (Sigma_1_1 * Sigma_2_2 - Sigma_1_2 * Sigma_1_2)
+        - Sigma_0_1 * (cov_g * Sigma_2_2 - cov_b * Sigma_1_2)
+        + Sigma_0_2 * (cov_g * Sigma_1_2 - cov_b * Sigma_1_1);
+      const float det2 = Sigma_0_0 * (cov_g * Sigma_2_2 - cov_b * Sigma_1_2)
+        - cov_r * (Sigma_0_1 * Sigma_2_2 - Sigma_0_2 * Sigma_1_2)
+        + Sigma_0_2 * (Sigma_0_1 * cov_b - Sigma_0_2 * cov_g);
+      const float det3 = Sigma_0_0 * (Sigma_1_1 * cov_b - Sigma_1_2 * cov_g)
+        - Sigma_0_1 * (Sigma_0_1 * cov_b - Sigma_0_2 * cov_g)
+        + cov_r * (Sigma_0_1 * Sigma_1_2 - Sigma_0_2 * Sigma_1_1);
+      c[0] = det1 / det0;
+      c[1] = det2 / det0;
+      c[2] = det3 / det0;
+      c[3] = inp_mean - c[0] * guide_r - c[1] * guide_g - c[2] * guide_b;
+    }
+    else
+    {
+      // linear system is singular
+      c[0] = 0.f;
+      c[1] = 0.f;
+      c[2] = 0.f;
+      c[3] = inp_mean;
+    }
+  }
+
+  void output(const size_t row, const size_t x, const double *const m) const
+  {
+    const float *const px = guide + ch * (width * row + x);
+    const float res = guide_weight * (m[0] * px[0] + m[1] * px[1] + m[2] * px[2]) + m[3];
+    out[width * row + x] = CLAMP(res, min, max);
+  }
+};
+
+// single-channel mask guided by a single-channel image
+// statistics: guide, mask, guide * guide, guide * mask
+// coefficients: a, b
+struct _guided_gray_model
+{
+  static constexpr size_t NS = 4;
+  static constexpr size_t NC = 2;
+
+  const float *guide;
+  const float *mask;
+  float *ab;
+  size_t width;
+  float eps;
+
+  void stats(const size_t row, float *const __restrict__ s) const
+  {
+    const float *const __restrict__ g = guide + width * row;
+    const float *const __restrict__ v = mask + width * row;
+    DT_OMP_SIMD()
+    for(size_t x = 0; x < width; x++)
+    {
+      s[NS * x] = g[x];
+      s[NS * x + 1] = v[x];
+      s[NS * x + 2] = g[x] * g[x];
+      s[NS * x + 3] = g[x] * v[x];
+    }
+  }
+
+  void solve(const double *const m, float *const c) const
+  {
+    const double d = MAX(m[2] - m[0] * m[0] + eps, 1e-15); // avoid division by 0.
+    const double a = (m[3] - m[0] * m[1]) / d;
+    c[0] = a;
+    c[1] = m[1] - a * m[0];
+  }
+
+  void output(const size_t row, const size_t x, const double *const m) const
+  {
+    ab[NC * (width * row + x)] = m[0];
+    ab[NC * (width * row + x) + 1] = m[1];
+  }
+};
+
 void dt_box_mean(float *const buf,
                  const size_t height,
                  const size_t width,
@@ -630,60 +1011,46 @@ void dt_box_mean(float *const buf,
     dt_unreachable_codepath();
 }
 
-void dt_box_mean_horizontal(float *const __restrict__ buf,
-    const size_t width,
-    const uint32_t ch,
-    const size_t radius,
-    float *const __restrict__ user_scratch)
+gboolean dt_box_guided_filter(const float *const guide,
+                              const size_t ch,
+                              const float *const in,
+                              float *const out,
+                              const size_t width,
+                              const size_t height,
+                              const size_t radius,
+                              const float eps,
+                              const float guide_weight,
+                              const float min,
+                              const float max)
 {
-  if(ch == (4|BOXFILTER_KAHAN_SUM))
-  {
-    float *const __restrict__ scratch
-       = user_scratch ? user_scratch : dt_alloc_align_float(4 * dt_round_size(width, MAX_VECT));
-    if(scratch)
-    {
-      _blur_horizontal<4,true>(buf, width, radius, scratch);
-      if(!user_scratch)
-        dt_free_align(scratch);
-    }
-    else
-      dt_print(DT_DEBUG_ALWAYS, "[box_mean] unable to allocate scratch memory");
-  }
-  else if(ch == (9|BOXFILTER_KAHAN_SUM))
-  {
-    float *const __restrict__ scratch
-       = user_scratch ? user_scratch : dt_alloc_align_float(9 * dt_round_size(width, MAX_VECT));
-    if(scratch)
-    {
-      _blur_horizontal<9,true>(buf, width, radius, scratch);
-      if(!user_scratch)
-        dt_free_align(scratch);
-    }
-    else
-      dt_print(DT_DEBUG_ALWAYS, "[box_mean] unable to allocate scratch memory");
-  }
-  else
-    dt_unreachable_codepath();
+  const _guided_rgb_model model = { guide, in, out, ch, width, eps, guide_weight, min, max };
+  return _guided_filter(model, width, height, radius);
 }
 
-void dt_box_mean_vertical(float *const buf,
-    const size_t height,
-    const size_t width,
-    const uint32_t ch,
-    const size_t radius)
+size_t dt_box_guided_filter_memory(const size_t width,
+                                   const size_t height,
+                                   const size_t radius)
 {
-  if((ch & BOXFILTER_KAHAN_SUM) && (ch & ~BOXFILTER_KAHAN_SUM) <= 16)
-  {
-    size_t channels = ch & ~BOXFILTER_KAHAN_SUM;
-    size_t padded_size;
-    float *const __restrict__ scratch_buf = _alloc_scratch_space(channels, height, width, radius, &padded_size);
-    if(scratch_buf == NULL) return;
+  return _guided_memory<_guided_rgb_model>(width, height, radius);
+}
 
-    _blur_vertical_1ch<true>(buf, height, channels*width, radius, scratch_buf, padded_size);
-    dt_free_align(scratch_buf);
-  }
-  else
-    dt_unreachable_codepath();
+gboolean dt_box_guided_coefficients(const float *const guide,
+                                    const float *const mask,
+                                    float *const ab,
+                                    const size_t width,
+                                    const size_t height,
+                                    const size_t radius,
+                                    const float eps)
+{
+  const _guided_gray_model model = { guide, mask, ab, width, eps };
+  return _guided_filter(model, width, height, radius);
+}
+
+size_t dt_box_guided_coefficients_memory(const size_t width,
+                                         const size_t height,
+                                         const size_t radius)
+{
+  return _guided_memory<_guided_gray_model>(width, height, radius);
 }
 
 // in-place calculate the two-dimensional moving minimum over a box of size (2*radius+1) x (2*radius+1)
@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include <glib.h>
 #include <stdlib.h>
 #include <inttypes.h>
 
@@ -35,12 +36,23 @@ extern "C" {
 // ch = number of channels per pixel.  Supported values: 1, 2, 4, and 4|Kahan
 void dt_box_mean(float *const buf, const size_t height, const size_t width, const uint32_t ch,
                  const size_t radius, const uint32_t interations);
-// run a single iteration horizonally over a single row.  Supported values for ch: 4|Kahan
-// 'scratch' must point at a buffer large enough to hold ch*width floats, or be NULL
-void dt_box_mean_horizontal(float *const buf, const size_t width, const uint32_t ch, const size_t radius,
-                            float *const scratch);
-// run a single iteration vertically over the entire image.  Supported values for ch: 4|Kahan
-void dt_box_mean_vertical(float *const buf, const size_t height, const size_t width, const uint32_t ch, const size_t radius);
+
+// guided filter of the single-channel image 'in' by the first three channels of the ch-channel image 'guide'
+// (scaled by guide_weight) over a window of size 2*radius+1, with regularization eps, the output is clamped
+// to [min, max].  Runs in a single streaming pass without tiling, at a cost per pixel independent of radius.
+// Returns FALSE, with 'out' untouched, if its working memory can't be allocated.
+gboolean dt_box_guided_filter(const float *const guide, const size_t ch, const float *const in, float *const out,
+                              const size_t width, const size_t height, const size_t radius, const float eps,
+                              const float guide_weight, const float min, const float max);
+// bytes of working memory taken by dt_box_guided_filter(), for the tiling callbacks
+size_t dt_box_guided_filter_memory(const size_t width, const size_t height, const size_t radius);
+// box means of the coefficients a and b of the guided filter of the single-channel 'mask' by the
+// single-channel 'guide' (mask ~ a * guide + b), written interleaved to 'ab' (2 floats per pixel).
+// Returns FALSE, with 'ab' untouched, if its working memory can't be allocated.
+gboolean dt_box_guided_coefficients(const float *const guide, const float *const mask, float *const ab,
+                                    const size_t width, const size_t height, const size_t radius, const float eps);
+// bytes of working memory taken by dt_box_guided_coefficients()
+size_t dt_box_guided_coefficients_memory(const size_t width, const size_t height, const size_t radius);
 
 void dt_box_min(float *const buf, const size_t height, const size_t width, const uint32_t ch, const size_t radius);
 void dt_box_max(float *const buf, const size_t height, const size_t width, const uint32_t ch, const size_t radius);
@@ -20,6 +20,8 @@
 
 #include "common/darktable.h"
 #include "common/dwt.h"
+#include "common/half.h"
+#include "common/wavelets.h"
 #include "develop/openmp_maths.h"
 
 // Define the following as TRUE to use nontemporal writes in the decomposition
@@ -219,6 +221,51 @@ inline static void decompose_2D_Bspline(const float *const in,
 #endif
 }
 
+DT_OMP_DECLARE_SIMD(aligned(in, LF:64) aligned(tempbuf:16))
+inline static void decompose_2D_Bspline_half(const float *const in,
+                                             uint16_t *const HF,
+                                             float *const restrict LF,
+                                             const size_t width,
+                                             const size_t height,
+                                             const int mult,
+                                             float *const tempbuf,
+                                             const size_t padded_size)
+{
+  // same as decompose_2D_Bspline() but store the HF as half floats
+  DT_OMP_FOR()
+  for(size_t row = 0; row < height; row++)
+  {
+    float *restrict const temp = dt_get_perthread(tempbuf, padded_size);
+    const size_t i = dwt_interleave_rows(row, height, mult);
+    _bspline_vertical_pass(in, temp, i, width, height, mult, TRUE); // always clip negatives
+    for(size_t j = 0; j < width; j++)
+    {
+      const size_t index = 4U * (i * width + j);
+      _bspline_horizontal(temp, LF + index, j, width, mult, TRUE); // always clip negatives
+      for_four_channels(c)
+        HF[index + c] = dt_float_to_half(in[index + c] - LF[index + c]);
+    }
+  }
+}
+
+// blur in with the scale s filter into LF and keep the details in scale s
+// of 4 channels, full size bands
+static inline void dt_bspline_decompose_band(const float *const in,
+                                             const dt_wavelet_bands_t *const bands,
+                                             const int s,
+                                             float *const restrict LF,
+                                             float *const tempbuf,
+                                             const size_t padded_size)
+{
+  const int mult = 1 << s;
+  if(bands->storage == DT_WAVELET_STORAGE_HALF)
+    decompose_2D_Bspline_half(in, bands->band[s], LF, bands->width, bands->height,
+                              mult, tempbuf, padded_size);
+  else
+    decompose_2D_Bspline(in, bands->band[s], LF, bands->width, bands->height,
+                         mult, tempbuf, padded_size);
+}
+
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
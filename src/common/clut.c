@@ -0,0 +1,199 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/clut.h"
+
+dt_hash_t dt_clut_icc_hash_profile(dt_hash_t hash, cmsHPROFILE profile)
+{
+  cmsUInt32Number size = 0;
+  if(!profile || !cmsSaveProfileToMem(profile, NULL, &size) || size == 0)
+    return hash;
+
+  void *buf = g_malloc(size);
+  if(cmsSaveProfileToMem(profile, buf, &size))
+    hash = dt_hash(hash, buf, size);
+  g_free(buf);
+  return hash;
+}
+
+// the input of the transform at node i of an axis
+static inline void _node_input(const dt_clut_icc_input_t input,
+                               const float *const u,
+                               float *const px)
+{
+  if(input == DT_CLUT_ICC_LAB)
+  {
+    px[0] = 100.0f * u[0];
+    px[1] = 256.0f * u[1] - 128.0f;
+    px[2] = 256.0f * u[2] - 128.0f;
+  }
+  else
+  {
+    for(int c = 0; c < 3; c++) px[c] = u[c] * u[c];
+  }
+  px[3] = 0.0f;
+}
+
+dt_clut_icc_t *dt_clut_icc_new(const dt_clut_icc_input_t input,
+                               cmsHTRANSFORM xform,
+                               cmsHTRANSFORM xform2)
+{
+  if(!xform) return NULL;
+
+  const double start = dt_get_debug_wtime();
+  const int level = DT_CLUT_ICC_LEVEL;
+  const size_t level2 = (size_t)level * level;
+  dt_clut_icc_t *lut = (dt_clut_icc_t *)calloc(1, sizeof(dt_clut_icc_t));
+  // the tetrahedral interpolation reads 4 floats of the last node
+  float *clut = dt_alloc_align_float(3 * level2 * level + 1);
+  size_t padded_size;
+  float *slices = dt_alloc_perthread_float(4 * level2, &padded_size);
+  if(!lut || !clut || !slices)
+  {
+    free(lut);
+    dt_free_align(clut);
+    dt_free_align(slices);
+    return NULL;
+  }
+
+  const float step = 1.0f / (level - 1);
+
+  // one slice of constant third coordinate per call of the transform
+  DT_OMP_FOR()
+  for(int b = 0; b < level; b++)
+  {
+    float *const restrict px = dt_get_perthread(slices, padded_size);
+    for(int g = 0; g < level; g++)
+      for(int r = 0; r < level; r++)
+      {
+        const float u[3] = { r * step, g * step, b * step };
+        _node_input(input, u, px + 4 * ((size_t)g * level + r));
+      }
+
+    cmsDoTransform(xform, px, px, level2);
+    if(xform2)
+    {
+      for(size_t k = 0; k < level2; k++)
+        dt_vector_clip(px + 4 * k);
+      cmsDoTransform(xform2, px, px, level2);
+    }
+
+    float *const restrict out = clut + 3 * level2 * b;
+    for(size_t k = 0; k < level2; k++)
+      for(int c = 0; c < 3; c++)
+        out[3 * k + c] = px[4 * k + c];
+  }
+  clut[3 * level2 * level] = 0.0f;
+  dt_free_align(slices);
+
+  lut->input = input;
+  lut->level = level;
+  lut->clut = clut;
+
+  dt_print(DT_DEBUG_PERF, "[clut icc] baked %d^3 nodes in %.3fs",
+           level, dt_get_debug_wtime() - start);
+  return lut;
+}
+
+void dt_clut_icc_free(dt_clut_icc_t *lut)
+{
+  if(!lut) return;
+  dt_free_align(lut->clut);
+  free(lut);
+}
+
+void dt_clut_icc_apply(const dt_clut_icc_t *lut,
+                       const float *const in,
+                       float *const out,
+                       const size_t npixels)
+{
+  const float *const restrict clut = lut->clut;
+  const int level = lut->level;
+  if(lut->input == DT_CLUT_ICC_LAB)
+  {
+    static const dt_aligned_pixel_t offset = { 0.0f, 128.0f, 128.0f, 0.0f };
+    static const dt_aligned_pixel_t scale = { 1.0f / 100.0f, 1.0f / 256.0f, 1.0f / 256.0f, 1.0f };
+    for(size_t k = 0; k < 4 * npixels; k += 4)
+    {
+      dt_aligned_pixel_t u;
+      for_each_channel(c)
+        u[c] = (in[k + c] + offset[c]) * scale[c];
+      dt_clut_tetrahedral(u, out + k, clut, level);
+    }
+  }
+  else
+  {
+    for(size_t k = 0; k < 4 * npixels; k += 4)
+    {
+      dt_aligned_pixel_t u;
+      for_each_channel(c)
+        u[c] = sqrtf(MAX(in[k + c], 0.0f));
+      u[3] = in[k + 3];
+      dt_clut_tetrahedral(u, out + k, clut, level);
+    }
+  }
+}
+
+static void _clut_free(dt_lru_item_t *item)
+{
+  dt_clut_icc_free((dt_clut_icc_t *)item);
+}
+
+void dt_clut_icc_cache_init(dt_clut_icc_cache_t *cache)
+{
+  dt_lru_cache_init(&cache->lru, DT_CLUT_ICC_CACHE_SIZE, 0, _clut_free);
+}
+
+void dt_clut_icc_cache_cleanup(dt_clut_icc_cache_t *cache)
+{
+  dt_lru_cache_cleanup(&cache->lru);
+}
+
+static float _match(const dt_lru_item_t *item,
+                    const void *key)
+{
+  const dt_clut_icc_input_t *input = key;
+  return ((const dt_clut_icc_t *)item)->input == *input ? 0.0f : -1.0f;
+}
+
+dt_clut_icc_t *dt_clut_icc_cache_get(dt_clut_icc_cache_t *cache,
+                                     const dt_hash_t hash,
+                                     const dt_clut_icc_input_t input,
+                                     cmsHTRANSFORM xform,
+                                     cmsHTRANSFORM xform2)
+{
+  dt_lru_item_t *item = dt_lru_cache_get(&cache->lru, hash, _match, &input);
+  if(item) return (dt_clut_icc_t *)item;
+
+  // baked without the lock, the pipes needing other cluts don't wait
+  dt_clut_icc_t *baked = dt_clut_icc_new(input, xform, xform2);
+  if(!baked) return NULL;
+  return (dt_clut_icc_t *)dt_lru_cache_put(&cache->lru, hash, _match, &input, &baked->item);
+}
+
+void dt_clut_icc_cache_release(dt_clut_icc_cache_t *cache,
+                               dt_clut_icc_t *lut)
+{
+  if(lut) dt_lru_cache_release(&cache->lru, &lut->item);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,199 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/darktable.h"
+#include "common/lru_cache.h"
+#include "common/math.h"
+
+#include <lcms2.h>
+
+G_BEGIN_DECLS
+
+/* 3D color lookup tables.
+
+   A clut of level nodes per axis holds 3 floats per node, the first
+   coordinate running fastest. Pixels are interpolated in the tetrahedron
+   of their cube, see dt_clut_tetrahedral().
+
+   The LittleCMS transforms which darktable can't turn into a matrix, LUT
+   based camera profiles for instance, are baked into such a clut with
+   dt_clut_icc_new(): the transform is evaluated once per node and the
+   pixels are interpolated afterwards, which is much cheaper than
+   evaluating the profile pipeline for each of them. The input is clipped
+   to the domain of the clut:
+
+   DT_CLUT_ICC_RGB  RGB in [0, 1], the nodes are spaced on a square root
+                    scale so that the shadows of linear data get more of them
+   DT_CLUT_ICC_LAB  Lab with L in [0, 100], a and b in [-128, 128]
+
+   A dt_clut_icc_cache_t keeps the cluts of the last transforms used, so
+   that the pipes and the history changes using the same profiles bake
+   them only once.
+*/
+
+#define DT_CLUT_ICC_LEVEL 65
+#define DT_CLUT_ICC_CACHE_SIZE 4
+
+typedef enum dt_clut_icc_input_t
+{
+  DT_CLUT_ICC_RGB = 0,
+  DT_CLUT_ICC_LAB = 1,
+} dt_clut_icc_input_t;
+
+typedef struct dt_clut_icc_t
+{
+  dt_lru_item_t item; // identified by the hash of the transforms
+  dt_clut_icc_input_t input;
+  int level;
+  float *clut;
+} dt_clut_icc_t;
+
+typedef struct dt_clut_icc_cache_t
+{
+  dt_lru_cache_t lru;
+} dt_clut_icc_cache_t;
+
+// from OpenColorIO
+// https://github.com/imageworks/OpenColorIO/blob/master/src/OpenColorIO/ops/Lut3D/Lut3DOp.cpp
+// in is in [0, 1], the alpha channel is passed through. in and out may be the same.
+static inline void dt_clut_tetrahedral(const float *const in,
+                                       float *const out,
+                                       const float *const restrict clut,
+                                       const int level)
+{
+  const size_t level2 = (size_t)level * level;
+  const size_t level1_stride = 3 * (size_t)level;
+  const size_t level2_stride = 3 * level2;
+  const size_t level12_stride = 3 * (level + level2);
+  const float flevel_1 = (float)(level - 1);
+
+  dt_aligned_pixel_t rgbi;
+  dt_aligned_pixel_t rgbd;
+  for_each_channel(c)
+    rgbd[c] = CLIP(in[c]) * flevel_1;
+
+  for_each_channel(c)
+  {
+    rgbi[c] = CLAMP((int)rgbd[c], 0, level - 2);
+    rgbd[c] = rgbd[c] - rgbi[c]; // delta red/green/blue
+  }
+
+  // indexes of P000 to P111 in clut
+  const size_t color = rgbi[0] + rgbi[1] * level + rgbi[2] * level2;
+  const size_t i000 = color * 3;                     // P000
+  const size_t i100 = i000 + 3;                      // P100
+  const size_t i010 = i000 + level1_stride;          // P010
+  const size_t i110 = i010 + 3;                      // P110
+  const size_t i001 = i000 + level2_stride;          // P001
+  const size_t i101 = i001 + 3;                      // P101
+  const size_t i011 = i000 + level12_stride;         // P011
+  const size_t i111 = i011 + 3;                      // P111
+
+  dt_aligned_pixel_t output;
+  if(rgbd[0] > rgbd[1])
+  {
+    if(rgbd[1] > rgbd[2])
+    {
+      // rgbd[0] > rgbd[1] > rgbd[2]
+      for_each_channel(c, aligned(output))
+        output[c] = ((1-rgbd[0])*clut[i000+c] + (rgbd[0]-rgbd[1])*clut[i100+c]
+                    + (rgbd[1]-rgbd[2])*clut[i110+c] + rgbd[2]*clut[i111+c]);
+    }
+    else if(rgbd[0] > rgbd[2])
+    {
+      // rgbd[0] > rgbd[2] >= rgbd[1]
+      for_each_channel(c, aligned(output))
+        output[c] = ((1-rgbd[0])*clut[i000+c] + (rgbd[0]-rgbd[2])*clut[i100+c]
+                    + (rgbd[2]-rgbd[1])*clut[i101+c] + rgbd[1]*clut[i111+c]);
+    }
+    else
+    {
+      // rgbd[2] >= rgbd[0] > rgbd[2]
+      for_each_channel(c, aligned(output))
+        output[c] = ((1-rgbd[2])*clut[i000+c] + (rgbd[2]-rgbd[0])*clut[i001+c]
+                    + (rgbd[0]-rgbd[1])*clut[i101+c] + rgbd[1]*clut[i111+c]);
+    }
+  }
+  else
+  {
+    if(rgbd[2] > rgbd[1])
+    {
+      // rgbd[2] > rgbd[1] >= rgbd[0]
+      for_each_channel(c, aligned(output))
+        output[c] = ((1-rgbd[2])*clut[i000+c] + (rgbd[2]-rgbd[1])*clut[i001+c]
+                    + (rgbd[1]-rgbd[0])*clut[i011+c] + rgbd[0]*clut[i111+c]);
+    }
+    else if(rgbd[2] > rgbd[0])
+    {
+      // rgbd[1] >= rgbd[2] > rgbd[0]
+      for_each_channel(c, aligned(output))
+        output[c] = ((1-rgbd[1])*clut[i000+c] + (rgbd[1]-rgbd[2])*clut[i010+c]
+                    + (rgbd[2]-rgbd[0])*clut[i011+c] + rgbd[0]*clut[i111+c]);
+    }
+    else
+    {
+      // rgbd[1] >= rgbd[0] >= rgbd[2]
+      for_each_channel(c, aligned(output))
+        output[c] = ((1-rgbd[1])*clut[i000+c] + (rgbd[1]-rgbd[0])*clut[i010+c]
+                    + (rgbd[0]-rgbd[2])*clut[i110+c] + rgbd[2]*clut[i111+c]);
+    }
+  }
+  output[3] = in[3];
+  copy_pixel(out, output);
+}
+
+// the hash of the profile contents, to identify the cluts baked from it
+dt_hash_t dt_clut_icc_hash_profile(dt_hash_t hash, cmsHPROFILE profile);
+
+// bakes xform, a float transform from RGBA or LabA to 4 floats per pixel.
+// If xform2 is given, the output of xform is clipped to [0, 1] and fed
+// to xform2. NULL if out of memory.
+dt_clut_icc_t *dt_clut_icc_new(const dt_clut_icc_input_t input,
+                               cmsHTRANSFORM xform,
+                               cmsHTRANSFORM xform2);
+void dt_clut_icc_free(dt_clut_icc_t *lut);
+
+// interpolates npixels of 4 floats, the alpha channel is passed through.
+// in and out may be the same. Not threaded, called from the loops of the modules.
+void dt_clut_icc_apply(const dt_clut_icc_t *lut,
+                       const float *const in,
+                       float *const out,
+                       const size_t npixels);
+
+void dt_clut_icc_cache_init(dt_clut_icc_cache_t *cache);
+void dt_clut_icc_cache_cleanup(dt_clut_icc_cache_t *cache);
+
+// the clut of the transforms identified by hash, baked on first use. The
+// caller releases it after use, NULL if out of memory.
+dt_clut_icc_t *dt_clut_icc_cache_get(dt_clut_icc_cache_t *cache,
+                                     const dt_hash_t hash,
+                                     const dt_clut_icc_input_t input,
+                                     cmsHTRANSFORM xform,
+                                     cmsHTRANSFORM xform2);
+void dt_clut_icc_cache_release(dt_clut_icc_cache_t *cache,
+                               dt_clut_icc_t *lut);
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,62 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/cpu_dispatch.h"
+
+static const char *_level_names[DT_CPU_LEVEL_LAST] = { "baseline", "avx2", "avx512" };
+
+dt_cpu_level_t dt_cpu_detect_level(void)
+{
+#if DT_CPU_DISPATCH_X86
+  // the builtins also check that the OS saves the extended registers
+  __builtin_cpu_init();
+  const gboolean avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  if(avx2
+     && __builtin_cpu_supports("avx512f")
+     && __builtin_cpu_supports("avx512vl")
+     && __builtin_cpu_supports("avx512bw")
+     && __builtin_cpu_supports("avx512dq"))
+    return DT_CPU_LEVEL_AVX512;
+  if(avx2)
+    return DT_CPU_LEVEL_AVX2;
+#endif
+  return DT_CPU_LEVEL_BASELINE;
+}
+
+dt_cpu_level_t dt_cpu_select_level(const dt_cpu_level_t detected,
+                                   const char *setting)
+{
+  if(setting)
+    for(int level = DT_CPU_LEVEL_BASELINE; level < DT_CPU_LEVEL_LAST; level++)
+      if(!g_strcmp0(setting, _level_names[level]))
+        return MIN(detected, (dt_cpu_level_t)level);
+  return detected;
+}
+
+const char *dt_cpu_level_name(const dt_cpu_level_t level)
+{
+  return level >= DT_CPU_LEVEL_BASELINE && level < DT_CPU_LEVEL_LAST
+    ? _level_names[level]
+    : "unknown";
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,72 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/darktable.h"
+
+G_BEGIN_DECLS
+
+/* Runtime selection of the instruction set for the hot kernels.
+ *
+ * __DT_CLONE_TARGETS__ lets the compiler clone a function for several
+ * targets, but the clones are picked per call through an ifunc, which
+ * is only available with glibc, and the OpenMP regions of a clone are
+ * not always compiled for its target. The kernels using this mechanism
+ * are instead compiled once per level into plain functions (see
+ * common/cpu_variants.h), the level is decided once in dt_init() from
+ * the cpu features and the codepaths/cpu_level setting, and the public
+ * entry point calls the matching variant through DT_CPU_DISPATCH().
+ *
+ * The variants are compiled from the same C code, so they differ only
+ * by the rounding of fused multiply-adds and of the vectorized
+ * reductions. */
+
+#if (defined(__x86_64__) || defined(__amd64__)) && !defined(_WIN32) && !defined(NATIVE_ARCH) \
+  && (defined(__GNUC__) || defined(__clang__))
+#define DT_CPU_DISPATCH_X86 1
+#else
+#define DT_CPU_DISPATCH_X86 0
+#endif
+
+#if DT_CPU_DISPATCH_X86
+#define DT_CPU_DISPATCH(fn)                                               \
+  (darktable.codepath.cpu_level >= DT_CPU_LEVEL_AVX512 ? fn##_avx512      \
+   : darktable.codepath.cpu_level >= DT_CPU_LEVEL_AVX2 ? fn##_avx2        \
+   : fn##_baseline)
+#else
+#define DT_CPU_DISPATCH(fn) fn##_baseline
+#endif
+
+/** the best level supported by the cpu and the operating system */
+dt_cpu_level_t dt_cpu_detect_level(void);
+
+/** the level to use given the detected one and the user setting
+ * ("auto", "baseline", "avx2" or "avx512"), never above the detected one */
+dt_cpu_level_t dt_cpu_select_level(const dt_cpu_level_t detected,
+                                   const char *setting);
+
+const char *dt_cpu_level_name(const dt_cpu_level_t level);
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
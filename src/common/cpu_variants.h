@@ -0,0 +1,101 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Compiles the kernels of the file named by DT_CPU_KERNELS once for each
+ * level of dt_cpu_level_t. No include guard, this is meant to be included
+ * once per kernel file:
+ *
+ *   #define DT_CPU_KERNELS "common/kernels/foo.c"
+ *   #include "common/cpu_variants.h"
+ *
+ * The kernel file declares its functions static with DT_CPU_VARIANT(name),
+ * which yields name_baseline, name_avx2 and name_avx512, and must #undef
+ * any macro it defines. The target is set with a pragma around the whole
+ * file rather than with an attribute, so that the functions outlined by
+ * OpenMP from the parallel loops get compiled for the same target. Helpers
+ * defined before the inclusion are inlined into each variant.
+ *
+ * Floating point contraction is disabled for all variants: fused
+ * multiply-adds would only be emitted by some levels (the avx512 target
+ * has them even without fma, and so has the baseline built for a native
+ * cpu) and each level would round differently. With it off the levels
+ * give the same results and only differ by their speed. */
+
+#ifndef DT_CPU_KERNELS
+#error "DT_CPU_KERNELS must name the file holding the kernels"
+#endif
+
+#if defined(__clang__)
+#pragma float_control(push)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off", "no-unsafe-math-optimizations")
+#endif
+
+#define DT_CPU_VARIANT(fn) fn##_baseline
+#include DT_CPU_KERNELS
+#undef DT_CPU_VARIANT
+
+#if DT_CPU_DISPATCH_X86
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+#define DT_CPU_VARIANT(fn) fn##_avx2
+#include DT_CPU_KERNELS
+#undef DT_CPU_VARIANT
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx512f,avx512vl,avx512bw,avx512dq,avx2"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512vl,avx512bw,avx512dq,avx2")
+#endif
+#define DT_CPU_VARIANT(fn) fn##_avx512
+#include DT_CPU_KERNELS
+#undef DT_CPU_VARIANT
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#endif /* DT_CPU_DISPATCH_X86 */
+
+#if defined(__clang__)
+#pragma float_control(pop)
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#undef DT_CPU_KERNELS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -27,6 +27,7 @@
 
 #include "common/collection.h"
 #include "common/colorspaces.h"
+#include "common/cpu_dispatch.h"
 #include "common/darktable.h"
 #include "common/datetime.h"
 #include "common/exif.h"
@@ -43,6 +44,7 @@
 #include "common/grealpath.h"
 #include "common/image.h"
 #include "common/image_cache.h"
+#include "common/interpolation.h"
 #include "common/iop_order.h"
 #include "common/l10n.h"
 #include "common/mipmap_cache.h"
@@ -194,6 +196,13 @@ static int usage(const char *argv0)
          "    :memory: -> Use this option as FILE to keep the database in system memory,\n"
          "    discarding changes on darktable termination.\n"
          "\n"
+         "--library-readonly\n"
+         "    Open the library and data databases read-only without taking the lock,\n"
+         "    so that several headless processes (darktable-cli, darktable-mcp) can\n"
+         "    render from a library while another darktable instance is using it.\n"
+         "    Nothing is written back: history, sidecar files, image information and\n"
+         "    thumbnails on disk are left untouched. Not available with the GUI.\n"
+         "\n"
          "--localedir DIR\n"
          "    Define where darktable can find its language-specific text\n"
          "    strings. The default location depends on your installation.\n"
@@ -509,6 +518,13 @@ static void dt_codepaths_init()
 
   // do we have any intrinsics sets enabled? (nope)
   darktable.codepath._no_intrinsics = 1;
+
+  // instruction set of the kernels dispatched at runtime, see common/cpu_dispatch.h
+  const dt_cpu_level_t detected = dt_cpu_detect_level();
+  darktable.codepath.cpu_level =
+    dt_cpu_select_level(detected, dt_conf_get_string_const("codepaths/cpu_level"));
+  dt_print(DT_DEBUG_PERF, "[dt_codepaths_init] cpu kernels level: %s (detected %s)",
+           dt_cpu_level_name(darktable.codepath.cpu_level), dt_cpu_level_name(detected));
 }
 
 static inline size_t _get_total_memory()
@@ -1022,6 +1038,7 @@ int dt_init(int argc,
 
   // database
   char *dbfilename_from_command = NULL;
+  gboolean db_readonly_from_command = FALSE;
   char *noiseprofiles_from_command = NULL;
   char *datadir_from_command = NULL;
   char *moduledir_from_command = NULL;
@@ -1110,6 +1127,11 @@ int dt_init(int argc,
         argv[k-1] = NULL;
         argv[k] = NULL;
       }
+      else if(!strcmp(argv[k], "--library-readonly"))
+      {
+        db_readonly_from_command = TRUE;
+        argv[k] = NULL;
+      }
       else if(!strcmp(argv[k], "--datadir") && argc > k + 1)
       {
         datadir_from_command = argv[++k];
@@ -1737,7 +1759,14 @@ int dt_init(int argc,
 
   // initialize the database
   dt_splash_screen_set_progress(_("opening image library"));
-  darktable.db = dt_database_init(dbfilename_from_command, load_data, init_gui);
+  if(db_readonly_from_command && init_gui)
+  {
+    dt_print(DT_DEBUG_ALWAYS,
+             "[dt_init] --library-readonly is only supported without GUI, ignored");
+    db_readonly_from_command = FALSE;
+  }
+  darktable.db = dt_database_init(dbfilename_from_command, load_data, init_gui,
+                                  db_readonly_from_command);
   if(darktable.db == NULL)
   {
     dt_print(DT_DEBUG_ALWAYS, "ERROR : cannot open database");
@@ -2283,6 +2312,7 @@ void dt_cleanup()
 
   dt_image_cache_cleanup();
   dt_mipmap_cache_cleanup();
+  dt_interpolation_cleanup();
 
   dt_colorspaces_cleanup(darktable.color_profiles);
 #ifdef HAVE_AI
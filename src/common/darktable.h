@@ -396,9 +396,19 @@ typedef enum dt_debug_thread_t
   DT_DEBUG_RESTRICT       = DT_DEBUG_VERBOSE | DT_DEBUG_PERF,
 } dt_debug_thread_t;
 
+// instruction set levels of the kernels dispatched at runtime, see common/cpu_dispatch.h
+typedef enum dt_cpu_level_t
+{
+  DT_CPU_LEVEL_BASELINE = 0,
+  DT_CPU_LEVEL_AVX2 = 1,   // AVX2 + FMA
+  DT_CPU_LEVEL_AVX512 = 2, // AVX-512 F/VL/BW/DQ
+  DT_CPU_LEVEL_LAST
+} dt_cpu_level_t;
+
 typedef struct dt_codepath_t
 {
   unsigned int _no_intrinsics : 1;
+  dt_cpu_level_t cpu_level;
 } dt_codepath_t;
 
 typedef struct dt_sys_resources_t
@@ -63,6 +63,9 @@ typedef struct dt_database_t
 {
   gboolean lock_acquired;
 
+  /* opened as a read-only snapshot, see dt_database_init() */
+  gboolean read_only;
+
   /* data database filename */
   gchar *dbfilename_data, *lockfile_data;
 
@@ -4171,6 +4174,90 @@ static void _ask_for_upgrade(const gchar *dbname,
   }
 }
 
+// the write-ahead log and its index of a database in WAL mode. they
+// belong to the main file: sqlite applies a -wal it finds next to a
+// database, so they must be copied, moved and deleted with it.
+static const char *_database_sidecars[] = { "-wal", "-shm" };
+
+// delete filename and its WAL files, returns the result of the main file
+static int _database_unlink(const char *filename)
+{
+  for(int k = 0; k < G_N_ELEMENTS(_database_sidecars); k++)
+  {
+    gchar *sidecar = g_strconcat(filename, _database_sidecars[k], NULL);
+    if(g_file_test(sidecar, G_FILE_TEST_EXISTS) && g_unlink(sidecar))
+      dt_print(DT_DEBUG_ALWAYS, "[init] can't delete `%s'", sidecar);
+    g_free(sidecar);
+  }
+  return g_unlink(filename);
+}
+
+// write the WAL of a database which is not opened yet back into its
+// main file, so that a plain copy of the file holds every commit. this
+// also covers a WAL left behind by a crash. returns FALSE if a -wal
+// still exists afterwards, e.g. if another process is using the file.
+static gboolean _database_checkpoint_file(const char *filename)
+{
+  gchar *wal = g_strconcat(filename, "-wal", NULL);
+  gboolean done = !g_file_test(wal, G_FILE_TEST_EXISTS);
+  if(!done)
+  {
+    sqlite3 *handle = NULL;
+    if(sqlite3_open_v2(filename, &handle, SQLITE_OPEN_READWRITE, NULL) == SQLITE_OK)
+    {
+      // the pragma, unlike sqlite3_wal_checkpoint_v2(), first reads the
+      // database and so opens its WAL
+      const int rc = sqlite3_exec(handle, "PRAGMA main.wal_checkpoint(TRUNCATE)", NULL, NULL, NULL);
+      if(rc != SQLITE_OK)
+        dt_print(DT_DEBUG_ALWAYS, "[backup] can't checkpoint `%s': %s",
+                 filename, sqlite3_errmsg(handle));
+    }
+    // closing the last connection of a WAL database also removes its -wal
+    sqlite3_close(handle);
+    done = !g_file_test(wal, G_FILE_TEST_EXISTS);
+  }
+  g_free(wal);
+  return done;
+}
+
+// copy a database which is not opened with its -wal, if one remains. the
+// -shm index is rebuilt by sqlite from the -wal, a stale one next to the
+// copy is deleted.
+static gboolean _database_copy(const char *filename, const char *copy, GError **gerror)
+{
+  gboolean copy_status = TRUE;
+  for(int k = 0; k < G_N_ELEMENTS(_database_sidecars) && copy_status; k++)
+  {
+    gchar *sidecar = g_strconcat(filename, _database_sidecars[k], NULL);
+    gchar *copy_sidecar = g_strconcat(copy, _database_sidecars[k], NULL);
+    if(!g_strcmp0(_database_sidecars[k], "-wal") && g_file_test(sidecar, G_FILE_TEST_EXISTS))
+    {
+      GFile *src = g_file_new_for_path(sidecar);
+      GFile *dest = g_file_new_for_path(copy_sidecar);
+      copy_status = g_file_copy(src, dest, G_FILE_COPY_OVERWRITE, NULL, NULL, NULL, gerror);
+      g_object_unref(src);
+      g_object_unref(dest);
+    }
+    else if(g_file_test(copy_sidecar, G_FILE_TEST_EXISTS))
+    {
+      // a stale journal would be applied to the copy
+      copy_status = g_unlink(copy_sidecar) == 0;
+    }
+    g_free(sidecar);
+    g_free(copy_sidecar);
+  }
+
+  if(copy_status)
+  {
+    GFile *src = g_file_new_for_path(filename);
+    GFile *dest = g_file_new_for_path(copy);
+    copy_status = g_file_copy(src, dest, G_FILE_COPY_NONE, NULL, NULL, NULL, gerror);
+    g_object_unref(src);
+    g_object_unref(dest);
+  }
+  return copy_status;
+}
+
 void dt_database_backup(const char *filename)
 {
   char *version = g_strdup(darktable_package_version);
@@ -4191,12 +4278,15 @@ void dt_database_backup(const char *filename)
   GError *gerror = NULL;
   if(!g_file_test(backup, G_FILE_TEST_EXISTS))
   {
-    GFile *src = g_file_new_for_path(filename);
-    GFile *dest = g_file_new_for_path(backup);
     gboolean copy_status = TRUE;
     if(g_file_test(filename, G_FILE_TEST_EXISTS))
     {
-      copy_status = g_file_copy(src, dest, G_FILE_COPY_NONE, NULL, NULL, NULL, &gerror);
+      // commits not yet checkpointed, e.g. after a crash, are only in the
+      // -wal. if it can't be written back it is copied along.
+      if(!_database_checkpoint_file(filename))
+        dt_print(DT_DEBUG_ALWAYS, "[backup] `%s' keeps its write-ahead log, copying it too",
+                 filename);
+      copy_status = _database_copy(filename, backup, &gerror);
     }
     else
     {
@@ -4206,9 +4296,6 @@ void dt_database_backup(const char *filename)
     }
     if(!copy_status)
       dt_print(DT_DEBUG_ALWAYS, "[backup failed] %s -> %s", filename, backup);
-
-    g_object_unref(src);
-    g_object_unref(dest);
   }
 
   g_free(version);
@@ -4257,9 +4344,144 @@ gchar* _get_pragma_string_val(sqlite3 *db,
   return val;
 }
 
+// WAL needs shared memory between the connections, which is not
+// reliable on network filesystems, see https://www.sqlite.org/wal.html
+static gboolean _database_on_remote_fs(const char *filename)
+{
+  if(!g_strcmp0(filename, ":memory:"))
+    return FALSE;
+
+  gchar *dirname = g_path_get_dirname(filename);
+  GFile *dir = g_file_new_for_path(dirname);
+  g_free(dirname);
+
+  gboolean remote = FALSE;
+  GFileInfo *info =
+    g_file_query_filesystem_info(dir,
+                                 G_FILE_ATTRIBUTE_FILESYSTEM_REMOTE ","
+                                 G_FILE_ATTRIBUTE_FILESYSTEM_TYPE,
+                                 NULL, NULL);
+  if(info)
+  {
+    remote = g_file_info_get_attribute_boolean(info, G_FILE_ATTRIBUTE_FILESYSTEM_REMOTE);
+    dt_print(DT_DEBUG_SQL, "[init sql] `%s' is on a %s filesystem (%s)",
+             filename, remote ? "remote" : "local",
+             g_file_info_get_attribute_string(info, G_FILE_ATTRIBUTE_FILESYSTEM_TYPE));
+    g_object_unref(info);
+  }
+  g_object_unref(dir);
+
+  return remote;
+}
+
+// switch one of the attached databases (main or data) to WAL journaling
+// if requested and possible, else keep the memory journal. each database
+// is decided on its own, a WAL library never forces its data database
+// and the other way round. returns TRUE for WAL.
+static gboolean _database_configure_journal(const dt_database_t *db,
+                                            const char *schema,
+                                            const char *filename,
+                                            const gboolean want_wal)
+{
+  gboolean wal = FALSE;
+
+  if(want_wal && _database_on_remote_fs(filename))
+  {
+    dt_print(DT_DEBUG_ALWAYS,
+             "[init] database `%s' on a network filesystem, not using WAL journaling",
+             filename);
+  }
+  else if(want_wal)
+  {
+    // :memory: databases silently stay with the memory journal
+    gchar *pragma = g_strdup_printf("%s.journal_mode = WAL", schema);
+    gchar *mode = _get_pragma_string_val(db->handle, pragma);
+    g_free(pragma);
+    wal = !g_strcmp0(mode, "wal");
+    if(!wal)
+      dt_print(DT_DEBUG_ALWAYS,
+               "[init] can't switch database `%s' to WAL journaling (%s), falling back",
+               filename, mode);
+    g_free(mode);
+  }
+
+  // with WAL a NORMAL sync never corrupts the database, it may only
+  // lose the last transactions on power loss. checkpoints are run by
+  // sqlite every wal_autocheckpoint pages and by dt_database_checkpoint().
+  gchar *pragma = wal
+    ? g_strdup_printf("PRAGMA %s.synchronous = NORMAL", schema)
+    : g_strdup_printf("PRAGMA %s.synchronous = OFF", schema);
+  sqlite3_exec(db->handle, pragma, NULL, NULL, NULL);
+  g_free(pragma);
+  if(!wal)
+  {
+    // also switches back a database left in WAL mode by an earlier run
+    pragma = g_strdup_printf("PRAGMA %s.journal_mode = MEMORY", schema);
+    sqlite3_exec(db->handle, pragma, NULL, NULL, NULL);
+    g_free(pragma);
+  }
+
+  return wal;
+}
+
+// set journaling and caching according to the database/ preferences.
+// the page size must be set before switching to WAL, afterwards it
+// can't be changed anymore.
+static void _database_configure(const dt_database_t *db)
+{
+  sqlite3_exec(db->handle, "PRAGMA page_size = 32768", NULL, NULL, NULL);
+
+  const gboolean want_wal =
+    !g_strcmp0(dt_conf_get_string_const("database/journal_mode"), "wal");
+  const gboolean main_wal =
+    _database_configure_journal(db, "main", db->dbfilename_library, want_wal);
+  const gboolean data_wal =
+    _database_configure_journal(db, "data", db->dbfilename_data, want_wal);
+
+  if(main_wal || data_wal)
+  {
+    // connection wide, only used by the databases in WAL mode
+    gchar *pragma = g_strdup_printf("PRAGMA wal_autocheckpoint = %d",
+                                    dt_conf_get_int("database/wal_autocheckpoint"));
+    sqlite3_exec(db->handle, pragma, NULL, NULL, NULL);
+    g_free(pragma);
+  }
+
+  // negative cache_size is in KiB instead of pages
+  const gint64 cache_kib = (gint64)dt_conf_get_int("database/cache_size") * 1024;
+  const gint64 mmap_bytes = (gint64)dt_conf_get_int("database/mmap_size") << 20;
+  gchar *pragma = g_strdup_printf("PRAGMA cache_size = %" G_GINT64_FORMAT, -cache_kib);
+  sqlite3_exec(db->handle, pragma, NULL, NULL, NULL);
+  g_free(pragma);
+  pragma = g_strdup_printf("PRAGMA mmap_size = %" G_GINT64_FORMAT, mmap_bytes);
+  sqlite3_exec(db->handle, pragma, NULL, NULL, NULL);
+  g_free(pragma);
+  sqlite3_exec(db->handle, "PRAGMA temp_store = MEMORY", NULL, NULL, NULL);
+
+  dt_print(DT_DEBUG_SQL,
+           "[init sql] journal: library %s, data %s, cache: %" G_GINT64_FORMAT " KiB, mmap: %"
+           G_GINT64_FORMAT " bytes",
+           main_wal ? "wal" : "memory", data_wal ? "wal" : "memory", cache_kib, mmap_bytes);
+}
+
+// build a sqlite URI opening filename in read-only mode. requires the
+// connection to be opened with SQLITE_OPEN_URI.
+static gchar *_database_readonly_uri(const char *filename)
+{
+  gchar *abs_filename = g_canonicalize_filename(filename, NULL);
+  gchar *uri = g_filename_to_uri(abs_filename, NULL, NULL);
+  g_free(abs_filename);
+  if(!uri) return NULL;
+
+  gchar *ro_uri = g_strconcat(uri, "?mode=ro", NULL);
+  g_free(uri);
+  return ro_uri;
+}
+
 dt_database_t *dt_database_init(const char *alternative,
                                 const gboolean load_data,
-                                const gboolean has_gui)
+                                const gboolean has_gui,
+                                const gboolean read_only)
 {
   /*  set the threading mode to Serialized */
   sqlite3_config(SQLITE_CONFIG_SERIALIZED);
@@ -4314,12 +4536,31 @@ start:
   else
     snprintf(dbfilename_data, sizeof(dbfilename_data), ":memory:");
 
+  // a read-only snapshot of an in-memory library is meaningless, and a
+  // missing library can't be created without writing to it.
+  if(read_only && !strcmp(dbfilename_library, ":memory:"))
+  {
+    dt_print(DT_DEBUG_ALWAYS,
+             "[init] read-only mode requested for an in-memory library, ignored");
+  }
+  else if(read_only && access(dbfilename_library, R_OK) != 0)
+  {
+    dt_print(DT_DEBUG_ALWAYS,
+             "[init] read-only mode requires an existing library, `%s' can't be read",
+             dbfilename_library);
+    g_free(dbname);
+    return NULL;
+  }
+  const gboolean ro_mode = read_only && strcmp(dbfilename_library, ":memory:");
+
   // It may happen that we will not have write access to the database restored
   // from a backup or snapshot. Running darktable with a database that cannot
   // be written to may result in incorrect operation, the cause of which will
   // be difficult to diagnose. Let's check if we can continue.
-  if((access(dbfilename_library, F_OK) == 0 && access(dbfilename_library, W_OK) != 0)
-     || (access(dbfilename_data, F_OK) == 0 && access(dbfilename_data, W_OK) != 0))
+  // in read-only mode we never write, so there is nothing to check.
+  if(!ro_mode
+     && ((access(dbfilename_library, F_OK) == 0 && access(dbfilename_library, W_OK) != 0)
+         || (access(dbfilename_data, F_OK) == 0 && access(dbfilename_data, W_OK) != 0)))
   {
     dt_print(DT_DEBUG_ALWAYS, "at least one of the dt databases (%s, %s) is not writeable",
                                dbfilename_library, dbfilename_data);
@@ -4350,19 +4591,20 @@ start:
   dt_database_t *db = g_malloc0(sizeof(dt_database_t));
   db->dbfilename_data = g_strdup(dbfilename_data);
   db->dbfilename_library = g_strdup(dbfilename_library);
+  db->read_only = ro_mode;
 
   dt_atomic_set_int(&_trxid, 0);
 
   /* make sure the folder exists. this might not be the case for new databases */
   /* also check if a database backup is needed */
-  if(g_strcmp0(dbfilename_data, ":memory:"))
+  if(!ro_mode && g_strcmp0(dbfilename_data, ":memory:"))
   {
     char *data_path = g_path_get_dirname(dbfilename_data);
     g_mkdir_with_parents(data_path, 0750);
     g_free(data_path);
     dt_database_backup(dbfilename_data);
   }
-  if(g_strcmp0(dbfilename_library, ":memory:"))
+  if(!ro_mode && g_strcmp0(dbfilename_library, ":memory:"))
   {
     char *library_path = g_path_get_dirname(dbfilename_library);
     g_mkdir_with_parents(library_path, 0750);
@@ -4370,12 +4612,13 @@ start:
     dt_database_backup(dbfilename_library);
   }
 
-  dt_print(DT_DEBUG_SQL, "[init sql] library: %s, data: %s",
-           dbfilename_library, dbfilename_data);
+  dt_print(DT_DEBUG_SQL, "[init sql] library: %s, data: %s%s",
+           dbfilename_library, dbfilename_data, ro_mode ? " (read-only)" : "");
 
   /* having more than one instance of darktable using the same database is a bad idea */
-  /* try to get locks for the databases */
-  db->lock_acquired = _lock_databases(db);
+  /* try to get locks for the databases. a read-only snapshot never writes and
+     so can safely share the databases with the instance holding the lock. */
+  db->lock_acquired = ro_mode ? TRUE : _lock_databases(db);
 
   if(!db->lock_acquired)
   {
@@ -4387,7 +4630,13 @@ start:
 
 
   /* opening / creating database */
-  if(sqlite3_open(db->dbfilename_library, &db->handle) != SQLITE_OK)
+  gchar *library_uri = ro_mode ? _database_readonly_uri(db->dbfilename_library) : NULL;
+  const int open_rc = ro_mode
+    ? sqlite3_open_v2(library_uri ? library_uri : "", &db->handle,
+                      SQLITE_OPEN_READWRITE | SQLITE_OPEN_URI, NULL)
+    : sqlite3_open(db->dbfilename_library, &db->handle);
+  g_free(library_uri);
+  if(open_rc != SQLITE_OK)
   {
     dt_print(DT_DEBUG_ALWAYS, "[init] could not find database %s%s%s",
                               dbname ? " `" : "", dbname ? dbname : "", dbname ? "'!" : "");
@@ -4411,10 +4660,15 @@ start:
   sqlite3_exec(db->handle, "attach database ':memory:' as memory", NULL, NULL, NULL);
 
   // attach the data database which contains presets, styles, tags and similar things not tied to single images
+  // in read-only mode a missing data database is replaced by an in-memory one
   sqlite3_stmt *stmt;
   gboolean have_data_db = load_data && g_file_test(dbfilename_data, G_FILE_TEST_EXISTS);
+  gchar *data_uri = ro_mode && have_data_db ? _database_readonly_uri(dbfilename_data) : NULL;
   int rc = sqlite3_prepare_v2(db->handle, "ATTACH DATABASE ?1 AS data", -1, &stmt, NULL);
-  sqlite3_bind_text(stmt, 1, dbfilename_data, -1, SQLITE_TRANSIENT);
+  sqlite3_bind_text(stmt, 1,
+                    data_uri ? data_uri : (ro_mode ? ":memory:" : dbfilename_data),
+                    -1, SQLITE_TRANSIENT);
+  g_free(data_uri);
   if(rc != SQLITE_OK || sqlite3_step(stmt) != SQLITE_DONE)
   {
     sqlite3_finalize(stmt);
@@ -4427,9 +4681,23 @@ start:
   sqlite3_finalize(stmt);
 
   // some sqlite3 config
-  sqlite3_exec(db->handle, "PRAGMA synchronous = OFF", NULL, NULL, NULL);
-  sqlite3_exec(db->handle, "PRAGMA journal_mode = MEMORY", NULL, NULL, NULL);
-  sqlite3_exec(db->handle, "PRAGMA page_size = 32768", NULL, NULL, NULL);
+  if(ro_mode)
+  {
+    // the journal mode belongs to the writer. wait for its commits instead of
+    // failing with SQLITE_BUSY, with WAL journaling readers never block it.
+    sqlite3_busy_timeout(db->handle, 5000);
+    gchar *journal_mode = _get_pragma_string_val(db->handle, "main.journal_mode");
+    if(g_strcmp0(journal_mode, "wal"))
+      dt_print(DT_DEBUG_ALWAYS,
+               "[init] read-only library `%s' uses journal mode `%s', "
+               "readers may delay the instance writing to it",
+               dbfilename_library, journal_mode ? journal_mode : "unknown");
+    g_free(journal_mode);
+  }
+  else
+  {
+    _database_configure(db);
+  }
 
   // WARNING: the foreign_keys pragma must not be used, the integrity of the
   // database rely on it.
@@ -4455,7 +4723,17 @@ start:
       // compare the version of the db with what is current for this executable
       const int db_version = sqlite3_column_int(stmt, 0);
       sqlite3_finalize(stmt);
-      if(db_version < CURRENT_DATABASE_VERSION_DATA)
+      if(ro_mode && db_version != CURRENT_DATABASE_VERSION_DATA)
+      {
+        // a read-only snapshot can't be upgraded
+        dt_print(DT_DEBUG_ALWAYS,
+                 "[init] read-only database `%s' has version %d, expected %d. aborting",
+                 dbfilename_data, db_version, CURRENT_DATABASE_VERSION_DATA);
+        dt_database_destroy(db);
+        db = NULL;
+        goto error;
+      }
+      else if(db_version < CURRENT_DATABASE_VERSION_DATA)
       {
         _ask_for_upgrade(dbfilename_data, has_gui);
 
@@ -4489,6 +4767,18 @@ start:
       }
       // else: the current version, do nothing
     }
+    else if(ro_mode)
+    {
+      // never offer to delete or restore a database we are only reading
+      sqlite3_finalize(stmt);
+      dt_print(DT_DEBUG_ALWAYS,
+               "[init] read-only database `%s' can't be read (quick_check: %s). aborting",
+               dbfilename_data, data_status ? data_status : "failed");
+      g_free(data_status);
+      dt_database_destroy(db);
+      db = NULL;
+      goto error;
+    }
     else
     {
       // oh, bad situation. the database is corrupt and can't be read!
@@ -4582,19 +4872,17 @@ start:
       //here were sure that response is either accept (restore from snap) or reject (just delete the damaged db)
       dt_print(DT_DEBUG_ALWAYS, "[init] deleting `%s' on user request: %s",
                dbfilename_data,
-               g_unlink(dbfilename_data) == 0 ? "ok" : "failed" );
+               _database_unlink(dbfilename_data) == 0 ? "ok" : "failed" );
 
       if(resp == GTK_RESPONSE_ACCEPT && data_snap)
       {
         GError *gerror = NULL;
         if(!g_file_test(dbfilename_data, G_FILE_TEST_EXISTS))
         {
-          GFile *src = g_file_new_for_path(data_snap);
-          GFile *dest = g_file_new_for_path(dbfilename_data);
           gboolean copy_status = TRUE;
           if(g_file_test(data_snap, G_FILE_TEST_EXISTS))
           {
-            copy_status = g_file_copy(src, dest, G_FILE_COPY_NONE, NULL, NULL, NULL, &gerror);
+            copy_status = _database_copy(data_snap, dbfilename_data, &gerror);
             if(copy_status)
               copy_status = g_chmod(dbfilename_data, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) == 0;
           }
@@ -4606,8 +4894,6 @@ start:
           }
           dt_print(DT_DEBUG_ALWAYS, "[init] restoring `%s' from `%s' :%s",
                    dbfilename_data, data_snap, copy_status ? "success" : "failed!");
-          g_object_unref(src);
-          g_object_unref(dest);
         }
       }
       g_free(data_snap);
@@ -4630,7 +4916,17 @@ start:
     const int db_version = sqlite3_column_int(stmt, 0);
 
     sqlite3_finalize(stmt);
-    if(db_version < CURRENT_DATABASE_VERSION_LIBRARY)
+    if(ro_mode && db_version != CURRENT_DATABASE_VERSION_LIBRARY)
+    {
+      // a read-only snapshot can't be upgraded
+      dt_print(DT_DEBUG_ALWAYS,
+               "[init] read-only database `%s' has version %d, expected %d. aborting",
+               dbname, db_version, CURRENT_DATABASE_VERSION_LIBRARY);
+      dt_database_destroy(db);
+      db = NULL;
+      goto error;
+    }
+    else if(db_version < CURRENT_DATABASE_VERSION_LIBRARY)
     {
       _ask_for_upgrade(dbfilename_library, has_gui);
 
@@ -4663,6 +4959,18 @@ start:
     }
     // else: the current version, do nothing
   }
+  else if(ro_mode)
+  {
+    // neither a corrupt nor a legacy library can be fixed without writing to it
+    sqlite3_finalize(stmt);
+    dt_print(DT_DEBUG_ALWAYS,
+             "[init] read-only database `%s' can't be used (quick_check: %s). aborting",
+             dbfilename_library, libdb_status ? libdb_status : "failed");
+    g_free(libdb_status);
+    dt_database_destroy(db);
+    db = NULL;
+    goto error;
+  }
   else if(g_strcmp0(libdb_status, "ok") || rc == SQLITE_CORRUPT || rc == SQLITE_NOTADB)
   {
     // oh, bad situation. the database is corrupt and can't be read!
@@ -4754,19 +5062,17 @@ start:
     //here were sure that response is either accept (restore from snap) or reject (just delete the damaged db)
 
     dt_print(DT_DEBUG_ALWAYS, "[init] deleting `%s' on user request ...%s",
-      dbfilename_library, g_unlink(dbfilename_library) == 0 ? "OK" : "failed");
+      dbfilename_library, _database_unlink(dbfilename_library) == 0 ? "OK" : "failed");
 
     if(resp == GTK_RESPONSE_ACCEPT && data_snap)
     {
       GError *gerror = NULL;
       if(!g_file_test(dbfilename_library, G_FILE_TEST_EXISTS))
       {
-        GFile *src = g_file_new_for_path(data_snap);
-        GFile *dest = g_file_new_for_path(dbfilename_library);
         gboolean copy_status = TRUE;
         if(g_file_test(data_snap, G_FILE_TEST_EXISTS))
         {
-          copy_status = g_file_copy(src, dest, G_FILE_COPY_NONE, NULL, NULL, NULL, &gerror);
+          copy_status = _database_copy(data_snap, dbfilename_library, &gerror);
           if(copy_status) copy_status = g_chmod(dbfilename_library, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) == 0;
         }
         else
@@ -4777,8 +5083,6 @@ start:
         }
         dt_print(DT_DEBUG_ALWAYS, "[init] restoring `%s' from `%s'... %s",
                dbfilename_library, data_snap, copy_status ? "success" : "failed");
-        g_object_unref(src);
-        g_object_unref(dest);
       }
     }
     g_free(data_snap);
@@ -4828,11 +5132,14 @@ start:
   // create the in-memory tables
   _create_memory_schema(db);
 
-  // drop table settings -- we don't want old versions of dt to drop our tables
-  sqlite3_exec(db->handle, "DROP TABLE main.settings", NULL, NULL, NULL);
+  if(!ro_mode)
+  {
+    // drop table settings -- we don't want old versions of dt to drop our tables
+    sqlite3_exec(db->handle, "DROP TABLE main.settings", NULL, NULL, NULL);
 
-  // take care of potential bad data in the db.
-  _sanitize_db(db);
+    // take care of potential bad data in the db.
+    _sanitize_db(db);
+  }
 
 #ifdef HAVE_ICU
   // check if sqlite is already icu enabled
@@ -4858,6 +5165,9 @@ error:
 
 void dt_upgrade_maker_model(const dt_database_t *db)
 {
+  if(db->read_only)
+    return;
+
   sqlite3_stmt *stmt;
 
   // check if updating the camera table is needed (done for each new darktable version)
@@ -4979,6 +5289,11 @@ gboolean dt_database_get_lock_acquired(const dt_database_t *db)
   return db->lock_acquired;
 }
 
+gboolean dt_database_is_read_only(const dt_database_t *db)
+{
+  return db ? db->read_only : FALSE;
+}
+
 void dt_database_cleanup_busy_statements(const dt_database_t *db)
 {
   sqlite3_stmt *stmt = NULL;
@@ -5065,7 +5380,7 @@ static inline gboolean _is_mem_db(const dt_database_t *db)
 
 gboolean dt_database_maybe_maintenance(const dt_database_t *db)
 {
-  if(_is_mem_db(db))
+  if(_is_mem_db(db) || db->read_only)
     return FALSE;
 
   // checking free pages
@@ -5111,12 +5426,30 @@ gboolean dt_database_maybe_maintenance(const dt_database_t *db)
 
 void dt_database_optimize(const dt_database_t *db)
 {
-  if(_is_mem_db(db))
+  if(_is_mem_db(db) || db->read_only)
     return;
   // optimize should in most cases be no-op and have no noticeable downsides
   // this should be ran on every exit
   // see: https://www.sqlite.org/pragma.html#pragma_optimize
   DT_DEBUG_SQLITE3_EXEC(db->handle, "PRAGMA optimize", NULL, NULL, NULL);
+  dt_database_checkpoint(db, TRUE);
+}
+
+void dt_database_checkpoint(const dt_database_t *db,
+                            const gboolean truncate)
+{
+  if(db->read_only)
+    return;
+
+  // no-op unless a database is in WAL mode. PASSIVE never waits for
+  // readers, TRUNCATE also resets the -wal file to zero bytes.
+  int log_frames = 0, checkpointed = 0;
+  const int rc = sqlite3_wal_checkpoint_v2(db->handle, NULL,
+                                           truncate ? SQLITE_CHECKPOINT_TRUNCATE
+                                                    : SQLITE_CHECKPOINT_PASSIVE,
+                                           &log_frames, &checkpointed);
+  dt_print(DT_DEBUG_SQL, "[db checkpoint] rc %d, %d of %d frames written back",
+           rc, checkpointed, log_frames);
 }
 
 static void _print_backup_progress(int remaining, int total)
@@ -5177,7 +5510,7 @@ static int _backup_db(
 gboolean dt_database_snapshot(const dt_database_t *db)
 {
   // backing up memory db is pointelss
-  if(_is_mem_db(db))
+  if(_is_mem_db(db) || db->read_only)
     return FALSE;
   GDateTime *date_now = g_date_time_new_now_local();
   gchar *date_suffix = g_date_time_format(date_now, "%Y%m%d%H%M%S");
@@ -5186,6 +5519,8 @@ gboolean dt_database_snapshot(const dt_database_t *db)
   const char *file_pattern = "%s-snp-%s";
   const char *temp_pattern = "%s-tmp-%s";
 
+  dt_database_checkpoint(db, FALSE);
+
   gchar *lib_backup_file = g_strdup_printf(file_pattern, db->dbfilename_library, date_suffix);
   gchar *lib_tmpbackup_file = g_strdup_printf(temp_pattern, db->dbfilename_library, date_suffix);
 
@@ -5224,7 +5559,7 @@ gboolean dt_database_snapshot(const dt_database_t *db)
 
 gboolean dt_database_maybe_snapshot(const dt_database_t *db)
 {
-  if(_is_mem_db(db))
+  if(_is_mem_db(db) || db->read_only)
     return FALSE;
 
   const char *config = dt_conf_get_string_const("database/create_snapshot");
@@ -25,10 +25,14 @@ G_BEGIN_DECLS
 
 struct dt_database_t;
 
-/** allocates and initializes database */
+/** allocates and initializes database.
+ * with read_only set the databases are opened without taking the lock
+ * and without any schema change, so several headless processes can
+ * share a catalog that is in use by a running darktable instance */
 struct dt_database_t *dt_database_init(const char *alternative,
                                        const gboolean load_data,
-                                       const gboolean has_gui);
+                                       const gboolean has_gui,
+                                       const gboolean read_only);
 /** closes down database and frees memory */
 void dt_database_destroy(const struct dt_database_t *);
 /** get handle */
@@ -37,11 +41,16 @@ struct sqlite3 *dt_database_get(const struct dt_database_t *);
 const gchar *dt_database_get_path(const struct dt_database_t *db);
 /** test if database was already locked by another instance */
 gboolean dt_database_get_lock_acquired(const struct dt_database_t *db);
+/** test if database has been opened as a read-only snapshot, all write
+ * paths (history, sidecars, image and thumbnail updates) must be skipped */
+gboolean dt_database_is_read_only(const struct dt_database_t *db);
 /** show an error popup. this has to be postponed until after we tried
  * using dbus to reach another instance */
 void dt_database_show_error(const struct dt_database_t *db, const char *dblabel);
 /** perform pre-db-close optimizations (always call when quiting darktable) */
 void dt_database_optimize(const struct dt_database_t *);
+/** write the WAL back into the databases, truncate also empties the -wal files */
+void dt_database_checkpoint(const struct dt_database_t *db, const gboolean truncate);
 /** conditionally perfrom db maintenance */
 gboolean dt_database_maybe_maintenance(const struct dt_database_t *db);
 void dt_database_perform_maintenance(const struct dt_database_t *db);
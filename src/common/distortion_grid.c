@@ -0,0 +1,263 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/distortion_grid.h"
+
+#include <math.h>
+
+// interpolation of the grid is not good enough at this point
+static inline gboolean _miss(const float *const exact,
+                             const float *const a,
+                             const float *const b,
+                             const float *const c,
+                             const float *const d)
+{
+  gboolean miss = FALSE;
+  for(int k = 0; k < 6; k++)
+  {
+    const float interpolated = 0.25f * (a[k] + b[k] + c[k] + d[k]);
+    const float error = fabsf(exact[k] - interpolated);
+    miss |= !isfinite(interpolated) || !isfinite(exact[k]) || !(error <= DT_DISTORTION_GRID_TOLERANCE);
+  }
+  return miss;
+}
+
+static dt_distortion_grid_t *_sample(const int width,
+                                     const int height,
+                                     const int step,
+                                     dt_distortion_grid_eval_t eval,
+                                     const void *data,
+                                     int *flagged)
+{
+  dt_distortion_grid_t *grid = (dt_distortion_grid_t *)calloc(1, sizeof(dt_distortion_grid_t));
+  if(!grid) return NULL;
+
+  const int nodes_x = (width - 1) / step + 2;
+  const int nodes_y = (height - 1) / step + 2;
+  const int cells_x = nodes_x - 1;
+  const int cells_y = nodes_y - 1;
+  const int half = step / 2;
+  grid->width = width;
+  grid->height = height;
+  grid->step = step;
+  grid->nodes_x = nodes_x;
+  grid->nodes_y = nodes_y;
+  grid->nodes = dt_alloc_align_float((size_t)6 * nodes_x * nodes_y);
+  grid->exact = (uint8_t *)calloc((size_t)cells_x * cells_y, sizeof(uint8_t));
+  // the middles of the horizontal and vertical sides are shared by two cells
+  uint8_t *hmiss = (uint8_t *)calloc((size_t)nodes_y * cells_x, sizeof(uint8_t));
+  uint8_t *vmiss = (uint8_t *)calloc((size_t)cells_y * nodes_x, sizeof(uint8_t));
+  if(!grid->nodes || !grid->exact || !hmiss || !vmiss)
+  {
+    free(hmiss);
+    free(vmiss);
+    dt_distortion_grid_free(grid);
+    return NULL;
+  }
+
+  float *const nodes = grid->nodes;
+  uint8_t *const exact = grid->exact;
+
+  DT_OMP_FOR()
+  for(int j = 0; j < nodes_y; j++)
+    for(int i = 0; i < nodes_x; i++)
+      eval(data, i * step, j * step, 1, nodes + (size_t)6 * (j * nodes_x + i));
+
+  DT_OMP_FOR()
+  for(int j = 0; j < nodes_y; j++)
+    for(int i = 0; i < cells_x; i++)
+    {
+      float DT_ALIGNED_PIXEL px[8];
+      eval(data, i * step + half, j * step, 1, px);
+      const float *a = nodes + (size_t)6 * (j * nodes_x + i);
+      hmiss[(size_t)j * cells_x + i] = _miss(px, a, a, a + 6, a + 6);
+    }
+
+  DT_OMP_FOR()
+  for(int j = 0; j < cells_y; j++)
+    for(int i = 0; i < nodes_x; i++)
+    {
+      float DT_ALIGNED_PIXEL px[8];
+      eval(data, i * step, j * step + half, 1, px);
+      const float *a = nodes + (size_t)6 * (j * nodes_x + i);
+      const float *c = a + (size_t)6 * nodes_x;
+      vmiss[(size_t)j * nodes_x + i] = _miss(px, a, a, c, c);
+    }
+
+  int count = 0;
+  DT_OMP_FOR(reduction(+ : count))
+  for(int j = 0; j < cells_y; j++)
+    for(int i = 0; i < cells_x; i++)
+    {
+      float DT_ALIGNED_PIXEL px[8];
+      eval(data, i * step + half, j * step + half, 1, px);
+      const float *a = nodes + (size_t)6 * (j * nodes_x + i);
+      const float *c = a + (size_t)6 * nodes_x;
+      const gboolean miss = _miss(px, a, a + 6, c, c + 6)
+                            || hmiss[(size_t)j * cells_x + i]
+                            || hmiss[(size_t)(j + 1) * cells_x + i]
+                            || vmiss[(size_t)j * nodes_x + i]
+                            || vmiss[(size_t)j * nodes_x + i + 1];
+      exact[(size_t)j * cells_x + i] = miss;
+      count += miss;
+    }
+
+  free(hmiss);
+  free(vmiss);
+  *flagged = count;
+  return grid;
+}
+
+dt_distortion_grid_t *dt_distortion_grid_new(const int width,
+                                             const int height,
+                                             dt_distortion_grid_eval_t eval,
+                                             const void *data)
+{
+  if(width < 1 || height < 1) return NULL;
+
+  const double start = dt_get_debug_wtime();
+  dt_distortion_grid_t *grid = NULL;
+  int flagged = 0;
+  for(int step = DT_DISTORTION_GRID_MAX_STEP; step >= DT_DISTORTION_GRID_MIN_STEP; step /= 2)
+  {
+    dt_distortion_grid_free(grid);
+    grid = _sample(width, height, step, eval, data, &flagged);
+    if(!grid) return NULL;
+    // a few exact cells are cheaper than a denser grid
+    const int cells = (grid->nodes_x - 1) * (grid->nodes_y - 1);
+    if(8 * flagged <= cells) break;
+  }
+
+  dt_print(DT_DEBUG_PERF,
+           "[distortion grid] %dx%d px, %dx%d nodes every %d px, %d exact cells, %.3fs",
+           width, height, grid->nodes_x, grid->nodes_y, grid->step, flagged,
+           dt_get_debug_wtime() - start);
+  return grid;
+}
+
+void dt_distortion_grid_free(dt_distortion_grid_t *grid)
+{
+  if(!grid) return;
+  dt_free_align(grid->nodes);
+  free(grid->exact);
+  free(grid);
+}
+
+void dt_distortion_grid_row(const dt_distortion_grid_t *grid,
+                            const int x,
+                            const int y,
+                            const int count,
+                            dt_distortion_grid_eval_t eval,
+                            const void *data,
+                            float *out)
+{
+  if(!grid || x < 0 || y < 0 || x + count > grid->width || y >= grid->height)
+  {
+    eval(data, x, y, count, out);
+    return;
+  }
+
+  const int step = grid->step;
+  const float inv_step = 1.0f / step;
+  const int j = y / step;
+  const float fy = (y - j * step) * inv_step;
+  const float *const row0 = grid->nodes + (size_t)6 * j * grid->nodes_x;
+  const float *const row1 = row0 + (size_t)6 * grid->nodes_x;
+  const uint8_t *const exact = grid->exact + (size_t)j * (grid->nodes_x - 1);
+
+  int k = 0;
+  while(k < count)
+  {
+    const int i = (x + k) / step;
+    const int end = MIN(count, (i + 1) * step - x);
+    if(exact[i])
+    {
+      eval(data, x + k, y, end - k, out + (size_t)6 * k);
+      k = end;
+      continue;
+    }
+
+    // the field along the left and right sides of the cell at this row
+    float left[6], right[6];
+    for(int c = 0; c < 6; c++)
+    {
+      left[c] = row0[6 * i + c] + fy * (row1[6 * i + c] - row0[6 * i + c]);
+      right[c] = row0[6 * i + 6 + c] + fy * (row1[6 * i + 6 + c] - row0[6 * i + 6 + c]);
+    }
+    for(; k < end; k++)
+    {
+      const float fx = (x + k - i * step) * inv_step;
+      float *const px = out + (size_t)6 * k;
+      for(int c = 0; c < 6; c++)
+        px[c] = left[c] + fx * (right[c] - left[c]);
+    }
+  }
+}
+
+static void _grid_free(dt_lru_item_t *item)
+{
+  dt_distortion_grid_free((dt_distortion_grid_t *)item);
+}
+
+void dt_distortion_grid_cache_init(dt_distortion_grid_cache_t *cache)
+{
+  dt_lru_cache_init(&cache->lru, DT_DISTORTION_GRID_CACHE_SIZE, 0, _grid_free);
+}
+
+void dt_distortion_grid_cache_cleanup(dt_distortion_grid_cache_t *cache)
+{
+  dt_lru_cache_cleanup(&cache->lru);
+}
+
+// a grid covers the whole image at one scale
+static float _match(const dt_lru_item_t *item,
+                    const void *key)
+{
+  const dt_distortion_grid_t *grid = (const dt_distortion_grid_t *)item;
+  const int *size = key;
+  return grid->width == size[0] && grid->height == size[1] ? 0.0f : -1.0f;
+}
+
+dt_distortion_grid_t *dt_distortion_grid_cache_get(dt_distortion_grid_cache_t *cache,
+                                                   const dt_hash_t hash,
+                                                   const int width,
+                                                   const int height,
+                                                   dt_distortion_grid_eval_t eval,
+                                                   const void *data)
+{
+  const int size[2] = { width, height };
+  dt_lru_item_t *item = dt_lru_cache_get(&cache->lru, hash, _match, size);
+  if(item) return (dt_distortion_grid_t *)item;
+
+  // sampled without the lock, the pipes needing other grids don't wait
+  dt_distortion_grid_t *sampled = dt_distortion_grid_new(width, height, eval, data);
+  if(!sampled) return NULL;
+  return (dt_distortion_grid_t *)dt_lru_cache_put(&cache->lru, hash, _match, size, &sampled->item);
+}
+
+void dt_distortion_grid_cache_release(dt_distortion_grid_cache_t *cache,
+                                      dt_distortion_grid_t *grid)
+{
+  if(grid) dt_lru_cache_release(&cache->lru, &grid->item);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,111 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/darktable.h"
+#include "common/lru_cache.h"
+
+G_BEGIN_DECLS
+
+/* Sparse sampling of a smooth distortion field.
+
+   The field maps each output pixel (x, y) to the input positions of its
+   red, green and blue channels, six floats per pixel in the order of
+   lensfun's ApplySubpixelGeometryDistortion(). It is evaluated on the
+   nodes of a square grid and bilinearly interpolated in between.
+
+   The grid step is the largest of DT_DISTORTION_GRID_MAX_STEP and its
+   halves for which few cells miss the tolerance. The interpolation error
+   of a cell is measured at its center and at the middle of its sides,
+   cells where it exceeds DT_DISTORTION_GRID_TOLERANCE or meeting a
+   non-finite position are flagged and their pixels are evaluated exactly.
+
+   A grid covers the whole image at one scale, so that the grids kept in
+   a dt_distortion_grid_cache_t serve every roi of the preview, full and
+   export pipes using that scale.
+*/
+
+#define DT_DISTORTION_GRID_MAX_STEP 16
+#define DT_DISTORTION_GRID_MIN_STEP 8
+// in pixels of the scaled image
+#define DT_DISTORTION_GRID_TOLERANCE 0.02f
+#define DT_DISTORTION_GRID_CACHE_SIZE 6
+
+// evaluates the exact field for count pixels starting at (x, y) along a row
+typedef void (*dt_distortion_grid_eval_t)(const void *data,
+                                          const int x,
+                                          const int y,
+                                          const int count,
+                                          float *out);
+
+typedef struct dt_distortion_grid_t
+{
+  dt_lru_item_t item; // identified by the hash of the field
+  int width;
+  int height;
+  int step;
+  int nodes_x;
+  int nodes_y;
+  float *nodes;     // 6 floats per node, node (i, j) at pixel (i * step, j * step)
+  uint8_t *exact;   // per cell, (nodes_x - 1) cells per row
+} dt_distortion_grid_t;
+
+typedef struct dt_distortion_grid_cache_t
+{
+  dt_lru_cache_t lru;
+} dt_distortion_grid_cache_t;
+
+// samples the field over width x height pixels, NULL if out of memory
+dt_distortion_grid_t *dt_distortion_grid_new(const int width,
+                                             const int height,
+                                             dt_distortion_grid_eval_t eval,
+                                             const void *data);
+void dt_distortion_grid_free(dt_distortion_grid_t *grid);
+
+// the field for count pixels starting at (x, y), pixels outside the
+// grid or in flagged cells are evaluated exactly. grid may be NULL.
+void dt_distortion_grid_row(const dt_distortion_grid_t *grid,
+                            const int x,
+                            const int y,
+                            const int count,
+                            dt_distortion_grid_eval_t eval,
+                            const void *data,
+                            float *out);
+
+void dt_distortion_grid_cache_init(dt_distortion_grid_cache_t *cache);
+void dt_distortion_grid_cache_cleanup(dt_distortion_grid_cache_t *cache);
+
+// the grid of the field identified by hash, sampled on first use. The
+// caller releases it after use, NULL if out of memory.
+dt_distortion_grid_t *dt_distortion_grid_cache_get(dt_distortion_grid_cache_t *cache,
+                                                   const dt_hash_t hash,
+                                                   const int width,
+                                                   const int height,
+                                                   dt_distortion_grid_eval_t eval,
+                                                   const void *data);
+void dt_distortion_grid_cache_release(dt_distortion_grid_cache_t *cache,
+                                      dt_distortion_grid_t *grid);
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
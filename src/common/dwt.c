@@ -17,6 +17,7 @@
 */
 
 #include "common/darktable.h"
+#include "common/cpu_dispatch.h"
 #include "common/imagebuf.h"
 #include "control/control.h"
 #include "develop/imageop.h"
@@ -378,128 +379,8 @@ void dwt_decompose(dwt_params_t *p, _dwt_layer_func layer_func)
   dwt_wavelet_decompose(p->image, p, layer_func);
 }
 
-// first, "vertical" pass of wavelet decomposition
-static void dwt_denoise_vert_1ch(
-    float *const restrict out,
-    const float *const restrict in,
-    const size_t height,
-    const size_t width,
-    const size_t lev)
-{
-  // cap at height-1 (not height): the top-edge reflection below reads
-  // abs(row-vscale), which lands one row past the buffer at row 0 once
-  // vscale == height. (matches dwt_decompose_vert.)
-  const int vscale = MIN(1 << lev, (int)height - 1);
-  DT_OMP_FOR()
-  for(int rowid = 0; rowid < height ; rowid++)
-  {
-    const int row = dwt_interleave_rows(rowid,height,vscale);
-    // perform a weighted sum of the current pixel row with the rows 'scale' pixels above and below
-    // if either of those is beyond the edge of the image, we use reflection to get a value for averaging,
-    // i.e. we move as many rows in from the edge as we would have been beyond the edge
-    // for the top edge, this means we can simply use the absolute value of row-vscale; for the bottom edge,
-    //   we need to reflect around height
-    const size_t rowstart = (size_t)row * width;
-    const size_t below_row = (row + vscale < height) ? (row + vscale) : 2*(height-1) - (row + vscale);
-    const float *const restrict center = in + rowstart;
-    const float *const restrict above =  in + abs(row - vscale) * width;
-    const float *const restrict below = in + below_row * width;
-    float* const restrict outrow = out + rowstart;
-    DT_OMP_SIMD()
-    for(int col= 0; col < width; col++)
-    {
-      outrow[col] = 2.f * center[col] + above[col] + below[col];
-    }
-  }
-}
-
-// second, horizontal pass of wavelet decomposition; generates 'coarse' into the output buffer and overwrites
-//   the input buffer with 'details'
-static void dwt_denoise_horiz_1ch(
-    float *const restrict out,
-    float *const restrict in,
-    float *const restrict accum,
-    const size_t height,
-    const size_t width,
-    const size_t lev,
-    const float thold,
-    const int last)
-{
-  // cap at width-1 (not width): the reflected neighbour indices below read out
-  // of bounds once hscale == width. (matches dwt_decompose_horiz.)
-  const int hscale = MIN(1 << lev, (int)width - 1);
-  DT_OMP_FOR()
-  for(int row = 0; row < height ; row++)
-  {
-    // perform a weighted sum of the current pixel with the ones 'scale' pixels to the left and right, using
-    // reflection to get a value if either of those positions is out of bounds, i.e. we move as many columns
-    // in from the edge as we would have been beyond the edge to avoid an additional pass, we also rescale the
-    // final sum and split the original input into 'coarse' and 'details' by subtracting the scaled sum from
-    // the original input.
-    const size_t rowindex = (size_t)row * width;
-    float *const restrict details = in + rowindex;
-    float *const restrict coarse = out + rowindex;
-    float *const restrict accum_row = accum + rowindex;
-    // the row splits into three regions: a left edge where the left neighbour
-    // (and, once 2*hscale > width, the right one too) needs reflection, a
-    // branch-free middle where both neighbours are in bounds, and a right edge
-    // where the right neighbour needs reflection. clamp the boundaries with
-    // MIN/MAX so the regions stay a non-overlapping partition for small images
-    // / large scales (2*hscale > width); otherwise they would overlap and
-    // double-process columns, and the middle loop would index out of bounds.
-    const int left_end = MIN(hscale, (int)width);
-    const int right_start = MAX((int)width - hscale, left_end);
-    // left edge: left neighbour reflects about column 0 (abs(col-hscale) == hscale-col
-    // here); guard the right neighbour explicitly since it can also fall off the end.
-    for(int col = 0; col < left_end; col++)
-    {
-      const int rightpos =
-        (col + hscale < (int)width) ? (col + hscale) : 2 * ((int)width - 1) - (col + hscale);
-      // add up left/center/right, and renormalize by dividing by the total weight of all numbers added together
-      const float hat = (2.f * coarse[col] + coarse[hscale - col] + coarse[rightpos]) / 16.f;
-      // the normalized value is our 'coarse' result; 'diff' is the difference between original
-      // input and 'coarse'
-      const float diff = details[col] - hat;
-      details[col] = hat; // done with original input, so we can overwrite it with 'coarse'
-      accum_row[col] += MAX(diff - thold,0.0f) + MIN(diff + thold, 0.0f);
-    }
-    DT_OMP_SIMD()
-    for(int col = left_end; col < right_start; col++)
-    {
-      // add up left/center/right, and renormalize by dividing by the total weight of all numbers added together
-      const float hat = (2.f * coarse[col] + coarse[col-hscale] + coarse[col+hscale]) / 16.f;
-      // the normalized value is our 'coarse' result; 'diff' is the difference between original input and 'coarse'
-      // (which would ordinarily be stored as the details scale, but we don't need it any further)
-      const float diff = details[col] - hat;
-      details[col] = hat;		// done with original input, so we can overwrite it with 'coarse'
-      // GCC8 won't vectorize if we use the following line, but it turns out that just adding the two conditional
-      // alternatives produces exactly the same result, and *that* does get vectorized
-      //const float excess = diff < 0.0 ? MIN(diff + thold, 0.0f) : MAX(diff - thold, 0.0f);
-      accum_row[col] += MAX(diff - thold,0.0f) + MIN(diff + thold, 0.0f);
-    }
-    // right edge: right neighbour reflects about the last column. col >= right_start
-    // >= hscale here, so the left neighbour (col-hscale) is always in bounds.
-    for(int col = right_start; col < width; col++)
-    {
-      const float right = coarse[2 * ((int)width - 1) - (col + hscale)];
-      // add up left/center/right, and renormalize by dividing by the total weight of all numbers added together
-      const float hat = (2.f * coarse[col] + coarse[col-hscale] + right) / 16.f;
-      // the normalized value is our 'coarse' result; 'diff' is the difference between original
-      // input and 'coarse'
-      const float diff = details[col] - hat;
-      details[col] = hat;		// done with original input, so we can overwrite it with 'coarse'
-      accum_row[col] += MAX(diff - thold,0.0f) + MIN(diff + thold, 0.0f);
-    }
-    if(last)
-    {
-      // add the details to the residue to create the final denoised result
-      for(int col = 0; col < width; col++)
-      {
-        details[col] += accum_row[col];
-      }
-    }
-  }
-}
+#define DT_CPU_KERNELS "common/kernels/dwt.c"
+#include "common/cpu_variants.h"
 
 /* this function denoises an image by decomposing it into the specified number of wavelet scales and
  * recomposing the result from just the portion of each scale which exceeds the magnitude of the given
@@ -528,13 +409,13 @@ void dwt_denoise(float *const img,
 
     // "vertical" pass, averages pixels with those 'scale' rows above
     // and below and puts result in 'interm'
-    dwt_denoise_vert_1ch(interm, img, height, width, lev);
+    DT_CPU_DISPATCH(dwt_denoise_vert_1ch)(interm, img, height, width, lev);
     // horizontal filtering pass, averages pixels in 'interm' with
     // those 'scale' rows to the left and right
     // accumulates the portion of the detail scale that is above the
     // noise threshold into 'details'; this will be added to the
     // residue left in 'img' on the last iteration
-    dwt_denoise_horiz_1ch(interm, img, details, height, width, lev, noise[lev], last);
+    DT_CPU_DISPATCH(dwt_denoise_horiz_1ch)(interm, img, details, height, width, lev, noise[lev], last);
   }
   dt_free_align(details);
 }
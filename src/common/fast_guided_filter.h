@@ -151,57 +151,6 @@ static inline void interpolate_bilinear(const float *const restrict in,
 }
 
 
-__DT_CLONE_TARGETS__
-static inline void variance_analyse(const float *const restrict guide, // I
-                                    const float *const restrict mask, //p
-                                    float *const restrict ab,
-                                    const size_t width,
-                                    const size_t height,
-                                    const int radius,
-                                    const float feathering)
-{
-  // Compute a box average (filter) on a grey image over a window of size 2*radius + 1
-  // then get the variance of the guide and covariance with its mask
-  // output a and b, the linear blending params
-  // p, the mask is the quantised guide I
-
-  const size_t Ndim = width * height;
-  const size_t Ndimch = Ndim * 4;
-
-  /*
-  * input is array of struct : { { guide , mask, guide * guide, guide * mask } }
-  */
-  float *const restrict input = dt_alloc_align_float(Ndimch);
-
-  // Pre-multiply guide and mask and pack all inputs into an array of 4×1 SIMD struct
-  DT_OMP_FOR_SIMD()
-  for(size_t k = 0; k < Ndim; k++)
-  {
-    const size_t index = k * 4;
-    input[index] = guide[k];
-    input[index + 1] = mask[k];
-    input[index + 2] = guide[k] * guide[k];
-    input[index + 3] = guide[k] * mask[k];
-  }
-
-  // blur the guide and mask as a four-channel image to exploit data locality and SIMD
-  dt_box_mean(input, height, width, 4, radius, 1);
-
-  // blend the result and store in output buffer
-  DT_OMP_FOR()
-  for(size_t idx = 0; idx < width*height; idx++)
-  {
-    const float d = fmaxf((input[4*idx+2] - input[4*idx+0] * input[4*idx+0]) + feathering, 1e-15f); // avoid division by 0.
-    const float a = (input[4*idx+3] - input[4*idx+0] * input[4*idx+1]) / d;
-    const float b = input[4*idx+1] - a * input[4*idx+0];
-    ab[2*idx] = a;
-    ab[2*idx+1] = b;
-  }
-
-  if(input != NULL) dt_free_align(input);
-}
-
-
 __DT_CLONE_TARGETS__
 static inline void apply_linear_blending(float *const restrict image,
                                          const float *const restrict ab,
@@ -310,12 +259,14 @@ static inline void fast_surface_blur(float *const restrict image,
     // (Re)build the mask from the quantized image to help guiding
     quantize(ds_image, ds_mask, ds_width * ds_height, quantization, quantize_min, quantize_max);
 
-    // Perform the patch-wise variance analyse to get
-    // the a and b parameters for the linear blending s.t. mask = a * I + b
-    variance_analyse(ds_mask, ds_image, ds_ab, ds_width, ds_height, ds_radius, feathering);
-
-    // Compute the patch-wise average of parameters a and b
-    dt_box_mean(ds_ab, ds_height, ds_width, 2, ds_radius, 1);
+    // Perform the patch-wise variance analyse to get the a and b parameters
+    // for the linear blending s.t. mask = a * I + b, and their patch-wise average,
+    // in a single streaming pass
+    if(!dt_box_guided_coefficients(ds_mask, ds_image, ds_ab, ds_width, ds_height, ds_radius, feathering))
+    {
+      dt_control_log(_("fast guided filter failed to allocate memory, check your RAM settings"));
+      goto clean;
+    }
 
     if(i != iterations - 1)
     {
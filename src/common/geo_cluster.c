@@ -0,0 +1,331 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/geo_cluster.h"
+#include "common/math.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+// above this number of expansions a bin stops growing its cluster
+#define EXPAND_LIMIT 250
+
+// starting point taken from https://github.com/gyaikhom/dbscan
+// Copyright 2015 Gagarine Yaikhom (MIT License)
+
+typedef struct geo_bin_t
+{
+  unsigned int points;
+  unsigned int num_points;
+} geo_bin_t;
+
+typedef struct dt_dbscan_t
+{
+  dt_geo_position_t *points;
+  geo_bin_t **geo_bins;
+  unsigned int num_points;
+  unsigned int num_lon_bins;
+  unsigned int num_lat_bins;
+  double epsilon;
+  unsigned int minpts;
+  unsigned int index;
+  unsigned int cluster_id;
+} dt_dbscan_t;
+
+static double round_down(const double x,
+                         const double binsize)
+{
+  const double scaled = floor(x / binsize);
+  return scaled * binsize;
+}
+
+static void _bin_points(dt_dbscan_t *db,
+                        const dt_map_box_t *bbox,
+                        const double epsilon)
+{
+  const double lat_north = deg2rad(bbox->lat1) ; // UI uses degrees, we compute in radians
+  const double lat_south = round_down(deg2rad(bbox->lat2), epsilon) ;
+  const double lon_east = deg2rad(bbox->lon2);
+  const double lon_west = round_down(deg2rad(bbox->lon1), epsilon) ;
+  const double lat_range = lat_north - lat_south;
+  const double lon_range = lon_east - lon_west;
+  const unsigned int num_lat_bins = ceil(lat_range / db->epsilon) + 1;
+  const unsigned int num_lon_bins = ceil(lon_range / db->epsilon) + 1;
+  for(unsigned int i = 0; i < db->num_points; i++)
+    db->points[i].next = DT_GEO_CLUSTER_NO_NEXT;
+  db->geo_bins = (geo_bin_t**)calloc(num_lon_bins, sizeof(geo_bin_t*));
+  db->num_lat_bins = num_lat_bins;
+  db->num_lon_bins = num_lon_bins;
+  if(!db->geo_bins)
+    return;
+
+  // bin the coordinates for the points, making a linked list of points in each bin
+  for(unsigned int i = 0; i < db->num_points; i++)
+  {
+    const unsigned int lon_bin =
+      (CLAMP(db->points[i].x, lon_west,lon_east) - lon_west) / db->epsilon ;
+    const unsigned int lat_bin =
+      (CLAMP(db->points[i].y, lat_south,lat_north) - lat_south) / db->epsilon ;
+    db->points[i].x_bin = lon_bin;
+    db->points[i].y_bin = lat_bin;
+    if(!db->geo_bins[lon_bin])
+    {
+      // we haven't yet seen any points in this longitude bin, so
+      // allocate pointers for all of the latitude bins at this
+      // longitude
+      db->geo_bins[lon_bin] = (geo_bin_t*)calloc(num_lat_bins, sizeof(geo_bin_t));
+      if(db->geo_bins[lon_bin])
+      {
+        for(int l = 0; l < num_lat_bins; l++)
+          db->geo_bins[lon_bin][l].points = DT_GEO_CLUSTER_NO_NEXT;
+      }
+    }
+    // push the point on the front of the linked list for its bin
+    db->points[i].next = db->geo_bins[lon_bin][lat_bin].points;
+    db->geo_bins[lon_bin][lat_bin].points = i;
+    // and update the count of images in the bin
+    db->geo_bins[lon_bin][lat_bin].num_points += db->points[i].count;
+  }
+}
+
+static gboolean _not_clustered(dt_dbscan_t *db,
+                               const unsigned int lon,
+                               const unsigned int lat)
+{
+  if(!db->geo_bins[lon] || db->geo_bins[lon][lat].num_points == 0)
+    return FALSE;
+  return db->points[db->geo_bins[lon][lat].points].cluster_id < 0;
+}
+
+static void _add_expand_cluster(dt_dbscan_t *db,
+                                const unsigned int lon,
+                                const unsigned int lat,
+                                const int id,
+                                int iter)
+{
+  // add the current bin to the cluster
+  if(iter >= 0)
+  {
+    for(unsigned int pt = db->geo_bins[lon][lat].points;
+        pt != DT_GEO_CLUSTER_NO_NEXT;
+        pt = db->points[pt].next)
+    {
+      db->points[pt].cluster_id = id;
+    }
+  }
+  if(iter == 0)
+    return;
+  if(iter == -1)
+    iter = 1;
+  // now look at the adjacent bins in all eight directions and add
+  // them if not already in a cluster
+  if(lon > 0 && db->geo_bins[lon-1])
+  {
+    for(int lat2 = lat > 0 ? lat - 1 : lat;
+        lat2 + 1 < MIN(db->num_lat_bins, lat + 2);
+        lat2++)
+    {
+      if(_not_clustered(db, lon-1,lat2))
+      {
+        _add_expand_cluster(db, lon-1, lat2, id, iter-1);
+      }
+    }
+  }
+  if(lat > 0 && _not_clustered(db, lon,lat-1))
+  {
+    _add_expand_cluster(db, lon, lat-1, id, iter-1);
+  }
+  if(lat+1 < db->num_lat_bins && _not_clustered(db, lon,lat+1))
+  {
+    _add_expand_cluster(db, lon, lat+1, id, iter-1);
+  }
+  if(lon+1 < db->num_lon_bins && db->geo_bins[lon+1])
+  {
+    for(int lat2 = lat > 0 ? lat-1 : lat;
+        lat2 + 1 < MIN(db->num_lat_bins, lat + 2);
+        lat2++)
+    {
+      if(_not_clustered(db, lon+1,lat2))
+      {
+        _add_expand_cluster(db, lon+1, lat2, id, iter-1);
+      }
+    }
+  }
+}
+
+static gboolean _identical_positions(dt_dbscan_t *db,
+                                     const unsigned int lon,
+                                     const unsigned int lat)
+{
+  if(db->geo_bins[lon][lat].num_points < 2)
+    return FALSE;
+  unsigned int pt = db->geo_bins[lon][lat].points;
+  const double x = db->points[pt].x;
+  const double y = db->points[pt].y;
+  if(!db->points[pt].same_loc)
+    return FALSE;
+
+  for(pt = db->points[pt].next;
+      pt != DT_GEO_CLUSTER_NO_NEXT;
+      pt = db->points[pt].next)
+  {
+    if(!db->points[pt].same_loc || db->points[pt].x != x || db->points[pt].y != y)
+      return FALSE;
+  }
+  return TRUE;
+}
+
+static gboolean _can_form_cluster(dt_dbscan_t *db,
+                                  const unsigned int lon,
+                                  const unsigned int lat)
+{
+  // look at the current bin, plus the adjacent ones in all eight
+  // directions which do not yet belong to a cluster
+  unsigned int points = db->geo_bins[lon][lat].num_points;
+  if(lat > 0 && _not_clustered(db, lon, lat-1))
+    points += db->geo_bins[lon][lat-1].num_points;
+
+  if(lat+1 < db->num_lat_bins && _not_clustered(db, lon, lat+1))
+    points += db->geo_bins[lon][lat+1].num_points;
+
+  if(lon > 0 && db->geo_bins[lon-1])
+  {
+    if(lat > 0 && _not_clustered(db, lon-1, lat-1))
+      points += db->geo_bins[lon-1][lat-1].num_points;
+    if(_not_clustered(db, lon-1, lat))
+      points += db->geo_bins[lon-1][lat].num_points;
+    if(lat+1 < db->num_lat_bins && _not_clustered(db, lon-1, lat+1))
+      points += db->geo_bins[lon-1][lat+1].num_points;
+  }
+
+  if(lon+1 < db->num_lon_bins && db->geo_bins[lon+1])
+  {
+    if(lat > 0 && _not_clustered(db, lon+1, lat-1))
+      points += db->geo_bins[lon+1][lat-1].num_points;
+    if(_not_clustered(db, lon+1, lat))
+      points += db->geo_bins[lon+1][lat].num_points;
+    if(lat+1 < db->num_lat_bins && _not_clustered(db, lon+1, lat+1))
+      points += db->geo_bins[lon+1][lat+1].num_points;
+  }
+  return points >= db->minpts;
+}
+
+int dt_geo_cluster_dbscan(dt_geo_position_t *points,
+                          const unsigned int num_points,
+                          const dt_map_box_t *bbox,
+                          const double epsilon,
+                          const unsigned int minpts)
+{
+  dt_dbscan_t dbscan = { 0 };
+  dt_dbscan_t *db = &dbscan;
+  db->points = points;
+  db->num_points = num_points;
+  db->epsilon = epsilon * 0.66;
+  // remove the pivot from target
+  db->minpts = minpts > 1 ? minpts - 1 : minpts;
+  db->cluster_id = 0;
+
+  // quantize the location coordinates and collect points into bins
+  _bin_points(db, bbox, db->epsilon);
+  // now that we've binned the points, process by bins instead of individual points
+  // first, check if individual bins have enough points to form a cluster
+  for(unsigned int lon = 0; lon < db->num_lon_bins; lon++)
+  {
+    if(!db->geo_bins[lon])
+      continue;
+    for(unsigned int lat = 0; lat < db->num_lat_bins; lat++)
+    {
+      if(db->geo_bins[lon][lat].num_points >= db->minpts)
+      {
+        _add_expand_cluster(db, lon, lat, db->cluster_id, EXPAND_LIMIT);
+        ++db->cluster_id;
+      }
+    }
+  }
+  // next, check if groups of adjacent bins can form a cluster
+  for(unsigned int lon = 0; lon < db->num_lon_bins; lon++)
+  {
+    if(!db->geo_bins[lon])
+      continue;
+    for(unsigned int lat = 0; lat < db->num_lat_bins; lat++)
+    {
+      if(_can_form_cluster(db, lon, lat))
+      {
+        _add_expand_cluster(db, lon, lat, db->cluster_id, EXPAND_LIMIT);
+        ++db->cluster_id;
+      }
+    }
+  }
+  // now that we've found the cluster cores, expand all of the clusters
+  // into neighboring bins where possible
+  for(unsigned int iter = 0; iter < 20; iter++)
+  {
+    for(unsigned int lon = 0; lon < db->num_lon_bins; lon++)
+    {
+      if(!db->geo_bins[lon])
+        continue;
+      for(unsigned int lat = 0; lat < db->num_lat_bins; lat++)
+      {
+        int id ;
+        if(db->geo_bins[lon][lat].num_points > 0
+           && (id = db->points[db->geo_bins[lon][lat].points].cluster_id) >= 0) // already in cluster?
+        {
+          _add_expand_cluster(db, lon, lat, id, -1);
+        }
+      }
+    }
+  }
+  // if we still have any unclustered images, treat them as a cluster
+  // if they are at identical positions, otherwise flag them as
+  // "noise"
+  for(unsigned int lon = 0; lon < db->num_lon_bins; lon++)
+  {
+    if(!db->geo_bins[lon])
+      continue;
+    for(unsigned int lat = 0; lat < db->num_lat_bins; lat++)
+    {
+      if(db->geo_bins[lon][lat].num_points > 1
+         && db->points[db->geo_bins[lon][lat].points].cluster_id == DT_GEO_CLUSTER_UNCLASSIFIED
+         && _identical_positions(db, lon,lat))
+      {
+        _add_expand_cluster(db, lon,lat, db->cluster_id++, 0);
+      }
+      else if(db->geo_bins[lon][lat].num_points > 0
+              && db->points[db->geo_bins[lon][lat].points].cluster_id == DT_GEO_CLUSTER_UNCLASSIFIED)
+      {
+        _add_expand_cluster(db, lon, lat, DT_GEO_CLUSTER_NOISE, 0);
+      }
+    }
+  }
+  // free allocated memory
+  for(unsigned int  lon = 0; lon < db->num_lon_bins; lon++)
+  {
+    if(db->geo_bins[lon])
+      free(db->geo_bins[lon]);
+  }
+  free(db->geo_bins);
+  db->geo_bins = NULL;
+  return db->cluster_id;
+}
+
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
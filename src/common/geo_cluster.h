@@ -0,0 +1,69 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/darktable.h"
+#include "common/geo.h"
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* density based clustering (dbscan) of the image positions shown by
+ * the map view. The positions are weighted: each one stands for count
+ * images, usually the cell of the spatial index holding them. The
+ * positions are binned on a grid of epsilon * 0.66 radians over the
+ * box, the clusters grow from the bins holding at least minpts images. */
+
+#define DT_GEO_CLUSTER_UNCLASSIFIED -1
+#define DT_GEO_CLUSTER_NOISE -2
+
+#define DT_GEO_CLUSTER_NO_NEXT (~((unsigned int)0))
+
+// a cell of the spatial index holding one or more images
+typedef struct dt_geo_position_t
+{
+  double x, y;                  // position in radians
+  unsigned int x_bin, y_bin;
+  unsigned int next;
+  int cluster_id;
+  dt_imgid_t imgid;
+  guint32 cell;
+  guint32 first, count;
+  gboolean same_loc;
+} dt_geo_position_t;
+
+/** set the cluster_id of the positions, DT_GEO_CLUSTER_NOISE for the
+ * ones which are not in a cluster. The cluster_id must be
+ * DT_GEO_CLUSTER_UNCLASSIFIED on entry.
+ * \return the number of clusters */
+int dt_geo_cluster_dbscan(dt_geo_position_t *points,
+                          const unsigned int num_points,
+                          const dt_map_box_t *bbox,
+                          const double epsilon,
+                          const unsigned int minpts);
+
+G_END_DECLS
+
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
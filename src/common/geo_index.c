@@ -0,0 +1,374 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/geo_index.h"
+
+#include <math.h>
+
+// number of levels whose cells are kept
+#define DT_GEO_INDEX_CACHED_LEVELS 4
+// below this number of cells the query checks them one by one
+#define DT_GEO_INDEX_SCAN_LIMIT 16
+
+typedef struct dt_geo_index_level_t
+{
+  int level;
+  guint64 used;
+  dt_geo_index_cell_t *cells;
+  guint32 count;
+} dt_geo_index_level_t;
+
+struct dt_geo_index_t
+{
+  GArray *points;         // dt_geo_index_point_t
+  gboolean sorted;
+  GHashTable *images;     // imgid -> point + 1
+  dt_geo_index_level_t levels[DT_GEO_INDEX_CACHED_LEVELS];
+  guint64 stamp;
+};
+
+typedef struct dt_geo_index_box_t
+{
+  guint64 x0, x1, y0, y1;
+} dt_geo_index_box_t;
+
+// spread the 32 bits of v on the even bits
+static inline guint64 _spread(guint64 v)
+{
+  v &= 0xffffffffULL;
+  v = (v | (v << 16)) & 0x0000ffff0000ffffULL;
+  v = (v | (v << 8)) & 0x00ff00ff00ff00ffULL;
+  v = (v | (v << 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  v = (v | (v << 2)) & 0x3333333333333333ULL;
+  v = (v | (v << 1)) & 0x5555555555555555ULL;
+  return v;
+}
+
+// gather the even bits of v
+static inline guint64 _compact(guint64 v)
+{
+  v &= 0x5555555555555555ULL;
+  v = (v | (v >> 1)) & 0x3333333333333333ULL;
+  v = (v | (v >> 2)) & 0x0f0f0f0f0f0f0f0fULL;
+  v = (v | (v >> 4)) & 0x00ff00ff00ff00ffULL;
+  v = (v | (v >> 8)) & 0x0000ffff0000ffffULL;
+  v = (v | (v >> 16)) & 0x00000000ffffffffULL;
+  return v;
+}
+
+static inline guint64 _quantize(const double v,
+                                const double min,
+                                const double range)
+{
+  const double q = (v - min) / range * 4294967296.0;
+  return q <= 0.0 ? 0 : q >= 4294967295.0 ? 0xffffffffULL : (guint64)q;
+}
+
+static inline guint64 _cell_key(const guint64 key,
+                                const int level)
+{
+  const int shift = 2 * (DT_GEO_INDEX_MAX_LEVEL - level);
+  return shift >= 64 ? 0 : key >> shift;
+}
+
+static gint _sort_points(gconstpointer a,
+                         gconstpointer b)
+{
+  const dt_geo_index_point_t *pa = a;
+  const dt_geo_index_point_t *pb = b;
+  if(pa->key != pb->key) return pa->key < pb->key ? -1 : 1;
+  return pa->imgid - pb->imgid;
+}
+
+static void _clear_levels(dt_geo_index_t *index)
+{
+  for(int i = 0; i < DT_GEO_INDEX_CACHED_LEVELS; i++)
+  {
+    g_free(index->levels[i].cells);
+    index->levels[i].cells = NULL;
+    index->levels[i].count = 0;
+  }
+}
+
+static void _sort(dt_geo_index_t *index)
+{
+  if(index->sorted) return;
+
+  g_array_sort(index->points, _sort_points);
+  g_hash_table_remove_all(index->images);
+  for(guint i = 0; i < index->points->len; i++)
+  {
+    const dt_geo_index_point_t *p = &g_array_index(index->points, dt_geo_index_point_t, i);
+    g_hash_table_insert(index->images, GINT_TO_POINTER(p->imgid), GUINT_TO_POINTER(i + 1));
+  }
+  index->sorted = TRUE;
+}
+
+static dt_geo_index_level_t *_get_level(dt_geo_index_t *index,
+                                        const int level)
+{
+  _sort(index);
+
+  dt_geo_index_level_t *slot = &index->levels[0];
+  for(int i = 0; i < DT_GEO_INDEX_CACHED_LEVELS; i++)
+  {
+    dt_geo_index_level_t *l = &index->levels[i];
+    if(l->cells && l->level == level)
+    {
+      l->used = ++index->stamp;
+      return l;
+    }
+    // reuse an empty slot or the least recently used level
+    if(slot->cells && (!l->cells || l->used < slot->used))
+      slot = l;
+  }
+
+  g_free(slot->cells);
+  slot->cells = NULL;
+  slot->count = 0;
+  slot->level = level;
+  slot->used = ++index->stamp;
+
+  const guint32 nb = index->points->len;
+  if(!nb) return slot;
+
+  // the points are sorted, the points of a cell follow each other
+  GArray *cells = g_array_new(FALSE, FALSE, sizeof(dt_geo_index_cell_t));
+  dt_geo_index_cell_t cell = { 0 };
+  for(guint32 i = 0; i < nb; i++)
+  {
+    const dt_geo_index_point_t *p = &g_array_index(index->points, dt_geo_index_point_t, i);
+    const guint64 key = _cell_key(p->key, level);
+    if(!cell.count || key != cell.key)
+    {
+      if(cell.count)
+      {
+        cell.lon /= cell.count;
+        cell.lat /= cell.count;
+        g_array_append_val(cells, cell);
+      }
+      cell.key = key;
+      cell.first = i;
+      cell.count = 0;
+      cell.lon = cell.lat = 0.0;
+      cell.same_loc = TRUE;
+    }
+    else if(cell.same_loc)
+    {
+      const dt_geo_index_point_t *first =
+        &g_array_index(index->points, dt_geo_index_point_t, cell.first);
+      cell.same_loc = p->lon == first->lon && p->lat == first->lat;
+    }
+    cell.count++;
+    cell.lon += p->lon;
+    cell.lat += p->lat;
+  }
+  cell.lon /= cell.count;
+  cell.lat /= cell.count;
+  g_array_append_val(cells, cell);
+
+  slot->count = cells->len;
+  slot->cells = (dt_geo_index_cell_t *)g_array_free(cells, FALSE);
+  return slot;
+}
+
+// first cell from lo with a key not lower than key
+static guint32 _lower_bound(const dt_geo_index_cell_t *cells,
+                            guint32 lo,
+                            guint32 hi,
+                            const guint64 key)
+{
+  while(lo < hi)
+  {
+    const guint32 mid = lo + (hi - lo) / 2;
+    if(cells[mid].key < key)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+// the position of the quadtree node of prefix at depth relative to the box
+static gboolean _node_intersects(const guint64 prefix,
+                                 const int depth,
+                                 const dt_geo_index_box_t *box,
+                                 gboolean *inside)
+{
+  const int size = DT_GEO_INDEX_MAX_LEVEL - depth;
+  const guint64 x0 = _compact(prefix) << size;
+  const guint64 y0 = _compact(prefix >> 1) << size;
+  const guint64 w = (G_GUINT64_CONSTANT(1) << size) - 1;
+  if(x0 > box->x1 || x0 + w < box->x0 || y0 > box->y1 || y0 + w < box->y0)
+    return FALSE;
+  *inside = x0 >= box->x0 && x0 + w <= box->x1 && y0 >= box->y0 && y0 + w <= box->y1;
+  return TRUE;
+}
+
+static void _query_node(const dt_geo_index_level_t *l,
+                        const guint64 prefix,
+                        const int depth,
+                        const guint32 lo,
+                        const guint32 hi,
+                        const dt_geo_index_box_t *box,
+                        GArray *cells)
+{
+  if(lo >= hi) return;
+
+  gboolean inside = FALSE;
+  if(!_node_intersects(prefix, depth, box, &inside)) return;
+
+  if(inside || depth == l->level)
+  {
+    for(guint32 i = lo; i < hi; i++)
+      g_array_append_val(cells, i);
+    return;
+  }
+
+  if(hi - lo <= DT_GEO_INDEX_SCAN_LIMIT)
+  {
+    for(guint32 i = lo; i < hi; i++)
+      if(_node_intersects(l->cells[i].key, l->level, box, &inside))
+        g_array_append_val(cells, i);
+    return;
+  }
+
+  // split the run of the node between its four children
+  const int shift = 2 * (l->level - depth - 1);
+  guint32 bounds[5] = { lo, 0, 0, 0, hi };
+  for(int q = 1; q < 4; q++)
+    bounds[q] = _lower_bound(l->cells, bounds[q - 1], hi, ((prefix << 2) | q) << shift);
+
+  for(int q = 0; q < 4; q++)
+    _query_node(l, (prefix << 2) | q, depth + 1, bounds[q], bounds[q + 1], box, cells);
+}
+
+dt_geo_index_t *dt_geo_index_new(void)
+{
+  dt_geo_index_t *index = g_malloc0(sizeof(dt_geo_index_t));
+  index->points = g_array_new(FALSE, FALSE, sizeof(dt_geo_index_point_t));
+  index->images = g_hash_table_new(NULL, NULL);
+  index->sorted = TRUE;
+  return index;
+}
+
+void dt_geo_index_free(dt_geo_index_t *index)
+{
+  if(!index) return;
+  _clear_levels(index);
+  g_array_free(index->points, TRUE);
+  g_hash_table_destroy(index->images);
+  g_free(index);
+}
+
+void dt_geo_index_add(dt_geo_index_t *index,
+                      const dt_imgid_t imgid,
+                      const double lon,
+                      const double lat)
+{
+  dt_geo_index_point_t p = { 0 };
+  p.lon = lon;
+  p.lat = lat;
+  p.imgid = imgid;
+  p.key = _spread(_quantize(lon, -180.0, 360.0))
+        | (_spread(_quantize(lat, -90.0, 180.0)) << 1);
+  g_array_append_val(index->points, p);
+  if(index->sorted)
+  {
+    index->sorted = FALSE;
+    _clear_levels(index);
+  }
+}
+
+guint32 dt_geo_index_count(dt_geo_index_t *index)
+{
+  return index->points->len;
+}
+
+const dt_geo_index_point_t *dt_geo_index_get_point(dt_geo_index_t *index,
+                                                   const guint32 point)
+{
+  _sort(index);
+  if(point >= index->points->len) return NULL;
+  return &g_array_index(index->points, dt_geo_index_point_t, point);
+}
+
+const dt_geo_index_cell_t *dt_geo_index_get_cells(dt_geo_index_t *index,
+                                                  const int level,
+                                                  guint32 *count)
+{
+  const dt_geo_index_level_t *l =
+    _get_level(index, CLAMP(level, 0, DT_GEO_INDEX_MAX_LEVEL));
+  *count = l->count;
+  return l->cells;
+}
+
+int dt_geo_index_level(const double lon_size)
+{
+  if(!(lon_size > 0.0)) return DT_GEO_INDEX_MAX_LEVEL;
+  const int level = ceil(log2(360.0 / lon_size));
+  return CLAMP(level, 0, DT_GEO_INDEX_MAX_LEVEL);
+}
+
+guint32 dt_geo_index_query(dt_geo_index_t *index,
+                           const int level,
+                           const double lon_min,
+                           const double lon_max,
+                           const double lat_min,
+                           const double lat_max,
+                           GArray *cells)
+{
+  const guint before = cells->len;
+  const dt_geo_index_level_t *l =
+    _get_level(index, CLAMP(level, 0, DT_GEO_INDEX_MAX_LEVEL));
+  if(!l->count || lon_min > lon_max || lat_min > lat_max) return 0;
+
+  const dt_geo_index_box_t box =
+    { .x0 = _quantize(lon_min, -180.0, 360.0),
+      .x1 = _quantize(lon_max, -180.0, 360.0),
+      .y0 = _quantize(lat_min, -90.0, 180.0),
+      .y1 = _quantize(lat_max, -90.0, 180.0) };
+  _query_node(l, 0, 0, 0, l->count, &box, cells);
+  return cells->len - before;
+}
+
+gint64 dt_geo_index_find_image(dt_geo_index_t *index,
+                               const dt_imgid_t imgid)
+{
+  _sort(index);
+  const guint point = GPOINTER_TO_UINT(g_hash_table_lookup(index->images,
+                                                           GINT_TO_POINTER(imgid)));
+  return (gint64)point - 1;
+}
+
+guint32 dt_geo_index_find_cell(dt_geo_index_t *index,
+                               const int level,
+                               const guint32 point)
+{
+  const dt_geo_index_level_t *l =
+    _get_level(index, CLAMP(level, 0, DT_GEO_INDEX_MAX_LEVEL));
+  const dt_geo_index_point_t *p = dt_geo_index_get_point(index, point);
+  if(!p) return l->count;
+  return _lower_bound(l->cells, 0, l->count, _cell_key(p->key, l->level));
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
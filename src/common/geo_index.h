@@ -0,0 +1,113 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/darktable.h"
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* in-memory spatial index of the image positions (linear quadtree).
+ *
+ * The positions are quantized on a 2^32 x 2^32 grid over the
+ * longitude/latitude plane and sorted by their Z-order (Morton) key,
+ * so that each cell of the implicit quadtree at any level is a
+ * contiguous run of the sorted array. A box query descends the
+ * quadtree and binary searches the runs, its cost depends on the
+ * depth and on the number of cells returned, not on the number of
+ * images.
+ *
+ * For each level the cells holding images are aggregated (count,
+ * centroid) on first use and kept, so that the map view can cluster a
+ * bounded number of cells instead of every image of the viewport. */
+
+#define DT_GEO_INDEX_MAX_LEVEL 32
+
+typedef struct dt_geo_index_point_t
+{
+  guint64 key;
+  double lon, lat;
+  dt_imgid_t imgid;
+} dt_geo_index_point_t;
+
+typedef struct dt_geo_index_cell_t
+{
+  guint64 key;          // Z-order key at the level of the cell
+  guint32 first;        // first point of the cell
+  guint32 count;        // number of points of the cell
+  double lon, lat;      // centroid of the points
+  gboolean same_loc;    // all points at the same position
+} dt_geo_index_cell_t;
+
+typedef struct dt_geo_index_t dt_geo_index_t;
+
+dt_geo_index_t *dt_geo_index_new(void);
+void dt_geo_index_free(dt_geo_index_t *index);
+
+/** add an image position. The index is sorted on the next query. */
+void dt_geo_index_add(dt_geo_index_t *index,
+                      const dt_imgid_t imgid,
+                      const double lon,
+                      const double lat);
+
+/** number of images in the index */
+guint32 dt_geo_index_count(dt_geo_index_t *index);
+
+/** the points in Z-order, the members of a cell are the count points
+ * starting at its first point */
+const dt_geo_index_point_t *dt_geo_index_get_point(dt_geo_index_t *index,
+                                                   const guint32 point);
+
+/** the cells of a level, built on first use. Only a few levels are
+ * kept, the array is valid until cells of other levels are requested. */
+const dt_geo_index_cell_t *dt_geo_index_get_cells(dt_geo_index_t *index,
+                                                  const int level,
+                                                  guint32 *count);
+
+/** the coarsest level whose cells are not wider than lon_size degrees */
+int dt_geo_index_level(const double lon_size);
+
+/** append to cells (guint32) the indexes of the cells of the level
+ * intersecting the box, in increasing order.
+ * \return the number of cells appended */
+guint32 dt_geo_index_query(dt_geo_index_t *index,
+                           const int level,
+                           const double lon_min,
+                           const double lon_max,
+                           const double lat_min,
+                           const double lat_max,
+                           GArray *cells);
+
+/** the point of an image, -1 if the image is not in the index */
+gint64 dt_geo_index_find_image(dt_geo_index_t *index,
+                               const dt_imgid_t imgid);
+
+/** the index of the cell of the level holding a point */
+guint32 dt_geo_index_find_cell(dt_geo_index_t *index,
+                               const int level,
+                               const guint32 point);
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -52,8 +52,9 @@ static inline void copy_gray_image(gray_image img1, gray_image img2)
   memcpy(img2.data, img1.data, sizeof(float) * img1.width * img1.height);
 }
 
-void guided_filter(const float *guide, const float *in, float *out, int width, int height, int ch, int w,
-                   float sqrt_eps, float guide_weight, float min, float max);
+// returns FALSE, with out untouched, if the working memory can't be allocated
+gboolean guided_filter(const float *guide, const float *in, float *out, int width, int height, int ch, int w,
+                       float sqrt_eps, float guide_weight, float min, float max);
 
 #ifdef HAVE_OPENCL
 
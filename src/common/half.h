@@ -0,0 +1,90 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+/* IEEE 754 half floats for compact scratch buffers. The conversions are
+   plain integer arithmetic, without F16C, so that the loops using them
+   vectorize on any target. Rounding is to nearest even, half denormals
+   are kept, values beyond the half range become infinities.
+   See https://gist.github.com/rygorous/2156668 */
+
+static inline uint16_t dt_float_to_half(const float f)
+{
+  const uint32_t f32_infinity = 255u << 23;
+  const uint32_t f16_overflow = (127u + 16u) << 23;
+  const uint32_t denormal_magic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+  uint32_t x;
+  memcpy(&x, &f, sizeof(x));
+  const uint32_t sign = x & 0x80000000u;
+  x ^= sign;
+
+  // all the cases are computed and selected so that the loops vectorize
+
+  // normal half: rebias the exponent and round to nearest even
+  const uint32_t mantissa_odd = (x >> 13) & 1u;
+  const uint32_t normal = (x + ((uint32_t)(15 - 127) << 23) + 0xfffu + mantissa_odd) >> 13;
+
+  // half denormal or zero: let the float addition do the rounding
+  float fx, fmagic;
+  memcpy(&fx, &x, sizeof(fx));
+  memcpy(&fmagic, &denormal_magic, sizeof(fmagic));
+  fx += fmagic;
+  uint32_t denormal;
+  memcpy(&denormal, &fx, sizeof(denormal));
+  denormal -= denormal_magic;
+
+  // NaN stays NaN, others are infinity
+  const uint32_t overflow = x > f32_infinity ? 0x7e00u : 0x7c00u;
+
+  const uint32_t h = x >= f16_overflow ? overflow : (x < (113u << 23) ? denormal : normal);
+  return (uint16_t)(h | (sign >> 16));
+}
+
+static inline float dt_half_to_float(const uint16_t h)
+{
+  // both cases are computed and selected so that the loops vectorize
+  const uint32_t magnitude = (uint32_t)h & 0x7fffu;
+  uint32_t x = (magnitude << 13) + ((127u - 15u) << 23); // rebias the exponent
+  x = magnitude >= 0x7c00u ? x + ((128u - 16u) << 23) : x; // infinity or NaN
+  const uint32_t x_denormal = x + (1u << 23);
+
+  float normal, denormal;
+  memcpy(&normal, &x, sizeof(normal));
+  memcpy(&denormal, &x_denormal, sizeof(denormal));
+  // zero or denormal, renormalize by subtracting 2^-14
+  denormal -= 6.103515625e-05f;
+
+  const float f = magnitude < 0x0400u ? denormal : normal;
+  uint32_t r;
+  memcpy(&r, &f, sizeof(r));
+  r |= ((uint32_t)h & 0x8000u) << 16;
+  float result;
+  memcpy(&result, &r, sizeof(result));
+  return result;
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
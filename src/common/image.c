@@ -2991,6 +2991,10 @@ gboolean dt_image_write_sidecar_file(const dt_imgid_t imgid)
   if(!dt_is_valid_imgid(imgid))
     return TRUE;
 
+  // sidecars belong to the instance owning the library
+  if(dt_database_is_read_only(darktable.db))
+    return FALSE;
+
   const dt_imageio_write_xmp_t xmp_mode = dt_image_get_xmp_mode();
 
   char filename[PATH_MAX] = { 0 };
@@ -331,6 +331,13 @@ void dt_image_cache_write_release_info(dt_image_t *img,
 
   img->aspect_ratio = dt_usable_aspect(img->aspect_ratio);
 
+  // with a read-only library the changes are only kept in the cache
+  if(dt_database_is_read_only(darktable.db))
+  {
+    dt_cache_release(&cache->cache, img->cache_entry);
+    return;
+  }
+
   sqlite3_stmt *stmt;
   // clang-format off
   DT_DEBUG_SQLITE3_PREPARE_V2
@@ -24,6 +24,7 @@
 #include <assert.h>
 #include <glib.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -976,6 +977,178 @@ static gboolean _prepare_resampling_plan(const dt_interpolation_t *itor,
   return FALSE;
 }
 
+/* --------------------------------------------------------------------------
+ * Resampling plan cache
+ * ------------------------------------------------------------------------*/
+
+/* Thumbnails, fit-to-screen previews and exports keep resampling between
+ * the same sizes, so the plans are kept in a small cache keyed by all the
+ * parameters of _prepare_resampling_plan() and recycled in least recently
+ * used order. A plan is shared by the cache and its current users and freed
+ * by the last of them to let go, so that evicting a plan in use is safe. */
+
+#define RESAMPLING_PLAN_CACHE_SIZE 16
+
+typedef struct _resampling_plan_t
+{
+  // key
+  const dt_interpolation_t *itor;
+  int in;
+  int out;
+  int shift;
+  float scale;
+  // plan, see _prepare_resampling_plan()
+  int *length;
+  float *kernel;
+  int *index;
+  int *meta;
+  int users;
+  uint64_t last_use;
+} _resampling_plan_t;
+
+static _resampling_plan_t *_plan_cache[RESAMPLING_PLAN_CACHE_SIZE];
+static uint64_t _plan_cache_clock = 0;
+G_LOCK_DEFINE_STATIC(plan_cache);
+
+static void _free_resampling_plan(_resampling_plan_t *plan)
+{
+  // the length array holds the whole plan
+  dt_free_align(plan->length);
+  free(plan);
+}
+
+// must be followed by _release_resampling_plan() once done with the plan
+static _resampling_plan_t *_get_resampling_plan(const dt_interpolation_t *itor,
+                                                const int in,
+                                                const int out,
+                                                const int shift,
+                                                const float scale)
+{
+  G_LOCK(plan_cache);
+  for(int k = 0; k < RESAMPLING_PLAN_CACHE_SIZE; k++)
+  {
+    _resampling_plan_t *plan = _plan_cache[k];
+    if(plan && plan->itor == itor && plan->in == in && plan->out == out
+       && plan->shift == shift && plan->scale == scale)
+    {
+      plan->users++;
+      plan->last_use = ++_plan_cache_clock;
+      G_UNLOCK(plan_cache);
+      return plan;
+    }
+  }
+  G_UNLOCK(plan_cache);
+
+  _resampling_plan_t *plan = calloc(1, sizeof(_resampling_plan_t));
+  if(!plan) return NULL;
+  if(_prepare_resampling_plan(itor, in, out, shift, scale,
+                              &plan->length, &plan->kernel, &plan->index, &plan->meta))
+  {
+    free(plan);
+    return NULL;
+  }
+  plan->itor = itor;
+  plan->in = in;
+  plan->out = out;
+  plan->shift = shift;
+  plan->scale = scale;
+  plan->users = 2; // the caller and the cache
+
+  G_LOCK(plan_cache);
+  int victim = 0;
+  for(int k = 0; k < RESAMPLING_PLAN_CACHE_SIZE; k++)
+  {
+    if(!_plan_cache[k])
+    {
+      victim = k;
+      break;
+    }
+    if(_plan_cache[k]->last_use < _plan_cache[victim]->last_use)
+      victim = k;
+  }
+  _resampling_plan_t *evicted = _plan_cache[victim];
+  _plan_cache[victim] = plan;
+  plan->last_use = ++_plan_cache_clock;
+  const gboolean free_evicted = evicted && --evicted->users == 0;
+  G_UNLOCK(plan_cache);
+
+  if(free_evicted) _free_resampling_plan(evicted);
+  return plan;
+}
+
+static void _release_resampling_plan(_resampling_plan_t *plan)
+{
+  if(!plan) return;
+  G_LOCK(plan_cache);
+  const gboolean last = --plan->users == 0;
+  G_UNLOCK(plan_cache);
+  if(last) _free_resampling_plan(plan);
+}
+
+void dt_interpolation_cleanup(void)
+{
+  G_LOCK(plan_cache);
+  for(int k = 0; k < RESAMPLING_PLAN_CACHE_SIZE; k++)
+  {
+    _resampling_plan_t *plan = _plan_cache[k];
+    _plan_cache[k] = NULL;
+    if(plan && --plan->users == 0)
+      _free_resampling_plan(plan);
+  }
+  G_UNLOCK(plan_cache);
+}
+
+// output rows resampled together by dt_interpolation_resample()
+#define RESAMPLING_BAND_ROWS 32
+// floats processed per step of the vertical pass, 4 channels x 8 pixels
+#define RESAMPLING_VECTOR_FLOATS 32
+
+// first and last input lines used by the output rows oy0 to oy1-1 of a vertical plan
+static void _plan_span(const _resampling_plan_t *const vplan,
+                       const size_t oy0,
+                       const size_t oy1,
+                       int *first,
+                       int *last)
+{
+  *first = INT_MAX;
+  *last = INT_MIN;
+  for(size_t oy = oy0; oy < oy1; oy++)
+  {
+    const int vl = vplan->length[vplan->meta[3 * oy + 0]];
+    const int *const vindex = vplan->index + vplan->meta[3 * oy + 2];
+    for(int iy = 0; iy < vl; iy++)
+    {
+      *first = MIN(*first, vindex[iy]);
+      *last = MAX(*last, vindex[iy]);
+    }
+  }
+}
+
+// resample a line of 4-channel pixels with a horizontal plan
+static void _resample_line_4c(const _resampling_plan_t *const hplan,
+                              const float *const restrict in,
+                              float *const restrict out,
+                              const int width)
+{
+  const int *const hlength = hplan->length;
+  const float *const hkernel = hplan->kernel;
+  const int *const hindex = hplan->index;
+  int hkidx = 0;
+  for(int ox = 0; ox < width; ox++)
+  {
+    dt_aligned_pixel_t hs = { 0.0f, 0.0f, 0.0f, 0.0f };
+    const int hl = hlength[ox];
+    for(int ix = 0; ix < hl; ix++, hkidx++)
+    {
+      const float htap = hkernel[hkidx];
+      const float *const px = in + 4 * (size_t)hindex[hkidx];
+      for_four_channels(c, aligned(hs:16))
+        hs[c] += px[c] * htap;
+    }
+    copy_pixel(out + 4 * ox, hs);
+  }
+}
+
 /** Applies resampling (re-scaling) on *full* input and output buffers.
  *  roi_in and roi_out define the part of the buffers that is affected.
  */
@@ -991,14 +1164,6 @@ void dt_interpolation_resample(const dt_interpolation_t *itor,
     return;
   }
 
-  int *hindex = NULL;
-  int *hlength = NULL;
-  float *hkernel = NULL;
-  int *vindex = NULL;
-  int *vlength = NULL;
-  float *vkernel = NULL;
-  int *vmeta = NULL;
-
   const size_t in_stride_floats = roi_in->width * 4;
   const size_t out_stride_floats = roi_out->width * 4;
 
@@ -1045,88 +1210,89 @@ void dt_interpolation_resample(const dt_interpolation_t *itor,
 
   // Generic non 1:1 case... much more complicated :D
 
-  // Prepare resampling plans once and for all
-  if(_prepare_resampling_plan(itor, roi_in->width, roi_out->width, dx, roi_out->scale,
-                              &hlength, &hkernel, &hindex, NULL))
+  // Fetch the resampling plans
+  _resampling_plan_t *hplan = _get_resampling_plan(itor, roi_in->width, roi_out->width,
+                                                   dx, roi_out->scale);
+  _resampling_plan_t *vplan = _get_resampling_plan(itor, roi_in->height, roi_out->height,
+                                                   dy, roi_out->scale);
+  if(!hplan || !vplan)
     goto exit;
 
-  if(_prepare_resampling_plan(itor, roi_in->height, roi_out->height, dy, roi_out->scale,
-                              &vlength, &vkernel, &vindex, &vmeta))
+  const int *const vlength = vplan->length;
+  const int *const vmeta = vplan->meta;
+
+  /* The filter is separable, so rather than convolving each output pixel
+   * with the full 2D kernel (vertical taps x horizontal taps reads) the
+   * output is produced in bands of rows: the input lines needed by the band
+   * are resampled horizontally into a scratch buffer, then the vertical
+   * taps are applied to whole scratch lines, a contiguous loop working on
+   * 4 channels x 8 pixels at a time. The lines at the edge of a band are
+   * resampled again by the next one, which is cheap compared to the saving
+   * as soon as the kernel spans a few pixels. */
+  const size_t band_rows = RESAMPLING_BAND_ROWS;
+  const size_t nbands = (roi_out->height + band_rows - 1) / band_rows;
+  const size_t line_floats = dt_round_size(out_stride_floats, RESAMPLING_VECTOR_FLOATS);
+
+  // the most input lines needed by any band
+  size_t max_lines = 0;
+  for(size_t band = 0; band < nbands; band++)
+  {
+    const size_t oy0 = band * band_rows;
+    const size_t oy1 = MIN(oy0 + band_rows, (size_t)roi_out->height);
+    int first, last;
+    _plan_span(vplan, oy0, oy1, &first, &last);
+    max_lines = MAX(max_lines, (size_t)(last - first + 1));
+  }
+
+  size_t padded_size;
+  float *const scratch_buffers = dt_alloc_perthread_float(max_lines * line_floats, &padded_size);
+  if(!scratch_buffers)
     goto exit;
 
   dt_get_perf_times(&mid);
 
-  // Process each output line
   DT_OMP_FOR()
-  for(size_t oy = 0; oy < (size_t)roi_out->height; oy++)
+  for(size_t band = 0; band < nbands; band++)
   {
-    // Initialize column resampling indexes
-    int vlidx = vmeta[3 * oy + 0]; // V(ertical) L(ength) I(n)d(e)x
-    int vkidx = vmeta[3 * oy + 1]; // V(ertical) K(ernel) I(n)d(e)x
-    int viidx = vmeta[3 * oy + 2]; // V(ertical) I(ndex) I(n)d(e)x
-
-    // Initialize row resampling indexes
-    int hlidx = 0; // H(orizontal) L(ength) I(n)d(e)x
-    int hkidx = 0; // H(orizontal) K(ernel) I(n)d(e)x
-
-    // Number of lines contributing to the output line
-    const int vl = vlength[vlidx++]; // V(ertical) L(ength)
-
-    // Process each output column
-    for(size_t ox = 0; ox < (size_t)roi_out->width; ox++)
+    float *const restrict lines = dt_get_perthread(scratch_buffers, padded_size);
+    const size_t oy0 = band * band_rows;
+    const size_t oy1 = MIN(oy0 + band_rows, (size_t)roi_out->height);
+    int first, last;
+    _plan_span(vplan, oy0, oy1, &first, &last);
+
+    // horizontal pass over the input lines of the band
+    for(int iy = first; iy <= last; iy++)
+      _resample_line_4c(hplan, in + (size_t)iy * in_stride_floats,
+                        lines + (iy - first) * line_floats, roi_out->width);
+
+    // vertical pass
+    for(size_t oy = oy0; oy < oy1; oy++)
     {
-      // This will hold the resulting pixel
-      dt_aligned_pixel_t vs = { 0.0f, 0.0f, 0.0f, 0.0f };
+      const int vl = vlength[vmeta[3 * oy + 0]];
+      const float *const vkernel = vplan->kernel + vmeta[3 * oy + 1];
+      const int *const vindex = vplan->index + vmeta[3 * oy + 2];
+      float *const o = out + oy * out_stride_floats;
 
-      // Number of horizontal samples contributing to the output
-      const int hl = hlength[hlidx++]; // H(orizontal) L(ength)
-
-      for(size_t iy = 0; iy < vl; iy++)
+      for(size_t x = 0; x < out_stride_floats; x += RESAMPLING_VECTOR_FLOATS)
       {
-        // This is our input line
-        const size_t baseidx_vindex = (size_t)vindex[viidx++] * in_stride_floats;
-
-        dt_aligned_pixel_t vhs = { 0.0f, 0.0f, 0.0f, 0.0f };
-
-        for(size_t ix = 0; ix < hl; ix++)
+        float DT_ALIGNED_ARRAY vs[RESAMPLING_VECTOR_FLOATS] = { 0.0f };
+        for(int iy = 0; iy < vl; iy++)
         {
-          // Apply the precomputed filter kernel
-          const size_t baseidx = baseidx_vindex + (size_t)hindex[hkidx] * 4;
-          const float htap = hkernel[hkidx++];
-          dt_aligned_pixel_t tmp;
-          copy_pixel(tmp, in + baseidx);
-          for_each_channel(c, aligned(tmp,vhs:16))
-            vhs[c] += tmp[c] * htap;
+          const float *const restrict line = lines + (vindex[iy] - first) * line_floats + x;
+          const float vtap = vkernel[iy];
+          DT_OMP_SIMD(aligned(vs, line : 64))
+          for(size_t k = 0; k < RESAMPLING_VECTOR_FLOATS; k++)
+            vs[k] += line[k] * vtap;
         }
-
-        // Accumulate contribution from this line
-        const float vtap = vkernel[vkidx++];
-        for_each_channel(c, aligned(vhs,vs:16)) vs[c] += vhs[c] * vtap;
-
-        // Reset horizontal resampling context
-        hkidx -= hl;
+        memcpy(o + x, vs, sizeof(float) * MIN(RESAMPLING_VECTOR_FLOATS, out_stride_floats - x));
       }
-
-      // Output pixel is ready
-      const size_t baseidx = (size_t)oy * out_stride_floats + (size_t)ox * 4;
-      copy_pixel_nontemporal(out + baseidx, vs);
-
-      // Reset vertical resampling context
-      viidx -= vl;
-      vkidx -= vl;
-
-      // Progress in horizontal context
-      hkidx += hl;
     }
   }
-  dt_omploop_sfence();
+  dt_free_align(scratch_buffers);
 
 exit:
-  /* Free the resampling plans. It's nasty to optimize allocs like that, but
-   * it simplifies the code :-D. The length array is in fact the only memory
-   * allocated. */
-  dt_free_align(hlength);
-  dt_free_align(vlength);
+  _release_resampling_plan(hplan);
+  _release_resampling_plan(vplan);
   _show_2_times(&start, &mid, "resample_plain");
 }
 
@@ -1193,14 +1359,8 @@ int dt_interpolation_resample_cl(const dt_interpolation_t *itor,
                                  cl_mem dev_in,
                                  const dt_iop_roi_t *const roi_in)
 {
-  int *hindex = NULL;
-  int *hlength = NULL;
-  float *hkernel = NULL;
-  int *hmeta = NULL;
-  int *vindex = NULL;
-  int *vlength = NULL;
-  float *vkernel = NULL;
-  int *vmeta = NULL;
+  _resampling_plan_t *hplan = NULL;
+  _resampling_plan_t *vplan = NULL;
 
   cl_int err = DT_OPENCL_DEFAULT_ERROR;
 
@@ -1257,14 +1417,20 @@ int dt_interpolation_resample_cl(const dt_interpolation_t *itor,
 
   // Generic non 1:1 case... much more complicated :D
 
-  // Prepare resampling plans once and for all
-  if(_prepare_resampling_plan(itor, roi_in->width, width, dx, roi_out->scale,
-                              &hlength, &hkernel, &hindex, &hmeta))
+  // Fetch the resampling plans
+  hplan = _get_resampling_plan(itor, roi_in->width, width, dx, roi_out->scale);
+  vplan = _get_resampling_plan(itor, roi_in->height, height, dy, roi_out->scale);
+  if(!hplan || !vplan)
     goto error;
 
-  if(_prepare_resampling_plan(itor, roi_in->height, height, dy, roi_out->scale,
-                              &vlength, &vkernel, &vindex, &vmeta))
-    goto error;
+  int *const hindex = hplan->index;
+  int *const hlength = hplan->length;
+  float *const hkernel = hplan->kernel;
+  int *const hmeta = hplan->meta;
+  int *const vindex = vplan->index;
+  int *const vlength = vplan->length;
+  float *const vkernel = vplan->kernel;
+  int *const vmeta = vplan->meta;
 
   dt_get_perf_times(&mid);
 
@@ -1368,8 +1534,8 @@ error:
   dt_opencl_release_mem_object(dev_vlength);
   dt_opencl_release_mem_object(dev_vkernel);
   dt_opencl_release_mem_object(dev_vmeta);
-  dt_free_align(hlength);
-  dt_free_align(vlength);
+  _release_resampling_plan(hplan);
+  _release_resampling_plan(vplan);
   return err;
 }
 
@@ -1404,14 +1570,6 @@ void dt_interpolation_resample_mask(const dt_interpolation_t *itor,
                                   const float *const in,
                                   const dt_iop_roi_t *const roi_in)
 {
-  int *hindex = NULL;
-  int *hlength = NULL;
-  float *hkernel = NULL;
-  int *vindex = NULL;
-  int *vlength = NULL;
-  float *vkernel = NULL;
-  int *vmeta = NULL;
-
   dt_times_t start = { 0 }, mid = { 0 };
   dt_get_perf_times(&start);
 
@@ -1456,20 +1614,24 @@ void dt_interpolation_resample_mask(const dt_interpolation_t *itor,
 
   // Generic non 1:1 case... much more complicated :D
   gboolean error = FALSE;
-  // Prepare resampling plans once and for all
-  if(_prepare_resampling_plan(itor, roi_in->width, roi_out->width, dx, roi_out->scale,
-                              &hlength, &hkernel, &hindex, NULL))
+  // Fetch the resampling plans
+  _resampling_plan_t *hplan = _get_resampling_plan(itor, roi_in->width, roi_out->width,
+                                                   dx, roi_out->scale);
+  _resampling_plan_t *vplan = _get_resampling_plan(itor, roi_in->height, roi_out->height,
+                                                   dy, roi_out->scale);
+  if(!hplan || !vplan)
   {
     error = TRUE;
     goto exit;
   }
 
-  if(_prepare_resampling_plan(itor, roi_in->height, roi_out->height, dy, roi_out->scale,
-                              &vlength, &vkernel, &vindex, &vmeta))
-  {
-    error = TRUE;
-    goto exit;
-  }
+  const int *const hindex = hplan->index;
+  const int *const hlength = hplan->length;
+  const float *const hkernel = hplan->kernel;
+  const int *const vindex = vplan->index;
+  const int *const vlength = vplan->length;
+  const float *const vkernel = vplan->kernel;
+  const int *const vmeta = vplan->meta;
 
   dt_get_perf_times(&mid);
 
@@ -1543,11 +1705,8 @@ void dt_interpolation_resample_mask(const dt_interpolation_t *itor,
     dt_print_pipe(DT_DEBUG_ALWAYS,
       "resample mask failed", NULL, NULL, DT_DEVICE_CPU, roi_in, roi_out);
 
-  /* Free the resampling plans. It's nasty to optimize allocs like that, but
-   * it simplifies the code :-D. The length array is in fact the only memory
-   * allocated. */
-  dt_free_align(hlength);
-  dt_free_align(vlength);
+  _release_resampling_plan(hplan);
+  _release_resampling_plan(vplan);
   _show_2_times(&start, &mid, "resample_mask_plain");
 }
 
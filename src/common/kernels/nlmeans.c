@@ -0,0 +1,478 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* patch loops of nlmeans_denoise(), included by common/nlmeans_core.c
+ * through common/cpu_variants.h once per instruction set level */
+
+static void DT_CPU_VARIANT(init_column_sums)(
+        float *const col_sums,
+        const patch_t *const patch,
+        const float *const in,
+        const int row,
+        const int chunk_left,
+        const int chunk_right,
+        const int height,
+        const int width,
+        const int stride,
+        const int radius,
+        const float *const norm)
+{
+  // Compute column sums from scratch.  Needed for the very first row, and at intervals thereafter
+  //   to limit accumulation of rounding errors
+
+  // figure out which columns can possibly contribute to patches whose centers lie within the RoI
+  // we can go up to 'radius' columns beyond the current chunk provided that the patch does not
+  // lie in the same direction from the pixel being denoised and that we're still in the RoI
+  const int scol = patch->cols;
+  const int col_min = chunk_left - MIN(radius,MIN(chunk_left,chunk_left+scol));
+  const int col_max = chunk_right + MIN(radius,MIN(width-chunk_right,width-(chunk_right+scol)));
+  // adjust bounds if the patch extends past top/bottom of RoI
+  const int srow = patch->rows;
+  const int rmin = row - MIN(radius,MIN(row,row+srow));
+  const int rmax = row + MIN(radius,MIN(height-1-row,height-1-(row+srow)));
+  for(int col = chunk_left-radius-1; col < MIN(col_min,chunk_right+radius); col++)
+  {
+    col_sums[PATCH_GROUP*col] = 0.0f;
+  }
+  for(int col = col_min; col < col_max; col++)
+  {
+    float sum = 0.0f;
+    for(int r = rmin; r <= rmax; r++)
+    {
+      const float *pixel = in + r*stride + 4*col;
+      sum += pixel_difference(pixel,pixel+patch->offset,norm);
+    }
+    col_sums[PATCH_GROUP*col] = sum;
+  }
+  // clear out any columns where the patch column would be outside the RoI, as well as our overrun area
+  for(int col = MAX(col_min,col_max); col < chunk_right + radius; col++)
+  {
+    col_sums[PATCH_GROUP*col] = 0.0f;
+  }
+  return;
+}
+
+// add the contribution of one search offset to the output pixels [col_start,col_end) of a row
+static inline void DT_CPU_VARIANT(accumulate_patch)(
+        float *const out,
+        const float *const in,
+        patch_state_t *const state,
+        const int col_start,
+        const int col_end,
+        const int radius,
+        const int stride,
+        const dt_nlmeans_param_t *const params,
+        const dt_aligned_pixel_t center_norm)
+{
+  const float *const col_sums = state->col_sums;
+  const int offset = state->patch->offset;
+  const float sharpness = params->sharpness;
+  float distortion = state->distortion;
+  if(params->center_weight < 0.0f)
+  {
+    // computation as used by denoise(non-local) iop
+    for(int col = col_start; col < col_end; col++)
+    {
+      distortion += (col_sums[PATCH_GROUP*(col+radius)] - col_sums[PATCH_GROUP*(col-radius-1)]);
+      const float wt = gh(distortion * sharpness);
+      const float *const inpx = in+4*col;
+      const dt_aligned_pixel_t pixel = { inpx[offset], inpx[offset+1], inpx[offset+2], 1.0f };
+      for_four_channels(c,aligned(pixel,out:16))
+      {
+        out[4*col+c] += pixel[c] * wt;
+      }
+      _mm_prefetch(in+4*col+offset+stride,_MM_HINT_T0);	// try to ensure next row is ready in time
+    }
+  }
+  else
+  {
+    // computation as used by denoiseprofiled iop with non-local means
+    for(int col = col_start; col < col_end; col++)
+    {
+      distortion += (col_sums[PATCH_GROUP*(col+radius)] - col_sums[PATCH_GROUP*(col-radius-1)]);
+      const float dissimilarity = (distortion + pixel_difference(in+4*col,in+4*col+offset,center_norm))
+                                   / (1.0f + params->center_weight);
+      const float wt = gh(fmaxf(0.0f, dissimilarity * sharpness - 2.0f));
+      const float *const inpx = in + 4*col;
+      const dt_aligned_pixel_t pixel = { inpx[offset], inpx[offset+1], inpx[offset+2], 1.0f };
+      for_four_channels(c,aligned(pixel,out:16))
+      {
+        out[4*col+c] += pixel[c] * wt;
+      }
+      _mm_prefetch(in+4*col+offset+stride,_MM_HINT_T0);	// try to ensure next row is ready in time
+    }
+  }
+  state->distortion = distortion;
+}
+
+// same as accumulate_patch() for a full group of search offsets, whose column sums are interleaved so that
+//   the sliding distortions and the weights of the group are computed as one vector.  The contributions
+//   are added in the same order as one offset after the other would, so the result does not depend on
+//   the grouping
+static inline void DT_CPU_VARIANT(accumulate_group)(
+        float *const out,
+        const float *const in,
+        patch_state_t *const state,
+        const int col_start,
+        const int col_end,
+        const int radius,
+        const int stride,
+        const dt_nlmeans_param_t *const params,
+        const dt_aligned_pixel_t center_norm)
+{
+  const float *const col_sums = state[0].col_sums;
+  int offset[PATCH_GROUP];
+  float DT_ALIGNED_PIXEL distortion[PATCH_GROUP];
+  for(int k = 0; k < PATCH_GROUP; k++)
+  {
+    offset[k] = state[k].patch->offset;
+    distortion[k] = state[k].distortion;
+  }
+  const float sharpness = params->sharpness;
+  const gboolean profile = params->center_weight >= 0.0f;
+  for(int col = col_start; col < col_end; col++)
+  {
+    const float *const inpx = in + 4*col;
+    const float *const add = col_sums + PATCH_GROUP*(col+radius);
+    const float *const sub = col_sums + PATCH_GROUP*(col-radius-1);
+    float DT_ALIGNED_PIXEL wt[PATCH_GROUP];
+    if(profile)
+    {
+      // computation as used by denoiseprofiled iop with non-local means
+      float DT_ALIGNED_PIXEL center[PATCH_GROUP];
+      for(int k = 0; k < PATCH_GROUP; k++)
+        center[k] = pixel_difference(inpx,inpx+offset[k],center_norm);
+      for(int k = 0; k < PATCH_GROUP; k++)
+      {
+        distortion[k] += (add[k] - sub[k]);
+        const float dissimilarity = (distortion[k] + center[k]) / (1.0f + params->center_weight);
+        wt[k] = gh(fmaxf(0.0f, dissimilarity * sharpness - 2.0f));
+      }
+    }
+    else
+    {
+      // computation as used by denoise(non-local) iop
+      for(int k = 0; k < PATCH_GROUP; k++)
+      {
+        distortion[k] += (add[k] - sub[k]);
+        wt[k] = gh(distortion[k] * sharpness);
+      }
+    }
+    dt_aligned_pixel_t sum;
+    copy_pixel(sum, out + 4*col);
+    for(int k = 0; k < PATCH_GROUP; k++)
+    {
+      const dt_aligned_pixel_t pixel = { inpx[offset[k]], inpx[offset[k]+1], inpx[offset[k]+2], 1.0f };
+      for_four_channels(c,aligned(pixel,sum:16))
+      {
+        sum[c] += pixel[c] * wt[k];
+      }
+      _mm_prefetch(inpx+offset[k]+stride,_MM_HINT_T0);	// try to ensure next row is ready in time
+    }
+    copy_pixel(out + 4*col, sum);
+  }
+  for(int k = 0; k < PATCH_GROUP; k++)
+    state[k].distortion = distortion[k];
+}
+
+// move the column sums [col_start,col_end) of one search offset down by one row
+static inline void DT_CPU_VARIANT(update_column_sums)(
+        patch_state_t *const state,
+        const float *const inbuf,
+        const int row,
+        const int col_start,
+        const int col_end,
+        const int stride,
+        const int radius,
+        const float *const norm)
+{
+  float *const col_sums = state->col_sums;
+  const int offset = state->patch->offset;
+  if(row < MIN(state->row_top, state->row_bot))
+  {
+    // top edge of patch was above top of RoI, so it had a value of zero; just add in the new row
+    const float *bot_row = inbuf + (row+1+radius)*stride;
+    for(int col = col_start; col < col_end; col++)
+    {
+      const float *const bot_px = bot_row + 4*col;
+      const float diff = pixel_difference(bot_px,bot_px+offset,norm);
+      _mm_prefetch(bot_px+stride, _MM_HINT_T0);
+      col_sums[PATCH_GROUP*col] += diff;
+      _mm_prefetch(bot_px+offset+stride, _MM_HINT_T0);
+    }
+  }
+  else if(row < state->row_bot)
+  {
+    const float *const top_row = inbuf + (row-radius)*stride;
+    const float *const bot_row = inbuf + (row+1+radius)*stride;
+    // both prior and new positions are entirely within the RoI, so subtract the old row and add the new one
+    for(int col = col_start; col < col_end; col++)
+    {
+      const float *const top_px = top_row + 4*col;
+      const float *const bot_px = bot_row + 4*col;
+      const float diff = diff_of_pixels_diff(bot_px,bot_px+offset,top_px,top_px+offset,norm);
+      _mm_prefetch(bot_px+stride, _MM_HINT_T0);
+      col_sums[PATCH_GROUP*col] += diff;
+      _mm_prefetch(bot_px+offset+stride, _MM_HINT_T0);
+    }
+  }
+  else if(row >= state->row_top && row + 1 < state->row_max) // don't bother updating if last iteration
+  {
+    // new row of the patch is below the bottom of RoI, so its value is zero; just subtract the old row
+    const float *top_row = inbuf + (row-radius)*stride;
+    for(int col = col_start; col < col_end; col++)
+    {
+      const float *const top_px = top_row + 4*col;
+      col_sums[PATCH_GROUP*col] -= pixel_difference(top_px,top_px+offset,norm);
+    }
+  }
+}
+
+// same as update_column_sums() for a full group of search offsets which are all fully inside the RoI
+static inline void DT_CPU_VARIANT(update_column_sums_group)(
+        patch_state_t *const state,
+        const float *const inbuf,
+        const int row,
+        const int col_start,
+        const int col_end,
+        const int stride,
+        const int radius,
+        const float *const norm)
+{
+  float *const col_sums = state[0].col_sums;
+  int offset[PATCH_GROUP];
+  for(int k = 0; k < PATCH_GROUP; k++)
+    offset[k] = state[k].patch->offset;
+  const float *const top_row = inbuf + (row-radius)*stride;
+  const float *const bot_row = inbuf + (row+1+radius)*stride;
+  for(int col = col_start; col < col_end; col++)
+  {
+    const float *const top_px = top_row + 4*col;
+    const float *const bot_px = bot_row + 4*col;
+    float DT_ALIGNED_PIXEL diff[PATCH_GROUP];
+    for(int k = 0; k < PATCH_GROUP; k++)
+      diff[k] = diff_of_pixels_diff(bot_px,bot_px+offset[k],top_px,top_px+offset[k],norm);
+    for(int k = 0; k < PATCH_GROUP; k++)
+      col_sums[PATCH_GROUP*col+k] += diff[k];
+    _mm_prefetch(bot_px+stride, _MM_HINT_T0);
+    _mm_prefetch(bot_px+offset[0]+stride, _MM_HINT_T0);
+    _mm_prefetch(bot_px+offset[PATCH_GROUP-1]+stride, _MM_HINT_T0);
+  }
+}
+
+static void DT_CPU_VARIANT(nlmeans_denoise)(
+        const float *const inbuf,
+        float *const outbuf,
+        const dt_iop_roi_t *const roi_in,
+        const dt_iop_roi_t *const roi_out,
+        const dt_nlmeans_param_t *const params)
+{
+  // define the factors for applying blending between the original image and the denoised version
+  // if running in RGB space, 'luma' should equal 'chroma'
+  const dt_aligned_pixel_t weight = { params->luma, params->chroma, params->chroma, 1.0f };
+  const dt_aligned_pixel_t invert = { 1.0f - params->luma, 1.0f - params->chroma, 1.0f - params->chroma, 0.0f };
+  const gboolean skip_blend = (params->luma == 1.0 && params->chroma == 1.0);
+
+  // define the normalization to convert central pixel differences into central pixel weights
+  const float cp_norm = compute_center_pixel_norm(params->center_weight,params->patch_radius);
+  const dt_aligned_pixel_t center_norm = { cp_norm, cp_norm, cp_norm, 1.0f };
+
+  // define the patches to be compared when denoising a pixel
+  const size_t stride = 4 * roi_in->width;
+  int num_patches;
+  int max_shift;
+  struct patch_t* patches = define_patches(params,stride,&num_patches,&max_shift);
+  // allocate scratch space for the column sums of a group of patches, including an overrun area on each
+  // end so we don't need a boundary check on every access
+  const int radius = params->patch_radius;
+  const size_t scratch_size = PATCH_GROUP * (SLICE_WIDTH + 2*radius + 1) + 48; // getting false sharing without the +48....
+  size_t padded_scratch_size;
+  float *const restrict scratch_buf = dt_alloc_perthread_float(scratch_size, &padded_scratch_size);
+  const int chk_height = compute_slice_height(roi_out->height);
+  const int chk_width = compute_slice_width(roi_out->width);
+  DT_OMP_FOR(collapse(2))
+  for(int chunk_top = 0 ; chunk_top < roi_out->height; chunk_top += chk_height)
+  {
+    for(int chunk_left = 0; chunk_left < roi_out->width; chunk_left += chk_width)
+    {
+      // locate our scratch space within the big buffer allocated above
+      float *const restrict tmpbuf = dt_get_perthread(scratch_buf, padded_scratch_size);
+      // determine which horizontal slice of the image to process
+      const int chunk_bot = MIN(chunk_top + chk_height, roi_out->height);
+      // determine which vertical slice of the image to process
+      const int chunk_right = MIN(chunk_left + chk_width, roi_out->width);
+      const int height = roi_out->height;
+      const int width = roi_out->width;
+      // we want to incrementally sum results (especially weights in col[3]), so clear the output buffer to zeros
+      for(int i = chunk_top; i < chunk_bot; i++)
+      {
+        memset(outbuf + 4*(i*roi_out->width+chunk_left), '\0', sizeof(float) * 4 * (chunk_right-chunk_left));
+      }
+      // cycle through all of the patches over our slice of the image, PATCH_GROUP of them at a time
+      for(int p = 0; p < num_patches; p += PATCH_GROUP)
+      {
+        const int group = MIN(PATCH_GROUP, num_patches - p);
+        patch_state_t state[PATCH_GROUP];
+        int group_row_min = chunk_bot;
+        int group_row_max = chunk_top;
+        for(int k = 0; k < group; k++)
+        {
+          patch_state_t *const st = &state[k];
+          // retrieve info about the current patch
+          const patch_t *const patch = &patches[p + k];
+          st->patch = patch;
+          // the column sums of the group are interleaved, column col of patch k is at col_sums[PATCH_GROUP*col]
+          // with col_sums offset by k.  We'll also offset by chunk_left so that we don't have to subtract on
+          // every access
+          st->col_sums = tmpbuf + PATCH_GROUP * ((radius+1) - chunk_left) + k;
+          // skip any rows where the patch center would be above top of RoI or below bottom of RoI
+          st->row_min = MAX(chunk_top,MAX(0,-patch->rows));
+          st->row_max = MIN(chunk_bot,height - MAX(0,patch->rows));
+          // figure out which rows at top and bottom result in patches extending outside the RoI, even though
+          // the center pixel is inside
+          st->row_top = MAX(st->row_min,MAX(radius,radius-patch->rows));
+          st->row_bot = MIN(st->row_max,height-1-MAX(radius,radius+patch->rows));
+          // skip any columns where the patch center would be to the left or the right of the RoI
+          const int scol = patch->cols;
+          st->col_min = MAX(chunk_left,-scol);
+          st->col_max = MIN(chunk_right,width - scol);
+          st->pcol_min = chunk_left - MIN(radius,MIN(chunk_left,chunk_left+scol));
+          st->pcol_max = chunk_right + MIN(radius,MIN(width-chunk_right,width-(chunk_right+scol)));
+          DT_CPU_VARIANT(init_column_sums)(st->col_sums,patch,inbuf,st->row_min,chunk_left,chunk_right,
+                                           height,width,stride,radius,params->norm);
+          group_row_min = MIN(group_row_min, st->row_min);
+          group_row_max = MAX(group_row_max, st->row_max);
+        }
+        for(int row = group_row_min; row < group_row_max; row++)
+        {
+          const float *in = inbuf + stride * row;
+          float *const out = outbuf + (size_t)4 * width * row;
+          // the patches of a group only differ near the borders of the RoI, process the columns they have in
+          // common together when all of them are active on this row
+          gboolean together = group == PATCH_GROUP;
+          int col_lo = chunk_left;
+          int col_hi = chunk_right;
+          for(int k = 0; k < group; k++)
+          {
+            patch_state_t *const st = &state[k];
+            if(row < st->row_min || row >= st->row_max)
+            {
+              together = FALSE;
+              continue;
+            }
+            // add up the initial columns of the sliding window of total patch distortion
+            float distortion = 0.0f;
+            for(int i = st->col_min - radius; i < MIN(st->col_min+radius, st->col_max); i++)
+            {
+              distortion += st->col_sums[PATCH_GROUP*i];
+            }
+            st->distortion = distortion;
+            col_lo = MAX(col_lo, st->col_min);
+            col_hi = MIN(col_hi, st->col_max);
+          }
+          // now proceed down the current row of the image
+          if(together && col_lo < col_hi)
+          {
+            for(int k = 0; k < PATCH_GROUP; k++)
+              DT_CPU_VARIANT(accumulate_patch)(out,in,&state[k],state[k].col_min,col_lo,radius,stride,params,
+                                               center_norm);
+            DT_CPU_VARIANT(accumulate_group)(out,in,state,col_lo,col_hi,radius,stride,params,center_norm);
+            for(int k = 0; k < PATCH_GROUP; k++)
+              DT_CPU_VARIANT(accumulate_patch)(out,in,&state[k],col_hi,state[k].col_max,radius,stride,params,
+                                               center_norm);
+          }
+          else
+          {
+            for(int k = 0; k < group; k++)
+              if(row >= state[k].row_min && row < state[k].row_max)
+                DT_CPU_VARIANT(accumulate_patch)(out,in,&state[k],state[k].col_min,state[k].col_max,radius,stride,
+                                                 params,center_norm);
+          }
+          // slide the column sums down to the next row
+          int pcol_lo = chunk_left - radius;
+          int pcol_hi = chunk_right + radius;
+          for(int k = 0; k < group && together; k++)
+          {
+            together = patch_fully_inside(&state[k], row);
+            pcol_lo = MAX(pcol_lo, state[k].pcol_min);
+            pcol_hi = MIN(pcol_hi, state[k].pcol_max);
+          }
+          if(together && pcol_lo < pcol_hi)
+          {
+            for(int k = 0; k < PATCH_GROUP; k++)
+              DT_CPU_VARIANT(update_column_sums)(&state[k],inbuf,row,state[k].pcol_min,pcol_lo,stride,radius,
+                                                 params->norm);
+            DT_CPU_VARIANT(update_column_sums_group)(state,inbuf,row,pcol_lo,pcol_hi,stride,radius,params->norm);
+            for(int k = 0; k < PATCH_GROUP; k++)
+              DT_CPU_VARIANT(update_column_sums)(&state[k],inbuf,row,pcol_hi,state[k].pcol_max,stride,radius,
+                                                 params->norm);
+          }
+          else
+          {
+            for(int k = 0; k < group; k++)
+              if(row >= state[k].row_min && row < state[k].row_max)
+                DT_CPU_VARIANT(update_column_sums)(&state[k],inbuf,row,state[k].pcol_min,state[k].pcol_max,stride,
+                                                   radius,params->norm);
+          }
+        }
+      }
+      if(skip_blend)
+      {
+        // normalize the pixels
+        for(int row = chunk_top; row < chunk_bot; row++)
+        {
+          float *const out = outbuf + 4 * row * roi_out->width;
+          for(int col = chunk_left; col < chunk_right; col++)
+          {
+            for_each_channel(c,aligned(out:16))
+            {
+              out[4*col+c] /= out[4*col+3];
+            }
+          }
+        }
+      }
+      else
+      {
+        // normalize and apply chroma/luma blending
+        for(int row = chunk_top; row < chunk_bot; row++)
+        {
+          const float *in = inbuf + row * stride;
+          float *out = outbuf + row * 4 * roi_out->width;
+          for(int col = chunk_left; col < chunk_right; col++)
+          {
+            for_each_channel(c,aligned(in,out,weight,invert:16))
+            {
+              out[4*col+c] = (in[4*col+c] * invert[c]) + (out[4*col+c] / out[4*col+3] * weight[c]);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // clean up: free the work space
+  dt_free_align(patches);
+  dt_free_align(scratch_buf);
+  return;
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
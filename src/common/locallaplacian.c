@@ -445,32 +445,69 @@ void local_laplacian_internal(
   for(int k=0;k<num_gamma;k++) gamma[k] = (k+.5f)/(float)num_gamma;
   // for(int k=0;k<num_gamma;k++) gamma[k] = k/(num_gamma-1.0f);
 
-  // allocate memory for intermediate laplacian pyramids
-  float *buf[num_gamma][max_levels] = {{0}};
-  for(int k=0;k<num_gamma;k++)
-    for(int l=0;l<=last_level;l++)
+  // allocate memory for the gaussian pyramid of one curve sample at a time.
+  // the pyramids stay in floats: the laplacian coefficients are differences
+  // of close values of these levels, half floats (common/half.h) would
+  // round them by up to 2^-12 around mid grey, a fair part of the finest
+  // details, and the output levels accumulate all the curve samples. only
+  // the padded input pyramid would take halves safely, a sixth of the memory.
+  float *buf[max_levels] = {0};
+  for(int l=0;l<=last_level;l++)
+  {
+    buf[l] = dt_alloc_align_float((size_t)dl(w,l)*dl(h,l));
+    if(!buf[l])
     {
-      buf[k][l] = dt_alloc_align_float((size_t)dl(w,l)*dl(h,l));
-      if(!buf[k][l])
-      {
-        // copy the input buffer to the output so that we at least get a
-        // valid result
-        for(size_t p = 0; p < (size_t)4 * wd * ht; p++)
-          out[p] = input[p];
-        goto cleanup;
-      }
+      // copy the input buffer to the output so that we at least get a
+      // valid result
+      for(size_t p = 0; p < (size_t)4 * wd * ht; p++)
+        out[p] = input[p];
+      goto cleanup;
     }
+  }
+
+  // the output pyramid is the expanded coarse level plus, at each
+  // level, the laplacian coefficients of the curve samples bracketing
+  // the pixel brightness. Expanding is linear, so the coefficients of
+  // each curve sample can be accumulated into the levels as soon as
+  // its pyramid is built, and the levels collapsed at the end: only
+  // one intermediate pyramid is alive instead of num_gamma of them.
+  for(int l=0;l<last_level;l++)
+    memset(output[l], 0, sizeof(float) * dl(w,l) * dl(h,l));
 
   // the paper says remapping only level 3 not 0 does the trick, too
   // (but i really like the additional octave of sharpness we get,
   // willing to pay the cost).
   for(int k=0;k<num_gamma;k++)
   { // process images
-    apply_curve(buf[k][0], padded[0], w, h, max_supp, gamma[k], sigma, shadows, highlights, clarity);
+    apply_curve(buf[0], padded[0], w, h, max_supp, gamma[k], sigma, shadows, highlights, clarity);
 
-    // create gaussian pyramids
+    // create gaussian pyramid
     for(int l=1;l<=last_level;l++)
-      gauss_reduce(buf[k][l-1], buf[k][l], dl(w,l-1), dl(h,l-1));
+      gauss_reduce(buf[l-1], buf[l], dl(w,l-1), dl(h,l-1));
+
+    // add its weighted laplacian coefficients
+    for(int l=0;l<last_level;l++)
+    {
+      const int pw = dl(w,l), ph = dl(h,l);
+      DT_OMP_FOR(collapse(2))
+      for(int j=0;j<ph;j++) for(int i=0;i<pw;i++)
+      {
+        const float v = padded[l][j*pw+i];
+        int hi = 1;
+        for(;hi<num_gamma-1 && gamma[hi] <= v;hi++);
+        const int lo = hi-1;
+        if(k != lo && k != hi) continue;
+        const float a = CLAMPS((v - gamma[lo])/(gamma[hi]-gamma[lo]), 0.0f, 1.0f);
+        const float weight = k == lo ? 1.0f-a : a;
+        if(weight == 0.0f) continue;
+        output[l][j*pw+i] += ll_laplacian(buf[l+1], buf[l], i, j, pw, ph) * weight;
+        // we could do this to save on memory (no need for finest buf[]).
+        // unfortunately it results in a quite noticeable loss of sharpness, i think
+        // the extra level is worth it.
+        // else if(l == 0) // use finest scale from input to not amplify noise (and use less memory)
+        //   output[l][j*pw+i] += ll_laplacian(padded[l+1], padded[l], i, j, pw, ph);
+      }
+    }
   }
 
   // resample output[last_level] from preview
@@ -533,30 +570,17 @@ void local_laplacian_internal(
       dt_dump_pfm("newcoarse", output[last_level], pw, ph,  4 * sizeof(float), "locallaplacian");
   }
 
-  // assemble output pyramid coarse to fine
+  // assemble output pyramid coarse to fine, the finest level of the
+  // curve pyramid is free now and holds the upsampled coarser level
   for(int l=last_level-1;l >= 0; l--)
   {
     const int pw = dl(w,l), ph = dl(h,l);
+    float *const expanded = buf[0];
 
-    gauss_expand(output[l+1], output[l], pw, ph);
-    // go through all coefficients in the upsampled gauss buffer:
-    DT_OMP_FOR(collapse(2))
-    for(int j=0;j<ph;j++) for(int i=0;i<pw;i++)
-    {
-      const float v = padded[l][j*pw+i];
-      int hi = 1;
-      for(;hi<num_gamma-1 && gamma[hi] <= v;hi++);
-      int lo = hi-1;
-      const float a = CLAMPS((v - gamma[lo])/(gamma[hi]-gamma[lo]), 0.0f, 1.0f);
-      const float l0 = ll_laplacian(buf[lo][l+1], buf[lo][l], i, j, pw, ph);
-      const float l1 = ll_laplacian(buf[hi][l+1], buf[hi][l], i, j, pw, ph);
-      output[l][j*pw+i] += l0 * (1.0f-a) + l1 * a;
-      // we could do this to save on memory (no need for finest buf[][]).
-      // unfortunately it results in a quite noticeable loss of sharpness, i think
-      // the extra level is worth it.
-      // else if(l == 0) // use finest scale from input to not amplify noise (and use less memory)
-      //   output[l][j*pw+i] += ll_laplacian(padded[l+1], padded[l], i, j, pw, ph);
-    }
+    gauss_expand(output[l+1], expanded, pw, ph);
+    DT_OMP_FOR_SIMD(aligned(expanded : 64))
+    for(size_t k=0;k<(size_t)pw*ph;k++)
+      output[l][k] += expanded[k];
   }
   DT_OMP_FOR(collapse(2))
   for(int j=0;j<ht;j++) for(int i=0;i<wd;i++)
@@ -581,7 +605,7 @@ cleanup:
   {
     if(!b || b->mode != 1 || l)   dt_free_align(padded[l]);
     if(!b || b->mode != 1)        dt_free_align(output[l]);
-    for(int k=0; k<num_gamma;k++) dt_free_align(buf[k][l]);
+    dt_free_align(buf[l]);
   }
 }
 
@@ -596,8 +620,9 @@ size_t local_laplacian_memory_use(const int width,     // width of input image
 
   size_t memory_use = 0;
 
+  // padded input, output and the pyramid of the current curve sample
   for(int l=0;l<num_levels;l++)
-    memory_use += sizeof(float) * (2 + num_gamma) * dl(paddwd, l) * dl(paddht, l);
+    memory_use += sizeof(float) * 3 * dl(paddwd, l) * dl(paddht, l);
 
   return memory_use;
 }
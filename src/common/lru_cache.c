@@ -0,0 +1,162 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/lru_cache.h"
+
+void dt_lru_cache_init(dt_lru_cache_t *cache,
+                       const int size,
+                       const size_t max_bytes,
+                       dt_lru_free_t free_item)
+{
+  memset(cache, 0, sizeof(dt_lru_cache_t));
+  dt_pthread_mutex_init(&cache->lock, NULL);
+  // without slots nothing is cached, the items are freed on release
+  cache->item = calloc(size, sizeof(dt_lru_item_t *));
+  cache->size = cache->item ? size : 0;
+  cache->max_bytes = max_bytes;
+  cache->free_item = free_item;
+}
+
+void dt_lru_cache_cleanup(dt_lru_cache_t *cache)
+{
+  for(int k = 0; k < cache->size; k++)
+    if(cache->item[k]) cache->free_item(cache->item[k]);
+  free(cache->item);
+  cache->item = NULL;
+  cache->size = 0;
+  cache->bytes = 0;
+  dt_pthread_mutex_destroy(&cache->lock);
+}
+
+static dt_lru_item_t *_find(dt_lru_cache_t *cache,
+                            const dt_hash_t hash,
+                            dt_lru_match_t match,
+                            const void *key,
+                            const gboolean exact)
+{
+  dt_lru_item_t *best = NULL;
+  float best_rank = 0.0f;
+  for(int k = 0; k < cache->size; k++)
+  {
+    dt_lru_item_t *item = cache->item[k];
+    if(!item || item->hash != hash) continue;
+    const float rank = match ? match(item, key) : 0.0f;
+    if(rank == 0.0f) return item;
+    if(!exact && rank > 0.0f && (!best || rank < best_rank))
+    {
+      best = item;
+      best_rank = rank;
+    }
+  }
+  return best;
+}
+
+static inline void _acquire(dt_lru_cache_t *cache,
+                            dt_lru_item_t *item)
+{
+  item->users++;
+  item->used = ++cache->clock;
+}
+
+static void _evict(dt_lru_cache_t *cache,
+                   const int k)
+{
+  dt_lru_item_t *item = cache->item[k];
+  cache->item[k] = NULL;
+  cache->bytes -= item->bytes;
+  // an item still in use is freed by its last user
+  if(item->users)
+    item->cached = FALSE;
+  else
+    cache->free_item(item);
+}
+
+dt_lru_item_t *dt_lru_cache_get(dt_lru_cache_t *cache,
+                                const dt_hash_t hash,
+                                dt_lru_match_t match,
+                                const void *key)
+{
+  dt_pthread_mutex_lock(&cache->lock);
+  dt_lru_item_t *item = _find(cache, hash, match, key, FALSE);
+  if(item) _acquire(cache, item);
+  dt_pthread_mutex_unlock(&cache->lock);
+  return item;
+}
+
+dt_lru_item_t *dt_lru_cache_put(dt_lru_cache_t *cache,
+                                const dt_hash_t hash,
+                                dt_lru_match_t match,
+                                const void *key,
+                                dt_lru_item_t *item)
+{
+  item->hash = hash;
+  item->users = 0;
+  item->cached = FALSE;
+
+  dt_pthread_mutex_lock(&cache->lock);
+  // another thread may have been quicker
+  dt_lru_item_t *cached = _find(cache, hash, match, key, TRUE);
+  if(cached)
+  {
+    _acquire(cache, cached);
+    dt_pthread_mutex_unlock(&cache->lock);
+    cache->free_item(item);
+    return cached;
+  }
+
+  _acquire(cache, item);
+  if(cache->size && (!cache->max_bytes || item->bytes <= cache->max_bytes))
+  {
+    int slot = -1;
+    for(int k = 0; k < cache->size && slot < 0; k++)
+      if(!cache->item[k]) slot = k;
+    // the least recently used items make room for this one
+    while(slot < 0 || (cache->max_bytes && cache->bytes + item->bytes > cache->max_bytes))
+    {
+      int oldest = -1;
+      for(int k = 0; k < cache->size; k++)
+        if(cache->item[k] && (oldest < 0 || cache->item[k]->used < cache->item[oldest]->used))
+          oldest = k;
+      if(oldest < 0) break;
+      _evict(cache, oldest);
+      if(slot < 0) slot = oldest;
+    }
+    item->cached = TRUE;
+    cache->item[slot] = item;
+    cache->bytes += item->bytes;
+  }
+  dt_pthread_mutex_unlock(&cache->lock);
+  return item;
+}
+
+void dt_lru_cache_release(dt_lru_cache_t *cache,
+                          dt_lru_item_t *item)
+{
+  if(!item) return;
+  dt_pthread_mutex_lock(&cache->lock);
+  item->users--;
+  const gboolean orphan = !item->cached && item->users == 0;
+  dt_pthread_mutex_unlock(&cache->lock);
+  if(orphan) cache->free_item(item);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,98 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/darktable.h"
+#include "common/dtpthread.h"
+
+G_BEGIN_DECLS
+
+/* Small cache of reference counted items, shared by the pipes.
+
+   The items are structs starting with a dt_lru_item_t, built by the
+   caller without the lock and handed to dt_lru_cache_put(). An item
+   acquired by dt_lru_cache_get() or dt_lru_cache_put() stays valid until
+   it is given back with dt_lru_cache_release(), even if it is evicted in
+   the meantime: it is then freed by its last user.
+
+   The least recently used items are evicted when all the slots are taken
+   or, if the cache has a byte budget, when it would be exceeded.
+
+   Items are looked up by hash, and among those by a match callback
+   ranking how well an item serves the key of the caller:
+   - a negative rank if it doesn't serve it,
+   - 0 if it is the item of the key, which stops the search,
+   - a positive rank otherwise, the lowest one is picked.
+   A NULL callback takes every item of the hash as the item of the key.
+*/
+
+typedef struct dt_lru_item_t
+{
+  dt_hash_t hash;
+  size_t bytes;
+  int users;
+  gboolean cached;
+  uint64_t used;
+} dt_lru_item_t;
+
+typedef float (*dt_lru_match_t)(const dt_lru_item_t *item, const void *key);
+typedef void (*dt_lru_free_t)(dt_lru_item_t *item);
+
+typedef struct dt_lru_cache_t
+{
+  dt_pthread_mutex_t lock;
+  dt_lru_item_t **item;
+  int size;
+  size_t max_bytes; // 0 for no budget
+  size_t bytes;
+  uint64_t clock;
+  dt_lru_free_t free_item;
+} dt_lru_cache_t;
+
+void dt_lru_cache_init(dt_lru_cache_t *cache,
+                       const int size,
+                       const size_t max_bytes,
+                       dt_lru_free_t free_item);
+void dt_lru_cache_cleanup(dt_lru_cache_t *cache);
+
+// the best item of hash for key, acquired, NULL if none serves it
+dt_lru_item_t *dt_lru_cache_get(dt_lru_cache_t *cache,
+                                const dt_hash_t hash,
+                                dt_lru_match_t match,
+                                const void *key);
+
+// caches the item of hash for key and returns it acquired. If another
+// thread put the item of the key first, item is freed and the cached one
+// is returned instead. item->bytes is set by the caller.
+dt_lru_item_t *dt_lru_cache_put(dt_lru_cache_t *cache,
+                                const dt_hash_t hash,
+                                dt_lru_match_t match,
+                                const void *key,
+                                dt_lru_item_t *item);
+
+void dt_lru_cache_release(dt_lru_cache_t *cache,
+                          dt_lru_item_t *item);
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
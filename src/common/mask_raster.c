@@ -0,0 +1,255 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/mask_raster.h"
+#include "develop/pixelpipe.h"
+
+static void _raster_free(dt_lru_item_t *item)
+{
+  dt_mask_raster_t *raster = (dt_mask_raster_t *)item;
+  dt_free_align(raster->data);
+  free(raster);
+}
+
+void dt_mask_raster_cache_init(dt_mask_raster_cache_t *cache)
+{
+  dt_lru_cache_init(&cache->lru, DT_MASK_RASTER_CACHE_SIZE, DT_MASK_RASTER_CACHE_BYTES,
+                    _raster_free);
+}
+
+void dt_mask_raster_cache_cleanup(dt_mask_raster_cache_t *cache)
+{
+  dt_lru_cache_cleanup(&cache->lru);
+}
+
+static inline gboolean _same_roi(const dt_mask_raster_t *raster,
+                                 const dt_iop_roi_t *roi)
+{
+  return raster->roi_x == roi->x && raster->roi_y == roi->y
+         && raster->roi_width == roi->width && raster->roi_height == roi->height
+         && raster->scale == roi->scale;
+}
+
+// the raster is at a scale not lower than the roi and holds all of it
+static gboolean _covers(const dt_mask_raster_t *raster,
+                        const dt_iop_roi_t *roi)
+{
+  if(raster->scale < roi->scale) return FALSE;
+  const float ratio = raster->scale / roi->scale;
+  const float x0 = roi->x * ratio - raster->roi_x;
+  const float y0 = roi->y * ratio - raster->roi_y;
+  const float x1 = (roi->x + roi->width - 1) * ratio - raster->roi_x;
+  const float y1 = (roi->y + roi->height - 1) * ratio - raster->roi_y;
+  return x0 >= 0.0f && y0 >= 0.0f
+         && x1 <= raster->roi_width - 1 + 1e-3f
+         && y1 <= raster->roi_height - 1 + 1e-3f;
+}
+
+static inline float _value(const dt_mask_raster_t *raster,
+                           const int x,
+                           const int y)
+{
+  const int i = x - raster->x;
+  const int j = y - raster->y;
+  return (i >= 0 && j >= 0 && i < raster->width && j < raster->height)
+    ? raster->data[(size_t)j * raster->width + i]
+    : 0.0f;
+}
+
+// mean of the raster pixels under each pixel of the roi, centered in
+// [-ratio/2, ratio/2) of it, when it covers more than 2x2 of them and a
+// single sample would alias
+static void _fill_average(const dt_mask_raster_t *raster,
+                          const dt_iop_roi_t *roi,
+                          float *buffer)
+{
+  const float ratio = raster->scale / roi->scale;
+  const float half = 0.5f * ratio;
+  const int last_x = raster->roi_width - 1;
+  const int last_y = raster->roi_height - 1;
+
+  DT_OMP_FOR()
+  for(int j = 0; j < roi->height; j++)
+  {
+    float *const out = buffer + (size_t)j * roi->width;
+    const float v = (roi->y + j) * ratio - raster->roi_y;
+    const int y0 = CLAMP((int)ceilf(v - half), 0, last_y);
+    const int y1 = CLAMP((int)ceilf(v + half) - 1, 0, last_y);
+    // only the rows of the bounding box add to the sums
+    const int by0 = MAX(y0, raster->y);
+    const int by1 = MIN(y1, raster->y + raster->height - 1);
+    if(by0 > by1)
+    {
+      memset(out, 0, sizeof(float) * roi->width);
+      continue;
+    }
+    for(int i = 0; i < roi->width; i++)
+    {
+      const float u = (roi->x + i) * ratio - raster->roi_x;
+      const int x0 = CLAMP((int)ceilf(u - half), 0, last_x);
+      const int x1 = CLAMP((int)ceilf(u + half) - 1, 0, last_x);
+      const int bx0 = MAX(x0, raster->x);
+      const int bx1 = MIN(x1, raster->x + raster->width - 1);
+      float sum = 0.0f;
+      for(int y = by0; y <= by1; y++)
+      {
+        const float *const row = raster->data + (size_t)(y - raster->y) * raster->width;
+        for(int x = bx0; x <= bx1; x++)
+          sum += row[x - raster->x];
+      }
+      out[i] = sum / ((x1 - x0 + 1) * (y1 - y0 + 1));
+    }
+  }
+}
+
+// bilinear interpolation of the raster at the pixels of the roi, a plain
+// copy at the same scale
+static void _fill(const dt_mask_raster_t *raster,
+                  const dt_iop_roi_t *roi,
+                  float *buffer)
+{
+  const float ratio = raster->scale / roi->scale;
+  if(ratio > 2.0f)
+  {
+    _fill_average(raster, roi, buffer);
+    return;
+  }
+  const int last_x = raster->roi_width - 1;
+  const int last_y = raster->roi_height - 1;
+
+  DT_OMP_FOR()
+  for(int j = 0; j < roi->height; j++)
+  {
+    float *const out = buffer + (size_t)j * roi->width;
+    const float v = MAX((roi->y + j) * ratio - raster->roi_y, 0.0f);
+    const int y0 = MIN((int)v, last_y);
+    const int y1 = MIN(y0 + 1, last_y);
+    const float fy = v - y0;
+    // rows out of the bounding box
+    if(y1 < raster->y || y0 >= raster->y + raster->height)
+    {
+      memset(out, 0, sizeof(float) * roi->width);
+      continue;
+    }
+    for(int i = 0; i < roi->width; i++)
+    {
+      const float u = MAX((roi->x + i) * ratio - raster->roi_x, 0.0f);
+      const int x0 = MIN((int)u, last_x);
+      const int x1 = MIN(x0 + 1, last_x);
+      const float fx = u - x0;
+      const float top = _value(raster, x0, y0) + fx * (_value(raster, x1, y0) - _value(raster, x0, y0));
+      const float bottom = _value(raster, x0, y1) + fx * (_value(raster, x1, y1) - _value(raster, x0, y1));
+      out[i] = top + fy * (bottom - top);
+    }
+  }
+}
+
+// the same roi, else the covering raster of the closest scale
+static float _match(const dt_lru_item_t *item,
+                    const void *key)
+{
+  const dt_mask_raster_t *raster = (const dt_mask_raster_t *)item;
+  const dt_iop_roi_t *roi = key;
+  if(_same_roi(raster, roi)) return 0.0f;
+  return _covers(raster, roi) ? raster->scale : -1.0f;
+}
+
+gboolean dt_mask_raster_cache_get(dt_mask_raster_cache_t *cache,
+                                  const dt_hash_t hash,
+                                  const dt_iop_roi_t *roi,
+                                  float *buffer)
+{
+  if(hash == DT_INVALID_HASH || roi->width < 1 || roi->height < 1) return FALSE;
+
+  dt_lru_item_t *item = dt_lru_cache_get(&cache->lru, hash, _match, roi);
+  if(!item) return FALSE;
+  _fill((dt_mask_raster_t *)item, roi, buffer);
+  dt_lru_cache_release(&cache->lru, item);
+  return TRUE;
+}
+
+void dt_mask_raster_cache_put(dt_mask_raster_cache_t *cache,
+                              const dt_hash_t hash,
+                              const dt_iop_roi_t *roi,
+                              const float *buffer)
+{
+  if(hash == DT_INVALID_HASH || roi->width < 1 || roi->height < 1) return;
+
+  const int width = roi->width;
+  const int height = roi->height;
+  int xmin = width, xmax = -1, ymin = height, ymax = -1;
+  DT_OMP_FOR(reduction(min : xmin, ymin) reduction(max : xmax, ymax))
+  for(int j = 0; j < height; j++)
+  {
+    const float *const row = buffer + (size_t)j * width;
+    int first = 0;
+    while(first < width && row[first] == 0.0f) first++;
+    if(first == width) continue;
+    int last = width - 1;
+    while(row[last] == 0.0f) last--;
+    xmin = MIN(xmin, first);
+    xmax = MAX(xmax, last);
+    ymin = MIN(ymin, j);
+    ymax = MAX(ymax, j);
+  }
+
+  dt_mask_raster_t *raster = calloc(1, sizeof(dt_mask_raster_t));
+  if(!raster) return;
+  raster->roi_x = roi->x;
+  raster->roi_y = roi->y;
+  raster->roi_width = width;
+  raster->roi_height = height;
+  raster->scale = roi->scale;
+  if(xmax >= 0)
+  {
+    raster->x = xmin;
+    raster->y = ymin;
+    raster->width = xmax - xmin + 1;
+    raster->height = ymax - ymin + 1;
+  }
+  const size_t bytes = sizeof(float) * raster->width * raster->height;
+  // a few large rasters would flush all the others
+  if(bytes > DT_MASK_RASTER_CACHE_BYTES / 4)
+  {
+    free(raster);
+    return;
+  }
+  if(bytes)
+  {
+    raster->data = dt_alloc_align_float((size_t)raster->width * raster->height);
+    if(!raster->data)
+    {
+      free(raster);
+      return;
+    }
+    for(int j = 0; j < raster->height; j++)
+      memcpy(raster->data + (size_t)j * raster->width,
+             buffer + (size_t)(raster->y + j) * width + raster->x,
+             sizeof(float) * raster->width);
+  }
+
+  raster->item.bytes = bytes;
+  dt_lru_cache_release(&cache->lru,
+                       dt_lru_cache_put(&cache->lru, hash, _match, roi, &raster->item));
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,84 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/darktable.h"
+#include "common/lru_cache.h"
+
+G_BEGIN_DECLS
+
+struct dt_iop_roi_t;
+
+/* Cache of the rasterised mask shapes.
+
+   The raster of a shape over a roi is identified by a hash of whatever it
+   depends on but the roi: the shape itself, the distorting modules in front
+   of the module using it and the input of the pipe. The pipes of a
+   dt_develop_t share the cache, so that the full, preview and export pipes
+   rendering the same shape through the same modules rasterise it once.
+
+   Only the bounding box of the non-zero values of a raster is kept. A roi
+   at a lower scale, covered by a cached raster of the same shape, is
+   interpolated from it rather than rasterised again, or averaged from it
+   below half its scale.
+*/
+
+#define DT_MASK_RASTER_CACHE_SIZE 64
+#define DT_MASK_RASTER_CACHE_BYTES ((size_t)256 << 20)
+
+typedef struct dt_mask_raster_t
+{
+  dt_lru_item_t item; // identified by the hash of the shape
+  // the roi rasterised
+  int roi_x, roi_y, roi_width, roi_height;
+  float scale;
+  // bounding box of the non-zero values, relative to the roi
+  int x, y, width, height;
+  float *data;
+} dt_mask_raster_t;
+
+typedef struct dt_mask_raster_cache_t
+{
+  dt_lru_cache_t lru;
+} dt_mask_raster_cache_t;
+
+void dt_mask_raster_cache_init(dt_mask_raster_cache_t *cache);
+void dt_mask_raster_cache_cleanup(dt_mask_raster_cache_t *cache);
+
+// fills the buffer of roi->width x roi->height with the raster identified
+// by hash, copied or interpolated from a higher scale. FALSE if no cached
+// raster covers the roi.
+gboolean dt_mask_raster_cache_get(dt_mask_raster_cache_t *cache,
+                                  const dt_hash_t hash,
+                                  const struct dt_iop_roi_t *roi,
+                                  float *buffer);
+
+// keeps the raster of roi->width x roi->height in the cache
+void dt_mask_raster_cache_put(dt_mask_raster_cache_t *cache,
+                              const dt_hash_t hash,
+                              const struct dt_iop_roi_t *roi,
+                              const float *buffer);
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
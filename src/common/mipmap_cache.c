@@ -601,7 +601,8 @@ static void _mipmap_cache_unlink_ondisk_thumbnail(void *data,
   // also remove jpg backing (always try to do that, in case user just
   // temporarily switched it off, to avoid inconsistencies.
   // if(dt_conf_get_bool("cache_disk_backend"))
-  if(cache->cachedir[0])
+  // the on-disk thumbnails of a read-only library are owned by its writer.
+  if(cache->cachedir[0] && !dt_database_is_read_only(darktable.db))
   {
     char filename[PATH_MAX] = { 0 };
     snprintf(filename, sizeof(filename),
@@ -626,6 +627,7 @@ static void _mipmap_cache_deallocate_dynamic(void *data,
         _mipmap_cache_unlink_ondisk_thumbnail(data, _get_imgid(entry->key), mip);
       }
       else if(cache->cachedir[0]
+              && !dt_database_is_read_only(darktable.db)
               && ((dt_conf_get_bool("cache_disk_backend")
                    && mip < DT_MIPMAP_LDR_MAX)
                   || (dt_conf_get_bool("cache_disk_backend_full")
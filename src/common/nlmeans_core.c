@@ -16,6 +16,7 @@
     along with darktable.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include "common/cpu_dispatch.h"
 #include "common/math.h"
 #include "common/opencl.h"
 #include "control/control.h"
@@ -44,11 +45,12 @@
 #define SLICE_WIDTH 72
 #define SLICE_HEIGHT 60
 
-// try to speed up processing by caching pixel differences?  If cached, they won't need to be computed a
-// second time when sliding the patch window away from the pixel.  Testing shows it to be slower than
-// recomputing for both scalar and SSE on a Threadripper due to increased memory writes; this may differ on
-// architectures with slower multiplication.
-//#define CACHE_PIXDIFFS
+// number of search offsets processed together in one pass over a slice.  The pixel being denoised and its
+//   output accumulator are loaded once for the whole group, and the column sums of the group are
+//   interleaved so that its sliding distortions and weights are computed as one vector.  Consecutive
+//   offsets only differ by a column, so the group reads nearly the same input lines as a single offset
+//   does and the working set stays within L1.
+#define PATCH_GROUP 4
 
 // number of intermediate buffers used by OpenCL code path.  If you change this, you must also change
 //   the definition in src/iop/nlmeans.c and src/iop/denoiseprofile.c
@@ -173,106 +175,31 @@ static inline float diff_of_pixels_diff(
   return sum[0] + sum[1] + sum[2];
 }
 
-#if defined(CACHE_PIXDIFFS)
-static inline float get_pixdiff(
-        const float *const col_sums,
-        const int radius,
-        const int row,
-        const int col)
+// the bounds of a search offset within the slice being processed, and its sliding sums
+struct patch_state_t
 {
-  const int stride = 2*(radius+1);
-  const int modrow = 1 + (row + stride) % stride;
-  const float *const pixrow = col_sums + (SLICE_WIDTH + 2*radius)*modrow;
-  return pixrow[col];
-}
+  const patch_t *patch;
+  float *col_sums;	// per-column sums of the pixel differences over the patch height
+  float distortion;	// sum of col_sums over the patch width, slides along the row
+  int row_min;		// rows [row_min,row_max) have the patch center within the RoI
+  int row_max;
+  int row_top;		// rows [row_top,row_bot) have the whole patch within the RoI
+  int row_bot;
+  int col_min;		// columns [col_min,col_max) have the patch center within the RoI
+  int col_max;
+  int pcol_min;		// columns [pcol_min,pcol_max) contribute to the column sums
+  int pcol_max;
+};
+typedef struct patch_state_t patch_state_t;
 
-static inline void set_pixdiff(
-        float *const col_sums,
-        const int radius,
-        const int row,
-        const int col,
-        const float diff)
+// both the row leaving the patch and the row entering it lie within the RoI
+static inline gboolean patch_fully_inside(
+        const patch_state_t *const state,
+        const int row)
 {
-  const int stride = 2*(radius+1);
-  const int modrow = 1 + (row + stride) % stride;
-  float *const pixrow = col_sums + (SLICE_WIDTH + 2*radius)*modrow;
-  pixrow[col] = diff;
+  return row >= MIN(state->row_top, state->row_bot) && row < state->row_bot;
 }
 
-static inline float pixdiff_column_sum(
-        const float *const col_sums,
-        const int radius,
-        const int col)
-{
-  const int stride = SLICE_WIDTH + 2*radius;
-  float sum = col_sums[stride+col];
-  for(int i = 2; i <= (2*radius+1) ; i++)
-    sum  += col_sums[i*stride+col];
-  return sum;
-}
-#endif
-
-static void init_column_sums(
-        float *const col_sums,
-        const patch_t *const patch,
-        const float *const in,
-        const int row,
-        const int chunk_left,
-        const int chunk_right,
-        const int height,
-        const int width,
-        const int stride,
-        const int radius,
-        const float *const norm)
-{
-  // Compute column sums from scratch.  Needed for the very first row, and at intervals thereafter
-  //   to limit accumulation of rounding errors
-
-  // figure out which columns can possibly contribute to patches whose centers lie within the RoI
-  // we can go up to 'radius' columns beyond the current chunk provided that the patch does not
-  // lie in the same direction from the pixel being denoised and that we're still in the RoI
-  const int scol = patch->cols;
-  const int col_min = chunk_left - MIN(radius,MIN(chunk_left,chunk_left+scol));
-  const int col_max = chunk_right + MIN(radius,MIN(width-chunk_right,width-(chunk_right+scol)));
-  // adjust bounds if the patch extends past top/bottom of RoI
-  const int srow = patch->rows;
-  const int rmin = row - MIN(radius,MIN(row,row+srow));
-  const int rmax = row + MIN(radius,MIN(height-1-row,height-1-(row+srow)));
-  for(int col = chunk_left-radius-1; col < MIN(col_min,chunk_right+radius); col++)
-  {
-    col_sums[col] = 0.0f;
-#ifdef CACHE_PIXDIFFS
-    for(int i = row-radius; i <= row+radius; i++)
-      set_pixdiff(col_sums,radius,i,col,0.0f);
-#endif
-  }
-  for(int col = col_min; col < col_max; col++)
-  {
-    float sum = 0.0f;
-    for(int r = rmin; r <= rmax; r++)
-    {
-      const float *pixel = in + r*stride + 4*col;
-      const float diff = pixel_difference(pixel,pixel+patch->offset,norm);
-#ifdef CACHE_PIXDIFFS
-      set_pixdiff(col_sums,radius,r,col,diff);
-#endif
-      sum += diff;
-    }
-    col_sums[col] = sum;
-  }
-  // clear out any columns where the patch column would be outside the RoI, as well as our overrun area
-  for(int col = MAX(col_min,col_max); col < chunk_right + radius; col++)
-  {
-    col_sums[col] = 0.0f;
-#ifdef CACHE_PIXDIFFS
-    for(int i = row-radius; i <= row+radius; i++)
-      set_pixdiff(col_sums,radius,i,col,0.0f);
-#endif
-  }
-  return;
-}
-
-
 // determine the height of the horizontal slice each thread will process
 static int compute_slice_height(const int height)
 {
@@ -321,7 +248,9 @@ static int compute_slice_width(const int width)
   return sl_width;
 }
 
-__DT_CLONE_TARGETS__
+#define DT_CPU_KERNELS "common/kernels/nlmeans.c"
+#include "common/cpu_variants.h"
+
 void nlmeans_denoise(
         const float *const inbuf,
         float *const outbuf,
@@ -329,217 +258,7 @@ void nlmeans_denoise(
         const dt_iop_roi_t *const roi_out,
         const dt_nlmeans_param_t *const params)
 {
-  // define the factors for applying blending between the original image and the denoised version
-  // if running in RGB space, 'luma' should equal 'chroma'
-  const dt_aligned_pixel_t weight = { params->luma, params->chroma, params->chroma, 1.0f };
-  const dt_aligned_pixel_t invert = { 1.0f - params->luma, 1.0f - params->chroma, 1.0f - params->chroma, 0.0f };
-  const gboolean skip_blend = (params->luma == 1.0 && params->chroma == 1.0);
-
-  // define the normalization to convert central pixel differences into central pixel weights
-  const float cp_norm = compute_center_pixel_norm(params->center_weight,params->patch_radius);
-  const dt_aligned_pixel_t center_norm = { cp_norm, cp_norm, cp_norm, 1.0f };
-
-  // define the patches to be compared when denoising a pixel
-  const size_t stride = 4 * roi_in->width;
-  int num_patches;
-  int max_shift;
-  struct patch_t* patches = define_patches(params,stride,&num_patches,&max_shift);
-  // allocate scratch space, including an overrun area on each end so we don't need a boundary check on every access
-  const int radius = params->patch_radius;
-#if defined(CACHE_PIXDIFFS)
-  const size_t scratch_size = (2*radius+3)*(SLICE_WIDTH + 2*radius + 1);
-#else
-  const size_t scratch_size = SLICE_WIDTH + 2*radius + 1 + 48; // getting false sharing without the +48....
-#endif /* CACHE_PIXDIFFS */
-  size_t padded_scratch_size;
-  float *const restrict scratch_buf = dt_alloc_perthread_float(scratch_size, &padded_scratch_size);
-  const int chk_height = compute_slice_height(roi_out->height);
-  const int chk_width = compute_slice_width(roi_out->width);
-  DT_OMP_FOR(collapse(2))
-  for(int chunk_top = 0 ; chunk_top < roi_out->height; chunk_top += chk_height)
-  {
-    for(int chunk_left = 0; chunk_left < roi_out->width; chunk_left += chk_width)
-    {
-      // locate our scratch space within the big buffer allocated above
-      // we'll offset by chunk_left so that we don't have to subtract on every access
-      float *const restrict tmpbuf = dt_get_perthread(scratch_buf, padded_scratch_size);
-      float *const col_sums =  tmpbuf + (radius+1) - chunk_left;
-      // determine which horizontal slice of the image to process
-      const int chunk_bot = MIN(chunk_top + chk_height, roi_out->height);
-      // determine which vertical slice of the image to process
-      const int chunk_right = MIN(chunk_left + chk_width, roi_out->width);
-      // we want to incrementally sum results (especially weights in col[3]), so clear the output buffer to zeros
-      for(int i = chunk_top; i < chunk_bot; i++)
-      {
-        memset(outbuf + 4*(i*roi_out->width+chunk_left), '\0', sizeof(float) * 4 * (chunk_right-chunk_left));
-      }
-      // cycle through all of the patches over our slice of the image
-      for(int p = 0; p < num_patches; p++)
-      {
-        // retrieve info about the current patch
-        const patch_t *patch = &patches[p];
-        // skip any rows where the patch center would be above top of RoI or below bottom of RoI
-        const int height = roi_out->height;
-        const int row_min = MAX(chunk_top,MAX(0,-patch->rows));
-        const int row_max = MIN(chunk_bot,height - MAX(0,patch->rows));
-        // figure out which rows at top and bottom result in patches extending outside the RoI, even though the
-        // center pixel is inside
-        const int row_top = MAX(row_min,MAX(radius,radius-patch->rows));
-        const int row_bot = MIN(row_max,height-1-MAX(radius,radius+patch->rows));
-        // skip any columns where the patch center would be to the left or the right of the RoI
-        const int width = roi_out->width;
-        const int scol = patch->cols;
-        const int col_min = MAX(chunk_left,-scol);
-        const int col_max = MIN(chunk_right,roi_out->width - scol);
-
-        init_column_sums(col_sums,patch,inbuf,row_min,chunk_left,chunk_right,height,width,
-                         stride,radius,params->norm);
-        for(int row = row_min; row < row_max; row++)
-        {
-          // add up the initial columns of the sliding window of total patch distortion
-          float distortion = 0.0f;
-          for(int i = col_min - radius; i < MIN(col_min+radius, col_max); i++)
-          {
-            distortion += col_sums[i];
-          }
-          // now proceed down the current row of the image
-          const float *in = inbuf + stride * row;
-          float *const out = outbuf + (size_t)4 * width * row;
-          const int offset = patch->offset;
-          const float sharpness = params->sharpness;
-          if(params->center_weight < 0.0f)
-          {
-            // computation as used by denoise(non-local) iop
-            for(int col = col_min; col < col_max; col++)
-            {
-              distortion += (col_sums[col+radius] - col_sums[col-radius-1]);
-              const float wt = gh(distortion * sharpness);
-              const float *const inpx = in+4*col;
-              const dt_aligned_pixel_t pixel = { inpx[offset], inpx[offset+1], inpx[offset+2], 1.0f };
-              for_four_channels(c,aligned(pixel,out:16))
-              {
-                out[4*col+c] += pixel[c] * wt;
-              }
-              _mm_prefetch(in+4*col+offset+stride,_MM_HINT_T0);	// try to ensure next row is ready in time
-            }
-          }
-          else
-          {
-            // computation as used by denoiseprofiled iop with non-local means
-            for(int col = col_min; col < col_max; col++)
-            {
-              distortion += (col_sums[col+radius] - col_sums[col-radius-1]);
-              const float dissimilarity = (distortion + pixel_difference(in+4*col,in+4*col+offset,center_norm))
-                                           / (1.0f + params->center_weight);
-              const float wt = gh(fmaxf(0.0f, dissimilarity * sharpness - 2.0f));
-              const float *const inpx = in + 4*col;
-              const dt_aligned_pixel_t pixel = { inpx[offset], inpx[offset+1], inpx[offset+2], 1.0f };
-              for_four_channels(c,aligned(pixel,out:16))
-              {
-                out[4*col+c] += pixel[c] * wt;
-              }
-              _mm_prefetch(in+4*col+offset+stride,_MM_HINT_T0);	// try to ensure next row is ready in time
-            }
-          }
-          const int pcol_min = chunk_left - MIN(radius,MIN(chunk_left,chunk_left+scol));
-          const int pcol_max = chunk_right + MIN(radius,MIN(width-chunk_right,width-(chunk_right+scol)));
-          if(row < MIN(row_top, row_bot))
-          {
-            // top edge of patch was above top of RoI, so it had a value of zero; just add in the new row
-            const float *bot_row = inbuf + (row+1+radius)*stride;
-            for(int col = pcol_min; col < pcol_max; col++)
-            {
-              const float *const bot_px = bot_row + 4*col;
-              const float diff = pixel_difference(bot_px,bot_px+offset,params->norm);
-              _mm_prefetch(bot_px+stride, _MM_HINT_T0);
-#ifdef CACHE_PIXDIFFS
-              set_pixdiff(col_sums,radius,row+radius+1,col,diff);
-#endif
-              col_sums[col] += diff;
-              _mm_prefetch(bot_px+offset+stride, _MM_HINT_T0);
-            }
-          }
-          else if(row < row_bot)
-          {
-#ifndef CACHE_PIXDIFFS
-            const float *const top_row = inbuf + (row-radius)*stride   /* +(2*radius+1)*stride*/ ;
-#endif /* !CACHE_PIXDIFFS */
-            const float *const bot_row = inbuf + (row+1+radius)*stride ;
-            // both prior and new positions are entirely within the RoI, so subtract the old row and add the new one
-            for(int col = pcol_min; col < pcol_max; col++)
-            {
-#ifdef CACHE_PIXDIFFS
-              const float *const bot_px = bot_row + 4*col;
-              const float diff = pixel_difference(bot_px,bot_px+offset,params->norm);
-              col_sums[col] += diff - get_pixdiff(col_sums,radius,row-radius,col);
-              _mm_prefetch(bot_px+stride, _MM_HINT_T0);
-              set_pixdiff(col_sums,radius,row+1+radius,col,diff);
-#else
-              const float *const top_px = top_row + 4*col;
-              const float *const bot_px = bot_row + 4*col;
-              const float diff = diff_of_pixels_diff(bot_px,bot_px+offset,top_px,top_px+offset,params->norm);
-              _mm_prefetch(bot_px+stride, _MM_HINT_T0);
-              col_sums[col] += diff;
-#endif /* CACHE_PIXDIFFS */
-              _mm_prefetch(bot_px+offset+stride, _MM_HINT_T0);
-            }
-          }
-          else if(row >= row_top && row + 1 < row_max) // don't bother updating if last iteration
-          {
-            // new row of the patch is below the bottom of RoI, so its value is zero; just subtract the old row
-#ifndef CACHE_PIXDIFFS
-            const float *top_row = inbuf + (row-radius)*stride;
-#endif /* !CACHE_PIXDIFFS */
-            for(int col = pcol_min; col < pcol_max; col++)
-            {
-#ifdef CACHE_PIXDIFFS
-              col_sums[col] -= get_pixdiff(col_sums,radius,row-radius,col);
-#else
-              const float *const top_px = top_row + 4*col;
-              col_sums[col] -= pixel_difference(top_px,top_px+offset,params->norm);
-#endif /* CACHE_PIXDIFFS */
-            }
-          }
-        }
-      }
-      if(skip_blend)
-      {
-        // normalize the pixels
-        for(int row = chunk_top; row < chunk_bot; row++)
-        {
-          float *const out = outbuf + 4 * row * roi_out->width;
-          for(int col = chunk_left; col < chunk_right; col++)
-          {
-            for_each_channel(c,aligned(out:16))
-            {
-              out[4*col+c] /= out[4*col+3];
-            }
-          }
-        }
-      }
-      else
-      {
-        // normalize and apply chroma/luma blending
-        for(int row = chunk_top; row < chunk_bot; row++)
-        {
-          const float *in = inbuf + row * stride;
-          float *out = outbuf + row * 4 * roi_out->width;
-          for(int col = chunk_left; col < chunk_right; col++)
-          {
-            for_each_channel(c,aligned(in,out,weight,invert:16))
-            {
-              out[4*col+c] = (in[4*col+c] * invert[c]) + (out[4*col+c] / out[4*col+3] * weight[c]);
-            }
-          }
-        }
-      }
-    }
-  }
-
-  // clean up: free the work space
-  dt_free_align(patches);
-  dt_free_align(scratch_buf);
-  return;
+  DT_CPU_DISPATCH(nlmeans_denoise)(inbuf, outbuf, roi_in, roi_out, params);
 }
 
 /**************************************************************/
@@ -0,0 +1,217 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/tag_tree.h"
+#include "common/tags.h"
+
+static void _node_free(dt_tag_node_t *node)
+{
+  if(node->children)
+  {
+    for(guint i = 0; i < node->children->len; i++)
+      _node_free(g_ptr_array_index(node->children, i));
+    g_ptr_array_free(node->children, TRUE);
+    g_hash_table_destroy(node->index);
+  }
+  g_free(node->name);
+  g_free(node->path);
+  g_free(node->synonym);
+  g_free(node);
+}
+
+static void _node_clear(dt_tag_node_t *node)
+{
+  if(node->children)
+  {
+    for(guint i = 0; i < node->children->len; i++)
+      _node_free(g_ptr_array_index(node->children, i));
+    g_ptr_array_free(node->children, TRUE);
+    g_hash_table_destroy(node->index);
+  }
+  node->children = NULL;
+  node->index = NULL;
+}
+
+static dt_tag_node_t *_node_get_child(dt_tag_node_t *parent,
+                                      const char *name,
+                                      const gboolean create)
+{
+  dt_tag_node_t *child = parent->index ? g_hash_table_lookup(parent->index, name) : NULL;
+  if(child || !create) return child;
+
+  child = g_malloc0(sizeof(dt_tag_node_t));
+  child->name = g_strdup(name);
+  child->path = parent->path[0]
+    ? g_strconcat(parent->path, "|", name, NULL)
+    : g_strdup(name);
+  child->parent = parent;
+  if(!parent->children)
+  {
+    parent->children = g_ptr_array_new();
+    parent->index = g_hash_table_new(g_str_hash, g_str_equal);
+  }
+  g_ptr_array_add(parent->children, child);
+  // the key is owned by the child
+  g_hash_table_insert(parent->index, child->name, child);
+  return child;
+}
+
+static void _node_set_select(dt_tag_node_t *node, const guint select)
+{
+  const gboolean was_selected = node->select != DT_TS_NO_IMAGE;
+  const gboolean selected = select != DT_TS_NO_IMAGE;
+  node->select = select;
+  if(was_selected == selected) return;
+
+  for(dt_tag_node_t *parent = node->parent; parent; parent = parent->parent)
+  {
+    if(selected)
+      parent->selected_below++;
+    else
+      parent->selected_below--;
+  }
+}
+
+dt_tag_tree_t *dt_tag_tree_new(void)
+{
+  dt_tag_tree_t *tree = g_malloc0(sizeof(dt_tag_tree_t));
+  tree->root.name = g_strdup("");
+  tree->root.path = g_strdup("");
+  tree->ids = g_hash_table_new(g_direct_hash, g_direct_equal);
+  return tree;
+}
+
+void dt_tag_tree_free(dt_tag_tree_t *tree)
+{
+  if(!tree) return;
+  _node_clear(&tree->root);
+  g_free(tree->root.name);
+  g_free(tree->root.path);
+  g_hash_table_destroy(tree->ids);
+  g_free(tree);
+}
+
+dt_tag_node_t *dt_tag_tree_insert(dt_tag_tree_t *tree, const dt_tag_t *tag)
+{
+  if(!tag->tag || !tag->tag[0]) return NULL;
+
+  gchar **tokens = g_strsplit(tag->tag, "|", -1);
+  dt_tag_node_t *node = &tree->root;
+  for(gchar **token = tokens; *token; token++)
+    node = _node_get_child(node, *token, TRUE);
+  g_strfreev(tokens);
+
+  if(node->tagid && node->tagid != tag->id)
+    g_hash_table_remove(tree->ids, GUINT_TO_POINTER(node->tagid));
+  node->tagid = tag->id;
+  node->count = tag->count;
+  node->flags = tag->flags;
+  g_free(node->synonym);
+  node->synonym = g_strdup(tag->synonym);
+  _node_set_select(node, tag->select);
+  if(tag->id)
+    g_hash_table_insert(tree->ids, GUINT_TO_POINTER(tag->id), node);
+  return node;
+}
+
+void dt_tag_tree_insert_list(dt_tag_tree_t *tree, const GList *tags)
+{
+  for(const GList *t = tags; t; t = g_list_next(t))
+    dt_tag_tree_insert(tree, (dt_tag_t *)t->data);
+}
+
+dt_tag_node_t *dt_tag_tree_find(const dt_tag_tree_t *tree, const char *path)
+{
+  dt_tag_node_t *node = (dt_tag_node_t *)&tree->root;
+  if(!path || !path[0]) return node;
+
+  gchar **tokens = g_strsplit(path, "|", -1);
+  for(gchar **token = tokens; node && *token; token++)
+    node = _node_get_child(node, *token, FALSE);
+  g_strfreev(tokens);
+  return node;
+}
+
+dt_tag_node_t *dt_tag_tree_find_id(const dt_tag_tree_t *tree, const guint tagid)
+{
+  return tagid ? g_hash_table_lookup(tree->ids, GUINT_TO_POINTER(tagid)) : NULL;
+}
+
+dt_tag_node_t *dt_tag_tree_remove(dt_tag_tree_t *tree, const guint tagid)
+{
+  dt_tag_node_t *node = dt_tag_tree_find_id(tree, tagid);
+  if(!node) return NULL;
+
+  g_hash_table_remove(tree->ids, GUINT_TO_POINTER(tagid));
+  _node_set_select(node, DT_TS_NO_IMAGE);
+  node->tagid = 0;
+  node->count = 0;
+  node->flags = 0;
+  g_free(node->synonym);
+  node->synonym = NULL;
+
+  // prune the levels which don't lead to any tag anymore
+  while(node != &tree->root && !node->tagid && !dt_tag_tree_node_has_children(node))
+  {
+    dt_tag_node_t *parent = node->parent;
+    g_hash_table_remove(parent->index, node->name);
+    g_ptr_array_remove(parent->children, node);
+    _node_free(node);
+    node = parent;
+  }
+  return node;
+}
+
+void dt_tag_tree_set_count(dt_tag_tree_t *tree, const guint tagid, const guint count)
+{
+  dt_tag_node_t *node = dt_tag_tree_find_id(tree, tagid);
+  if(node) node->count = count;
+}
+
+void dt_tag_tree_set_select(dt_tag_tree_t *tree, const guint tagid, const guint select)
+{
+  dt_tag_node_t *node = dt_tag_tree_find_id(tree, tagid);
+  if(node) _node_set_select(node, select);
+}
+
+static void _node_reset_select(dt_tag_node_t *node)
+{
+  node->select = DT_TS_NO_IMAGE;
+  node->selected_below = 0;
+  if(node->children)
+    for(guint i = 0; i < node->children->len; i++)
+      _node_reset_select(g_ptr_array_index(node->children, i));
+}
+
+void dt_tag_tree_reset_select(dt_tag_tree_t *tree)
+{
+  _node_reset_select(&tree->root);
+}
+
+guint dt_tag_tree_node_select(const dt_tag_node_t *node)
+{
+  if(node->select != DT_TS_NO_IMAGE)
+    return node->select;
+  return node->selected_below ? DT_TS_SOME_IMAGES : DT_TS_NO_IMAGE;
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
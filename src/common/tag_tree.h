@@ -0,0 +1,101 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* in-memory index of the tag hierarchy: a trie over the '|' separated
+ * tag names. A node either is a tag (tagid != 0) or only a level of
+ * the path of deeper tags. Each node caches the number of images the
+ * tag is attached to and its selection state so that the tagging
+ * module can update the tree on attach/detach without reloading the
+ * dictionary, and can fill the rows of the GtkTreeStore on demand. */
+
+typedef struct dt_tag_node_t
+{
+  gchar *name;            // last level of the path
+  gchar *path;            // full tag name
+  guint tagid;            // 0 if the node is only a path
+  guint count;            // images the tag is attached to
+  guint select;           // dt_tag_selection_t of the tag
+  guint selected_below;   // descendants with select != DT_TS_NO_IMAGE
+  gint flags;
+  gchar *synonym;
+  struct dt_tag_node_t *parent;
+  GPtrArray *children;    // dt_tag_node_t, NULL if none
+  GHashTable *index;      // name -> child node, NULL if none
+} dt_tag_node_t;
+
+typedef struct dt_tag_tree_t
+{
+  dt_tag_node_t root;
+  GHashTable *ids;        // tagid -> node
+} dt_tag_tree_t;
+
+dt_tag_tree_t *dt_tag_tree_new(void);
+void dt_tag_tree_free(dt_tag_tree_t *tree);
+
+/** insert a tag (dt_tag_t) creating the missing levels of its path.
+ * If the path already exists the node becomes a tag. */
+dt_tag_node_t *dt_tag_tree_insert(dt_tag_tree_t *tree, const struct dt_tag_t *tag);
+
+/** fill the tree from a list of dt_tag_t as returned by dt_tag_get_with_usage() */
+void dt_tag_tree_insert_list(dt_tag_tree_t *tree, const GList *tags);
+
+/** the node for the full path, NULL if the path does not exist. An
+ * empty path returns the root. */
+dt_tag_node_t *dt_tag_tree_find(const dt_tag_tree_t *tree, const char *path);
+
+/** the node of a tag, NULL if unknown */
+dt_tag_node_t *dt_tag_tree_find_id(const dt_tag_tree_t *tree, const guint tagid);
+
+/** remove a tag. The node stays as a path if it has children,
+ * otherwise it is removed as well as the levels which became empty.
+ * \return the deepest remaining ancestor of the tag, NULL if the tag
+ * is unknown. */
+dt_tag_node_t *dt_tag_tree_remove(dt_tag_tree_t *tree, const guint tagid);
+
+/** update the cached image count of a tag */
+void dt_tag_tree_set_count(dt_tag_tree_t *tree, const guint tagid, const guint count);
+
+/** update the selection state of a tag, maintaining the state of the
+ * ancestors */
+void dt_tag_tree_set_select(dt_tag_tree_t *tree, const guint tagid, const guint select);
+
+/** reset the selection state of all tags */
+void dt_tag_tree_reset_select(dt_tag_tree_t *tree);
+
+/** selection state shown for the node: its own state or some images
+ * when only tags below are attached to the selected images */
+guint dt_tag_tree_node_select(const dt_tag_node_t *node);
+
+static inline gboolean dt_tag_tree_node_has_children(const dt_tag_node_t *node)
+{
+  return node->children && node->children->len;
+}
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,188 @@
+/*
+   This file is part of darktable,
+   Copyright (C) 2026 darktable developers.
+
+   darktable is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   darktable is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/darktable.h"
+#include "common/half.h"
+
+/* Common pieces of the à-trous decompositions (diffuse, atrous, equalizer).
+
+   The filters differ, but the modules drive them the same way: each scale
+   blurs the low frequencies of the previous one, ping-ponging between two
+   full size buffers, see dt_wavelet_decompose(). The details of a scale
+   are either consumed at once (atrous) or kept until the synthesis, which
+   runs from the coarsest scale back to the finest one (diffuse,
+   equalizer). The kept scales are held by dt_wavelet_bands_t and can take
+   a lot of memory for large images with many scales:
+
+   - diffuse stores 4 channels full size details, which can be stored as
+     half floats, 8 bytes per pixel instead of 16, keeping about 3
+     significant digits. The storage is chosen by the caller and never
+     from the free memory, so that the output of a pipe does not depend on
+     the load of the machine: when the scales don't fit, the tiling takes
+     over;
+   - equalizer stores one channel of edge weights per scale, decimated by
+     2 at each scale.
+
+   tiling_callback() should report dt_wavelet_lf_memory() and
+   dt_wavelet_bands_memory() for the same layout as process(). */
+
+#define DT_WAVELET_MAX_SCALES 16
+
+typedef enum dt_wavelet_storage_t
+{
+  DT_WAVELET_STORAGE_FLOAT = 0,
+  DT_WAVELET_STORAGE_HALF = 1,
+} dt_wavelet_storage_t;
+
+typedef struct dt_wavelet_bands_t
+{
+  size_t width;
+  size_t height;
+  int channels;
+  int scales;
+  gboolean decimated;
+  dt_wavelet_storage_t storage;
+  void *band[DT_WAVELET_MAX_SCALES];
+} dt_wavelet_bands_t;
+
+// size of scale s, decimated scales keep one more row and column
+static inline size_t dt_wavelet_band_width(const size_t width,
+                                           const int s,
+                                           const gboolean decimated)
+{
+  return decimated ? 1 + (width >> s) : width;
+}
+
+// bytes taken by the two low frequency buffers of dt_wavelet_decompose()
+static inline size_t dt_wavelet_lf_memory(const size_t width,
+                                          const size_t height,
+                                          const int channels)
+{
+  return 2 * channels * width * height * sizeof(float);
+}
+
+// bytes taken by the detail scales
+static inline size_t dt_wavelet_bands_memory(const size_t width,
+                                             const size_t height,
+                                             const int channels,
+                                             const int scales,
+                                             const gboolean decimated,
+                                             const dt_wavelet_storage_t storage)
+{
+  const size_t bytes = storage == DT_WAVELET_STORAGE_HALF ? sizeof(uint16_t) : sizeof(float);
+  size_t memory = 0;
+  for(int s = 0; s < scales; s++)
+    memory += channels * dt_wavelet_band_width(width, s, decimated)
+              * dt_wavelet_band_width(height, s, decimated) * bytes;
+  return memory;
+}
+
+static inline void dt_wavelet_bands_free(dt_wavelet_bands_t *bands)
+{
+  for(int s = 0; s < DT_WAVELET_MAX_SCALES; s++)
+  {
+    dt_free_align(bands->band[s]);
+    bands->band[s] = NULL;
+  }
+}
+
+// all or nothing, returns FALSE with no scale allocated if out of memory
+static inline gboolean dt_wavelet_bands_alloc(dt_wavelet_bands_t *bands,
+                                              const size_t width,
+                                              const size_t height,
+                                              const int channels,
+                                              const int scales,
+                                              const gboolean decimated,
+                                              const dt_wavelet_storage_t storage)
+{
+  memset(bands, 0, sizeof(dt_wavelet_bands_t));
+  bands->width = width;
+  bands->height = height;
+  bands->channels = channels;
+  bands->scales = MIN(scales, DT_WAVELET_MAX_SCALES);
+  bands->decimated = decimated;
+  bands->storage = storage;
+  for(int s = 0; s < bands->scales; s++)
+  {
+    const size_t bytes = dt_wavelet_bands_memory(dt_wavelet_band_width(width, s, decimated),
+                                                 dt_wavelet_band_width(height, s, decimated),
+                                                 channels, 1, FALSE, storage);
+    bands->band[s] = dt_alloc_aligned(bytes);
+    if(!bands->band[s])
+    {
+      dt_wavelet_bands_free(bands);
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+// fetch the pixel at index (4 floats per pixel) of a detail scale
+static inline void dt_wavelet_band_load(const void *const band,
+                                        const dt_wavelet_storage_t storage,
+                                        const size_t index,
+                                        dt_aligned_pixel_t pixel)
+{
+  if(storage == DT_WAVELET_STORAGE_HALF)
+  {
+    const uint16_t *const b = band;
+    for_four_channels(c)
+      pixel[c] = dt_half_to_float(b[index + c]);
+  }
+  else
+  {
+    const float *const b = band;
+    for_four_channels(c)
+      pixel[c] = b[index + c];
+  }
+}
+
+// blur in with the filter of scale s into LF, handling its details
+typedef void((*dt_wavelet_decompose_t)(const float *const in,
+                                       float *const LF,
+                                       const int s,
+                                       void *const data));
+
+/* run the decomposition from the finest scale to the coarsest one, the
+   low frequencies ping-ponging between LF_odd and LF_even, and return the
+   one holding the coarse residual. There must be at least one scale */
+static inline float *dt_wavelet_decompose(const float *const in,
+                                          float *const LF_odd,
+                                          float *const LF_even,
+                                          const int scales,
+                                          dt_wavelet_decompose_t decompose,
+                                          void *const data)
+{
+  float *residual = LF_odd;
+  for(int s = 0; s < scales; s++)
+  {
+    const float *const buffer_in = s == 0 ? in : residual;
+    float *const buffer_out = s % 2 == 0 ? LF_odd : LF_even;
+    decompose(buffer_in, buffer_out, s, data);
+    residual = buffer_out;
+  }
+  return residual;
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -18,6 +18,7 @@
 
 #include "blend.h"
 #include "common/gaussian.h"
+#include "common/box_filters.h"
 #include "common/guided_filter.h"
 #include "common/imagebuf.h"
 #include "common/interpolation.h"
@@ -29,6 +30,10 @@
 #include "develop/imageop_math.h"
 #include <math.h>
 
+// pixels of a band of rows per thread, when the parametric mask, its tone
+// curve and the blending go through the image band by band
+#define BLEND_BAND_PIXELS 32768
+
 typedef enum _develop_mask_post_processing
 {
   DEVELOP_MASK_POST_NONE = 0,
@@ -398,7 +403,9 @@ static void _develop_blend_process_feather(const float *const guide,
   if(mask_bak)
   {
     dt_iop_image_copy_by_size(mask_bak, mask, width, height, 1);
-    guided_filter(guide, mask_bak, mask, width, height, ch, w, sqrt_eps, guide_weight, 0.f, 1.f);
+    // out of memory, the mask is left as it is
+    if(!guided_filter(guide, mask_bak, mask, width, height, ch, w, sqrt_eps, guide_weight, 0.f, 1.f))
+      dt_print(DT_DEBUG_PIPE, "[blend] mask not feathered, out of memory");
     dt_free_align(mask_bak);
   }
 }
@@ -455,6 +462,105 @@ static const char *_develop_blend_colorspace_to_str(const dt_develop_blend_color
 }
 
 /* we test in pixelpipe processing if this required */
+// the parametric mask of the rows of roi_out, combined with the drawn mask
+// and the global opacity
+static void _develop_blend_make_mask(const dt_develop_blend_colorspace_t blend_csp,
+                                     dt_dev_pixelpipe_iop_t *piece,
+                                     const float *const restrict a,
+                                     const float *const restrict b,
+                                     const dt_iop_roi_t *const roi_in,
+                                     const dt_iop_roi_t *const roi_out,
+                                     float *const restrict mask)
+{
+  switch(blend_csp)
+  {
+    case DEVELOP_BLEND_CS_LAB:
+      dt_develop_blendif_lab_make_mask(piece, a, b, roi_in, roi_out, mask);
+      break;
+    case DEVELOP_BLEND_CS_RGB_DISPLAY:
+      dt_develop_blendif_rgb_hsl_make_mask(piece, a, b, roi_in, roi_out, mask);
+      break;
+    case DEVELOP_BLEND_CS_RGB_SCENE:
+      dt_develop_blendif_rgb_jzczhz_make_mask(piece, a, b, roi_in, roi_out, mask);
+      break;
+    case DEVELOP_BLEND_CS_RAW:
+      dt_develop_blendif_raw_make_mask(piece, a, b, roi_in, roi_out, mask);
+      break;
+    default:
+      break;
+  }
+}
+
+// blending of the rows of roi_out with per-pixel opacity value as
+// defined in mask
+static void _develop_blend_apply(const dt_develop_blend_colorspace_t blend_csp,
+                                 dt_dev_pixelpipe_iop_t *piece,
+                                 const float *const restrict a,
+                                 float *const restrict b,
+                                 const dt_iop_roi_t *const roi_in,
+                                 const dt_iop_roi_t *const roi_out,
+                                 const float *const restrict mask,
+                                 const dt_dev_pixelpipe_display_mask_t request_mask_display)
+{
+  switch(blend_csp)
+  {
+    case DEVELOP_BLEND_CS_LAB:
+      dt_develop_blendif_lab_blend(piece, a, b, roi_in, roi_out, mask, request_mask_display);
+      break;
+    case DEVELOP_BLEND_CS_RGB_DISPLAY:
+      dt_develop_blendif_rgb_hsl_blend(piece, a, b, roi_in, roi_out, mask, request_mask_display);
+      break;
+    case DEVELOP_BLEND_CS_RGB_SCENE:
+      dt_develop_blendif_rgb_jzczhz_blend(piece, a, b, roi_in, roi_out, mask, request_mask_display);
+      break;
+    case DEVELOP_BLEND_CS_RAW:
+      dt_develop_blendif_raw_blend(piece, a, b, roi_in, roi_out, mask, request_mask_display);
+      break;
+    default:
+      break;
+  }
+}
+
+// the parametric mask, its tone curve and the blending only look at the
+// pixels of their own row. They go through the image by bands of rows,
+// one band after the other, so that the rows of a band stay in the caches
+// of the threads from one step to the next. The same rows of a band go to
+// the same threads at every step
+static void _develop_blend_process_bands(const dt_develop_blend_colorspace_t blend_csp,
+                                         dt_dev_pixelpipe_iop_t *piece,
+                                         const float *const restrict a,
+                                         float *const restrict b,
+                                         const dt_iop_roi_t *const roi_in,
+                                         const dt_iop_roi_t *const roi_out,
+                                         float *const restrict mask,
+                                         const gboolean tone_curve,
+                                         const dt_dev_pixelpipe_display_mask_t request_mask_display)
+{
+  const dt_develop_blend_params_t *const d = piece->blendop_data;
+  const float opacity = CLIP(d->opacity / 100.0f);
+  const size_t ch = piece->colors;
+  const int owidth = roi_out->width;
+  int rows = MAX(1, (int)(dt_get_num_threads() * BLEND_BAND_PIXELS / MAX(owidth, 1)));
+  // the bands of the buffers start on 64 bytes
+  while(((size_t)rows * owidth) % 16) rows++;
+
+  for(int y = 0; y < roi_out->height; y += rows)
+  {
+    dt_iop_roi_t band = *roi_out;
+    band.y += y;
+    band.height = MIN(rows, roi_out->height - y);
+    float *const band_b = b + (size_t)y * owidth * ch;
+    float *const band_mask = mask + (size_t)y * owidth;
+
+    _develop_blend_make_mask(blend_csp, piece, a, band_b, roi_in, &band, band_mask);
+    if(tone_curve)
+      _develop_blend_process_mask_tone_curve(band_mask, (size_t)band.height * owidth,
+                                             d->contrast, d->brightness, opacity);
+    _develop_blend_apply(blend_csp, piece, a, band_b, roi_in, &band, band_mask,
+                         request_mask_display);
+  }
+}
+
 void dt_develop_blend_process(dt_iop_module_t *self,
                               dt_dev_pixelpipe_iop_t *piece,
                               const void *const ivoid,
@@ -528,6 +634,13 @@ void dt_develop_blend_process(dt_iop_module_t *self,
   // get the clipped opacity value  0 - 1
   const float opacity = CLIP(d->opacity / 100.0f);
 
+  // without feathering nor blurring, which need the whole mask, the
+  // parametric mask is made band by band together with the blending
+  gboolean banded = !uniform && !raster;
+  for(size_t index = 0; index < post_operations_size; index++)
+    if(post_operations[index] != DEVELOP_MASK_POST_TONE_CURVE)
+      banded = FALSE;
+
   // allocate space for blend mask used by roi_out
   float *const restrict _mask = dt_alloc_align_float(obuffsize);
   if(!_mask)
@@ -630,35 +743,14 @@ void dt_develop_blend_process(dt_iop_module_t *self,
     _refine_with_detail_mask(self, piece, mask, roi_in, roi_out, d->details);
 
     // get parametric mask (if any) and apply global opacity
-    switch(blend_csp)
-    {
-      case DEVELOP_BLEND_CS_LAB:
-        dt_develop_blendif_lab_make_mask(piece,
-                                         (const float *const restrict)ivoid,
-                                         (const float *const restrict)ovoid,
-                                         roi_in, roi_out, mask);
-        break;
-      case DEVELOP_BLEND_CS_RGB_DISPLAY:
-        dt_develop_blendif_rgb_hsl_make_mask(piece, (const float *const restrict)ivoid,
-                                             (const float *const restrict)ovoid,
-                                             roi_in, roi_out, mask);
-        break;
-      case DEVELOP_BLEND_CS_RGB_SCENE:
-        dt_develop_blendif_rgb_jzczhz_make_mask(piece, (const float *const restrict)ivoid,
-                                                (const float *const restrict)ovoid,
-                                                roi_in, roi_out, mask);
-        break;
-      case DEVELOP_BLEND_CS_RAW:
-        dt_develop_blendif_raw_make_mask(piece, (const float *const restrict)ivoid,
-                                         (const float *const restrict)ovoid,
-                                         roi_in, roi_out, mask);
-        break;
-      default:
-        break;
-    }
+    if(!banded)
+      _develop_blend_make_mask(blend_csp, piece,
+                               (const float *const restrict)ivoid,
+                               (const float *const restrict)ovoid,
+                               roi_in, roi_out, mask);
   }
 
-  if(!uniform)
+  if(!uniform && !banded)
   {
     const float guide_weight = _get_guide_weight(piece);
     const float sqrt_eps = _get_feathering_eps(piece);
@@ -722,32 +814,17 @@ void dt_develop_blend_process(dt_iop_module_t *self,
   }
 
   // now apply blending with per-pixel opacity value as defined in mask
-  // select the blend operator
-  switch(blend_csp)
-  {
-    case DEVELOP_BLEND_CS_LAB:
-      dt_develop_blendif_lab_blend(piece, (const float *const restrict)ivoid,
-                                   (float *const restrict)ovoid,
-                                   roi_in, roi_out, mask, request_mask_display);
-      break;
-    case DEVELOP_BLEND_CS_RGB_DISPLAY:
-      dt_develop_blendif_rgb_hsl_blend(piece, (const float *const restrict)ivoid,
-                                       (float *const restrict)ovoid,
-                                       roi_in, roi_out, mask, request_mask_display);
-      break;
-    case DEVELOP_BLEND_CS_RGB_SCENE:
-      dt_develop_blendif_rgb_jzczhz_blend(piece, (const float *const restrict)ivoid,
-                                          (float *const restrict)ovoid,
-                                          roi_in, roi_out, mask, request_mask_display);
-      break;
-    case DEVELOP_BLEND_CS_RAW:
-      dt_develop_blendif_raw_blend(piece, (const float *const restrict)ivoid,
-                                   (float *const restrict)ovoid,
-                                   roi_in, roi_out, mask, request_mask_display);
-      break;
-    default:
-      break;
-  }
+  if(banded)
+    _develop_blend_process_bands(blend_csp, piece,
+                                 (const float *const restrict)ivoid,
+                                 (float *const restrict)ovoid,
+                                 roi_in, roi_out, mask,
+                                 post_operations_size > 0, request_mask_display);
+  else
+    _develop_blend_apply(blend_csp, piece,
+                         (const float *const restrict)ivoid,
+                         (float *const restrict)ovoid,
+                         roi_in, roi_out, mask, request_mask_display);
 
   // register if _this_ module should expose mask or display channel
   if(request_mask_display
@@ -1493,7 +1570,10 @@ void tiling_callback_blendop(dt_iop_module_t *self,
       */
       tiling->factor_cl = MAX(tiling->factor_cl, 1.0f);
     }
-    tiling->factor = MAX(tiling->factor, 18.0f * 0.25f); // we need all 18 intermediate guided filter mask buffers
+    // the guided filter streams its strips, with running sums and a ring of
+    // coefficient rows per strip
+    const int w = _get_required_w(bldata->feathering_radius, roi_out->scale / piece->iscale);
+    tiling->overhead += dt_box_guided_filter_memory(roi_out->width, roi_out->height, w);
 
     tiling->factor += 1.5f; // in + (guide, tmp) + two quarter buffers for the mask
     tiling->factor_cl += 1.5f;
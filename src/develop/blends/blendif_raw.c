@@ -25,6 +25,7 @@
                      "fast-math", "no-math-errno")
 #endif
 
+#include "common/cpu_dispatch.h"
 #include "common/imagebuf.h"
 #include "common/math.h"
 #include "develop/blend.h"
@@ -68,328 +69,8 @@ void dt_develop_blendif_raw_make_mask(dt_dev_pixelpipe_iop_t *piece,
   }
 }
 
-
-/* normal blend with clamping */
-_BLEND_FUNC _blend_normal_bounded(const float *const restrict a,
-                                  const float *const restrict b,
-                                  float *const restrict out,
-                                  const float *const restrict mask,
-                                  const size_t stride)
-{
-  for(size_t j = 0; j < stride; j++)
-  {
-    const float local_opacity = mask[j];
-    out[j] = clamp_simd(a[j] * (1.0f - local_opacity) + b[j] * local_opacity);
-  }
-}
-
-/* normal blend without any clamping */
-_BLEND_FUNC _blend_normal_unbounded(const float *const restrict a,
-                                    const float *const restrict b,
-                                    float *const restrict out,
-                                    const float *const restrict mask,
-                                    const size_t stride)
-{
-  for(size_t j = 0; j < stride; j++)
-  {
-    const float local_opacity = mask[j];
-    out[j] = a[j] * (1.0f - local_opacity) + b[j] * local_opacity;
-  }
-}
-
-/* lighten */
-_BLEND_FUNC _blend_lighten(const float *const restrict a,
-                           const float *const restrict b,
-                           float *const restrict out,
-                           const float *const restrict mask,
-                           const size_t stride)
-{
-  for(size_t j = 0; j < stride; j++)
-  {
-    const float local_opacity = mask[j];
-    out[j] = clamp_simd(a[j] * (1.0f - local_opacity) + fmaxf(a[j], b[j]) * local_opacity);
-  }
-}
-
-/* darken */
-_BLEND_FUNC _blend_darken(const float *const restrict a,
-                          const float *const restrict b,
-                          float *const restrict out,
-                          const float *const restrict mask,
-                          const size_t stride)
-{
-  for(size_t j = 0; j < stride; j++)
-  {
-    const float local_opacity = mask[j];
-    out[j] = clamp_simd(a[j] * (1.0f - local_opacity) + fminf(a[j], b[j]) * local_opacity);
-  }
-}
-
-/* multiply */
-_BLEND_FUNC _blend_multiply(const float *const restrict a,
-                            const float *const restrict b,
-                            float *const restrict out,
-                            const float *const restrict mask,
-                            const size_t stride)
-{
-  for(size_t j = 0; j < stride; j++)
-  {
-    const float local_opacity = mask[j];
-    out[j] = clamp_simd(a[j] * (1.0f - local_opacity) + (a[j] * b[j]) * local_opacity);
-  }
-}
-
-/* average */
-_BLEND_FUNC _blend_average(const float *const restrict a,
-                           const float *const restrict b,
-                           float *const restrict out,
-                           const float *const restrict mask,
-                           const size_t stride)
-{
-  for(size_t j = 0; j < stride; j++)
-  {
-    const float local_opacity = mask[j];
-    out[j] = clamp_simd(a[j] * (1.0f - local_opacity) + (a[j] + b[j]) / 2.0f * local_opacity);
-  }
-}
-
-/* add */
-_BLEND_FUNC _blend_add(const float *const restrict a,
-                       const float *const restrict b,
-                       float *const restrict out,
-                       const float *const restrict mask,
-                       const size_t stride)
-{
-  for(size_t j = 0; j < stride; j++)
-  {
-    const float local_opacity = mask[j];
-    out[j] = clamp_simd(a[j] * (1.0f - local_opacity) + (a[j] + b[j]) * local_opacity);
-  }
-}
-
-/* subtract */
-_BLEND_FUNC _blend_subtract(const float *const restrict a,
-                            const float *const restrict b,
-                            float *const restrict out,
-                            const float *const restrict mask,
-                            const size_t stride)
-{
-  for(size_t j = 0; j < stride; j++)
-  {
-    const float local_opacity = mask[j];
-    out[j] = clamp_simd(a[j] * (1.0f - local_opacity) + ((b[j] + a[j]) - 1.0f) * local_opacity);
-  }
-}
-
-/* difference */
-_BLEND_FUNC _blend_difference(const float *const restrict a,
-                              const float *const restrict b,
-                              float *const restrict out,
-                              const float *const restrict mask,
-                              const size_t stride)
-{
-  for(size_t j = 0; j < stride; j++)
-  {
-    const float local_opacity = mask[j];
-    out[j] = clamp_simd(a[j] * (1.0f - local_opacity) + fabsf(a[j] - b[j]) * local_opacity);
-  }
-}
-
-/* screen */
-_BLEND_FUNC _blend_screen(const float *const restrict a,
-                          const float *const restrict b,
-                          float *const restrict out,
-                          const float *const restrict mask,
-                          const size_t stride)
-{
-  for(size_t j = 0; j < stride; j++)
-  {
-    const float local_opacity = mask[j];
-    const float la = clamp_simd(a[j]);
-    const float lb = clamp_simd(b[j]);
-    out[j] = clamp_simd(la * (1.0f - local_opacity) + (1.0f - (1.0f - la) * (1.0f - lb)) * local_opacity);
-  }
-}
-
-/* overlay */
-_BLEND_FUNC _blend_overlay(const float *const restrict a,
-                           const float *const restrict b,
-                           float *const restrict out,
-                           const float *const restrict mask,
-                           const size_t stride)
-{
-  for(size_t j = 0; j < stride; j++)
-  {
-    const float local_opacity = mask[j];
-    const float local_opacity2 = local_opacity * local_opacity;
-    const float la = clamp_simd(a[j]);
-    const float lb = clamp_simd(b[j]);
-    out[j] = clamp_simd(
-        la * (1.0f - local_opacity2)
-        + (la > 0.5f ? 1.0f - (1.0f - 2.0f * (la - 0.5f)) * (1.0f - lb) : 2.0f * la * lb) * local_opacity2);
-  }
-}
-
-/* softlight */
-_BLEND_FUNC _blend_softlight(const float *const restrict a,
-                             const float *const restrict b,
-                             float *const restrict out,
-                             const float *const restrict mask,
-                             const size_t stride)
-{
-  for(size_t j = 0; j < stride; j++)
-  {
-    const float local_opacity = mask[j];
-    const float local_opacity2 = local_opacity * local_opacity;
-    const float la = clamp_simd(a[j]);
-    const float lb = clamp_simd(b[j]);
-    out[j] = clamp_simd(
-        la * (1.0f - local_opacity2)
-        + (lb > 0.5f ? 1.0f - (1.0f - la) * (1.0f - (lb - 0.5f)) : la * (lb + 0.5f)) * local_opacity2);
-  }
-}
-
-/* hardlight */
-_BLEND_FUNC _blend_hardlight(const float *const restrict a,
-                             const float *const restrict b,
-                             float *const restrict out,
-                             const float *const restrict mask,
-                             const size_t stride)
-{
-  for(size_t j = 0; j < stride; j++)
-  {
-    const float local_opacity = mask[j];
-    const float local_opacity2 = local_opacity * local_opacity;
-    const float la = clamp_simd(a[j]);
-    const float lb = clamp_simd(b[j]);
-    out[j] = clamp_simd(
-        la * (1.0f - local_opacity2)
-        + (lb > 0.5f ? 1.0f - (1.0f - 2.0f * (la - 0.5f)) * (1.0f - lb) : 2.0f * la * lb) * local_opacity2);
-  }
-}
-
-/* vividlight */
-_BLEND_FUNC _blend_vividlight(const float *const restrict a,
-                              const float *const restrict b,
-                              float *const restrict out,
-                              const float *const restrict mask,
-                              const size_t stride)
-{
-  for(size_t j = 0; j < stride; j++)
-  {
-    const float local_opacity = mask[j];
-    const float local_opacity2 = local_opacity * local_opacity;
-    const float la = clamp_simd(a[j]);
-    const float lb = clamp_simd(b[j]);
-    out[j] = clamp_simd(
-        la * (1.0f - local_opacity2)
-        + (lb > 0.5f ? (lb >= 1.0f ? 1.0f : la / (2.0f * (1.0f - lb)))
-                     : (lb <= 0.0f ? 0.0f : 1.0f - (1.0f - la) / (2.0f * lb)))
-          * local_opacity2);
-  }
-}
-
-/* linearlight */
-_BLEND_FUNC _blend_linearlight(const float *const restrict a,
-                               const float *const restrict b,
-                               float *const restrict out,
-                               const float *const restrict mask,
-                               const size_t stride)
-{
-  for(size_t j = 0; j < stride; j++)
-  {
-    const float local_opacity = mask[j];
-    const float local_opacity2 = local_opacity * local_opacity;
-    const float la = clamp_simd(a[j]);
-    const float lb = clamp_simd(b[j]);
-    out[j] = clamp_simd(la * (1.0f - local_opacity2) + (la + 2.0f * lb - 1.0f) * local_opacity2);
-  }
-}
-
-/* pinlight */
-_BLEND_FUNC _blend_pinlight(const float *const restrict a,
-                            const float *const restrict b,
-                            float *const restrict out,
-                            const float *const restrict mask,
-                            const size_t stride)
-{
-  for(size_t j = 0; j < stride; j++)
-  {
-    const float local_opacity = mask[j];
-    const float local_opacity2 = local_opacity * local_opacity;
-    const float la = clamp_simd(a[j]);
-    const float lb = clamp_simd(b[j]);
-    out[j] = clamp_simd(
-        la * (1.0f - local_opacity2)
-        + (lb > 0.5f ? fmaxf(la, 2.0f * (lb - 0.5f)) : fminf(la, 2.0f * lb)) * local_opacity2);
-  }
-}
-
-
-static _blend_row_func *_choose_blend_func(const unsigned int blend_mode)
-{
-  _blend_row_func *blend = NULL;
-
-  /* select the blend operator */
-  switch(blend_mode & DEVELOP_BLEND_MODE_MASK)
-  {
-    case DEVELOP_BLEND_LIGHTEN:
-      blend = _blend_lighten;
-      break;
-    case DEVELOP_BLEND_DARKEN:
-      blend = _blend_darken;
-      break;
-    case DEVELOP_BLEND_MULTIPLY:
-      blend = _blend_multiply;
-      break;
-    case DEVELOP_BLEND_AVERAGE:
-      blend = _blend_average;
-      break;
-    case DEVELOP_BLEND_ADD:
-      blend = _blend_add;
-      break;
-    case DEVELOP_BLEND_SUBTRACT:
-      blend = _blend_subtract;
-      break;
-    case DEVELOP_BLEND_DIFFERENCE:
-    case DEVELOP_BLEND_DIFFERENCE2:
-      blend = _blend_difference;
-      break;
-    case DEVELOP_BLEND_SCREEN:
-      blend = _blend_screen;
-      break;
-    case DEVELOP_BLEND_OVERLAY:
-      blend = _blend_overlay;
-      break;
-    case DEVELOP_BLEND_SOFTLIGHT:
-      blend = _blend_softlight;
-      break;
-    case DEVELOP_BLEND_HARDLIGHT:
-      blend = _blend_hardlight;
-      break;
-    case DEVELOP_BLEND_VIVIDLIGHT:
-      blend = _blend_vividlight;
-      break;
-    case DEVELOP_BLEND_LINEARLIGHT:
-      blend = _blend_linearlight;
-      break;
-    case DEVELOP_BLEND_PINLIGHT:
-      blend = _blend_pinlight;
-      break;
-    case DEVELOP_BLEND_BOUNDED:
-      blend = _blend_normal_bounded;
-      break;
-
-    /* fallback to normal blend */
-    case DEVELOP_BLEND_NORMAL2:
-    default:
-      blend = _blend_normal_unbounded;
-      break;
-  }
-
-  return blend;
-}
-
+#define DT_CPU_KERNELS "develop/blends/kernels/blendif_raw.c"
+#include "common/cpu_variants.h"
 
 void dt_develop_blendif_raw_blend(dt_dev_pixelpipe_iop_t *piece,
                                   const float *const restrict a,
@@ -399,53 +80,10 @@ void dt_develop_blendif_raw_blend(dt_dev_pixelpipe_iop_t *piece,
                                   const float *const restrict mask,
                                   const dt_dev_pixelpipe_display_mask_t request_mask_display)
 {
-  const dt_develop_blend_params_t *const d = piece->blendop_data;
-
-  if(piece->colors != 1) return;
-
-  const int xoffs = roi_out->x - roi_in->x;
-  const int yoffs = roi_out->y - roi_in->y;
-  const int iwidth = roi_in->width;
-  const int owidth = roi_out->width;
-  const int oheight = roi_out->height;
-
-  if(request_mask_display & DT_DEV_PIXELPIPE_DISPLAY_ANY)
-  {
-    dt_iop_image_fill(b, 0.0f, owidth, oheight, 1); //b[k] = 0.0f;
-  }
-  else
-  {
-    _blend_row_func *const blend = _choose_blend_func(d->blend_mode);
-
-    float *tmp_buffer = dt_alloc_align_float((size_t)owidth * oheight);
-    if(tmp_buffer != NULL)
-    {
-      dt_iop_image_copy(tmp_buffer, b, (size_t)owidth * oheight);
-      if((d->blend_mode & DEVELOP_BLEND_REVERSE) == DEVELOP_BLEND_REVERSE)
-      {
-        DT_OMP_FOR()
-        for(size_t y = 0; y < oheight; y++)
-        {
-          const size_t a_start = (y + yoffs) * iwidth + xoffs;
-          const size_t bm_start = y * owidth;
-          blend(tmp_buffer + bm_start, a + a_start, b + bm_start, mask + bm_start, owidth);
-        }
-      }
-      else
-      {
-        DT_OMP_FOR()
-        for(size_t y = 0; y < oheight; y++)
-        {
-          const size_t a_start = (y + yoffs) * iwidth + xoffs;
-          const size_t bm_start = y * owidth;
-          blend(a + a_start, tmp_buffer + bm_start, b + bm_start, mask + bm_start, owidth);
-        }
-      }
-      dt_free_align(tmp_buffer);
-    }
-  }
+  DT_CPU_DISPATCH(_blend)(piece, a, b, roi_in, roi_out, mask, request_mask_display);
 }
 
+
 // tools/update_modelines.sh
 // remove-trailing-space on;
 // clang-format off
@@ -26,6 +26,7 @@
 #endif
 
 #include "common/colorspaces_inline_conversions.h"
+#include "common/cpu_dispatch.h"
 #include "common/imagebuf.h"
 #include "develop/blend.h"
 #include "develop/imageop.h"
@@ -49,32 +50,18 @@ static inline float _blendif_compute_factor(const float value,
                                             const unsigned int invert_mask,
                                             const float *const restrict parameters)
 {
-  float factor = 0.0f;
-  if(value <= parameters[0])
-  {
-   // we are below the keyframe
-   factor = 0.0f;
-  }
-  else if(value < parameters[1])
-  {
-   // we are on the bottom slope of the keyframe
-   factor = (value - parameters[0]) * parameters[4];
-  }
-  else if(value <= parameters[2])
-  {
-   // we are on the ramp - constant part - of the keyframe
-   factor = 1.0f;
-  }
-  else if(value < parameters[3])
-  {
-   // we are on the top slope of the keyframe
-   factor = 1.0f - (value - parameters[2]) * parameters[5];
-  }
-  else
-  {
-   // we are above the keyframe
-   factor = 0.0f;
-  }
+  // the parameters are all loaded and the keyframe evaluated without
+  // branches, for the loops over the pixels to get vectorised
+  const float low = parameters[0];
+  const float bottom = parameters[1];
+  const float top = parameters[2];
+  const float high = parameters[3];
+  // the bottom slope up to the constant part of the keyframe, the top
+  // slope after it
+  const float rising = value < bottom ? (value - low) * parameters[4] : 1.0f;
+  const float falling = value > top ? 1.0f - (value - top) * parameters[5] : 1.0f;
+  // 0 below and above the keyframe
+  const float factor = (value > low) & (value < high) ? MIN(rising, falling) : 0.0f;
   return invert_mask ? 1.0f - factor : factor; // inverted channel?
 }
 
@@ -194,576 +181,6 @@ static inline void _blendif_jzczhz_lab(const float *const restrict pixels,
   }
 }
 
-DT_OMP_DECLARE_SIMD(aligned(pixels: 16) uniform(stride, blendif, parameters, profile))
-static void _blendif_combine_channels(const float *const restrict pixels,
-                                      float *const restrict mask,
-                                      const size_t stride,
-                                      const unsigned int blendif,
-                                      const float *const restrict parameters,
-                                      const dt_iop_order_iccprofile_info_t *const restrict profile)
-{
-  if(blendif & (1 << DEVELOP_BLENDIF_GRAY_in))
-  {
-    const unsigned int invert_mask = (blendif >> 16) & (1 << DEVELOP_BLENDIF_GRAY_in);
-    _blendif_gray(pixels, mask, stride, parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_GRAY_in,
-                  invert_mask, profile);
-  }
-
-  if(blendif & (1 << DEVELOP_BLENDIF_RED_in))
-  {
-    const unsigned int invert_mask = (blendif >> 16) & (1 << DEVELOP_BLENDIF_RED_in);
-    _blendif_rgb_red(pixels, mask, stride, parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_RED_in,
-                     invert_mask);
-  }
-
-  if(blendif & (1 << DEVELOP_BLENDIF_GREEN_in))
-  {
-    const unsigned int invert_mask = (blendif >> 16) & (1 << DEVELOP_BLENDIF_GREEN_in);
-    _blendif_rgb_green(pixels, mask, stride,
-                       parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_GREEN_in, invert_mask);
-  }
-
-  if(blendif & (1 << DEVELOP_BLENDIF_BLUE_in))
-  {
-    const unsigned int invert_mask = (blendif >> 16) & (1 << DEVELOP_BLENDIF_BLUE_in);
-    _blendif_rgb_blue(pixels, mask, stride, parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_BLUE_in,
-                      invert_mask);
-  }
-
-  if(blendif & ((1 << DEVELOP_BLENDIF_Jz_in) | (1 << DEVELOP_BLENDIF_Cz_in) | (1 << DEVELOP_BLENDIF_hz_in)))
-  {
-    const unsigned int invert_mask[3] DT_ALIGNED_PIXEL = {
-        (blendif >> 16) & (1 << DEVELOP_BLENDIF_Jz_in),
-        (blendif >> 16) & (1 << DEVELOP_BLENDIF_Cz_in),
-        (blendif >> 16) & (1 << DEVELOP_BLENDIF_hz_in) };
-
-    if(dt_is_valid_colormatrix(profile->matrix_out_transposed[0][0]))
-      _blendif_jzczhz(pixels, mask, stride, parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_Jz_in,
-                    invert_mask, profile);
-    else
-    {
-      cmsHPROFILE *input = dt_colorspaces_get_profile(profile->type, profile->filename, DT_PROFILE_DIRECTION_IN)->profile;
-      cmsHPROFILE *Lab = dt_colorspaces_get_profile(DT_COLORSPACE_LAB, "", DT_PROFILE_DIRECTION_ANY)->profile;
-      cmsHTRANSFORM *xform = cmsCreateTransform(input, TYPE_RGBA_FLT, Lab, TYPE_LabA_FLT, profile->intent, 0);
-
-      _blendif_jzczhz_lab(pixels, mask, stride, parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_Jz_in,
-                    invert_mask, xform);
-      cmsDeleteTransform(xform);
-    }
-  }
-}
-
-void dt_develop_blendif_rgb_jzczhz_make_mask(dt_dev_pixelpipe_iop_t *piece,
-                                             const float *const restrict a,
-                                             const float *const restrict b,
-                                             const dt_iop_roi_t *const roi_in,
-                                             const dt_iop_roi_t *const roi_out,
-                                             float *const restrict mask)
-{
-  const dt_develop_blend_params_t *const d = piece->blendop_data;
-
-  if(piece->colors != DT_BLENDIF_RGB_CH) return;
-
-  const int xoffs = roi_out->x - roi_in->x;
-  const int yoffs = roi_out->y - roi_in->y;
-  const int iwidth = roi_in->width;
-  const int owidth = roi_out->width;
-  const int oheight = roi_out->height;
-
-  const unsigned int any_channel_active = d->blendif & DEVELOP_BLENDIF_RGB_MASK;
-  const unsigned int mask_inclusive = d->mask_combine & DEVELOP_COMBINE_INCL;
-  const unsigned int mask_inversed = d->mask_combine & DEVELOP_COMBINE_INV;
-
-  // invert the individual channels if the combine mode is inclusive
-  const unsigned int blendif = d->blendif ^ (mask_inclusive ? DEVELOP_BLENDIF_RGB_MASK << 16 : 0);
-
-  // a channel cancels the mask if the whole span is selected and the channel is inverted
-  const unsigned int canceling_channel = (blendif >> 16) & ~blendif & DEVELOP_BLENDIF_RGB_MASK;
-
-  const size_t buffsize = (size_t)owidth * oheight;
-
-  // get the clipped opacity value  0 - 1
-  const float global_opacity = clamp_simd(d->opacity / 100.0f);
-
-  if(!(d->mask_mode & DEVELOP_MASK_CONDITIONAL) || (!canceling_channel && !any_channel_active))
-  {
-    // mask is not conditional, invert the mask if required
-    if(mask_inversed)
-    {
-      DT_OMP_FOR_SIMD()
-      for(size_t x = 0; x < buffsize; x++)
-        mask[x] = global_opacity * (1.0f - mask[x]);
-    }
-    else
-    {
-      dt_iop_image_mul_const(mask,global_opacity,owidth,oheight,1); // mask[k] *= global_opacity;
-    }
-  }
-  else if(canceling_channel || !any_channel_active)
-  {
-    // one of the conditional channel selects nothing
-    // this means that the conditional opacity of all pixels is the same
-    // and depends on whether the mask combination is inclusive and whether the mask is inverted
-    const float opac = ((mask_inversed == 0) ^ (mask_inclusive == 0)) ? global_opacity : 0.0f;
-    dt_iop_image_fill(mask,opac,owidth,oheight,1); // mask[k] = opac;
-  }
-  else
-  {
-    // we need to process all conditional channels
-
-    // parameters, for every channel the 4 limits + pre-computed increasing slope and decreasing slope
-    float parameters[DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_SIZE] DT_ALIGNED_ARRAY;
-    dt_develop_blendif_process_parameters(parameters, d);
-
-    dt_iop_order_iccprofile_info_t blend_profile;
-    if(!dt_develop_blendif_init_masking_profile(piece, &blend_profile, DEVELOP_BLEND_CS_RGB_SCENE))
-    {
-      return;
-    }
-    const dt_iop_order_iccprofile_info_t *profile = &blend_profile;
-
-    // allocate space for a temporary mask buffer to split the computation of every channel
-    float *const restrict temp_mask = dt_alloc_align_float(buffsize);
-    if(!temp_mask)
-    {
-      return;
-    }
-
-    DT_OMP_PRAGMA(parallel default(none)
-                  dt_omp_firstprivate(temp_mask, mask, a, b, oheight, owidth, iwidth, yoffs, xoffs, buffsize,
-                                      blendif, profile, parameters, mask_inclusive, mask_inversed, global_opacity))
-    {
-      // flush denormals to zero to avoid performance penalty if there are a lot of zero values in the mask
-      const int oldMode = dt_mm_enable_flush_zero();
-
-      // initialize the parametric mask
-      DT_OMP_PRAGMA(for simd schedule(static) aligned(temp_mask:64))
-      for(size_t x = 0; x < buffsize; x++) temp_mask[x] = 1.0f;
-
-      // combine channels
-      DT_OMP_PRAGMA(for schedule(static))
-      for(size_t y = 0; y < oheight; y++)
-      {
-        const size_t start = ((y + yoffs) * iwidth + xoffs) * DT_BLENDIF_RGB_CH;
-        _blendif_combine_channels(a + start, temp_mask + (y * owidth), owidth, blendif, parameters, profile);
-      }
-      DT_OMP_PRAGMA(for schedule(static))
-      for(size_t y = 0; y < oheight; y++)
-      {
-        const size_t start = (y * owidth) * DT_BLENDIF_RGB_CH;
-        _blendif_combine_channels(b + start, temp_mask + (y * owidth), owidth, blendif >> DEVELOP_BLENDIF_GRAY_out,
-                                  parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_GRAY_out,
-                                  profile);
-      }
-
-      // apply global opacity
-      if(mask_inclusive)
-      {
-        if(mask_inversed)
-        {
-          DT_OMP_PRAGMA(for simd schedule(static) aligned(mask, temp_mask:64))
-          for(size_t x = 0; x < buffsize; x++) mask[x] = global_opacity * (1.0f - mask[x]) * temp_mask[x];
-        }
-        else
-        {
-          DT_OMP_PRAGMA(for simd schedule(static) aligned(mask, temp_mask:64))
-          for(size_t x = 0; x < buffsize; x++) mask[x] = global_opacity * (1.0f - (1.0f - mask[x]) * temp_mask[x]);
-        }
-      }
-      else
-      {
-        if(mask_inversed)
-        {
-          DT_OMP_PRAGMA(for simd schedule(static) aligned(mask, temp_mask:64))
-          for(size_t x = 0; x < buffsize; x++) mask[x] = global_opacity * (1.0f - mask[x] * temp_mask[x]);
-        }
-        else
-        {
-          DT_OMP_PRAGMA(for simd schedule(static) aligned(mask, temp_mask:64))
-          for(size_t x = 0; x < buffsize; x++) mask[x] = global_opacity * mask[x] * temp_mask[x];
-        }
-      }
-
-      dt_mm_restore_flush_zero(oldMode);
-    }
-
-    dt_free_align(temp_mask);
-  }
-}
-
-
-/* normal blend without any clamping */
-_BLEND_FUNC _blend_normal(const float *const a,
-                          const float *const b,
-                          const float p,
-                          float *const out,
-                          const float *const restrict mask,
-                          const size_t stride)
-{
-  for(size_t i = 0, j = 0; i < stride; i++, j += DT_BLENDIF_RGB_CH)
-  {
-    const float local_opacity = mask[i];
-    for(int k = 0; k < DT_BLENDIF_RGB_BCH; k++)
-    {
-      out[j + k] = a[j + k] * (1.0f - local_opacity) + b[j + k] * local_opacity;
-    }
-    out[j + DT_BLENDIF_RGB_BCH] = local_opacity;
-  }
-}
-
-/* multiply */
-_BLEND_FUNC _blend_multiply(const float *const a,
-                            const float *const b,
-                            const float p,
-                            float *const out,
-                            const float *const restrict mask,
-                            const size_t stride)
-{
-  for(size_t i = 0, j = 0; i < stride; i++, j += DT_BLENDIF_RGB_CH)
-  {
-    const float local_opacity = mask[i];
-    for(int k = 0; k < DT_BLENDIF_RGB_BCH; k++)
-    {
-      out[j + k] = a[j + k] * (1.0f - local_opacity) + (a[j + k] * b[j + k] * p) * local_opacity;
-    }
-    out[j + DT_BLENDIF_RGB_BCH] = local_opacity;
-  }
-}
-
-/* add */
-_BLEND_FUNC _blend_add(const float *const a,
-                       const float *const b,
-                       const float p,
-                       float *const out,
-                       const float *const restrict mask,
-                       const size_t stride)
-{
-  for(size_t i = 0, j = 0; i < stride; i++, j += DT_BLENDIF_RGB_CH)
-  {
-    const float local_opacity = mask[i];
-    for(int k = 0; k < DT_BLENDIF_RGB_BCH; k++)
-    {
-      out[j + k] = a[j + k] * (1.0f - local_opacity) + (a[j + k] + p * b[j + k]) * local_opacity;
-    }
-    out[j + DT_BLENDIF_RGB_BCH] = local_opacity;
-  }
-}
-
-/* subtract */
-_BLEND_FUNC _blend_subtract(const float *const a,
-                            const float *const b,
-                            const float p,
-                            float *const out,
-                            const float *const restrict mask,
-                            const size_t stride)
-{
-  for(size_t i = 0, j = 0; i < stride; i++, j += DT_BLENDIF_RGB_CH)
-  {
-    const float local_opacity = mask[i];
-    for(int k = 0; k < DT_BLENDIF_RGB_BCH; k++)
-    {
-      out[j + k] = a[j + k] * (1.0f - local_opacity) + fmaxf(a[j + k] - p * b[j + k], 0.0f) * local_opacity;
-    }
-    out[j + 3] = local_opacity;
-  }
-}
-
-/* subtract inverse */
-_BLEND_FUNC _blend_subtract_inverse(const float *const a,
-                                    const float *const b,
-                                    const float p,
-                                    float *const out,
-                                    const float *const restrict mask,
-                                    const size_t stride)
-{
-  for(size_t i = 0, j = 0; i < stride; i++, j += DT_BLENDIF_RGB_CH)
-  {
-    const float local_opacity = mask[i];
-    for(int k = 0; k < DT_BLENDIF_RGB_BCH; k++)
-    {
-      out[j + k] = a[j + k] * (1.0f - local_opacity) + fmaxf(b[j + k] - p * a[j + k], 0.0f) * local_opacity;
-    }
-    out[j + 3] = local_opacity;
-  }
-}
-
-/* difference */
-_BLEND_FUNC _blend_difference(const float *const a,
-                              const float *const b,
-                              const float p,
-                              float *const out,
-                              const float *const restrict mask,
-                              const size_t stride)
-{
-  for(size_t i = 0, j = 0; i < stride; i++, j += DT_BLENDIF_RGB_CH)
-  {
-    const float local_opacity = mask[i];
-    for(int k = 0; k < DT_BLENDIF_RGB_BCH; k++)
-    {
-      out[j + k] = a[j + k] * (1.0f - local_opacity) + fabsf(a[j + k] - b[j + k]) * local_opacity;
-    }
-    out[j + DT_BLENDIF_RGB_BCH] = local_opacity;
-  }
-}
-
-/* divide */
-_BLEND_FUNC _blend_divide(const float *const a,
-                          const float *const b,
-                          const float p,
-                          float *const out,
-                          const float *const restrict mask,
-                          const size_t stride)
-{
-  for(size_t i = 0, j = 0; i < stride; i++, j += DT_BLENDIF_RGB_CH)
-  {
-    const float local_opacity = mask[i];
-    for(int k = 0; k < DT_BLENDIF_RGB_BCH; k++)
-    {
-      out[j + k] = a[j + k] * (1.0f - local_opacity) + a[j + k] / fmaxf(p * b[j + k], 1e-6f) * local_opacity;
-    }
-    out[j + DT_BLENDIF_RGB_BCH] = local_opacity;
-  }
-}
-
-/* divide inverse */
-_BLEND_FUNC _blend_divide_inverse(const float *const a,
-                                  const float *const b,
-                                  const float p,
-                                  float *const out,
-                                  const float *const restrict mask,
-                                  const size_t stride)
-{
-  for(size_t i = 0, j = 0; i < stride; i++, j += DT_BLENDIF_RGB_CH)
-  {
-    const float local_opacity = mask[i];
-    for(int k = 0; k < DT_BLENDIF_RGB_BCH; k++)
-    {
-      out[j + k] = a[j + k] * (1.0f - local_opacity) + b[j + k] / fmaxf(p * a[j + k], 1e-6f) * local_opacity;
-    }
-    out[j + DT_BLENDIF_RGB_BCH] = local_opacity;
-  }
-}
-
-/* average */
-_BLEND_FUNC _blend_average(const float *const a,
-                           const float *const b,
-                           const float p,
-                           float *const out,
-                           const float *const restrict mask,
-                           const size_t stride)
-{
-  for(size_t i = 0, j = 0; i < stride; i++, j += DT_BLENDIF_RGB_CH)
-  {
-    const float local_opacity = mask[i];
-    for(int k = 0; k < DT_BLENDIF_RGB_BCH; k++)
-    {
-      out[j + k] = a[j + k] * (1.0f - local_opacity) + 0.5f * (a[j + k] + b[j + k]) * local_opacity;
-    }
-    out[j + DT_BLENDIF_RGB_BCH] = local_opacity;
-  }
-}
-
-/* geometric mean */
-_BLEND_FUNC _blend_geometric_mean(const float *const a,
-                                  const float *const b,
-                                  const float p,
-                                  float *const out,
-                                  const float *const restrict mask,
-                                  const size_t stride)
-{
-  for(size_t i = 0, j = 0; i < stride; i++, j += DT_BLENDIF_RGB_CH)
-  {
-    const float local_opacity = mask[i];
-    for(int k = 0; k < DT_BLENDIF_RGB_BCH; k++)
-    {
-      out[j + k] = a[j + k] * (1.0f - local_opacity) + sqrtf(fmax(a[j + k] * b[j + k], 0.0f)) * local_opacity;
-    }
-    out[j + DT_BLENDIF_RGB_BCH] = local_opacity;
-  }
-}
-
-/* harmonic mean */
-_BLEND_FUNC _blend_harmonic_mean(const float *const a,
-                                 const float *const b,
-                                 const float p,
-                                 float *const out,
-                                 const float *const restrict mask,
-                                 const size_t stride)
-{
-  for(size_t i = 0, j = 0; i < stride; i++, j += DT_BLENDIF_RGB_CH)
-  {
-    const float local_opacity = mask[i];
-    for(int k = 0; k < DT_BLENDIF_RGB_BCH; k++)
-    {
-      // consider that pixel values should be positive
-      out[j + k] = a[j + k] * (1.0f - local_opacity)
-          + 2.0f * a[j + k] * b[j + k] / (fmaxf(a[j + k], 5e-7f) + fmaxf(b[j + k], 5e-7f)) * local_opacity;
-    }
-    out[j + DT_BLENDIF_RGB_BCH] = local_opacity;
-  }
-}
-
-/* chromaticity */
-_BLEND_FUNC _blend_chromaticity(const float *const a,
-                                const float *const b,
-                                const float p,
-                                float *const out,
-                                const float *const restrict mask,
-                                const size_t stride)
-{
-  for(size_t i = 0, j = 0; i < stride; i++, j += DT_BLENDIF_RGB_CH)
-  {
-    const float local_opacity = mask[i];
-    const float norm_a = fmax(sqrtf(sqf(a[j]) + sqf(a[j + 1]) + sqf(a[j + 2])), 1e-6f);
-    const float norm_b = fmax(sqrtf(sqf(b[j]) + sqf(b[j + 1]) + sqf(b[j + 2])), 1e-6f);
-    for(int k = 0; k < DT_BLENDIF_RGB_BCH; k++)
-    {
-      out[j + k] = a[j + k] * (1.0f - local_opacity) + b[j + k] * norm_a / norm_b * local_opacity;
-    }
-    out[j + DT_BLENDIF_RGB_BCH] = local_opacity;
-  }
-}
-
-/* luminance */
-_BLEND_FUNC _blend_luminance(const float *const a,
-                             const float *const b,
-                             const float p,
-                             float *const out,
-                             const float *const restrict mask,
-                             const size_t stride)
-{
-  for(size_t i = 0, j = 0; i < stride; i++, j += DT_BLENDIF_RGB_CH)
-  {
-    const float local_opacity = mask[i];
-    const float norm_a = fmax(sqrtf(sqf(a[j]) + sqf(a[j + 1]) + sqf(a[j + 2])), 1e-6f);
-    const float norm_b = fmax(sqrtf(sqf(b[j]) + sqf(b[j + 1]) + sqf(b[j + 2])), 1e-6f);
-    for(int k = 0; k < DT_BLENDIF_RGB_BCH; k++)
-    {
-      out[j + k] = a[j + k] * (1.0f - local_opacity) + a[j + k] * norm_b / norm_a * local_opacity;
-    }
-    out[j + DT_BLENDIF_RGB_BCH] = local_opacity;
-  }
-}
-
-/* blend only R-channel in RGB color space without any clamping */
-_BLEND_FUNC _blend_RGB_R(const float *const a,
-                         const float *const b,
-                         const float p,
-                         float *const out,
-                         const float *const restrict mask,
-                         const size_t stride)
-{
-  for(size_t i = 0, j = 0; i < stride; i++, j += DT_BLENDIF_RGB_CH)
-  {
-    const float local_opacity = mask[i];
-    out[j + 0] = a[j + 0] * (1.0f - local_opacity) + p * b[j + 0] * local_opacity;
-    out[j + 1] = a[j + 1];
-    out[j + 2] = a[j + 2];
-    out[j + 3] = local_opacity;
-  }
-}
-
-/* blend only R-channel in RGB color space without any clamping */
-_BLEND_FUNC _blend_RGB_G(const float *const a,
-                         const float *const b,
-                         const float p,
-                         float *const out,
-                         const float *const restrict mask,
-                         const size_t stride)
-{
-  for(size_t i = 0, j = 0; i < stride; i++, j += DT_BLENDIF_RGB_CH)
-  {
-    const float local_opacity = mask[i];
-    out[j + 0] = a[j + 0];
-    out[j + 1] = a[j + 1] * (1.0f - local_opacity) + p * b[j + 1] * local_opacity;
-    out[j + 2] = a[j + 2];
-    out[j + 3] = local_opacity;
-  }
-}
-
-/* blend only R-channel in RGB color space without any clamping */
-_BLEND_FUNC _blend_RGB_B(const float *const a,
-                         const float *const b,
-                         const float p,
-                         float *const out,
-                         const float *const restrict mask,
-                         const size_t stride)
-{
-  for(size_t i = 0, j = 0; i < stride; i++, j += DT_BLENDIF_RGB_CH)
-  {
-    const float local_opacity = mask[i];
-    out[j + 0] = a[j + 0];
-    out[j + 1] = a[j + 1];
-    out[j + 2] = a[j + 2] * (1.0f - local_opacity) + p * b[j + 2] * local_opacity;
-    out[j + 3] = local_opacity;
-  }
-}
-
-
-static _blend_row_func *_choose_blend_func(const unsigned int blend_mode)
-{
-  _blend_row_func *blend = NULL;
-
-  /* select the blend operator */
-  switch(blend_mode & DEVELOP_BLEND_MODE_MASK)
-  {
-    case DEVELOP_BLEND_MULTIPLY:
-      blend = _blend_multiply;
-      break;
-    case DEVELOP_BLEND_AVERAGE:
-      blend = _blend_average;
-      break;
-    case DEVELOP_BLEND_ADD:
-      blend = _blend_add;
-      break;
-    case DEVELOP_BLEND_SUBTRACT:
-      blend = _blend_subtract;
-      break;
-    case DEVELOP_BLEND_SUBTRACT_INVERSE:
-      blend = _blend_subtract_inverse;
-      break;
-    case DEVELOP_BLEND_DIFFERENCE:
-    case DEVELOP_BLEND_DIFFERENCE2:
-      blend = _blend_difference;
-      break;
-    case DEVELOP_BLEND_DIVIDE:
-      blend = _blend_divide;
-      break;
-    case DEVELOP_BLEND_DIVIDE_INVERSE:
-      blend = _blend_divide_inverse;
-      break;
-    case DEVELOP_BLEND_LIGHTNESS:
-      blend = _blend_luminance;
-      break;
-    case DEVELOP_BLEND_CHROMATICITY:
-      blend = _blend_chromaticity;
-      break;
-    case DEVELOP_BLEND_RGB_R:
-      blend = _blend_RGB_R;
-      break;
-    case DEVELOP_BLEND_RGB_G:
-      blend = _blend_RGB_G;
-      break;
-    case DEVELOP_BLEND_RGB_B:
-      blend = _blend_RGB_B;
-      break;
-    case DEVELOP_BLEND_GEOMETRIC_MEAN:
-      blend = _blend_geometric_mean;
-      break;
-    case DEVELOP_BLEND_HARMONIC_MEAN:
-      blend = _blend_harmonic_mean;
-      break;
-
-    /* fallback to normal blend */
-    default:
-      blend = _blend_normal;
-      break;
-  }
-
-  return blend;
-}
-
-
 DT_OMP_DECLARE_SIMD(aligned(rgb: 16) uniform(profile))
 static inline float _rgb_luminance(const float *const restrict rgb,
                                    const dt_iop_order_iccprofile_info_t *const restrict profile)
@@ -803,191 +220,6 @@ static inline void _rgb_to_JzCzhz(const dt_aligned_pixel_t rgb,
   dt_JzAzBz_2_JzCzhz(JzAzBz, JzCzhz);
 }
 
-
-DT_OMP_DECLARE_SIMD(aligned(a, b:16) uniform(channel, profile, stride))
-static void _display_channel(const float *const restrict a,
-                             float *const restrict b,
-                             const float *const restrict mask,
-                             const size_t stride,
-                             const int channel,
-                             const float *const restrict boost_factors,
-                             const dt_iop_order_iccprofile_info_t *const profile)
-{
-  switch(channel)
-  {
-    case DT_DEV_PIXELPIPE_DISPLAY_R:
-    {
-      const float factor = 1.0f / exp2f(boost_factors[DEVELOP_BLENDIF_RED_in]);
-      for(size_t i = 0, j = 0; i < stride; i++, j += DT_BLENDIF_RGB_CH)
-      {
-        const float c = clamp_simd(a[j + 0] * factor);
-        for(int k = 0; k < DT_BLENDIF_RGB_BCH; k++) b[j + k] = c;
-        b[j + DT_BLENDIF_RGB_BCH] = mask[i];
-      }
-      break;
-    }
-    case DT_DEV_PIXELPIPE_DISPLAY_R | DT_DEV_PIXELPIPE_DISPLAY_OUTPUT:
-    {
-      const float factor = 1.0f / exp2f(boost_factors[DEVELOP_BLENDIF_RED_out]);
-      for(size_t i = 0, j = 0; i < stride; i++, j += DT_BLENDIF_RGB_CH)
-      {
-        const float c = clamp_simd(b[j + 0] * factor);
-        for(int k = 0; k < DT_BLENDIF_RGB_BCH; k++) b[j + k] = c;
-        b[j + DT_BLENDIF_RGB_BCH] = mask[i];
-      }
-      break;
-    }
-    case DT_DEV_PIXELPIPE_DISPLAY_G:
-    {
-      const float factor = 1.0f / exp2f(boost_factors[DEVELOP_BLENDIF_GREEN_in]);
-      for(size_t i = 0, j = 0; i < stride; i++, j += DT_BLENDIF_RGB_CH)
-      {
-        const float c = clamp_simd(a[j + 1] * factor);
-        for(int k = 0; k < DT_BLENDIF_RGB_BCH; k++) b[j + k] = c;
-        b[j + DT_BLENDIF_RGB_BCH] = mask[i];
-      }
-      break;
-    }
-    case DT_DEV_PIXELPIPE_DISPLAY_G | DT_DEV_PIXELPIPE_DISPLAY_OUTPUT:
-    {
-      const float factor = 1.0f / exp2f(boost_factors[DEVELOP_BLENDIF_GREEN_out]);
-      for(size_t i = 0, j = 0; i < stride; i++, j += DT_BLENDIF_RGB_CH)
-      {
-        const float c = clamp_simd(b[j + 1] * factor);
-        for(int k = 0; k < DT_BLENDIF_RGB_BCH; k++) b[j + k] = c;
-        b[j + DT_BLENDIF_RGB_BCH] = mask[i];
-      }
-      break;
-    }
-    case DT_DEV_PIXELPIPE_DISPLAY_B:
-    {
-      const float factor = 1.0f / exp2f(boost_factors[DEVELOP_BLENDIF_BLUE_in]);
-      for(size_t i = 0, j = 0; i < stride; i++, j += DT_BLENDIF_RGB_CH)
-      {
-        const float c = clamp_simd(a[j + 2] * factor);
-        for(int k = 0; k < DT_BLENDIF_RGB_BCH; k++) b[j + k] = c;
-        b[j + DT_BLENDIF_RGB_BCH] = mask[i];
-      }
-      break;
-    }
-    case DT_DEV_PIXELPIPE_DISPLAY_B | DT_DEV_PIXELPIPE_DISPLAY_OUTPUT:
-    {
-      const float factor = 1.0f / exp2f(boost_factors[DEVELOP_BLENDIF_BLUE_out]);
-      for(size_t i = 0, j = 0; i < stride; i++, j += DT_BLENDIF_RGB_CH)
-      {
-        const float c = clamp_simd(b[j + 2] * factor);
-        for(int k = 0; k < DT_BLENDIF_RGB_BCH; k++) b[j + k] = c;
-        b[j + DT_BLENDIF_RGB_BCH] = mask[i];
-      }
-      break;
-    }
-    case DT_DEV_PIXELPIPE_DISPLAY_GRAY:
-    {
-      const float factor = 1.0f / exp2f(boost_factors[DEVELOP_BLENDIF_GRAY_in]);
-      for(size_t i = 0, j = 0; i < stride; i++, j += DT_BLENDIF_RGB_CH)
-      {
-        const float c = clamp_simd(_rgb_luminance(a + j, profile) * factor);
-        for(int k = 0; k < DT_BLENDIF_RGB_BCH; k++) b[j + k] = c;
-        b[j + DT_BLENDIF_RGB_BCH] = mask[i];
-      }
-      break;
-    }
-    case DT_DEV_PIXELPIPE_DISPLAY_GRAY | DT_DEV_PIXELPIPE_DISPLAY_OUTPUT:
-    {
-      const float factor = 1.0f / exp2f(boost_factors[DEVELOP_BLENDIF_GRAY_out]);
-      for(size_t i = 0, j = 0; i < stride; i++, j += DT_BLENDIF_RGB_CH)
-      {
-        const float c = clamp_simd(_rgb_luminance(b + j, profile) * factor);
-        for(int k = 0; k < DT_BLENDIF_RGB_BCH; k++) b[j + k] = c;
-        b[j + DT_BLENDIF_RGB_BCH] = mask[i];
-      }
-      break;
-    }
-    case DT_DEV_PIXELPIPE_DISPLAY_JzCzhz_Jz:
-    {
-      const float factor = 1.0f / exp2f(boost_factors[DEVELOP_BLENDIF_Jz_in]);
-      for(size_t i = 0, j = 0; i < stride; i++, j += DT_BLENDIF_RGB_CH)
-      {
-        dt_aligned_pixel_t JzCzhz;
-        _rgb_to_JzCzhz(a + j, JzCzhz, profile);
-        const float c = clamp_simd(JzCzhz[0] * factor);
-        for(int k = 0; k < DT_BLENDIF_RGB_BCH; k++) b[j + k] = c;
-        b[j + DT_BLENDIF_RGB_BCH] = mask[i];
-      }
-      break;
-    }
-    case DT_DEV_PIXELPIPE_DISPLAY_JzCzhz_Jz | DT_DEV_PIXELPIPE_DISPLAY_OUTPUT:
-    {
-      const float factor = 1.0f / exp2f(boost_factors[DEVELOP_BLENDIF_Jz_out]);
-      for(size_t i = 0, j = 0; i < stride; i++, j += DT_BLENDIF_RGB_CH)
-      {
-        dt_aligned_pixel_t JzCzhz;
-        _rgb_to_JzCzhz(b + j, JzCzhz, profile);
-        const float c = clamp_simd(JzCzhz[0] * factor);
-        for(int k = 0; k < DT_BLENDIF_RGB_BCH; k++) b[j + k] = c;
-        b[j + DT_BLENDIF_RGB_BCH] = mask[i];
-      }
-      break;
-    }
-    case DT_DEV_PIXELPIPE_DISPLAY_JzCzhz_Cz:
-    {
-      const float factor = 1.0f / exp2f(boost_factors[DEVELOP_BLENDIF_Cz_in]);
-      for(size_t i = 0, j = 0; i < stride; i++, j += DT_BLENDIF_RGB_CH)
-      {
-        dt_aligned_pixel_t JzCzhz;
-        _rgb_to_JzCzhz(a + j, JzCzhz, profile);
-        const float c = clamp_simd(JzCzhz[1] * factor);
-        for(int k = 0; k < DT_BLENDIF_RGB_BCH; k++) b[j + k] = c;
-        b[j + DT_BLENDIF_RGB_BCH] = mask[i];
-      }
-      break;
-    }
-    case DT_DEV_PIXELPIPE_DISPLAY_JzCzhz_Cz | DT_DEV_PIXELPIPE_DISPLAY_OUTPUT:
-    {
-      const float factor = 1.0f / exp2f(boost_factors[DEVELOP_BLENDIF_Cz_out]);
-      for(size_t i = 0, j = 0; i < stride; i++, j += DT_BLENDIF_RGB_CH)
-      {
-        dt_aligned_pixel_t JzCzhz;
-        _rgb_to_JzCzhz(b + j, JzCzhz, profile);
-        const float c = clamp_simd(JzCzhz[1] * factor);
-        for(int k = 0; k < DT_BLENDIF_RGB_BCH; k++) b[j + k] = c;
-        b[j + DT_BLENDIF_RGB_BCH] = mask[i];
-      }
-      break;
-    }
-    case DT_DEV_PIXELPIPE_DISPLAY_JzCzhz_hz:
-      // no boost factor for hues
-      for(size_t i = 0, j = 0; i < stride; i++, j += DT_BLENDIF_RGB_CH)
-      {
-        dt_aligned_pixel_t JzCzhz;
-        _rgb_to_JzCzhz(a + j, JzCzhz, profile);
-        const float c = clamp_simd(JzCzhz[2]);
-        for(int k = 0; k < DT_BLENDIF_RGB_BCH; k++) b[j + k] = c;
-        b[j + DT_BLENDIF_RGB_BCH] = mask[i];
-      }
-      break;
-    case DT_DEV_PIXELPIPE_DISPLAY_JzCzhz_hz | DT_DEV_PIXELPIPE_DISPLAY_OUTPUT:
-      // no boost factor for hues
-      for(size_t i = 0, j = 0; i < stride; i++, j += DT_BLENDIF_RGB_CH)
-      {
-        dt_aligned_pixel_t JzCzhz;
-        _rgb_to_JzCzhz(b + j, JzCzhz, profile);
-        const float c = clamp_simd(JzCzhz[2]);
-        for(int k = 0; k < DT_BLENDIF_RGB_BCH; k++) b[j + k] = c;
-        b[j + DT_BLENDIF_RGB_BCH] = mask[i];
-      }
-      break;
-    default:
-      for(size_t i = 0, j = 0; i < stride; i++, j += DT_BLENDIF_RGB_CH)
-      {
-        for(int k = 0; k < DT_BLENDIF_RGB_BCH; k++) b[j + k] = 0.0f;
-        b[j + DT_BLENDIF_RGB_BCH] = mask[i];
-      }
-      break;
-  }
-}
-
-
 DT_OMP_DECLARE_SIMD(aligned(a, b:16) uniform(stride))
 static inline void _copy_mask(const float *const restrict a, float *const restrict b, const size_t stride)
 {
@@ -995,6 +227,19 @@ static inline void _copy_mask(const float *const restrict a, float *const restri
   for(size_t x = DT_BLENDIF_RGB_BCH; x < stride; x += DT_BLENDIF_RGB_CH) b[x] = a[x];
 }
 
+#define DT_CPU_KERNELS "develop/blends/kernels/blendif_rgb_jzczhz.c"
+#include "common/cpu_variants.h"
+
+void dt_develop_blendif_rgb_jzczhz_make_mask(dt_dev_pixelpipe_iop_t *piece,
+                                             const float *const restrict a,
+                                             const float *const restrict b,
+                                             const dt_iop_roi_t *const roi_in,
+                                             const dt_iop_roi_t *const roi_out,
+                                             float *const restrict mask)
+{
+  DT_CPU_DISPATCH(_make_mask)(piece, a, b, roi_in, roi_out, mask);
+}
+
 void dt_develop_blendif_rgb_jzczhz_blend(dt_dev_pixelpipe_iop_t *piece,
                                          const float *const restrict a,
                                          float *const restrict b,
@@ -1003,80 +248,10 @@ void dt_develop_blendif_rgb_jzczhz_blend(dt_dev_pixelpipe_iop_t *piece,
                                          const float *const restrict mask,
                                          const dt_dev_pixelpipe_display_mask_t request_mask_display)
 {
-  const dt_develop_blend_params_t *const d = piece->blendop_data;
-
-  if(piece->colors != DT_BLENDIF_RGB_CH) return;
-
-  const int xoffs = roi_out->x - roi_in->x;
-  const int yoffs = roi_out->y - roi_in->y;
-  const int iwidth = roi_in->width;
-  const int owidth = roi_out->width;
-  const int oheight = roi_out->height;
-
-  // only non-zero if mask_display was set by an _earlier_ module
-  const dt_dev_pixelpipe_display_mask_t mask_display = piece->pipe->mask_display;
-
-  // process the blending operator
-  if(request_mask_display & DT_DEV_PIXELPIPE_DISPLAY_ANY)
-  {
-    dt_iop_order_iccprofile_info_t blend_profile;
-    const gboolean use_profile = dt_develop_blendif_init_masking_profile(piece, &blend_profile,
-                                                                    DEVELOP_BLEND_CS_RGB_SCENE);
-    const dt_iop_order_iccprofile_info_t *profile = use_profile ? &blend_profile : NULL;
-    const float *const restrict boost_factors = d->blendif_boost_factors;
-    const dt_dev_pixelpipe_display_mask_t channel = request_mask_display & DT_DEV_PIXELPIPE_DISPLAY_ANY;
-
-    DT_OMP_FOR()
-    for(size_t y = 0; y < oheight; y++)
-    {
-      const size_t a_start = ((y + yoffs) * iwidth + xoffs) * DT_BLENDIF_RGB_CH;
-      const size_t b_start = y * owidth * DT_BLENDIF_RGB_CH;
-      const size_t m_start = y * owidth;
-      _display_channel(a + a_start, b + b_start, mask + m_start, owidth, channel, boost_factors, profile);
-    }
-  }
-  else
-  {
-    const float p = exp2f(d->blend_parameter);
-    _blend_row_func *const blend = _choose_blend_func(d->blend_mode);
-
-    if((d->blend_mode & DEVELOP_BLEND_REVERSE) == DEVELOP_BLEND_REVERSE)
-    {
-      DT_OMP_FOR()
-      for(size_t y = 0; y < oheight; y++)
-      {
-        const size_t a_start = ((y + yoffs) * iwidth + xoffs) * DT_BLENDIF_RGB_CH;
-        const size_t b_start = y * owidth * DT_BLENDIF_RGB_CH;
-        const size_t m_start = y * owidth;
-        blend(b + b_start, a + a_start, p, b + b_start, mask + m_start, owidth);
-      }
-    }
-    else
-    {
-      DT_OMP_FOR()
-      for(size_t y = 0; y < oheight; y++)
-      {
-        const size_t a_start = ((y + yoffs) * iwidth + xoffs) * DT_BLENDIF_RGB_CH;
-        const size_t b_start = y * owidth * DT_BLENDIF_RGB_CH;
-        const size_t m_start = y * owidth;
-        blend(a + a_start, b + b_start, p, b + b_start, mask + m_start, owidth);
-      }
-    }
-  }
-
-  if(mask_display & DT_DEV_PIXELPIPE_DISPLAY_MASK)
-  {
-    const size_t stride = owidth * DT_BLENDIF_RGB_CH;
-    DT_OMP_FOR()
-    for(size_t y = 0; y < oheight; y++)
-    {
-      const size_t a_start = ((y + yoffs) * iwidth + xoffs) * DT_BLENDIF_RGB_CH;
-      const size_t b_start = y * stride;
-      _copy_mask(a + a_start, b + b_start, stride);
-    }
-  }
+  DT_CPU_DISPATCH(_blend)(piece, a, b, roi_in, roi_out, mask, request_mask_display);
 }
 
+
 // tools/update_modelines.sh
 // remove-trailing-space on;
 // clang-format off
@@ -77,6 +77,7 @@ void dt_dev_init(dt_develop_t *dev,
   pthread_mutexattr_init(&recursive_locking);
   pthread_mutexattr_settype(&recursive_locking, PTHREAD_MUTEX_RECURSIVE);
   dt_pthread_mutex_init(&dev->history_mutex, &recursive_locking);
+  dt_mask_raster_cache_init(&dev->mask_rasters);
 
   dev->snapshot_id = -1;
   dev->history_end = 0;
@@ -248,6 +249,12 @@ void dt_dev_cleanup(dt_develop_t *dev)
     dt_free_align(dev->allprofile_info->data);
     dev->allprofile_info = g_list_delete_link(dev->allprofile_info, dev->allprofile_info);
   }
+  for(int k = 0; k < DT_DEV_TRANSFORM_CACHE_SIZE; k++)
+  {
+    dt_free_align(dev->transform_cache.entry[k].input);
+    dt_free_align(dev->transform_cache.entry[k].points);
+  }
+  dt_mask_raster_cache_cleanup(&dev->mask_rasters);
   dt_pthread_mutex_destroy(&dev->history_mutex);
   if(dev->histogram_pre_tonecurve) free(dev->histogram_pre_tonecurve);
   if(dev->histogram_pre_levels) free(dev->histogram_pre_levels);
@@ -1841,6 +1848,10 @@ static void _cleanup_history(const dt_imgid_t imgid)
 void dt_dev_write_history_ext(dt_develop_t *dev,
                               const dt_imgid_t imgid)
 {
+  // a read-only library keeps the history it has been opened with
+  if(dt_database_is_read_only(darktable.db))
+    return;
+
   dt_lock_image(imgid);
 
   _cleanup_history(imgid);
@@ -3064,18 +3075,44 @@ static char *_transform_type(const dt_dev_transform_direction_t transf_direction
   }
 }
 
-// running with the history locked
-static gboolean _dev_distort_transform_locked(dt_develop_t *dev,
-                                              dt_dev_pixelpipe_t *pipe,
-                                              const gboolean back,
-                                              const double iop_order,
-                                              const dt_dev_transform_direction_t transf_direction,
-                                              float *points,
-                                              const size_t points_count)
+// the modules transforming the points in this direction
+static inline gboolean _dev_distort_applies(const dt_develop_t *dev,
+                                            const dt_dev_pixelpipe_t *pipe,
+                                            const dt_iop_module_t *module,
+                                            const dt_dev_pixelpipe_iop_t *piece,
+                                            const gboolean back,
+                                            const double iop_order,
+                                            const dt_dev_transform_direction_t transf_direction)
+{
+  return piece->enabled
+    && (back ? module->distort_backtransform : module->distort_transform)
+    && piece->data
+    && ((transf_direction == DT_DEV_TRANSFORM_DIR_ALL)
+        || (transf_direction == DT_DEV_TRANSFORM_DIR_ALL_GEOMETRY
+            && !(module->operation_tags() & IOP_TAG_GEOMETRY))
+        || (transf_direction == DT_DEV_TRANSFORM_DIR_FORW_INCL
+            && module->iop_order >= iop_order)
+        || (transf_direction == DT_DEV_TRANSFORM_DIR_FORW_EXCL
+            && module->iop_order > iop_order)
+        || (transf_direction == DT_DEV_TRANSFORM_DIR_BACK_INCL
+            && module->iop_order <= iop_order)
+        || (transf_direction == DT_DEV_TRANSFORM_DIR_BACK_EXCL
+            && module->iop_order < iop_order))
+    && !(dt_iop_module_is_skipped(dev, module)
+         && (pipe->type & DT_DEV_PIXELPIPE_BASIC));
+}
+
+static gboolean _dev_distort_apply_locked(dt_develop_t *dev,
+                                          dt_dev_pixelpipe_t *pipe,
+                                          const gboolean back,
+                                          const double iop_order,
+                                          const dt_dev_transform_direction_t transf_direction,
+                                          float *points,
+                                          const size_t points_count,
+                                          const gboolean log)
 {
   GList *modules = back ? g_list_last(pipe->iop) : g_list_first(pipe->iop);
   GList *pieces = back ? g_list_last(pipe->nodes) : g_list_first(pipe->nodes);
-  const gboolean log = (darktable.unmuted & (DT_DEBUG_CONTROL|DT_DEBUG_VERBOSE)) == (DT_DEBUG_CONTROL|DT_DEBUG_VERBOSE);
 
   while(modules)
   {
@@ -3090,22 +3127,7 @@ static gboolean _dev_distort_transform_locked(dt_develop_t *dev,
       ? module->distort_backtransform
       : module->distort_transform;
 
-    if(piece->enabled
-       && transform
-       && piece->data
-       && ((transf_direction == DT_DEV_TRANSFORM_DIR_ALL)
-           || (transf_direction == DT_DEV_TRANSFORM_DIR_ALL_GEOMETRY
-               && !(module->operation_tags() & IOP_TAG_GEOMETRY))
-           || (transf_direction == DT_DEV_TRANSFORM_DIR_FORW_INCL
-               && module->iop_order >= iop_order)
-           || (transf_direction == DT_DEV_TRANSFORM_DIR_FORW_EXCL
-               && module->iop_order > iop_order)
-           || (transf_direction == DT_DEV_TRANSFORM_DIR_BACK_INCL
-               && module->iop_order <= iop_order)
-           || (transf_direction == DT_DEV_TRANSFORM_DIR_BACK_EXCL
-               && module->iop_order < iop_order))
-       && !(dt_iop_module_is_skipped(dev, module)
-            && (pipe->type & DT_DEV_PIXELPIPE_BASIC)))
+    if(_dev_distort_applies(dev, pipe, module, piece, back, iop_order, transf_direction))
     {
       if(log)
       {
@@ -3137,6 +3159,167 @@ static gboolean _dev_distort_transform_locked(dt_develop_t *dev,
   return TRUE;
 }
 
+// the smaller batches are transformed again, cheaper than looking them up
+#define DT_DEV_TRANSFORM_CACHE_MIN_POINTS 64
+#define DT_DEV_TRANSFORM_CACHE_MAX_POINTS (1 << 20)
+
+/* the version of the chain of modules transforming the points. As the
+   distorting modules may transform their own parameters through the
+   modules before them (liquify does), all the distorting pieces are
+   accounted for, not only the ones applied. DT_INVALID_HASH if the
+   points are left untouched or the pipe is not complete. */
+static dt_hash_t _dev_distort_chain_hash(const dt_develop_t *dev,
+                                         const dt_dev_pixelpipe_t *pipe,
+                                         const gboolean back,
+                                         const double iop_order,
+                                         const dt_dev_transform_direction_t transf_direction)
+{
+  dt_hash_t hash = dt_hash(DT_INITHASH, &pipe, sizeof(pipe));
+  hash = dt_hash(hash, &pipe->type, sizeof(pipe->type));
+  hash = dt_hash(hash, &pipe->image.id, sizeof(pipe->image.id));
+  hash = dt_hash(hash, &pipe->iwidth, sizeof(pipe->iwidth));
+  hash = dt_hash(hash, &pipe->iheight, sizeof(pipe->iheight));
+  hash = dt_hash(hash, &pipe->iscale, sizeof(pipe->iscale));
+  hash = dt_hash(hash, &back, sizeof(back));
+
+  gboolean applied = FALSE;
+  const GList *pieces = pipe->nodes;
+  for(const GList *modules = pipe->iop; modules; modules = g_list_next(modules))
+  {
+    if(!pieces) return DT_INVALID_HASH;
+
+    const dt_iop_module_t *module = modules->data;
+    const dt_dev_pixelpipe_iop_t *piece = pieces->data;
+    if(module->distort_transform || module->distort_backtransform)
+    {
+      const gboolean applies =
+        _dev_distort_applies(dev, pipe, module, piece, back, iop_order, transf_direction);
+      // crop and ashift commit another transform while they have the
+      // focus, without a change of the history
+      const gboolean focused = dt_iop_has_focus(module);
+      applied |= applies;
+      hash = dt_hash(hash, &module, sizeof(module));
+      hash = dt_hash(hash, &applies, sizeof(applies));
+      hash = dt_hash(hash, &focused, sizeof(focused));
+      hash = dt_hash(hash, &piece->enabled, sizeof(piece->enabled));
+      hash = dt_hash(hash, &piece->hash, sizeof(piece->hash));
+      hash = dt_hash(hash, &piece->iscale, sizeof(piece->iscale));
+      hash = dt_hash(hash, &piece->iwidth, sizeof(piece->iwidth));
+      hash = dt_hash(hash, &piece->iheight, sizeof(piece->iheight));
+      hash = dt_hash(hash, &piece->buf_in, sizeof(dt_iop_roi_t));
+      hash = dt_hash(hash, &piece->buf_out, sizeof(dt_iop_roi_t));
+    }
+    pieces = g_list_next(pieces);
+  }
+  return applied ? hash : DT_INVALID_HASH;
+}
+
+// FNV-1a on the 64 bits of each point, the point batches are large
+static dt_hash_t _dev_hash_points(dt_hash_t hash,
+                                  const float *points,
+                                  const size_t points_count)
+{
+  for(size_t k = 0; k < points_count; k++)
+  {
+    uint64_t word;
+    memcpy(&word, points + 2 * k, sizeof(word));
+    hash = (hash ^ word) * 0x100000001b3ull;
+  }
+  return dt_hash(hash, &points_count, sizeof(points_count));
+}
+
+static gboolean _dev_transform_cache_get(dt_dev_transform_cache_t *cache,
+                                         const dt_hash_t hash,
+                                         float *points,
+                                         const size_t points_count)
+{
+  const size_t bytes = sizeof(float) * 2 * points_count;
+  for(int k = 0; k < DT_DEV_TRANSFORM_CACHE_SIZE; k++)
+  {
+    dt_dev_transform_cache_entry_t *entry = &cache->entry[k];
+    // the hash may collide, the points given must be the same
+    if(entry->points && entry->hash == hash && entry->points_count == points_count
+       && !memcmp(entry->input, points, bytes))
+    {
+      memcpy(points, entry->points, sizeof(float) * 2 * points_count);
+      entry->used = ++cache->clock;
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+static void _dev_transform_cache_put(dt_dev_transform_cache_t *cache,
+                                     const dt_hash_t hash,
+                                     const float *input,
+                                     const float *points,
+                                     const size_t points_count)
+{
+  int slot = 0;
+  for(int k = 1; k < DT_DEV_TRANSFORM_CACHE_SIZE && cache->entry[slot].points; k++)
+    if(!cache->entry[k].points || cache->entry[k].used < cache->entry[slot].used)
+      slot = k;
+
+  dt_dev_transform_cache_entry_t *entry = &cache->entry[slot];
+  if(entry->points_count != points_count || !entry->points)
+  {
+    dt_free_align(entry->input);
+    dt_free_align(entry->points);
+    entry->input = dt_alloc_align_float(2 * points_count);
+    entry->points = dt_alloc_align_float(2 * points_count);
+    if(!entry->input || !entry->points)
+    {
+      dt_free_align(entry->input);
+      dt_free_align(entry->points);
+      entry->input = entry->points = NULL;
+    }
+    entry->points_count = entry->points ? points_count : 0;
+  }
+  if(!entry->points) return;
+
+  memcpy(entry->input, input, sizeof(float) * 2 * points_count);
+  memcpy(entry->points, points, sizeof(float) * 2 * points_count);
+  entry->hash = hash;
+  entry->used = ++cache->clock;
+}
+
+// running with the history locked
+static gboolean _dev_distort_transform_locked(dt_develop_t *dev,
+                                              dt_dev_pixelpipe_t *pipe,
+                                              const gboolean back,
+                                              const double iop_order,
+                                              const dt_dev_transform_direction_t transf_direction,
+                                              float *points,
+                                              const size_t points_count)
+{
+  const gboolean log = (darktable.unmuted & (DT_DEBUG_CONTROL|DT_DEBUG_VERBOSE)) == (DT_DEBUG_CONTROL|DT_DEBUG_VERBOSE);
+
+  // the masks and overlays transform the same polygons at each redraw
+  dt_hash_t hash = DT_INVALID_HASH;
+  if(!log
+     && points_count >= DT_DEV_TRANSFORM_CACHE_MIN_POINTS
+     && points_count <= DT_DEV_TRANSFORM_CACHE_MAX_POINTS)
+    hash = _dev_distort_chain_hash(dev, pipe, back, iop_order, transf_direction);
+
+  float *input = NULL;
+  if(hash != DT_INVALID_HASH)
+  {
+    hash = _dev_hash_points(hash, points, points_count);
+    if(_dev_transform_cache_get(&dev->transform_cache, hash, points, points_count))
+      return TRUE;
+    // the points are transformed in place
+    input = dt_alloc_align_float(2 * points_count);
+    if(input) memcpy(input, points, sizeof(float) * 2 * points_count);
+  }
+
+  const gboolean done = _dev_distort_apply_locked(dev, pipe, back, iop_order, transf_direction,
+                                                  points, points_count, log);
+  if(done && input)
+    _dev_transform_cache_put(&dev->transform_cache, hash, input, points, points_count);
+  dt_free_align(input);
+  return done;
+}
+
 // Compute the bounding box of the mask overlay currently being edited
 // (all displayed points, borders and clone sources), expressed in
 // normalised image coordinates where the image spans [-0.5, 0.5]. The
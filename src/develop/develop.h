@@ -26,6 +26,7 @@
 #include "common/darktable.h"
 #include "common/dtpthread.h"
 #include "common/image.h"
+#include "common/mask_raster.h"
 #include "control/settings.h"
 #include "develop/imageop.h"
 
@@ -89,6 +90,29 @@ typedef enum dt_dev_transform_direction_t
   DT_DEV_TRANSFORM_DIR_ALL_GEOMETRY = 5,
 } dt_dev_transform_direction_t;
 
+/* the points lately transformed through the distorting modules, reused
+   while the same masks and overlays are drawn again through an unchanged
+   chain of modules. The entries are identified by the hash of the
+   parameters and buffers of the distorting pieces, of the modules applied
+   and of the points given, and checked against the points given. They
+   are protected by the history_mutex. */
+#define DT_DEV_TRANSFORM_CACHE_SIZE 16
+
+typedef struct dt_dev_transform_cache_entry_t
+{
+  dt_hash_t hash;
+  size_t points_count;
+  float *input;  // the points given
+  float *points; // the points transformed
+  uint64_t used;
+} dt_dev_transform_cache_entry_t;
+
+typedef struct dt_dev_transform_cache_t
+{
+  dt_dev_transform_cache_entry_t entry[DT_DEV_TRANSFORM_CACHE_SIZE];
+  uint64_t clock;
+} dt_dev_transform_cache_t;
+
 typedef enum dt_clipping_preview_mode_t
 {
   DT_CLIPPING_PREVIEW_GAMUT = 0,
@@ -213,6 +237,10 @@ typedef struct dt_develop_t
   gboolean history_postpone_invalidate;
   // avoid checking for latest added module into history via list traversal
   struct dt_iop_module_t *history_last_module;
+  // points transformed through the distorting modules
+  dt_dev_transform_cache_t transform_cache;
+  // mask shapes rasterised by the pipes
+  dt_mask_raster_cache_t mask_rasters;
 
   // operations pipeline
   int32_t iop_instance;
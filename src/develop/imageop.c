@@ -2367,6 +2367,9 @@ void dt_iop_commit_params(dt_iop_module_t *module,
   if(module->flags() & IOP_FLAGS_ALLOW_TILING)
     piece->process_tiling_ready = TRUE;
 
+  // geometry modules opt in to the single resampling in commit_params
+  piece->distort_resample = DT_DEV_DISTORT_RESAMPLE_NONE;
+
   if((piece->enabled || module->enabled) // better to check for both
     && module->so->get_introspection()
     && darktable.unmuted & DT_DEBUG_PARAMS)
@@ -628,6 +628,64 @@ static void _combine_masks_exclusion(float *const restrict dest,
   }
 }
 
+// what the raster of a shape depends on but the roi: the shape, the
+// distorting modules up to this one and the input of the pipe
+static dt_hash_t _group_raster_hash(const dt_iop_module_t *const module,
+                                    const dt_dev_pixelpipe_iop_t *const piece,
+                                    dt_masks_form_t *const form)
+{
+  if(!module->dev || (form->type & DT_MASKS_GROUP)) return DT_INVALID_HASH;
+
+  dt_dev_pixelpipe_t *pipe = piece->pipe;
+  const dt_hash_t distort = dt_dev_hash_distort_plus(module->dev, pipe, module->iop_order,
+                                                     DT_DEV_TRANSFORM_DIR_BACK_INCL);
+  if(distort == DT_INVALID_HASH) return DT_INVALID_HASH;
+
+  dt_hash_t hash = distort;
+  // crop and ashift commit another transform while they have the focus,
+  // without a change of their parameters
+  for(const GList *modules = pipe->iop; modules; modules = g_list_next(modules))
+  {
+    const dt_iop_module_t *distorting = modules->data;
+    if(distorting->iop_order > module->iop_order
+       || !(distorting->operation_tags() & IOP_TAG_DISTORT))
+      continue;
+    const gboolean focused = dt_iop_has_focus(distorting);
+    hash = dt_hash(hash, &focused, sizeof(focused));
+  }
+
+  hash = dt_masks_group_hash(hash, form);
+  hash = dt_hash(hash, &pipe->image.id, sizeof(pipe->image.id));
+  hash = dt_hash(hash, &pipe->iwidth, sizeof(pipe->iwidth));
+  hash = dt_hash(hash, &pipe->iheight, sizeof(pipe->iheight));
+  hash = dt_hash(hash, &pipe->iscale, sizeof(pipe->iscale));
+  return hash;
+}
+
+// the shape rasterised over the roi, taken from the rasters kept by the
+// pipes of the develop when possible
+static int _group_get_shape_roi(const dt_iop_module_t *const module,
+                                const dt_dev_pixelpipe_iop_t *const piece,
+                                dt_masks_form_t *const form,
+                                const dt_iop_roi_t *const roi,
+                                float *const buffer)
+{
+  const dt_hash_t hash = _group_raster_hash(module, piece, form);
+  if(hash == DT_INVALID_HASH)
+    return dt_masks_get_mask_roi(module, piece, form, roi, buffer);
+
+  dt_mask_raster_cache_t *cache = &module->dev->mask_rasters;
+  if(dt_mask_raster_cache_get(cache, hash, roi, buffer))
+  {
+    dt_print(DT_DEBUG_MASKS, "[masks %s] raster reused", form->name);
+    return 1;
+  }
+
+  const int ok = dt_masks_get_mask_roi(module, piece, form, roi, buffer);
+  if(ok) dt_mask_raster_cache_put(cache, hash, roi, buffer);
+  return ok;
+}
+
 static int _group_get_mask_roi(const dt_iop_module_t *const restrict module,
                                const dt_dev_pixelpipe_iop_t *const restrict piece,
                                dt_masks_form_t *const form,
@@ -658,7 +716,7 @@ static int _group_get_mask_roi(const dt_iop_module_t *const restrict module,
       // ensure that we start with a zeroed buffer regardless of what
       // was previously written into 'bufs'
       memset(bufs, 0, npixels*sizeof(float));
-      const int ok = dt_masks_get_mask_roi(module, piece, sel, roi, bufs);
+      const int ok = _group_get_shape_roi(module, piece, sel, roi, bufs);
       const float op = fpt->opacity;
       const int state = fpt->state;
 
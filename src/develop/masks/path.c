@@ -4944,39 +4944,388 @@ static int _path_crop_to_roi(float *path,
   return 1;
 }
 
-/** we write a falloff segment respecting limits of buffer */
-static void _path_falloff_roi(float *buffer,
-                              int *p0,
-                              int *p1,
-                              const int bw,
-                              const int bh)
+static int _path_compare_int(const void *a, const void *b)
 {
-  // segment length
-  const int l = sqrtf((p1[0] - p0[0]) * (p1[0] - p0[0])
-                      + (p1[1] - p0[1]) * (p1[1] - p0[1])) + 1;
+  const int ia = *(const int *)a;
+  const int ib = *(const int *)b;
+  return (ia > ib) - (ia < ib);
+}
 
-  const float lx = p1[0] - p0[0];
-  const float ly = p1[1] - p0[1];
+// scanline fill of the path, from an edge table holding the crossings of
+// the edges with each row. A crossing flags the pixel at its rounded
+// position, two crossings of the same pixel cancel out and the rows are
+// filled between pairs of flags, inclusive, within the bounding box.
+// 'cpoints' is the path cropped to the roi
+static gboolean _path_fill_roi(float *const buffer,
+                               const float *const cpoints,
+                               const int first,
+                               const int points_count,
+                               const int width,
+                               const int height,
+                               const int xxmin,
+                               const int xxmax,
+                               const int yymin,
+                               const int yymax)
+{
+  int *row_start = calloc(height + 1, sizeof(int));
+  int *row_end = malloc(sizeof(int) * height);
+  int *crossings = NULL;
+  if(row_start == NULL || row_end == NULL) goto error;
 
-  const int dx = lx < 0 ? -1 : 1;
-  const int dy = ly < 0 ? -1 : 1;
-  const int dpy = dy * bw;
+  // counts the crossings of each row first, then stores them
+  for(int pass = 0; pass < 2; pass++)
+  {
+    float xlast = cpoints[(points_count - 1) * 2];
+    float ylast = cpoints[(points_count - 1) * 2 + 1];
 
-  for(int i = 0; i < l; i++)
+    for(int i = first; i < points_count; i++)
+    {
+      float xstart = xlast;
+      float ystart = ylast;
+
+      float xend = xlast = cpoints[i * 2];
+      float yend = ylast = cpoints[i * 2 + 1];
+
+      if(ystart > yend)
+      {
+        float tmp;
+        tmp = ystart, ystart = yend, yend = tmp;
+        tmp = xstart, xstart = xend, xend = tmp;
+      }
+
+      const float m = (xstart - xend) / (ystart - yend);
+
+      for(int yy = (int)ceilf(ystart); (float)yy < yend; yy++)
+      {
+        const float xcross = xstart + m * (yy - ystart);
+
+        int xx = floorf(xcross);
+        if((float)xx + 0.5f <= xcross)
+          xx++;
+
+        if(xx < 0 || xx >= width || yy < 0 || yy >= height)
+          continue;
+
+        if(pass == 0)
+          row_start[yy + 1]++;
+        else
+          crossings[row_end[yy]++] = xx;
+      }
+    }
+
+    if(pass == 0)
+    {
+      for(int yy = 0; yy < height; yy++)
+        row_start[yy + 1] += row_start[yy];
+      memcpy(row_end, row_start, sizeof(int) * height);
+      crossings = malloc(sizeof(int) * MAX(row_start[height], 1));
+      if(crossings == NULL) goto error;
+    }
+  }
+
+  DT_OMP_FOR()
+  for(int yy = 0; yy < height; yy++)
   {
-    // position
-    const int x = (int)((float)i * lx / (float)l) + p0[0];
-    const int y = (int)((float)i * ly / (float)l) + p0[1];
-    const float op = 1.0f - (float)i / (float)l;
-    float *buf = buffer + (size_t)y * bw + x;
-
-    if(x >= 0 && x < bw && y >= 0 && y < bh)
-      buf[0] = MAX(buf[0], op);
-    if(x + dx >= 0 && x + dx < bw && y >= 0 && y < bh)
-      buf[dx] = MAX(buf[dx], op); // this one is to avoid gap due to int rounding
-    if(x >= 0 && x < bw && y + dy >= 0 && y + dy < bh)
-      buf[dpy] = MAX(buf[dpy], op); // this one is to avoid gap due to int rounding
+    int *const x = crossings + row_start[yy];
+    const int n = row_end[yy] - row_start[yy];
+    if(n == 0) continue;
+
+    qsort(x, n, sizeof(int), _path_compare_int);
+    int flags = 0;
+    for(int k = 0; k < n; k++)
+    {
+      if(flags > 0 && x[flags - 1] == x[k])
+        flags--;
+      else
+        x[flags++] = x[k];
+    }
+
+    float *const row = buffer + (size_t)yy * width;
+    for(int k = 0; k < flags; k++)
+      row[x[k]] = 1.0f;
+    if(yy < yymin || yy > yymax) continue;
+
+    gboolean inside = FALSE;
+    int from = 0;
+    for(int k = 0; k < flags; k++)
+    {
+      if(x[k] < xxmin || x[k] > xxmax) continue;
+      if(inside)
+        for(int xx = from; xx <= x[k]; xx++) row[xx] = 1.0f;
+      from = x[k];
+      inside = !inside;
+    }
+    if(inside)
+      for(int xx = from; xx <= xxmax; xx++) row[xx] = 1.0f;
   }
+
+  free(row_start);
+  free(row_end);
+  free(crossings);
+  return TRUE;
+
+error:
+  free(row_start);
+  free(row_end);
+  free(crossings);
+  return FALSE;
+}
+
+// a triangle of the feather, over which the falloff is linear
+typedef struct _path_ramp_t
+{
+  float x[3], y[3];
+  float a, b, c; // falloff = a * x + b * y + c
+  int ymin, ymax;
+} _path_ramp_t;
+
+// the linear falloff through these corners and falloffs. FALSE if the
+// corners are aligned
+static gboolean _path_ramp_plane(_path_ramp_t *ramp,
+                                 const float *const p0,
+                                 const float *const p1,
+                                 const float *const p2,
+                                 const float f0,
+                                 const float f1,
+                                 const float f2)
+{
+  const float dx1 = p1[0] - p0[0];
+  const float dy1 = p1[1] - p0[1];
+  const float dx2 = p2[0] - p0[0];
+  const float dy2 = p2[1] - p0[1];
+  const float det = dx1 * dy2 - dx2 * dy1;
+  if(fabsf(det) < 1e-6f) return FALSE;
+
+  ramp->a = ((f1 - f0) * dy2 - (f2 - f0) * dy1) / det;
+  ramp->b = ((f2 - f0) * dx1 - (f1 - f0) * dx2) / det;
+  ramp->c = f0 - ramp->a * p0[0] - ramp->b * p0[1];
+  return TRUE;
+}
+
+static inline float _path_ramp_value(const _path_ramp_t *const ramp,
+                                     const float x,
+                                     const float y)
+{
+  return ramp->a * x + ramp->b * y + ramp->c;
+}
+
+// the triangle of the feather with these corners and falloffs. FALSE if
+// it is degenerate or out of the roi
+static gboolean _path_ramp_init(_path_ramp_t *ramp,
+                                const float *const p0,
+                                const float *const p1,
+                                const float *const p2,
+                                const float f0,
+                                const float f1,
+                                const float f2,
+                                const int height)
+{
+  if(!_path_ramp_plane(ramp, p0, p1, p2, f0, f1, f2)) return FALSE;
+
+  ramp->x[0] = p0[0];
+  ramp->y[0] = p0[1];
+  ramp->x[1] = p1[0];
+  ramp->y[1] = p1[1];
+  ramp->x[2] = p2[0];
+  ramp->y[2] = p2[1];
+  ramp->ymin = MAX((int)ceilf(fminf(p0[1], fminf(p1[1], p2[1]))), 0);
+  ramp->ymax = MIN((int)floorf(fmaxf(p0[1], fmaxf(p1[1], p2[1]))), height - 1);
+  return ramp->ymin <= ramp->ymax;
+}
+
+// position along the segment from p0 to p1 of (x, y), -1 if it lies out
+// of the band from min to max pixels aside of it, counted positively
+// towards the side of the point 'side'
+static inline float _path_segment_position(const float *const p0,
+                                           const float *const p1,
+                                           const float *const side,
+                                           const float x,
+                                           const float y,
+                                           const float min,
+                                           const float max)
+{
+  const float dx = p1[0] - p0[0];
+  const float dy = p1[1] - p0[1];
+  const float l2 = dx * dx + dy * dy;
+  const float dot = (x - p0[0]) * dx + (y - p0[1]) * dy;
+  if(l2 == 0.0f || dot < 0.0f || dot > l2) return -1.0f;
+  const float sign = (side[0] - p0[0]) * dy - (side[1] - p0[1]) * dx < 0.0f ? -1.0f : 1.0f;
+  const float offset = sign * ((x - p0[0]) * dy - (y - p0[1]) * dx) / sqrtf(l2);
+  return offset >= min && offset <= max ? dot / l2 : -1.0f;
+}
+
+// twice the signed area of the triangle p0, p1, p2
+static inline float _path_orientation(const float *const p0,
+                                      const float *const p1,
+                                      const float *const p2)
+{
+  return (p1[0] - p0[0]) * (p2[1] - p0[1]) - (p1[1] - p0[1]) * (p2[0] - p0[0]);
+}
+
+// the falloff of the ramp where the segment from the path point p to the
+// border point b crosses the segment from d0 to d1, against the falloff
+// running from 1 to 0 along the segment from p to b
+static inline float _path_ramp_crossing_error(const _path_ramp_t *const ramp,
+                                              const float *const p,
+                                              const float *const b,
+                                              const float *const d0,
+                                              const float *const d1)
+{
+  const float ex = b[0] - p[0];
+  const float ey = b[1] - p[1];
+  const float gx = d1[0] - d0[0];
+  const float gy = d1[1] - d0[1];
+  const float den = ex * gy - ey * gx;
+  if(fabsf(den) < 1e-6f) return 0.0f;
+  const float wx = d0[0] - p[0];
+  const float wy = d0[1] - p[1];
+  const float s = (wx * gy - wy * gx) / den;
+  const float r = (wx * ey - wy * ex) / den;
+  if(s <= 0.0f || s >= 1.0f || r <= 0.0f || r >= 1.0f) return 0.0f;
+  return fabsf(_path_ramp_value(ramp, p[0] + s * ex, p[1] + s * ey) - (1.0f - s));
+}
+
+// the last pair of path and border points, after pair k, such that the
+// quadrangle they make with pair k holds the pairs in between: their
+// points lie on its sides, the path points not outside of the filled
+// path so that no pixel is left between them. The falloff of the two
+// triangles of the quadrangle is kept within 1/255 of the falloff of the
+// triangles between each pair: at the points of the pairs, and where the
+// diagonal of the quadrangle crosses the sides of these triangles, the
+// falloff of both being linear in between. The points of the paths being
+// dense, this saves most of the triangles along their smooth parts
+static int _path_ramp_extent(const float *const pairs,
+                             const int npairs,
+                             const int k)
+{
+  const float tolerance = 1.0f / 255.0f;
+  const float *const q0 = pairs + 4 * k;
+  int end = k + 1;
+  for(int j = k + 2; j <= MIN(k + 32, npairs); j++)
+  {
+    const float *const q1 = pairs + 4 * (j % npairs);
+    _path_ramp_t path_side, border_side;
+    if(!_path_ramp_plane(&path_side, q0, q1, q0 + 2, 1.0f, 1.0f, 0.0f)
+       || !_path_ramp_plane(&border_side, q1, q1 + 2, q0 + 2, 1.0f, 0.0f, 0.0f))
+      return end;
+    const float l2 = fmaxf(sqf(q1[0] - q0[0]) + sqf(q1[1] - q0[1]),
+                           sqf(q1[2] - q0[2]) + sqf(q1[3] - q0[3]));
+    for(int m = k + 1; m < j; m++)
+    {
+      const float *const q = pairs + 4 * m;
+      const float t = _path_segment_position(q0, q1, q0 + 2, q[0], q[1], -1e-3f, 0.25f);
+      const float u = _path_segment_position(q0 + 2, q1 + 2, q0, q[2], q[3], -0.25f, 0.25f);
+      if(t < 0.0f || u < 0.0f || sqf(t - u) * l2 > 0.25f
+         || fabsf(_path_ramp_value(&path_side, q[0], q[1]) - 1.0f) > tolerance
+         || fabsf(_path_ramp_value(&border_side, q[2], q[3])) > tolerance
+         || _path_ramp_crossing_error(&path_side, q, q + 2, q1, q0 + 2) > tolerance)
+        return end;
+    }
+    // where the feather folds over itself the triangles of the pairs
+    // turn over and are kept
+    const float turn = _path_orientation(q0, q1, q0 + 2);
+    for(int m = k; m < j; m++)
+    {
+      const float *const q = pairs + 4 * m;
+      const float *const next = pairs + 4 * ((m + 1) % npairs);
+      if(_path_orientation(q, next, q + 2) * turn <= 0.0f
+         || _path_orientation(next, next + 2, q + 2) * turn <= 0.0f
+         || _path_ramp_crossing_error(&path_side, next, q + 2, q1, q0 + 2) > tolerance)
+        return end;
+    }
+    end = j;
+  }
+  return end;
+}
+
+// the falloff of the triangle written into a row of the buffer, keeping
+// the larger values
+static inline void _path_ramp_row(const _path_ramp_t *const ramp,
+                                  float *const row,
+                                  const int y,
+                                  const int width)
+{
+  float xl = FLT_MAX;
+  float xr = -FLT_MAX;
+  for(int e = 0; e < 3; e++)
+  {
+    const int f = e == 2 ? 0 : e + 1;
+    const float y0 = ramp->y[e];
+    const float y1 = ramp->y[f];
+    if((y < y0 && y < y1) || (y > y0 && y > y1)) continue;
+    if(y0 == y1)
+    {
+      xl = fminf(xl, fminf(ramp->x[e], ramp->x[f]));
+      xr = fmaxf(xr, fmaxf(ramp->x[e], ramp->x[f]));
+    }
+    else
+    {
+      const float x = ramp->x[e] + (y - y0) * (ramp->x[f] - ramp->x[e]) / (y1 - y0);
+      xl = fminf(xl, x);
+      xr = fmaxf(xr, x);
+    }
+  }
+  // the neighbouring triangles share their edges
+  const int x0 = MAX((int)ceilf(xl - 1e-3f), 0);
+  const int x1 = MIN((int)floorf(xr + 1e-3f), width - 1);
+  const float c = ramp->b * y + ramp->c;
+  for(int x = x0; x <= x1; x++)
+    row[x] = fmaxf(row[x], CLIP(ramp->a * x + c));
+}
+
+// the feather between the path and its border: the quadrangles between
+// pairs of path and border points are split into two triangles, the
+// falloff running linearly from 1 on the path to 0 on the border. The
+// rows are written by bands of 32, each by a single thread
+static void _path_feather_roi(float *const buffer,
+                              const _path_ramp_t *const ramps,
+                              const int count,
+                              const int width,
+                              const int height)
+{
+  const int bands = (height + 31) / 32;
+  DT_OMP_PRAGMA(parallel for default(firstprivate) schedule(dynamic))
+  for(int band = 0; band < bands; band++)
+  {
+    const int ystart = band * 32;
+    const int yend = MIN(ystart + 32, height) - 1;
+    for(int k = 0; k < count; k++)
+    {
+      const _path_ramp_t *const ramp = ramps + k;
+      if(ramp->ymax < ystart || ramp->ymin > yend) continue;
+      for(int y = MAX(ramp->ymin, ystart); y <= MIN(ramp->ymax, yend); y++)
+        _path_ramp_row(ramp, buffer + (size_t)y * width, y, width);
+    }
+  }
+}
+
+// the falloff between the closed path and its border, given as pairs of
+// path and border points (px, py, bx, by)
+static gboolean _path_feather_pairs(float *const restrict buffer,
+                                    const float *const restrict pairs,
+                                    const int npairs,
+                                    const int width,
+                                    const int height)
+{
+  _path_ramp_t *ramps = dt_alloc_align_type(_path_ramp_t, (size_t)2 * MAX(npairs, 1));
+  if(ramps == NULL) return FALSE;
+
+  int nramps = 0;
+  for(int k = 0; k < npairs && npairs > 1;)
+  {
+    // the pairs in between lying on the quadrangle are skipped
+    const int end = _path_ramp_extent(pairs, npairs, k);
+    const float *const q0 = pairs + 4 * k;
+    const float *const q1 = pairs + 4 * (end % npairs);
+    nramps += _path_ramp_init(ramps + nramps, q0, q1, q0 + 2, 1.0f, 1.0f, 0.0f, height);
+    nramps += _path_ramp_init(ramps + nramps, q1, q1 + 2, q0 + 2, 1.0f, 0.0f, 0.0f, height);
+    k = end;
+  }
+
+  _path_feather_roi(buffer, ramps, nramps, width, height);
+
+  dt_free_align(ramps);
+  return TRUE;
 }
 
 // build a stamp which can be combined with other shapes in the same group
@@ -5168,71 +5517,19 @@ static int _path_get_mask_roi(const dt_iop_module_t *const module,
     {
       // all other cases
 
-      // edge-flag polygon fill: we write all the point around the path into the buffer
-      float xlast = cpoints[(points_count - 1) * 2];
-      float ylast = cpoints[(points_count - 1) * 2 + 1];
-
-      for(int i = _nb_wctrl_points(nb_corner); i < points_count; i++)
-      {
-        float xstart = xlast;
-        float ystart = ylast;
-
-        float xend = xlast = cpoints[i * 2];
-        float yend = ylast = cpoints[i * 2 + 1];
-
-        if(ystart > yend)
-        {
-          float tmp;
-          tmp = ystart, ystart = yend, yend = tmp;
-          tmp = xstart, xstart = xend, xend = tmp;
-        }
-
-        // we don't need special handling of ystart==yend
-        // as following loop will take care
-        const float m = (xstart - xend) / (ystart - yend);
-
-        for(int yy = (int)ceilf(ystart);
-            (float)yy < yend;
-            yy++) // this would normally never touch the last roi line
-                  // => see comment further above
-        {
-          const float xcross = xstart + m * (yy - ystart);
-
-          int xx = floorf(xcross);
-          if((float)xx + 0.5f <= xcross)
-            xx++;
-
-          if(xx < 0 || xx >= width || yy < 0 || yy >= height)
-            continue; // sanity check just to be on the safe side
-
-          const size_t index = (size_t)yy * width + xx;
-
-          buffer[index] = 1.0f - buffer[index];
-        }
-      }
-
-      dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
-               "[masks %s] path_fill draw path took %0.04f sec", form->name,
-               dt_get_lap_time(&start2));
-
-      // we fill the inside plain
       // we don't need to deal with parts of shape outside of roi
       const int xxmin = MAX(xmin, 0);
       const int xxmax = MIN(xmax, width - 1);
       const int yymin = MAX(ymin, 0);
       const int yymax = MIN(ymax, height - 1);
 
-      DT_OMP_FOR(num_threads(MIN(8, dt_get_num_threads())))
-      for(int yy = yymin; yy <= yymax; yy++)
+      if(!_path_fill_roi(buffer, cpoints, _nb_wctrl_points(nb_corner), points_count,
+                         width, height, xxmin, xxmax, yymin, yymax))
       {
-        int state = 0;
-        for(int xx = xxmin; xx <= xxmax; xx++)
-        {
-          const size_t index = (size_t)yy * width + xx;
-          const float v = buffer[index];
-          if(v > 0.5f) state = !state;
-          if(state) buffer[index] = 1.0f;
-        }
+        dt_free_align(cpoints);
+        dt_free_align(points);
+        dt_free_align(border);
+        return 0;
       }
 
       dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
@@ -5245,33 +5542,30 @@ static int _path_get_mask_roi(const dt_iop_module_t *const module,
   // deal with feather if it does not lie outside of roi
   if(!path_encircles_roi)
   {
-    int *dpoints = dt_alloc_align_int(4 * border_count);
-    if(dpoints == NULL)
+    // the pairs of path and border points, then the triangles between them
+    const int first = _nb_wctrl_points(nb_corner);
+    float *pairs = dt_alloc_align_float((size_t)4 * MAX(border_count - first, 1));
+    if(pairs == NULL)
     {
       dt_free_align(points);
       dt_free_align(border);
       return 0;
     }
 
-    int dindex = 0;
-    int p0[2], p1[2];
+    int npairs = 0;
     float pf1[2];
-    int last0[2] = { -100, -100 };
-    int last1[2] = { -100, -100 };
     int next = 0;
-    for(int i = _nb_wctrl_points(nb_corner); i < border_count; i++)
+    for(int i = first; i < border_count; i++)
     {
-      p0[0] = floorf(points[i * 2] + 0.5f);
-      p0[1] = ceilf(points[i * 2 + 1]);
       if(next > 0)
       {
-        p1[0] = pf1[0] = border[next * 2];
-        p1[1] = pf1[1] = border[next * 2 + 1];
+        pf1[0] = border[next * 2];
+        pf1[1] = border[next * 2 + 1];
       }
       else
       {
-        p1[0] = pf1[0] = border[i * 2];
-        p1[1] = pf1[1] = border[i * 2 + 1];
+        pf1[0] = border[i * 2];
+        pf1[1] = border[i * 2 + 1];
       }
 
       // now we check p1 value to know if we have to skip a part
@@ -5281,35 +5575,28 @@ static int _path_get_mask_roi(const dt_iop_module_t *const module,
         if(pf1[1] == DT_INVALID_COORDINATE)
           next = i - 1;
         else
-          next = p1[1];
-        p1[0] = pf1[0] = border[next * 2];
-        p1[1] = pf1[1] = border[next * 2 + 1];
+          next = (int)pf1[1];
+        pf1[0] = border[next * 2];
+        pf1[1] = border[next * 2 + 1];
       }
 
-      // and we draw the falloff
-      if(last0[0] != p0[0]
-         || last0[1] != p0[1]
-         || last1[0] != p1[0]
-         || last1[1] != p1[1])
-      {
-        dpoints[dindex] = p0[0];
-        dpoints[dindex + 1] = p0[1];
-        dpoints[dindex + 2] = p1[0];
-        dpoints[dindex + 3] = p1[1];
-        dindex += 4;
-
-        last0[0] = p0[0];
-        last0[1] = p0[1];
-        last1[0] = p1[0];
-        last1[1] = p1[1];
-      }
+      float *const pair = pairs + 4 * npairs;
+      pair[0] = points[i * 2];
+      pair[1] = points[i * 2 + 1];
+      pair[2] = pf1[0];
+      pair[3] = pf1[1];
+      if(npairs == 0 || memcmp(pair, pair - 4, sizeof(float) * 4))
+        npairs++;
     }
 
-    DT_OMP_FOR()
-    for(int n = 0; n < dindex; n += 4)
-      _path_falloff_roi(buffer, dpoints + n, dpoints + n + 2, width, height);
-
-    dt_free_align(dpoints);
+    const gboolean feathered = _path_feather_pairs(buffer, pairs, npairs, width, height);
+    dt_free_align(pairs);
+    if(!feathered)
+    {
+      dt_free_align(points);
+      dt_free_align(border);
+      return 0;
+    }
 
     dt_print(DT_DEBUG_MASKS | DT_DEBUG_PERF,
              "[masks %s] path_fill fill falloff took %0.04f sec", form->name,
@@ -22,6 +22,7 @@
 #include "common/opencl.h"
 #include "common/iop_order.h"
 #include "common/imagebuf.h"
+#include "common/interpolation.h"
 #include "control/control.h"
 #include "control/signal.h"
 #include "develop/blend.h"
@@ -540,6 +541,7 @@ void dt_dev_pixelpipe_create_nodes(dt_dev_pixelpipe_t *pipe,
     piece->hash = DT_INVALID_HASH;
     piece->process_cl_ready = FALSE;
     piece->process_tiling_ready = FALSE;
+    piece->distort_resample = DT_DEV_DISTORT_RESAMPLE_NONE;
     piece->raster_masks = g_hash_table_new_full(g_direct_hash,
                                                 g_direct_equal, NULL, dt_free_align_ptr);
     memset(&piece->processed_roi_in, 0, sizeof(piece->processed_roi_in));
@@ -1933,6 +1935,330 @@ static inline gboolean _dev_pixelpipe_early_exit(const dt_develop_t *dev,
       || (pipe->changed != DT_DEV_PIPE_UNCHANGED && pipe->changed != DT_DEV_PIPE_ZOOMED);
 }
 
+static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
+                                           dt_develop_t *dev,
+                                           void **output,
+                                           void **cl_mem_output,
+                                           dt_iop_buffer_dsc_t **out_format,
+                                           const dt_iop_roi_t *roi_out,
+                                           GList *modules,
+                                           GList *pieces,
+                                           const int pos);
+
+/* Single resampling of consecutive geometry modules.
+
+   Each of rotatepixels, ashift, flip, liquify ... interpolates its whole
+   input, a stack of them interpolates the image several times which costs
+   time and sharpness. A module whose process() only samples its input
+   along distort_backtransform() says so in commit_params via
+   piece->distort_resample, with the interpolator it uses. Consecutive such
+   pieces using the same interpolator are processed as one: the output
+   pixels are backtransformed through all of them to the input of the
+   first one and interpolated there once.
+
+   Pieces with blending or masks, histograms, color pickers, or the focus
+   of the gui are processed on their own and split the chain, as is
+   everything in OpenCL pipes where the pieces stay on the device.
+*/
+
+#define DT_DISTORT_CHAIN_MAX 16
+// points backtransformed at once, the modules are threaded over them
+#define DT_DISTORT_CHAIN_POINTS (1 << 20)
+
+static gboolean _distort_chain_member(dt_dev_pixelpipe_t *pipe,
+                                      dt_develop_t *dev,
+                                      dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_iop_module_t *module = piece->module;
+  return piece->distort_resample != DT_DEV_DISTORT_RESAMPLE_NONE
+    && module->distort_backtransform
+    && piece->colors == 4
+    && !_transform_for_blend(module, piece)
+    && !_piece_wants_blending(piece)
+    && !(module->flags() & (IOP_FLAGS_WRITE_RASTER | IOP_FLAGS_WRITE_DETAILS))
+    && !(piece->request_histogram & DT_REQUEST_ON)
+    && !dt_iop_has_focus(module)
+    && !_request_color_pick(pipe, dev, module);
+}
+
+// the pieces chained with the current one, last one first
+static int _distort_chain(dt_dev_pixelpipe_t *pipe,
+                          dt_develop_t *dev,
+                          GList *modules,
+                          GList *pieces,
+                          dt_dev_pixelpipe_iop_t **chain)
+{
+#ifdef HAVE_OPENCL
+  if(_opencl_pipe_isok(pipe)) return 0;
+#endif
+  if(dt_pipe_mask_display(pipe)) return 0;
+
+  int count = 0;
+  dt_iop_colorspace_type_t cst = IOP_CS_NONE;
+  dt_dev_distort_resample_t resample = DT_DEV_DISTORT_RESAMPLE_CENTER;
+  for(; modules && count < DT_DISTORT_CHAIN_MAX;
+      modules = g_list_previous(modules), pieces = g_list_previous(pieces))
+  {
+    dt_dev_pixelpipe_iop_t *piece = pieces->data;
+    if(_skip_piece_on_tags(piece)) continue;
+    if(!_distort_chain_member(pipe, dev, piece)) break;
+
+    // the input is converted once for the whole chain
+    const dt_iop_colorspace_type_t piece_cst =
+      piece->module->input_colorspace(piece->module, pipe, piece);
+    if(count && piece_cst != cst) break;
+    // the pieces must interpolate alike, pixel permutations fit any of them
+    if(piece->distort_resample != DT_DEV_DISTORT_RESAMPLE_CENTER)
+    {
+      if(resample != DT_DEV_DISTORT_RESAMPLE_CENTER && piece->distort_resample != resample)
+        break;
+      resample = piece->distort_resample;
+    }
+    cst = piece_cst;
+    chain[count++] = piece;
+  }
+  return count;
+}
+
+static void _distort_chain_shift(float *const restrict points,
+                                 const size_t count,
+                                 const float shift)
+{
+  DT_OMP_FOR_SIMD(aligned(points:64))
+  for(size_t k = 0; k < 2 * count; k++)
+    points[k] += shift;
+}
+
+// the interpolator the pieces would have used on their own
+static enum dt_interpolation_type _distort_chain_interpolation(dt_dev_pixelpipe_iop_t **chain,
+                                                               const int count)
+{
+  for(int k = 0; k < count; k++)
+    if(chain[k]->distort_resample == DT_DEV_DISTORT_RESAMPLE_SCALE)
+      return DT_INTERPOLATION_USERPREF;
+  return DT_INTERPOLATION_USERPREF_WARP;
+}
+
+static gboolean _distort_chain_resample(dt_dev_pixelpipe_iop_t **chain,
+                                        const int count,
+                                        const dt_interpolation_t *itor,
+                                        const dt_iop_roi_t *rois_in,
+                                        const dt_iop_roi_t *rois_out,
+                                        const float *const restrict input,
+                                        float *const restrict output)
+{
+  const dt_iop_roi_t *roi_out = &rois_out[0];
+  const dt_iop_roi_t *roi_in = &rois_in[count - 1];
+  const size_t width = roi_out->width;
+  const int rows = CLAMP(DT_DISTORT_CHAIN_POINTS / (int)width, 1, roi_out->height);
+
+  float *const restrict points = dt_alloc_align_float((size_t)2 * rows * width);
+  if(!points) return FALSE;
+
+  gboolean success = TRUE;
+  for(int first_row = 0; first_row < roi_out->height && success; first_row += rows)
+  {
+    const int nrows = MIN(rows, roi_out->height - first_row);
+    const size_t npoints = (size_t)nrows * width;
+
+    DT_OMP_FOR(collapse(2))
+    for(int j = 0; j < nrows; j++)
+      for(int i = 0; i < roi_out->width; i++)
+      {
+        float *const p = points + 2 * (j * width + i);
+        p[0] = (roi_out->x + i) / roi_out->scale;
+        p[1] = (roi_out->y + first_row + j) / roi_out->scale;
+      }
+
+    // from the output of the last module back to the input of the first one
+    for(int k = 0; k < count && success; k++)
+    {
+      dt_dev_pixelpipe_iop_t *piece = chain[k];
+      const gboolean center = piece->distort_resample == DT_DEV_DISTORT_RESAMPLE_CENTER;
+      if(center) _distort_chain_shift(points, npoints, 0.5f / rois_out[k].scale);
+      success = piece->module->distort_backtransform(piece->module, piece, points, npoints);
+      if(center) _distort_chain_shift(points, npoints, -0.5f / rois_in[k].scale);
+    }
+    if(!success) break;
+
+    DT_OMP_FOR(collapse(2))
+    for(int j = 0; j < nrows; j++)
+      for(int i = 0; i < roi_out->width; i++)
+      {
+        const float *const p = points + 2 * (j * width + i);
+        dt_interpolation_compute_pixel4c(itor, input,
+                                         output + 4 * ((first_row + j) * width + i),
+                                         p[0] * roi_in->scale - roi_in->x,
+                                         p[1] * roi_in->scale - roi_in->y,
+                                         roi_in->width, roi_in->height, 4 * roi_in->width);
+      }
+  }
+
+  dt_free_align(points);
+  return success;
+}
+
+// fallback if the points could not be backtransformed: one piece after the other
+static gboolean _distort_chain_sequential(dt_dev_pixelpipe_iop_t **chain,
+                                          const int count,
+                                          const dt_iop_roi_t *rois_in,
+                                          const dt_iop_roi_t *rois_out,
+                                          float *input,
+                                          float *output)
+{
+  float *in = input;
+  for(int k = count - 1; k >= 0; k--)
+  {
+    float *out = k ? dt_iop_image_alloc(rois_out[k].width, rois_out[k].height, 4) : output;
+    if(out)
+    {
+      dt_dev_pixelpipe_iop_t *piece = chain[k];
+      piece->module->process(piece->module, piece, in, out, &rois_in[k], &rois_out[k]);
+    }
+    if(in != input) dt_free_align(in);
+    if(!out) return FALSE;
+    in = out;
+  }
+  return TRUE;
+}
+
+// like _dev_pixelpipe_process_rec() for the chain ending at the current module
+static gboolean _dev_pixelpipe_process_chain(dt_dev_pixelpipe_t *pipe,
+                                             dt_develop_t *dev,
+                                             void **output,
+                                             dt_iop_buffer_dsc_t **out_format,
+                                             const dt_iop_roi_t *roi_out,
+                                             GList *modules,
+                                             GList *pieces,
+                                             const int pos,
+                                             dt_dev_pixelpipe_iop_t **chain,
+                                             const int count,
+                                             const dt_hash_t hash,
+                                             const size_t bufsize)
+{
+  dt_iop_module_t *module = chain[0]->module;
+
+  // regions of interest from the last piece to the first one
+  dt_iop_roi_t rois_in[DT_DISTORT_CHAIN_MAX], rois_out[DT_DISTORT_CHAIN_MAX];
+  dt_iop_roi_t roi = *roi_out;
+  int position = pos;
+  for(int k = 0; k < count;
+      modules = g_list_previous(modules), pieces = g_list_previous(pieces), position--)
+  {
+    dt_dev_pixelpipe_iop_t *piece = pieces->data;
+    if(piece != chain[k]) continue;
+
+    rois_out[k] = roi;
+    piece->module->modify_roi_in(piece->module, piece, &rois_out[k], &rois_in[k]);
+    piece->processed_roi_in = rois_in[k];
+    piece->processed_roi_out = rois_out[k];
+    piece->module->position = position;
+    roi = rois_in[k];
+    k++;
+  }
+
+  void *input = NULL;
+  void *cl_mem_input = NULL;
+  dt_iop_buffer_dsc_t _input_format = { 0 };
+  dt_iop_buffer_dsc_t *input_format = &_input_format;
+  if(_dev_pixelpipe_process_rec(pipe, dev, &input, &cl_mem_input, &input_format, &roi,
+                                modules, pieces, position))
+    return TRUE;
+
+#ifdef HAVE_OPENCL
+  // not expected as the chain is only used without OpenCL
+  if(cl_mem_input)
+  {
+    const cl_int err = _copy_image_to_host_err(pipe->devid, input, cl_mem_input,
+                                               roi.width, roi.height,
+                                               dt_iop_buffer_dsc_to_bpp(input_format),
+                                               "distort chain");
+    dt_opencl_release_mem_object(cl_mem_input);
+    if(err != CL_SUCCESS)
+    {
+      pipe->opencl_error = TRUE;
+      return TRUE;
+    }
+  }
+#endif
+
+  if(_pipe_has_shutdown(pipe))
+  {
+    dt_print_pipe(DT_DEBUG_PIPE, "pipe has shutdown",
+      pipe, module, DT_DEVICE_CPU, &roi, roi_out, "%s",
+      dt_dev_pixelpipe_shutdown_to_str(dt_atomic_get_int(&pipe->shutdown)));
+    return TRUE;
+  }
+
+  dt_times_t start;
+  dt_get_perf_times(&start);
+
+  // transform the input to the colorspace of the chain, keeping the cacheline
+  dt_dev_pixelpipe_iop_t *first = chain[count - 1];
+  const dt_iop_colorspace_type_t cst_to =
+    first->module->input_colorspace(first->module, pipe, first);
+  float *tmp = input;
+  if(input_format->cst != cst_to)
+  {
+    const dt_iop_order_iccprofile_info_t *const work_profile =
+      dt_ioppr_get_pipe_work_profile_info(pipe);
+    if(dt_pipe_is_screen(pipe))
+      tmp = dt_iop_image_alloc(roi.width, roi.height, 4);
+    if(tmp == NULL) tmp = input;
+    dt_iop_colorspace_type_t cst_tmp = input_format->cst;
+    dt_ioppr_transform_image_colorspace(first->module, input, tmp, roi.width, roi.height,
+                                        input_format->cst, cst_to, &cst_tmp, work_profile);
+    if(tmp == input)
+      dt_dev_pixelpipe_invalidate_cacheline(pipe, input, "inspace transform colorspace, no tmp");
+  }
+
+  // the formats as if the pieces had run one after the other
+  dt_iop_buffer_dsc_t dsc = *input_format;
+  dsc.cst = cst_to;
+  for(int k = count - 1; k >= 0; k--)
+  {
+    dt_dev_pixelpipe_iop_t *piece = chain[k];
+    piece->dsc_in = piece->dsc_out = dsc;
+    piece->module->output_format(piece->module, pipe, piece, &piece->dsc_out);
+    piece->dsc_out.cst = piece->module->output_colorspace(piece->module, pipe, piece);
+    dsc = piece->dsc_out;
+  }
+  **out_format = pipe->dsc = dsc;
+
+  const gboolean important_out = dt_pipe_is_screen(pipe)
+                                 && (module->flags() & IOP_FLAGS_WRITE_PIPECACHE);
+  dt_dev_pixelpipe_cache_get(pipe, hash, bufsize, output, out_format, module, important_out);
+
+  char names[256] = { 0 };
+  for(int k = count - 1; k >= 0; k--)
+  {
+    g_strlcat(names, chain[k]->module->op, sizeof(names));
+    if(k) g_strlcat(names, " ", sizeof(names));
+  }
+  dt_print_pipe(DT_DEBUG_PIPE, "process distort chain",
+                pipe, module, DT_DEVICE_CPU, &roi, roi_out, "%s", names);
+
+  const dt_interpolation_t *itor =
+    dt_interpolation_new(_distort_chain_interpolation(chain, count));
+  if(!_distort_chain_resample(chain, count, itor, rois_in, rois_out, tmp, *output)
+     && !_distort_chain_sequential(chain, count, rois_in, rois_out, tmp, *output))
+  {
+    dt_print_pipe(DT_DEBUG_ALWAYS, "distort chain failed",
+                  pipe, module, DT_DEVICE_CPU, &roi, roi_out, "%s", names);
+    memset(*output, 0, bufsize);
+    dt_dev_pixelpipe_invalidate_cacheline(pipe, *output, "distort chain failed");
+  }
+
+  if(tmp != input) dt_free_align(tmp);
+
+  if(_module_pipe_stop(pipe, module, *output) != DT_DEV_PIXELPIPE_STOP_NO)
+    return TRUE;
+
+  dt_show_times_f(&start, "[dev_pixelpipe]", "[%s] processed `%s' as one resampling on CPU",
+                  dt_dev_pixelpipe_type_to_str(pipe->type), names);
+  return FALSE;
+}
+
 // recursive helper for process, returns TRUE in case of unfinished work or error
 static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
                                            dt_develop_t *dev,
@@ -2178,6 +2504,13 @@ static gboolean _dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe,
     return FALSE;
   }
 
+  // 3a) consecutive geometry modules only resampling their input are interpolated once
+  dt_dev_pixelpipe_iop_t *chain[DT_DISTORT_CHAIN_MAX];
+  const int chained = _distort_chain(pipe, dev, modules, pieces, chain);
+  if(chained > 1)
+    return _dev_pixelpipe_process_chain(pipe, dev, output, out_format, roi_out,
+                                        modules, pieces, pos, chain, chained, hash, bufsize);
+
   // 3b) still recurse from end of list to first, obtain output array in &input
 
   // get region of interest which is needed in input
@@ -43,6 +43,19 @@ typedef struct dt_dev_distorted_mask_cache_t
   dt_hash_t src_hash; // hash of source data (e.g. threshold) for invalidation
 } dt_dev_distorted_mask_cache_t;
 
+/** how process() of a geometry module relates to its distort_backtransform(),
+ *  consecutive modules that only resample their input with the same
+ *  interpolator are interpolated once. */
+typedef enum dt_dev_distort_resample_t
+{
+  DT_DEV_DISTORT_RESAMPLE_NONE = 0, // process() does more than resampling, always run it
+  DT_DEV_DISTORT_RESAMPLE_WARP,     // input sampled at the backtransformed output pixel
+                                    // with DT_INTERPOLATION_USERPREF_WARP
+  DT_DEV_DISTORT_RESAMPLE_SCALE,    // same with DT_INTERPOLATION_USERPREF
+  DT_DEV_DISTORT_RESAMPLE_CENTER    // pixel centers mapped onto each other, for pixel
+                                    // permutations like flip, with any interpolator
+} dt_dev_distort_resample_t;
+
 typedef struct dt_dev_pixelpipe_iop_t
 {
   struct dt_iop_module_t *module;  // the module in the dev operation stack
@@ -68,6 +81,7 @@ typedef struct dt_dev_pixelpipe_iop_t
   dt_iop_roi_t processed_roi_out;
   gboolean process_cl_ready;      // set this to FALSE in commit_params to temporarily disable the use of process_cl
   gboolean process_tiling_ready;  // set this to FALSE in commit_params to temporarily disable tiling
+  dt_dev_distort_resample_t distort_resample; // set this in commit_params if process() only resamples
 
   // the following are used internally for caching:
   dt_iop_buffer_dsc_t dsc_in;
@@ -67,6 +67,11 @@
 #define LSD_DENSITY_TH 0.7                  // LSD: minimal density of region points in rectangle
 #define LSD_N_BINS 1024                     // LSD: number of bins in pseudo-ordering of gradient modulus
 #define LSD_GAMMA 0.45                      // gamma correction to apply on raw images prior to line detection
+#define LSD_MAX_PIXELS (2048 * 2048)        // LSD: larger images are halved until they fit prior to line detection
+#define LSD_TILE_SIZE 512                   // LSD: size of the tiles detected in parallel
+#define LSD_TILE_OVERLAP 32                 // LSD: margin of the tiles, so that the lines crossing a seam are seen by both tiles
+#define LSD_MERGE_DISTANCE 2.0              // LSD: maximum distance in pixels of the pieces of a line joined across a seam
+#define LSD_MERGE_ANGLE 2.0                 // LSD: maximum angle in degrees between the pieces of a line joined across a seam
 #define RANSAC_RUNS 400                     // how many iterations to run in ransac
 #define RANSAC_EPSILON 2                    // starting value for ransac epsilon (in -log10 units)
 #define RANSAC_EPSILON_STEP 1               // step size of epsilon optimization (log10 units)
@@ -1472,6 +1477,240 @@ static void gamma_correct(const float *const in,
   }
 }
 
+// LSD's logarithm of the number of tests on an image of this size,
+// see LineSegmentDetection()
+static double _lsd_log_nt(const int width,
+                          const int height)
+{
+  const double xsize = ceil(width * LSD_SCALE);
+  const double ysize = ceil(height * LSD_SCALE);
+  return 5.0 * (log10(xsize) + log10(ysize)) / 2.0 + log10(11.0);
+}
+
+// next level of the pyramid: the average of 2x2 pixels, the odd last
+// row and column are dropped
+static double *_lsd_downscale(const double *const in,
+                              const int width,
+                              const int height)
+{
+  const int wd = width / 2;
+  const int ht = height / 2;
+  double *out = malloc(sizeof(double) * wd * ht);
+  if(out == NULL) return NULL;
+
+  DT_OMP_FOR()
+  for(int j = 0; j < ht; j++)
+  {
+    const double *row0 = in + (size_t)2 * j * width;
+    const double *row1 = row0 + width;
+    for(int i = 0; i < wd; i++)
+      out[(size_t)j * wd + i] = 0.25 * (row0[2 * i] + row0[2 * i + 1]
+                                        + row1[2 * i] + row1[2 * i + 1]);
+  }
+  return out;
+}
+
+// joins b into a if both are collinear pieces of the same line, as
+// detected on either side of a seam between tiles. The 7 values of a
+// line are those returned by LSD
+static gboolean _lsd_merge(double *a,
+                           const double *b)
+{
+  const double la = hypot(a[2] - a[0], a[3] - a[1]);
+  const double lb = hypot(b[2] - b[0], b[3] - b[1]);
+  if(la < 1e-6 || lb < 1e-6) return FALSE;
+
+  const double cross = (a[2] - a[0]) * (b[3] - b[1]) - (a[3] - a[1]) * (b[2] - b[0]);
+  if(fabs(cross) > la * lb * sin(deg2rad(LSD_MERGE_ANGLE))) return FALSE;
+
+  // the longer piece is the reference, the other one has to lie on it
+  // and to overlap or touch it
+  const double *ref = la >= lb ? a : b;
+  const double *other = la >= lb ? b : a;
+  const double lref = MAX(la, lb);
+  const double ux = (ref[2] - ref[0]) / lref;
+  const double uy = (ref[3] - ref[1]) / lref;
+  const double d1 = -uy * (other[0] - ref[0]) + ux * (other[1] - ref[1]);
+  const double d2 = -uy * (other[2] - ref[0]) + ux * (other[3] - ref[1]);
+  if(fabs(d1) > LSD_MERGE_DISTANCE || fabs(d2) > LSD_MERGE_DISTANCE) return FALSE;
+
+  const double t1 = ux * (other[0] - ref[0]) + uy * (other[1] - ref[1]);
+  const double t2 = ux * (other[2] - ref[0]) + uy * (other[3] - ref[1]);
+  const double tmin = MIN(t1, t2);
+  const double tmax = MAX(t1, t2);
+  if(tmin > lref + LSD_MERGE_DISTANCE || tmax < -LSD_MERGE_DISTANCE) return FALSE;
+
+  const double start = MIN(tmin, 0.0);
+  const double end = MAX(tmax, lref);
+  const double x0 = ref[0];
+  const double y0 = ref[1];
+  const double width = (la * a[4] + lb * b[4]) / (la + lb);
+  const double p = (la * a[5] + lb * b[5]) / (la + lb);
+  a[0] = x0 + start * ux;
+  a[1] = y0 + start * uy;
+  a[2] = x0 + end * ux;
+  a[3] = y0 + end * uy;
+  a[4] = width;
+  a[5] = p;
+  a[6] = MAX(a[6], b[6]);
+  return TRUE;
+}
+
+// LSD run on overlapping tiles in parallel. Each line is kept by the tile
+// holding its middle and the pieces of the lines crossing the seams are
+// joined afterwards. The tiles are tested against the detection threshold
+// of the whole image. The tiles and their merge only depend on the size
+// of the image, so that the lines don't depend on the number of threads
+static double *_lsd_tiled(int *lines_count,
+                          double *greyscale,
+                          const int width,
+                          const int height)
+{
+  const int tiles_x = (width + LSD_TILE_SIZE - 1) / LSD_TILE_SIZE;
+  const int tiles_y = (height + LSD_TILE_SIZE - 1) / LSD_TILE_SIZE;
+  const int tiles = tiles_x * tiles_y;
+
+  if(tiles == 1)
+    return LineSegmentDetection(lines_count, greyscale, width, height,
+                                LSD_SCALE, LSD_SIGMA_SCALE, LSD_QUANT,
+                                LSD_ANG_TH, LSD_LOG_EPS, LSD_DENSITY_TH,
+                                LSD_N_BINS, NULL, NULL, NULL);
+
+  *lines_count = 0;
+  const double log_nt = _lsd_log_nt(width, height);
+  double **tile_lines = calloc(tiles, sizeof(double *));
+  int *tile_count = calloc(tiles, sizeof(int));
+  if(tile_lines == NULL || tile_count == NULL)
+  {
+    free(tile_lines);
+    free(tile_count);
+    return NULL;
+  }
+
+  DT_OMP_PRAGMA(parallel for default(firstprivate) schedule(dynamic))
+  for(int t = 0; t < tiles; t++)
+  {
+    const int tx = t % tiles_x;
+    const int ty = t / tiles_x;
+    const int x0 = MAX(tx * LSD_TILE_SIZE - LSD_TILE_OVERLAP, 0);
+    const int y0 = MAX(ty * LSD_TILE_SIZE - LSD_TILE_OVERLAP, 0);
+    const int x1 = MIN((tx + 1) * LSD_TILE_SIZE + LSD_TILE_OVERLAP, width);
+    const int y1 = MIN((ty + 1) * LSD_TILE_SIZE + LSD_TILE_OVERLAP, height);
+    const int wd = x1 - x0;
+    const int ht = y1 - y0;
+
+    double *tile = malloc(sizeof(double) * wd * ht);
+    if(tile == NULL) continue;
+    for(int j = 0; j < ht; j++)
+      memcpy(tile + (size_t)j * wd, greyscale + (size_t)(y0 + j) * width + x0,
+             sizeof(double) * wd);
+
+    // -log10(NFA) is larger by the difference of the numbers of tests
+    int count = 0;
+    double *lines = LineSegmentDetection(&count, tile, wd, ht,
+                                         LSD_SCALE, LSD_SIGMA_SCALE, LSD_QUANT,
+                                         LSD_ANG_TH, LSD_LOG_EPS + log_nt - _lsd_log_nt(wd, ht),
+                                         LSD_DENSITY_TH, LSD_N_BINS, NULL, NULL, NULL);
+    free(tile);
+
+    int kept = 0;
+    for(int n = 0; n < count; n++)
+    {
+      double *l = lines + 7 * n;
+      l[0] += x0;
+      l[1] += y0;
+      l[2] += x0;
+      l[3] += y0;
+      const int cx = CLAMP((int)floor(0.5 * (l[0] + l[2]) / LSD_TILE_SIZE), 0, tiles_x - 1);
+      const int cy = CLAMP((int)floor(0.5 * (l[1] + l[3]) / LSD_TILE_SIZE), 0, tiles_y - 1);
+      if(cx != tx || cy != ty) continue;
+      memmove(lines + 7 * kept, l, sizeof(double) * 7);
+      kept++;
+    }
+    tile_lines[t] = lines;
+    tile_count[t] = kept;
+  }
+
+  int total = 0;
+  for(int t = 0; t < tiles; t++) total += tile_count[t];
+
+  double *out = malloc(sizeof(double) * 7 * MAX(total, 1));
+  // the tile of each line, -1 once joined, and whether it reaches a seam
+  int *tile_of = malloc(sizeof(int) * MAX(total, 1));
+  gboolean *seam = malloc(sizeof(gboolean) * MAX(total, 1));
+  gboolean *joined = calloc(MAX(total, 1), sizeof(gboolean));
+  if(out == NULL || tile_of == NULL || seam == NULL || joined == NULL)
+  {
+    free(out);
+    out = NULL;
+    total = 0;
+  }
+
+  int k = 0;
+  for(int t = 0; t < tiles; t++)
+  {
+    if(out)
+    {
+      const double sx0 = (t % tiles_x) * LSD_TILE_SIZE;
+      const double sy0 = (t / tiles_x) * LSD_TILE_SIZE;
+      const double sx1 = sx0 + LSD_TILE_SIZE;
+      const double sy1 = sy0 + LSD_TILE_SIZE;
+      for(int n = 0; n < tile_count[t]; n++, k++)
+      {
+        const double *l = tile_lines[t] + 7 * n;
+        memcpy(out + 7 * k, l, sizeof(double) * 7);
+        tile_of[k] = t;
+        seam[k] = FALSE;
+        for(int e = 0; e < 4; e += 2)
+          seam[k] |= (sx0 > 0 && l[e] < sx0 + LSD_MERGE_DISTANCE)
+                     || (sx1 < width && l[e] > sx1 - LSD_MERGE_DISTANCE)
+                     || (sy0 > 0 && l[e + 1] < sy0 + LSD_MERGE_DISTANCE)
+                     || (sy1 < height && l[e + 1] > sy1 - LSD_MERGE_DISTANCE);
+      }
+    }
+    free(tile_lines[t]);
+  }
+  free(tile_lines);
+  free(tile_count);
+
+  // join the pieces of the lines, one of them at least reaching a seam
+  for(int i = 0; i < total; i++)
+  {
+    if(joined[i]) continue;
+    gboolean grown = TRUE;
+    while(grown)
+    {
+      grown = FALSE;
+      for(int j = 0; j < total; j++)
+      {
+        if(j == i || joined[j] || !(seam[i] || seam[j])) continue;
+        if(tile_of[i] == tile_of[j] && tile_of[i] >= 0) continue;
+        if(_lsd_merge(out + 7 * i, out + 7 * j))
+        {
+          joined[j] = TRUE;
+          tile_of[i] = -1;
+          seam[i] = TRUE;
+          grown = TRUE;
+        }
+      }
+    }
+  }
+
+  int count = 0;
+  for(int i = 0; i < total; i++)
+  {
+    if(joined[i]) continue;
+    memmove(out + 7 * count, out + 7 * i, sizeof(double) * 7);
+    count++;
+  }
+  free(tile_of);
+  free(seam);
+  free(joined);
+
+  *lines_count = count;
+  return out;
+}
+
 // do actual line_detection based on LSD algorithm and return results according
 // to this module's conventions
 static gboolean line_detect(float *in,
@@ -1523,15 +1762,42 @@ static gboolean line_detect(float *in,
     (void)edge_enhance(greyscale, greyscale, width, height);
   }
 
+  // large images are detected on a level of their pyramid
+  double *level = greyscale;
+  int level_width = width;
+  int level_height = height;
+  int factor = 1;
+  while((size_t)level_width * level_height > LSD_MAX_PIXELS)
+  {
+    double *half = _lsd_downscale(level, level_width, level_height);
+    if(level != greyscale) free(level);
+    if(half == NULL) goto error;
+    level = half;
+    level_width /= 2;
+    level_height /= 2;
+    factor *= 2;
+  }
+
   // call the line segment detector LSD;
   // LSD stores the number of found lines in lines_count.
   // it returns structural details as vector 'double lines[7 * lines_count]'
-  int lines_count;
+  int lines_count = 0;
 
-  lsd_lines = LineSegmentDetection(&lines_count, greyscale, width, height,
-                                   LSD_SCALE, LSD_SIGMA_SCALE, LSD_QUANT,
-                                   LSD_ANG_TH, LSD_LOG_EPS, LSD_DENSITY_TH,
-                                   LSD_N_BINS, NULL, NULL, NULL);
+  lsd_lines = _lsd_tiled(&lines_count, level, level_width, level_height);
+  if(level != greyscale) free(level);
+
+  // back to the coordinates of the image, the center of a pixel of the
+  // level is the center of the factor x factor pixels it averages
+  if(factor > 1)
+  {
+    const double offset = 0.5 * (factor - 1);
+    for(int n = 0; n < lines_count; n++)
+    {
+      for(int k = 0; k < 4; k++)
+        lsd_lines[n * 7 + k] = lsd_lines[n * 7 + k] * factor + offset;
+      lsd_lines[n * 7 + 4] *= factor;
+    }
+  }
 
   // we count the lines that we really want to use
   int lct = 0;
@@ -5631,6 +5897,10 @@ void commit_params(dt_iop_module_t *self,
     d->ct = p->ct;
     d->cb = p->cb;
   }
+
+  // process() of the preview pipe also collects the input for the fitting
+  if(!(self->gui_data && dt_pipe_is_preview(pipe)))
+    piece->distort_resample = DT_DEV_DISTORT_RESAMPLE_WARP;
 }
 
 void init_pipe(dt_iop_module_t *self,
@@ -25,6 +25,8 @@
  *      catch (unlikely) division by zero near line 2035
  *      rename rad1 and rad2 to radius1 and radius2 in reduce_region_radius()
  *        to avoid naming conflict in windows build
+ *      fill the table of inverse values once at startup, so that
+ *        LineSegmentDetection() can be run from several threads
  *
  */
 
@@ -1066,12 +1068,15 @@ static double log_gamma_windschitl(const double x)
 
 // clang-format on
 
-static double *inv = NULL; /* table to keep computed inverse values */
+static double *inv = NULL; /* table of the inverse values */
 
 __attribute__((constructor)) static void invConstructor()
 {
   if(inv) return;
   inv = malloc(sizeof(double) * TABSIZE);
+  if(inv == NULL) return;
+  inv[0] = 0.0;
+  for(int i = 1; i < TABSIZE; i++) inv[i] = 1.0 / (double) i;
 }
 
 __attribute__((destructor)) static void invDestructor()
@@ -1176,13 +1181,12 @@ static double nfa(const int n, const int k, const double p, const double logNT)
            term_i / term_i-1 = (n-i+1)/i * p/(1-p)
          and
            term_i = term_i-1 * (n-i+1)/i * p/(1-p).
-         1/i is stored in a table as they are computed,
+         1/i is read from a table filled at startup,
          because divisions are expensive.
          p/(1-p) is computed only once and stored in 'p_term'.
        */
-      bin_term = (double) (n-i+1) * ( i<TABSIZE ?
-                   ( inv[i]!=0.0 ? inv[i] : ( inv[i] = 1.0 / (double) i ) ) :
-                   1.0 / (double) i );
+      bin_term = (double) (n-i+1) * ( i<TABSIZE && inv != NULL ?
+                   inv[i] : 1.0 / (double) i );
 
       mult_term = bin_term * p_term;
       term *= mult_term;
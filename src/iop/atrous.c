@@ -21,6 +21,7 @@
 #include "common/eaw.h"
 #include "common/imagebuf.h"
 #include "common/opencl.h"
+#include "common/wavelets.h"
 #include "control/conf.h"
 #include "control/control.h"
 #include "develop/imageop.h"
@@ -270,6 +271,28 @@ static int get_scales(float (*thrs)[4],
   return MIN(max_scale_roi, i);
 }
 
+typedef struct _decompose_data_t
+{
+  float *out;
+  dt_aligned_pixel_t *thrs;
+  dt_aligned_pixel_t *boost;
+  const float *sharp;
+  int width;
+  int height;
+} _decompose_data_t;
+
+// immediately synthesize the detail scale into the final output so
+// that we don't need to store it past the current scale's iteration
+static void _decompose_scale(const float *const in,
+                             float *const LF,
+                             const int s,
+                             void *const data)
+{
+  const _decompose_data_t *const d = data;
+  eaw_decompose_and_synthesize(LF, in, d->out, s, d->sharp[s], d->thrs[s], d->boost[s],
+                               d->width, d->height);
+}
+
 /* just process the supplied image buffer, upstream
  * default_process_tiling() does the rest */
 static void process_wavelets(dt_iop_module_t *self,
@@ -298,8 +321,9 @@ static void process_wavelets(dt_iop_module_t *self,
   }
 
   // corner case of extremely small image. this is not really likely
-  // to happen but would lead to out of bounds memory access
-  if(width < 2 * max_mult || height < 2 * max_mult)
+  // to happen but would lead to out of bounds memory access. without
+  // any scale the output is the residue, the input itself
+  if(max_scale == 0 || width < 2 * max_mult || height < 2 * max_mult)
   {
     dt_iop_image_copy_by_size(o, i, width, height, 4);
     return;
@@ -315,27 +339,14 @@ static void process_wavelets(dt_iop_module_t *self,
     return;
   }
 
-  float *buf1 = (float *)i;
-  float *buf2 = tmp;
-
   // clear the output buffer, which will be accumulating all of the detail scales
   dt_iop_image_fill(out, 0.0f, width, height, 4);
 
-  // now do the wavelet decomposition, immediately synthesizing the
-  // detail scale into the final output so that we don't need to store
-  // it past the current scale's iteration
-  for(int scale = 0; scale < max_scale; scale++)
-  {
-    eaw_decompose_and_synthesize(buf2, buf1, out, scale, sharp[scale], thrs[scale],
-                                 boost[scale], width, height);
-    if(scale == 0) buf1 = (float *)tmp2; // now switch to second
-                                         // scratch for buffer
-                                         // ping-pong between buf1 and
-                                         // buf2
-    float *buf3 = buf2;
-    buf2 = buf1;
-    buf1 = buf3;
-  }
+  // now do the wavelet decomposition, ping-ponging between the two
+  // scratch buffers
+  _decompose_data_t decompose = { out, thrs, boost, sharp, width, height };
+  const float *const buf1 = dt_wavelet_decompose(i, tmp, tmp2, max_scale,
+                                                 _decompose_scale, &decompose);
 
   // add in the final residue
   DT_OMP_FOR_SIMD(aligned(buf1, out : 64) num_threads(MIN(dt_get_num_threads(),16)))
@@ -603,9 +614,18 @@ void tiling_callback(dt_iop_module_t *self,
   const int max_scale = get_scales(thrs, boost, sharp, d, roi_in, piece);
   const int max_filter_radius = 2 * (1 << max_scale); // 2 * 2^max_scale
 
-  tiling->factor = 4.0f;                // in + out + 2*tmp
+  // the cpu consumes each detail scale at once, the opencl code keeps
+  // them all
+  const size_t width = roi_out->width;
+  const size_t height = roi_out->height;
+  const size_t image_size = width * height * 4 * sizeof(float);
+  const float tmp = (float)dt_wavelet_lf_memory(width, height, 4) / image_size;
+  const float details = (float)dt_wavelet_bands_memory(width, height, 4, max_scale, FALSE,
+                                                       DT_WAVELET_STORAGE_FLOAT) / image_size;
+
+  tiling->factor = 2.0f + tmp;          // in + out + 2*tmp
   //  tiling->factor_cl = 5.0f; // in + out + details + 2*tmp - new flipping code
-  tiling->factor_cl = 3.0f + max_scale; // in + out + tmp + scale buffers
+  tiling->factor_cl = 3.0f + details;   // in + out + tmp + scale buffers
   tiling->maxbuf = 1.0f;
   tiling->maxbuf_cl = 1.0f;
   tiling->overhead = 0;
@@ -17,6 +17,7 @@
 */
 
 #include "bauhaus/bauhaus.h"
+#include "common/clut.h"
 #include "common/imagebuf.h"
 #include "common/iop_profile.h"
 #include "common/colormatrices.c"
@@ -92,6 +93,7 @@ typedef struct dt_iop_colorin_global_data_t
 {
   int kernel_colorin_unbound;
   int kernel_colorin_clipping;
+  dt_clut_icc_cache_t cluts;
 } dt_iop_colorin_global_data_t;
 
 typedef struct dt_iop_colorin_data_t
@@ -102,6 +104,7 @@ typedef struct dt_iop_colorin_data_t
   cmsHTRANSFORM *xform_cam_Lab;
   cmsHTRANSFORM *xform_cam_nrgb;
   cmsHTRANSFORM *xform_nrgb_Lab;
+  dt_clut_icc_t *clut; // the lcms2 transforms baked, if enabled
   float lut[3][LUT_SAMPLES];
   dt_colormatrix_t cmatrix;
   dt_colormatrix_t nmatrix;
@@ -479,6 +482,7 @@ void init_global(dt_iop_module_so_t *self)
   self->data = gd;
   gd->kernel_colorin_unbound = dt_opencl_create_kernel(program, "colorin_unbound");
   gd->kernel_colorin_clipping = dt_opencl_create_kernel(program, "colorin_clipping");
+  dt_clut_icc_cache_init(&gd->cluts);
 }
 
 void cleanup_global(dt_iop_module_so_t *self)
@@ -486,6 +490,7 @@ void cleanup_global(dt_iop_module_so_t *self)
   dt_iop_colorin_global_data_t *gd = self->data;
   dt_opencl_free_kernel(gd->kernel_colorin_unbound);
   dt_opencl_free_kernel(gd->kernel_colorin_clipping);
+  dt_clut_icc_cache_cleanup(&gd->cluts);
   free(self->data);
   self->data = NULL;
 }
@@ -1117,7 +1122,11 @@ static void process_lcms2_bm(dt_iop_module_t *self,
     }
 
     // convert to (L,a/L,b/L) to be able to change L without changing saturation.
-    if(!d->nrgb)
+    if(d->clut)
+    {
+      dt_clut_icc_apply(d->clut, out, out, width);
+    }
+    else if(!d->nrgb)
     {
       cmsDoTransform(d->xform_cam_Lab, out, out, width);
     }
@@ -1164,7 +1173,11 @@ static void process_lcms2_proper(dt_iop_module_t *self,
     float *out = (float *)ovoid + (size_t)4 * k * width;
 
     // convert to (L,a/L,b/L) to be able to change L without changing saturation.
-    if(!d->nrgb)
+    if(d->clut)
+    {
+      dt_clut_icc_apply(d->clut, in, out, width);
+    }
+    else if(!d->nrgb)
     {
       cmsDoTransform(d->xform_cam_Lab, in, out, width);
     }
@@ -1249,6 +1262,7 @@ void commit_params(dt_iop_module_t *self,
 {
   const dt_iop_colorin_params_t *p = (dt_iop_colorin_params_t *)p1;
   dt_iop_colorin_data_t *d = piece->data;
+  dt_iop_colorin_global_data_t *gd = self->global_data;
 
   d->type = p->type;
   d->type_work = p->type_work;
@@ -1306,6 +1320,8 @@ void commit_params(dt_iop_module_t *self,
     cmsDeleteTransform(d->xform_nrgb_Lab);
     d->xform_nrgb_Lab = NULL;
   }
+  dt_clut_icc_cache_release(&gd->cluts, d->clut);
+  d->clut = NULL;
 
   dt_mark_colormatrix_invalid(&d->cmatrix[0][0]);
   dt_mark_colormatrix_invalid(&d->nmatrix[0][0]);
@@ -1545,6 +1561,21 @@ void commit_params(dt_iop_module_t *self,
     }
   }
 
+  // bake the lcms2 fallback into a clut, XYZ input stays with lcms2
+  if(dt_conf_get_bool("plugins/lighttable/export/lcms2_clut")
+     && !dt_is_valid_colormatrix(d->cmatrix[0][0])
+     && cmsGetColorSpace(d->input) == cmsSigRgbData
+     && (d->nrgb ? d->xform_cam_nrgb && d->xform_nrgb_Lab : d->xform_cam_Lab != NULL))
+  {
+    dt_hash_t hash = dt_clut_icc_hash_profile(DT_INITHASH, d->input);
+    hash = dt_clut_icc_hash_profile(hash, d->nrgb);
+    hash = dt_hash(hash, &p->intent, sizeof(p->intent));
+    d->clut = d->nrgb
+      ? dt_clut_icc_cache_get(&gd->cluts, hash, DT_CLUT_ICC_RGB,
+                              d->xform_cam_nrgb, d->xform_nrgb_Lab)
+      : dt_clut_icc_cache_get(&gd->cluts, hash, DT_CLUT_ICC_RGB, d->xform_cam_Lab, NULL);
+  }
+
   d->nonlinearlut = FALSE;
 
   // now try to initialize unbounded mode:
@@ -1587,6 +1618,7 @@ void init_pipe(dt_iop_module_t *self,
   d->xform_cam_Lab = NULL;
   d->xform_cam_nrgb = NULL;
   d->xform_nrgb_Lab = NULL;
+  d->clut = NULL;
 }
 
 void cleanup_pipe(dt_iop_module_t *self,
@@ -1594,6 +1626,7 @@ void cleanup_pipe(dt_iop_module_t *self,
                   dt_dev_pixelpipe_iop_t *piece)
 {
   dt_iop_colorin_data_t *d = piece->data;
+  dt_iop_colorin_global_data_t *gd = self->global_data;
   if(d->input && d->clear_input) dt_colorspaces_cleanup_profile(d->input);
   if(d->xform_cam_Lab)
   {
@@ -1610,6 +1643,8 @@ void cleanup_pipe(dt_iop_module_t *self,
     cmsDeleteTransform(d->xform_nrgb_Lab);
     d->xform_nrgb_Lab = NULL;
   }
+  dt_clut_icc_cache_release(&gd->cluts, d->clut);
+  d->clut = NULL;
 
   free(piece->data);
   piece->data = NULL;
@@ -17,6 +17,7 @@
 */
 
 #include "bauhaus/bauhaus.h"
+#include "common/clut.h"
 #include "common/colorspaces.h"
 #include "common/colorspaces_inline_conversions.h"
 #include "common/dttypes.h"
@@ -52,12 +53,14 @@ typedef struct dt_iop_colorout_data_t
   float lut[3][LUT_SAMPLES];
   dt_colormatrix_t cmatrix;
   cmsHTRANSFORM *xform;
+  dt_clut_icc_t *clut; // xform baked, if enabled
   float unbounded_coeffs[3][3]; // for extrapolation of shaper curves
 } dt_iop_colorout_data_t;
 
 typedef struct dt_iop_colorout_global_data_t
 {
   int kernel_colorout;
+  dt_clut_icc_cache_t cluts;
 } dt_iop_colorout_global_data_t;
 
 typedef struct dt_iop_colorout_params_t
@@ -231,12 +234,14 @@ void init_global(dt_iop_module_so_t *self)
   dt_iop_colorout_global_data_t *gd = malloc(sizeof(dt_iop_colorout_global_data_t));
   self->data = gd;
   gd->kernel_colorout = dt_opencl_create_kernel(program, "colorout");
+  dt_clut_icc_cache_init(&gd->cluts);
 }
 
 void cleanup_global(dt_iop_module_so_t *self)
 {
   dt_iop_colorout_global_data_t *gd = self->data;
   dt_opencl_free_kernel(gd->kernel_colorout);
+  dt_clut_icc_cache_cleanup(&gd->cluts);
   free(self->data);
   self->data = NULL;
 }
@@ -500,7 +505,10 @@ static void _transform_lcms(const dt_iop_colorout_data_t *const d,
     size_t count = MIN(chunkstart + chunksize, npixels) - chunkstart;
     float *const outp = out + 4 * chunkstart;
 
-    cmsDoTransform(d->xform, in + 4*chunkstart, outp, count);
+    if(d->clut)
+      dt_clut_icc_apply(d->clut, in + 4*chunkstart, outp, count);
+    else
+      cmsDoTransform(d->xform, in + 4*chunkstart, outp, count);
 
     if(gamutcheck)
     {
@@ -549,6 +557,7 @@ void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_
 {
   dt_iop_colorout_params_t *p = (dt_iop_colorout_params_t *)p1;
   dt_iop_colorout_data_t *d = piece->data;
+  dt_iop_colorout_global_data_t *gd = self->global_data;
 
   d->type = p->type;
 
@@ -574,6 +583,8 @@ void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_
     cmsDeleteTransform(d->xform);
     d->xform = NULL;
   }
+  dt_clut_icc_cache_release(&gd->cluts, d->clut);
+  d->clut = NULL;
   dt_mark_colormatrix_invalid(&d->cmatrix[0][0]);
   d->lut[0][0] = -1.0f;
   d->lut[1][0] = -1.0f;
@@ -733,9 +744,23 @@ void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_
     }
   }
 
+  // bake the transform into a clut, softproofing and gamut check stay with lcms2
+  const gboolean bake = d->xform && d->mode == DT_PROFILE_NORMAL
+                        && dt_conf_get_bool("plugins/lighttable/export/lcms2_clut");
+  dt_hash_t clut_hash = DT_INITHASH;
+  if(bake)
+  {
+    clut_hash = dt_clut_icc_hash_profile(clut_hash, output);
+    clut_hash = dt_hash(clut_hash, &out_intent, sizeof(out_intent));
+    clut_hash = dt_hash(clut_hash, &output_format, sizeof(output_format));
+  }
+
   if(out_type == DT_COLORSPACE_DISPLAY || out_type == DT_COLORSPACE_DISPLAY2)
     pthread_rwlock_unlock(&darktable.color_profiles->xprofile_lock);
 
+  if(bake)
+    d->clut = dt_clut_icc_cache_get(&gd->cluts, clut_hash, DT_CLUT_ICC_LAB, d->xform, NULL);
+
   // now try to initialize unbounded mode:
   // we do extrapolation for input values above 1.0f.
   // unfortunately we can only do this if we got the computation
@@ -767,16 +792,20 @@ void init_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe
   piece->data = calloc(1, sizeof(dt_iop_colorout_data_t));
   dt_iop_colorout_data_t *d = piece->data;
   d->xform = NULL;
+  d->clut = NULL;
 }
 
 void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
   dt_iop_colorout_data_t *d = piece->data;
+  dt_iop_colorout_global_data_t *gd = self->global_data;
   if(d->xform)
   {
     cmsDeleteTransform(d->xform);
     d->xform = NULL;
   }
+  dt_clut_icc_cache_release(&gd->cluts, d->clut);
+  d->clut = NULL;
 
   free(piece->data);
   piece->data = NULL;
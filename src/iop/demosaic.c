@@ -18,6 +18,7 @@
 
 #include "bauhaus/bauhaus.h"
 #include "common/colorspaces.h"
+#include "common/cpu_dispatch.h"
 #include "common/darktable.h"
 #include "common/interpolation.h"
 #include "common/opencl.h"
@@ -294,6 +295,7 @@ void amaze_demosaic(const float *const in,
                     const uint32_t filters,
                     const float procmin);
 
+#include "iop/demosaicing/tiles.h"
 #include "iop/demosaicing/basics.c"
 #include "iop/demosaicing/vng.c"
 #include "iop/demosaicing/xtrans.c"
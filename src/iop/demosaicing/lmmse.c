@@ -58,7 +58,6 @@
 #define LMMSE_OVERLAP 8
 #define BORDER_AROUND 4
 #define LMMSE_TILE_INT (DT_LMMSE_TILESIZE - 2 * BORDER_AROUND)
-#define LMMSE_TILEVALID (LMMSE_TILE_INT - 2 * LMMSE_OVERLAP)
 #define w1 (DT_LMMSE_TILESIZE)
 #define w2 (DT_LMMSE_TILESIZE * 2)
 #define w3 (DT_LMMSE_TILESIZE * 3)
@@ -149,8 +148,9 @@ static void lmmse_demosaic(float *const restrict out,
   const int refine = (mode > DT_LMMSE_REFINE_2) ? mode - 2 : 0;
   const float revscaler = 1.0f / scaler;
 
-  const int num_vertical =   1 + (height - 2 * LMMSE_OVERLAP -1) / LMMSE_TILEVALID;
-  const int num_horizontal = 1 + (width  - 2 * LMMSE_OVERLAP -1) / LMMSE_TILEVALID;
+  dt_demosaic_tiles_t tiles = dt_demosaic_tiles_init("lmmse", width, height, LMMSE_TILE_INT, LMMSE_OVERLAP, 0);
+  const int num_vertical = tiles.num_vertical;
+  const int num_horizontal = tiles.num_horizontal;
   DT_OMP_PRAGMA(parallel firstprivate(width, height, out, in, scaler, revscaler, filters))
   {
     float *qix[6];
@@ -168,10 +168,11 @@ static void lmmse_demosaic(float *const restrict out,
     {
       for(int tile_horizontal = 0; tile_horizontal < num_horizontal; tile_horizontal++)
       {
-        const int rowStart = tile_vertical * LMMSE_TILEVALID;
+        const double tile_begin = dt_demosaic_tile_begin(&tiles);
+        const int rowStart = dt_demosaic_tile_start(&tiles, tile_vertical);
         const int rowEnd = MIN(rowStart + LMMSE_TILE_INT, height);
 
-        const int colStart = tile_horizontal * LMMSE_TILEVALID;
+        const int colStart = dt_demosaic_tile_start(&tiles, tile_horizontal);
         const int colEnd = MIN(colStart + LMMSE_TILE_INT, width);
 
         const int tileRows = MIN(rowEnd - rowStart, LMMSE_TILE_INT);
@@ -563,10 +564,12 @@ static void lmmse_demosaic(float *const restrict out,
             dest[3] = 0.0f;
           }
         }
+        dt_demosaic_tile_end(&tiles, tile_begin);
       }
     }
     dt_free_align(buffer);
   }
+  dt_demosaic_tiles_cleanup(&tiles);
 }
 
 // revert specific aggressive optimizing
@@ -577,7 +580,6 @@ static void lmmse_demosaic(float *const restrict out,
 #undef LMMSE_TILE_INT
 #undef LMMSE_OVERLAP
 #undef BORDER_AROUND
-#undef LMMSE_TILEVALID
 #undef w1
 #undef w2
 #undef w3
@@ -0,0 +1,147 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/darktable.h"
+
+#include <float.h>
+
+G_BEGIN_DECLS
+
+/* Tile grid of the cpu demosaicers doing internal tiling (rcd, lmmse
+   and amaze).
+
+   Tile n starts at origin + n * step and covers size pixels, the first
+   and last overlap pixels of an inner tile side are read but not written,
+   so step = size - 2 * overlap. origin is negative for the algorithms
+   padding the image with a mirrored border of -origin pixels on each
+   side. The grid is the smallest one whose last tile reaches the end of
+   the padded image, a tile starting past it would not write anything.
+
+   The tile sizes stay compile time constants (see DT_RCD_TILESIZE and
+   friends in common/darktable.h), the inner loops depend on it.
+
+   With -d perf the time spent in the tiles is collected per thread and
+   reported by dt_demosaic_tiles_cleanup(), a large spread between the
+   threads means the grid is too coarse for the image.
+*/
+
+typedef struct dt_demosaic_tile_stats_t
+{
+  double busy;
+  int tiles;
+} __attribute__((aligned(DT_CACHELINE_BYTES))) dt_demosaic_tile_stats_t;
+
+typedef struct dt_demosaic_tiles_t
+{
+  const char *name;
+  int size;
+  int overlap;
+  int step;
+  int origin;
+  int num_vertical;
+  int num_horizontal;
+  double start;
+  dt_demosaic_tile_stats_t *stats; // per thread, only with -d perf
+} dt_demosaic_tiles_t;
+
+static inline int _demosaic_tiles_count(const int extent,
+                                        const int size,
+                                        const int step,
+                                        const int origin)
+{
+  const int beyond = extent - 2 * origin - size;
+  return beyond > 0 ? 1 + (beyond + step - 1) / step : 1;
+}
+
+static inline dt_demosaic_tiles_t dt_demosaic_tiles_init(const char *name,
+                                                         const int width,
+                                                         const int height,
+                                                         const int size,
+                                                         const int overlap,
+                                                         const int origin)
+{
+  dt_demosaic_tiles_t t;
+  t.name = name;
+  t.size = size;
+  t.overlap = overlap;
+  t.step = size - 2 * overlap;
+  t.origin = origin;
+  t.num_vertical = _demosaic_tiles_count(height, size, t.step, origin);
+  t.num_horizontal = _demosaic_tiles_count(width, size, t.step, origin);
+  t.start = 0.0;
+  t.stats = NULL;
+  if(darktable.unmuted & DT_DEBUG_PERF)
+  {
+    t.stats = dt_calloc_align_type(dt_demosaic_tile_stats_t, dt_get_num_threads());
+    t.start = dt_get_wtime();
+  }
+  return t;
+}
+
+// first row or column of tile n
+static inline int dt_demosaic_tile_start(const dt_demosaic_tiles_t *t,
+                                         const int n)
+{
+  return t->origin + n * t->step;
+}
+
+static inline double dt_demosaic_tile_begin(const dt_demosaic_tiles_t *t)
+{
+  return t->stats ? dt_get_wtime() : 0.0;
+}
+
+static inline void dt_demosaic_tile_end(const dt_demosaic_tiles_t *t,
+                                        const double begin)
+{
+  if(!t->stats) return;
+  dt_demosaic_tile_stats_t *s = t->stats + dt_get_thread_num();
+  s->busy += dt_get_wtime() - begin;
+  s->tiles++;
+}
+
+static inline void dt_demosaic_tiles_cleanup(dt_demosaic_tiles_t *t)
+{
+  if(!t->stats) return;
+
+  double min_busy = DBL_MAX;
+  double max_busy = 0.0;
+  int threads = 0;
+  for(size_t k = 0; k < dt_get_num_threads(); k++)
+  {
+    if(!t->stats[k].tiles) continue;
+    min_busy = MIN(min_busy, t->stats[k].busy);
+    max_busy = MAX(max_busy, t->stats[k].busy);
+    threads++;
+  }
+  dt_print(DT_DEBUG_PERF,
+           "[demosaic %s] %dx%d tiles of %d px in %.3fs, %d threads busy %.3fs .. %.3fs",
+           t->name, t->num_horizontal, t->num_vertical, t->size,
+           dt_get_wtime() - t->start, threads, threads ? min_busy : 0.0, max_busy);
+  dt_free_align(t->stats);
+  t->stats = NULL;
+}
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
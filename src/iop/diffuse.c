@@ -27,6 +27,7 @@
 #include "common/imagebuf.h"
 #include "common/iop_profile.h"
 #include "common/opencl.h"
+#include "control/conf.h"
 #include "control/control.h"
 #include "develop/develop.h"
 #include "develop/imageop_gui.h"
@@ -774,6 +775,19 @@ void init_presets(dt_iop_module_so_t *self)
                              DEVELOP_BLEND_CS_RGB_SCENE);
 }
 
+// full size images needed besides the wavelets low frequencies and
+// details, see tiling_callback()
+#define DIFFUSE_BUFFERS 4.25f
+
+// the storage of the wavelets details on the cpu is a preference, the
+// tiling takes over when they don't fit in memory
+static inline dt_wavelet_storage_t _bands_storage(void)
+{
+  return dt_conf_get_bool("plugins/darkroom/diffuse/half_float_scales")
+    ? DT_WAVELET_STORAGE_HALF
+    : DT_WAVELET_STORAGE_FLOAT;
+}
+
 void tiling_callback(dt_iop_module_t *self,
                      dt_dev_pixelpipe_iop_t *piece,
                      const dt_iop_roi_t *roi_in,
@@ -789,9 +803,16 @@ void tiling_callback(dt_iop_module_t *self,
   const int scales = CLAMP(diffusion_scales, 1, MAX_NUM_SCALES);
   const int max_filter_radius = (1 << scales);
 
-  // in + out + 2 * tmp + 2 * LF + s details + grey mask
-  tiling->factor = 6.25f + scales;
-  tiling->factor_cl = 6.25f + scales;
+  // in + out + 2 * tmp + grey mask, 2 * LF, and the s details which
+  // can be stored as half floats on the cpu
+  const size_t width = roi_out->width;
+  const size_t height = roi_out->height;
+  const size_t image_size = width * height * 4 * sizeof(float);
+  const size_t lf_size = dt_wavelet_lf_memory(width, height, 4);
+  const dt_wavelet_storage_t storage = _bands_storage();
+  tiling->factor = DIFFUSE_BUFFERS + (float)lf_size / image_size
+    + (float)dt_wavelet_bands_memory(width, height, 4, scales, FALSE, storage) / image_size;
+  tiling->factor_cl = DIFFUSE_BUFFERS + (float)lf_size / image_size + scales;
 
   tiling->maxbuf = 1.0f;
   tiling->maxbuf_cl = 1.0f;
@@ -946,7 +967,20 @@ static inline void compute_kernel(const dt_aligned_pixel_t c2,
   }
 }
 
-static inline void heat_PDE_diffusion(const float *const restrict high_freq,
+DT_OMP_DECLARE_SIMD(aligned(kern, pixels, derivative:64))
+static inline void convolve_kernel(const dt_aligned_pixel_t kern[9],
+                                   const dt_aligned_pixel_t pixels[9],
+                                   dt_aligned_pixel_t derivative)
+{
+  for(size_t k = 0; k < 9; k++)
+  {
+    for_each_channel(c, aligned(kern, pixels, derivative))
+      derivative[c] += kern[k][c] * pixels[k][c];
+  }
+}
+
+static inline void heat_PDE_diffusion(const void *const restrict high_freq,
+                                      const dt_wavelet_storage_t storage,
                                       const float *const restrict low_freq,
                                       const uint8_t *const restrict mask,
                                       const gboolean has_mask,
@@ -979,9 +1013,20 @@ static inline void heat_PDE_diffusion(const float *const restrict high_freq,
 
   float *const restrict out = DT_IS_ALIGNED(output);
   const float *const restrict LF = DT_IS_ALIGNED(low_freq);
-  const float *const restrict HF = DT_IS_ALIGNED(high_freq);
 
   const float regularization_factor = regularization * current_radius_square / 9.f;
+
+  // an order with a zero speed doesn't change the update, skip its
+  // kernel, and the direction of the gradient or of the laplacian when
+  // no anisotropic kernel needs it
+  const gboolean order[4] = { ABCD[0] != 0.f, ABCD[1] != 0.f, ABCD[2] != 0.f, ABCD[3] != 0.f };
+  const gboolean gradient_direction =
+    (order[0] && isotropy_type[0] != DT_ISOTROPY_ISOTROPE)
+    || (order[2] && isotropy_type[2] != DT_ISOTROPY_ISOTROPE);
+  const gboolean laplacian_direction =
+    (order[1] && isotropy_type[1] != DT_ISOTROPY_ISOTROPE)
+    || (order[3] && isotropy_type[3] != DT_ISOTROPY_ISOTROPE);
+
   DT_OMP_FOR()
   for(size_t row = 0; row < height; ++row)
   {
@@ -1014,98 +1059,108 @@ static inline void heat_PDE_diffusion(const float *const restrict high_freq,
           for(size_t jj = 0; jj < 3; jj++)
           {
             size_t neighbor = 4 * (i_neighbours[ii] + j_neighbours[jj]);
+            dt_wavelet_band_load(high_freq, storage, neighbor, neighbour_pixel_HF[3 * ii + jj]);
             for_each_channel(c)
-            {
-              neighbour_pixel_HF[3 * ii + jj][c] = HF[neighbor + c];
               neighbour_pixel_LF[3 * ii + jj][c] = LF[neighbor + c];
-            }
           }
 
         // c² in https://www.researchgate.net/publication/220663968
-        dt_aligned_pixel_t c2[4];
+        dt_aligned_pixel_t c2[4] = { { 0.f } };
         // build the local anisotropic convolution filters for gradients and laplacians
         dt_aligned_pixel_t gradient[2], laplacian[2]; // x, y for each channel
-        find_gradients(neighbour_pixel_LF, gradient);
-        find_gradients(neighbour_pixel_HF, laplacian);
 
-        dt_aligned_pixel_t cos_theta_grad_sq;
-        dt_aligned_pixel_t sin_theta_grad_sq;
-        dt_aligned_pixel_t cos_theta_sin_theta_grad;
-        for_each_channel(c)
+        dt_aligned_pixel_t cos_theta_grad_sq = { 0.f };
+        dt_aligned_pixel_t sin_theta_grad_sq = { 0.f };
+        dt_aligned_pixel_t cos_theta_sin_theta_grad = { 0.f };
+        if(gradient_direction)
         {
-          float magnitude_grad = sqrtf(sqf(gradient[0][c]) + sqf(gradient[1][c]));
-          c2[0][c] = -magnitude_grad * anisotropy[0];
-          c2[2][c] = -magnitude_grad * anisotropy[2];
-          // Compute cos(arg(grad)) = dx / hypot - force arg(grad) = 0 if hypot == 0
-          gradient[0][c] = (magnitude_grad != 0.f)
-            ? gradient[0][c] / magnitude_grad
-            : 1.f; // cos(0)
-          // Compute sin (arg(grad))= dy / hypot - force arg(grad) = 0 if hypot == 0
-          gradient[1][c] = (magnitude_grad != 0.f)
-            ? gradient[1][c] / magnitude_grad
-            : 0.f; // sin(0)
-          // Warning : now gradient = { cos(arg(grad)) , sin(arg(grad)) }
-          cos_theta_grad_sq[c] = sqf(gradient[0][c]);
-          sin_theta_grad_sq[c] = sqf(gradient[1][c]);
-          cos_theta_sin_theta_grad[c] = gradient[0][c] * gradient[1][c];
+          find_gradients(neighbour_pixel_LF, gradient);
+          for_each_channel(c)
+          {
+            float magnitude_grad = sqrtf(sqf(gradient[0][c]) + sqf(gradient[1][c]));
+            c2[0][c] = -magnitude_grad * anisotropy[0];
+            c2[2][c] = -magnitude_grad * anisotropy[2];
+            // Compute cos(arg(grad)) = dx / hypot - force arg(grad) = 0 if hypot == 0
+            gradient[0][c] = (magnitude_grad != 0.f)
+              ? gradient[0][c] / magnitude_grad
+              : 1.f; // cos(0)
+            // Compute sin (arg(grad))= dy / hypot - force arg(grad) = 0 if hypot == 0
+            gradient[1][c] = (magnitude_grad != 0.f)
+              ? gradient[1][c] / magnitude_grad
+              : 0.f; // sin(0)
+            // Warning : now gradient = { cos(arg(grad)) , sin(arg(grad)) }
+            cos_theta_grad_sq[c] = sqf(gradient[0][c]);
+            sin_theta_grad_sq[c] = sqf(gradient[1][c]);
+            cos_theta_sin_theta_grad[c] = gradient[0][c] * gradient[1][c];
+          }
+          // elements of c2 need to be expf(mag*anistropy), but we
+          // haven't applied the expf() yet.  Do that now.
+          dt_vector_exp(c2[0], c2[0]);
+          dt_vector_exp(c2[2], c2[2]);
         }
 
-        dt_aligned_pixel_t cos_theta_lapl_sq;
-        dt_aligned_pixel_t sin_theta_lapl_sq;
-        dt_aligned_pixel_t cos_theta_sin_theta_lapl;
-        for_each_channel(c)
+        dt_aligned_pixel_t cos_theta_lapl_sq = { 0.f };
+        dt_aligned_pixel_t sin_theta_lapl_sq = { 0.f };
+        dt_aligned_pixel_t cos_theta_sin_theta_lapl = { 0.f };
+        if(laplacian_direction)
         {
-          float magnitude_lapl = sqrtf(sqf(laplacian[0][c]) + sqf(laplacian[1][c]));
-          c2[1][c] = -magnitude_lapl * anisotropy[1];
-          c2[3][c] = -magnitude_lapl * anisotropy[3];
-          // Compute cos(arg(lapl)) = dx / hypot - force arg(lapl) = 0 if hypot == 0
-          laplacian[0][c] = (magnitude_lapl != 0.f)
-            ? laplacian[0][c] / magnitude_lapl
-            : 1.f; // cos(0)
-          // Compute sin (arg(lapl))= dy / hypot - force arg(lapl) = 0 if hypot == 0
-          laplacian[1][c] = (magnitude_lapl != 0.f)
-            ? laplacian[1][c] / magnitude_lapl
-            : 0.f; // sin(0)
-          // Warning : now laplacian = { cos(arg(lapl)) , sin(arg(lapl)) }
-          cos_theta_lapl_sq[c] = sqf(laplacian[0][c]);
-          sin_theta_lapl_sq[c] = sqf(laplacian[1][c]);
-          cos_theta_sin_theta_lapl[c] = laplacian[0][c] * laplacian[1][c];
+          find_gradients(neighbour_pixel_HF, laplacian);
+          for_each_channel(c)
+          {
+            float magnitude_lapl = sqrtf(sqf(laplacian[0][c]) + sqf(laplacian[1][c]));
+            c2[1][c] = -magnitude_lapl * anisotropy[1];
+            c2[3][c] = -magnitude_lapl * anisotropy[3];
+            // Compute cos(arg(lapl)) = dx / hypot - force arg(lapl) = 0 if hypot == 0
+            laplacian[0][c] = (magnitude_lapl != 0.f)
+              ? laplacian[0][c] / magnitude_lapl
+              : 1.f; // cos(0)
+            // Compute sin (arg(lapl))= dy / hypot - force arg(lapl) = 0 if hypot == 0
+            laplacian[1][c] = (magnitude_lapl != 0.f)
+              ? laplacian[1][c] / magnitude_lapl
+              : 0.f; // sin(0)
+            // Warning : now laplacian = { cos(arg(lapl)) , sin(arg(lapl)) }
+            cos_theta_lapl_sq[c] = sqf(laplacian[0][c]);
+            sin_theta_lapl_sq[c] = sqf(laplacian[1][c]);
+            cos_theta_sin_theta_lapl[c] = laplacian[0][c] * laplacian[1][c];
+          }
+          dt_vector_exp(c2[1], c2[1]);
+          dt_vector_exp(c2[3], c2[3]);
         }
 
-        // elements of c2 need to be expf(mag*anistropy), but we
-        // haven't applied the expf() yet.  Do that now.
-        for(size_t k = 0; k < 4; k++)
+        // convolve filters
+        dt_aligned_pixel_t derivatives[4] = { { 0.f } };
+        dt_aligned_pixel_t kern[9];
+        if(order[0])
         {
-          dt_vector_exp(c2[k], c2[k]);
+          compute_kernel(c2[0], cos_theta_sin_theta_grad, cos_theta_grad_sq,
+                         sin_theta_grad_sq, isotropy_type[0], kern);
+          convolve_kernel(kern, neighbour_pixel_LF, derivatives[0]);
+        }
+        if(order[1])
+        {
+          compute_kernel(c2[1], cos_theta_sin_theta_lapl, cos_theta_lapl_sq,
+                         sin_theta_lapl_sq, isotropy_type[1], kern);
+          convolve_kernel(kern, neighbour_pixel_LF, derivatives[1]);
+        }
+        if(order[2])
+        {
+          compute_kernel(c2[2], cos_theta_sin_theta_grad, cos_theta_grad_sq,
+                         sin_theta_grad_sq, isotropy_type[2], kern);
+          convolve_kernel(kern, neighbour_pixel_HF, derivatives[2]);
+        }
+        if(order[3])
+        {
+          compute_kernel(c2[3], cos_theta_sin_theta_lapl, cos_theta_lapl_sq,
+                         sin_theta_lapl_sq, isotropy_type[3], kern);
+          convolve_kernel(kern, neighbour_pixel_HF, derivatives[3]);
         }
 
-        dt_aligned_pixel_t kern_first[9], kern_second[9], kern_third[9], kern_fourth[9];
-        compute_kernel(c2[0], cos_theta_sin_theta_grad, cos_theta_grad_sq,
-                       sin_theta_grad_sq, isotropy_type[0],
-                       kern_first);
-        compute_kernel(c2[1], cos_theta_sin_theta_lapl, cos_theta_lapl_sq,
-                       sin_theta_lapl_sq, isotropy_type[1],
-                       kern_second);
-        compute_kernel(c2[2], cos_theta_sin_theta_grad, cos_theta_grad_sq,
-                       sin_theta_grad_sq, isotropy_type[2],
-                       kern_third);
-        compute_kernel(c2[3], cos_theta_sin_theta_lapl, cos_theta_lapl_sq,
-                       sin_theta_lapl_sq, isotropy_type[3],
-                       kern_fourth);
-
-        dt_aligned_pixel_t derivatives[4] = { { 0.f } };
+        // compute the variance and the regularization term
         dt_aligned_pixel_t variance = { 0.f };
-        // convolve filters and compute the variance and the regularization term
         for(size_t k = 0; k < 9; k++)
         {
-          for_each_channel(c,aligned(derivatives,neighbour_pixel_LF,kern_first,kern_second))
-          {
-            derivatives[0][c] += kern_first[k][c] * neighbour_pixel_LF[k][c];
-            derivatives[1][c] += kern_second[k][c] * neighbour_pixel_LF[k][c];
-            derivatives[2][c] += kern_third[k][c] * neighbour_pixel_HF[k][c];
-            derivatives[3][c] += kern_fourth[k][c] * neighbour_pixel_HF[k][c];
+          for_each_channel(c,aligned(variance,neighbour_pixel_HF))
             variance[c] += sqf(neighbour_pixel_HF[k][c]);
-          }
         }
         // Regularize the variance taking into account the blurring scale.
         // This allows to keep the scene-referred variance roughly constant
@@ -1122,9 +1177,10 @@ static inline void heat_PDE_diffusion(const float *const restrict high_freq,
           for_each_channel(c, aligned(acc,derivatives,ABCD))
             acc[c] += derivatives[k][c] * ABCD[k];
         }
-        for_each_channel(c, aligned(acc,HF,LF,variance,out))
+        // the center of the stencil is the current pixel
+        for_each_channel(c, aligned(acc,neighbour_pixel_HF,LF,variance,out))
         {
-          acc[c] = (HF[index + c] * strength + acc[c] / variance[c]);
+          acc[c] = (neighbour_pixel_HF[4][c] * strength + acc[c] / variance[c]);
           // update the solution
           out[index + c] = fmaxf(acc[c] + LF[index + c], 0.f);
         }
@@ -1132,8 +1188,10 @@ static inline void heat_PDE_diffusion(const float *const restrict high_freq,
       else
       {
         // only copy input to output, do nothing
+        dt_aligned_pixel_t HF;
+        dt_wavelet_band_load(high_freq, storage, index, HF);
         for_each_channel(c, aligned(out, HF, LF : 64))
-          out[index + c] = HF[index + c] + LF[index + c];
+          out[index + c] = HF[c] + LF[index + c];
       }
     }
   }
@@ -1147,6 +1205,34 @@ static inline float compute_anisotropy_factor(const float user_param)
   return sqf(user_param);
 }
 
+typedef struct _decompose_data_t
+{
+  const dt_wavelet_bands_t *HF;
+  float *tempbuf;
+  size_t padded_size;
+  size_t width;
+  size_t height;
+} _decompose_data_t;
+
+static void _decompose_scale(const float *const in,
+                             float *const LF,
+                             const int s,
+                             void *const data)
+{
+  const _decompose_data_t *const d = data;
+  dt_bspline_decompose_band(in, d->HF, s, LF, d->tempbuf, d->padded_size);
+
+  if(darktable.dump_pfm_module)
+  {
+    char name[64];
+    sprintf(name, "scale-input-%i", s);
+    dt_dump_pfm(name, in, d->width, d->height, 4 * sizeof(float), "diffuse");
+
+    sprintf(name, "scale-blur-%i", s);
+    dt_dump_pfm(name, LF, d->width, d->height, 4 * sizeof(float), "diffuse");
+  }
+}
+
 static inline gboolean wavelets_process(const float *const restrict in,
                                     float *const restrict reconstructed,
                                     const uint8_t *const restrict mask,
@@ -1157,9 +1243,11 @@ static inline gboolean wavelets_process(const float *const restrict in,
                                     const float zoom,
                                     const int scales,
                                     const gboolean has_mask,
-                                    float *const restrict HF[MAX_NUM_SCALES],
+                                    const dt_wavelet_bands_t *const HF,
                                     float *const restrict LF_odd,
-                                    float *const restrict LF_even)
+                                    float *const restrict LF_even,
+                                    float *const restrict tempbuf,
+                                    const size_t padded_size)
 {
   gboolean success = TRUE;
 
@@ -1182,50 +1270,10 @@ static inline gboolean wavelets_process(const float *const restrict in,
   // we know that explains it :
   // https://jo.dreggn.org/home/2010_atrous.pdf the wavelets
   // decomposition here is the same as the equalizer/atrous module,
-  float *restrict residual; // will store the temp buffer containing the last step of blur
-  // allocate a one-row temporary buffer for the decomposition
-  size_t padded_size;
-  float *const restrict tempbuf = dt_alloc_perthread_float(4 * width, &padded_size); //TODO: alloc in caller
-  for(int s = 0; s < scales; ++s)
-  {
-    /* fprintf(stdout, "Wavelet decompose : scale %i\n", s); */
-    const int mult = 1 << s;
-
-    const float *restrict buffer_in;
-    float *restrict buffer_out;
-
-    if(s == 0)
-    {
-      buffer_in = in;
-      buffer_out = LF_odd;
-    }
-    else if(s % 2 != 0)
-    {
-      buffer_in = LF_odd;
-      buffer_out = LF_even;
-    }
-    else
-    {
-      buffer_in = LF_even;
-      buffer_out = LF_odd;
-    }
-
-    decompose_2D_Bspline(buffer_in, HF[s], buffer_out, width, height,
-                         mult, tempbuf, padded_size);
-
-    residual = buffer_out;
-
-    if(darktable.dump_pfm_module)
-    {
-      char name[64];
-      sprintf(name, "scale-input-%i", s);
-      dt_dump_pfm(name, buffer_in, width, height, 4 * sizeof(float), "diffuse");
-
-      sprintf(name, "scale-blur-%i", s);
-      dt_dump_pfm(name, buffer_out, width, height, 4 * sizeof(float), "diffuse");
-    }
-  }
-  dt_free_align(tempbuf);
+  _decompose_data_t decompose = { HF, tempbuf, padded_size, width, height };
+  // will store the temp buffer containing the last step of blur
+  float *restrict residual = dt_wavelet_decompose(in, LF_odd, LF_even, scales,
+                                                  _decompose_scale, &decompose);
 
   // will store the temp buffer NOT containing the last step of blur
   float *restrict temp = (residual == LF_even) ? LF_odd : LF_even;
@@ -1272,9 +1320,15 @@ static inline gboolean wavelets_process(const float *const restrict in,
     if(s == 0) buffer_out = reconstructed;
 
     // Compute wavelets low-frequency scales
-    heat_PDE_diffusion(HF[s], buffer_in, mask, has_mask, buffer_out, width, height,
-                       anisotropy, isotropy_type, regularization,
-                       variance_threshold, sqf(current_radius), mult, ABCD, strength);
+    // one instance of the solver per storage of the details
+    if(HF->storage == DT_WAVELET_STORAGE_HALF)
+      heat_PDE_diffusion(HF->band[s], DT_WAVELET_STORAGE_HALF, buffer_in, mask, has_mask,
+                         buffer_out, width, height, anisotropy, isotropy_type, regularization,
+                         variance_threshold, sqf(current_radius), mult, ABCD, strength);
+    else
+      heat_PDE_diffusion(HF->band[s], DT_WAVELET_STORAGE_FLOAT, buffer_in, mask, has_mask,
+                         buffer_out, width, height, anisotropy, isotropy_type, regularization,
+                         variance_threshold, sqf(current_radius), mult, ABCD, strength);
 
     if(darktable.dump_pfm_module)
     {
@@ -1387,12 +1441,15 @@ void process(dt_iop_module_t *self,
   const int scales = CLAMP(diffusion_scales, 1, MAX_NUM_SCALES);
 
   // wavelets scales buffers
-  float *restrict HF[MAX_NUM_SCALES];
-  for(int s = 0; s < scales; s++)
-  {
-    HF[s] = out_of_memory ? NULL : dt_alloc_align_float(width * height * 4);
-    if(!HF[s]) out_of_memory = TRUE;
-  }
+  const dt_wavelet_storage_t storage = _bands_storage();
+  dt_wavelet_bands_t HF = { 0 };
+  if(!out_of_memory)
+    out_of_memory = !dt_wavelet_bands_alloc(&HF, width, height, 4, scales, FALSE, storage);
+
+  // one-row temporary buffer for the decomposition
+  size_t padded_size = 0;
+  float *const restrict tempbuf = out_of_memory ? NULL : dt_alloc_perthread_float(4 * width, &padded_size);
+  if(!tempbuf) out_of_memory = TRUE;
 
   // check that all buffers exist before processing because we use a lot of memory here.
   if(out_of_memory)
@@ -1402,6 +1459,10 @@ void process(dt_iop_module_t *self,
     goto finish;
   }
 
+  if(storage == DT_WAVELET_STORAGE_HALF)
+    dt_print(DT_DEBUG_MEMORY, "[diffuse] %zux%zu, %d wavelets scales stored as half floats",
+             width, height, scales);
+
   const gboolean has_mask = (data->threshold > 0.f);
   if(has_mask)
   {
@@ -1437,7 +1498,8 @@ void process(dt_iop_module_t *self,
 
     wavelets_process(temp_in, temp_out, mask,
                      roi_out->width, roi_out->height,
-                     data, final_radius, scale, scales, has_mask, HF, LF_odd, LF_even);
+                     data, final_radius, scale, scales, has_mask, &HF, LF_odd, LF_even,
+                     tempbuf, padded_size);
   }
 
 finish:
@@ -1446,8 +1508,8 @@ finish:
   dt_free_align(temp2);
   dt_free_align(LF_even);
   dt_free_align(LF_odd);
-  for(int s = 0; s < scales; s++)
-    if(HF[s]) dt_free_align(HF[s]);
+  dt_free_align(tempbuf);
+  dt_wavelet_bands_free(&HF);
 }
 
 #if HAVE_OPENCL
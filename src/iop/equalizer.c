@@ -132,14 +132,17 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
   // printf("level range in %d %d: %f %f, cap: %d\n", 1, d->num_levels, l1, lm, numl_cap);
 
   // TODO: fixed alloc for data piece at capped resolution?
-  float **tmp = (float **)calloc(numl_cap, sizeof(float *));
-  for(int k = 1; k < numl_cap; k++)
+  // the edge weights of the levels 1 .. numl_cap - 1, the output is
+  // left as a copy of the input if they don't fit in memory
+  dt_wavelet_bands_t weights;
+  if(!dt_wavelet_bands_alloc(&weights, width, height, 1, MAX(numl_cap - 1, 0), TRUE,
+                             DT_WAVELET_STORAGE_FLOAT))
   {
-    const int wd = (int)(1 + (width >> (k - 1))), ht = (int)(1 + (height >> (k - 1)));
-    tmp[k] = (float *)malloc(sizeof(float) * wd * ht);
+    dt_print(DT_DEBUG_ALWAYS, "[equalizer process] error allocating memory for the wavelet weights");
+    return;
   }
 
-  for(int level = 1; level < numl_cap; level++) dt_iop_equalizer_wtf(ovoid, tmp, level, width, height);
+  for(int level = 1; level < numl_cap; level++) dt_iop_equalizer_wtf(ovoid, &weights, level, width, height);
 
   for(int l = 1; l < numl_cap; l++)
   {
@@ -160,10 +163,9 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
           out[(size_t)chs * width * j + (size_t)chs * i + ch] *= coeff * coeff;
     }
   }
-  for(int level = numl_cap - 1; level > 0; level--) dt_iop_equalizer_iwtf(ovoid, tmp, level, width, height);
+  for(int level = numl_cap - 1; level > 0; level--) dt_iop_equalizer_iwtf(ovoid, &weights, level, width, height);
 
-  for(int k = 1; k < numl_cap; k++) free(tmp[k]);
-  free(tmp);
+  dt_wavelet_bands_free(&weights);
 }
 
 void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_t *pipe,
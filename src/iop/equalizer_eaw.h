@@ -18,29 +18,35 @@
 
 #pragma once
 
-// edge-avoiding wavelet:
+#include "common/wavelets.h"
+
+// edge-avoiding wavelet, the weights of level l are in the scale l - 1
+// of a one channel decimated dt_wavelet_bands_t:
 #define gweight(i, j, ii, jj)                                                                                \
-  1.0 / (fabsf(weight_a[l][(size_t)wd * ((j) >> (l - 1)) + ((i) >> (l - 1))]                                 \
-               - weight_a[l][(size_t)wd * ((jj) >> (l - 1)) + ((ii) >> (l - 1))]) + 1.e-5)
-// #define gweight(i, j, ii, jj) 1.0/(powf(fabsf(weight_a[l][wd*((j)>>(l-1)) + ((i)>>(l-1))] -
-// weight_a[l][wd*((jj)>>(l-1)) + ((ii)>>(l-1))]),0.8)+1.e-5)
+  1.0 / (fabsf(weight_a[(size_t)wd * ((j) >> (l - 1)) + ((i) >> (l - 1))]                                    \
+               - weight_a[(size_t)wd * ((jj) >> (l - 1)) + ((ii) >> (l - 1))]) + 1.e-5)
+// #define gweight(i, j, ii, jj) 1.0/(powf(fabsf(weight_a[wd*((j)>>(l-1)) + ((i)>>(l-1))] -
+// weight_a[wd*((jj)>>(l-1)) + ((ii)>>(l-1))]),0.8)+1.e-5)
 // std cdf(2,2) wavelet:
 // #define gweight(i, j, ii, jj) (wd ? 1.0 : 1.0) //1.0
 #define gbuf(BUF, A, B) ((BUF)[4 * ((size_t)width * ((B)) + ((A))) + ch])
 
 
-static void dt_iop_equalizer_wtf(float *const buf, float **weight_a, const int l, const int width, const int height)
+static void dt_iop_equalizer_wtf(float *const buf, const dt_wavelet_bands_t *const weights, const int l,
+                                 const int width, const int height)
 {
-  const int wd = (int)(1 + (width >> (l - 1))), ht = (int)(1 + (height >> (l - 1)));
+  float *const weight_a = weights->band[l - 1];
+  const int wd = (int)dt_wavelet_band_width(width, l - 1, TRUE);
+  const int ht = (int)dt_wavelet_band_width(height, l - 1, TRUE);
   int ch = 0;
   // store weights for luma channel only, chroma uses same basis.
   for(int j = 0; j < ht - 1; j++)
   {
-    for(int i = 0; i < wd - 1; i++) weight_a[l][(size_t)j * wd + i] = gbuf(buf, i << (l - 1), j << (l - 1));
-    weight_a[l][j * wd + (wd - 1)] = 0.0f; // zero out right-most column
+    for(int i = 0; i < wd - 1; i++) weight_a[(size_t)j * wd + i] = gbuf(buf, i << (l - 1), j << (l - 1));
+    weight_a[j * wd + (wd - 1)] = 0.0f; // zero out right-most column
   }
   for(int i = 0; i < wd; i++) // zero out the bottom row
-    weight_a[l][(ht-1) * wd + i] = 0.0f;
+    weight_a[(ht-1) * wd + i] = 0.0f;
 
   const int step = 1 << l;
   const int st = step / 2;
@@ -103,11 +109,13 @@ static void dt_iop_equalizer_wtf(float *const buf, float **weight_a, const int l
   dt_free_align(tmp_height_buf);
 }
 
-static void dt_iop_equalizer_iwtf(float *buf, float **weight_a, const int l, const int width, const int height)
+static void dt_iop_equalizer_iwtf(float *buf, const dt_wavelet_bands_t *const weights, const int l,
+                                  const int width, const int height)
 {
+  const float *const weight_a = weights->band[l - 1];
   const int step = 1 << l;
   const int st = step / 2;
-  const int wd = (int)(1 + (width >> (l - 1)));
+  const int wd = (int)dt_wavelet_band_width(width, l - 1, TRUE);
 
   size_t scratch_size;
   float *const restrict tmp_height_buf = dt_alloc_perthread_float(height, &scratch_size);
@@ -422,6 +422,9 @@ void commit_params(dt_iop_module_t *self,
 
   if(d->orientation == ORIENTATION_NONE)
     piece->enabled = FALSE;
+
+  // a permutation of the pixels, their centers map onto each other
+  piece->distort_resample = DT_DEV_DISTORT_RESAMPLE_CENTER;
 }
 
 void init_pipe(dt_iop_module_t *self,
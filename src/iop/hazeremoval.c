@@ -667,9 +667,10 @@ void process(dt_iop_module_t *self,
   // refine the transition map
   dt_box_min(trans_map.data, trans_map.height, trans_map.width, 1, w1);
   gray_image trans_map_filtered = new_gray_image(width, height);
-  // apply guided filter with no clipping
-  guided_filter(img_in.data, trans_map.data, trans_map_filtered.data,
-                width, height, 4, w2, eps, 1.f, -FLT_MAX, FLT_MAX);
+  // apply guided filter with no clipping, keep the coarse map if out of memory
+  if(!guided_filter(img_in.data, trans_map.data, trans_map_filtered.data,
+                    width, height, 4, w2, eps, 1.f, -FLT_MAX, FLT_MAX))
+    copy_gray_image(trans_map, trans_map_filtered);
 
   // finally, calculate the haze-free image, minimum allowed value for transition map
   const float t_min = CLAMP(expf(-distance * distance_max), 1.0f / 1024.0f, 1.0f);
@@ -826,11 +827,16 @@ void tiling_callback(dt_iop_module_t *self,
                      const dt_iop_roi_t *roi_out,
                      dt_develop_tiling_t *tiling)
 {
+  dt_iop_hazeremoval_params_t *d = piece->data;
+  const float wscale = d->adaptive ? CLIP((float)roi_in->scale / (float)piece->pipe->iscale) : 1.0f;
+  const int w2 = 3 + (int)ceilf(6.0f * wscale);
+
   tiling->factor = 2.5f;  // in + out + two single-channel temp buffers
   tiling->factor_cl = 5.0f;
   tiling->maxbuf = 1.0f;
   tiling->maxbuf_cl = 1.0f;
-  tiling->overhead = 0;
+  // running sums and ring of coefficient rows of the strips of the guided filter
+  tiling->overhead = dt_box_guided_filter_memory(roi_in->width, roi_in->height, w2);
   tiling->overlap = 0;
   tiling->align = 1;
 }
@@ -27,6 +27,7 @@
 #endif
 
 #include "bauhaus/bauhaus.h"
+#include "common/distortion_grid.h"
 #include "common/interpolation.h"
 #include "common/file_location.h"
 #include "common/imagebuf.h"
@@ -206,6 +207,7 @@ typedef struct dt_iop_lens_global_data_t
   int kernel_md_vignette;
   int kernel_md_correct;
   lfDatabase *db;
+  dt_distortion_grid_cache_t grids; // shared by the pipes
 } dt_iop_lens_global_data_t;
 
 typedef struct dt_iop_lens_data_t
@@ -1043,6 +1045,52 @@ static float _get_autoscale_lf(dt_iop_module_t *self,
   return scale;
 }
 
+static void _distortion_lf(const void *data,
+                           const int x,
+                           const int y,
+                           const int count,
+                           float *out)
+{
+  const lfModifier *modifier = (const lfModifier *)data;
+  modifier->ApplySubpixelGeometryDistortion(x, y, count, 1, out);
+}
+
+// the distortion of the modifier sampled on a sparse grid, shared by
+// the pipes working at the same scale. Release it after use.
+static dt_distortion_grid_t *_get_grid_lf(dt_iop_module_t *self,
+                                          const dt_iop_lens_data_t *d,
+                                          const lfModifier *modifier,
+                                          const int mods_filter,
+                                          const float orig_w,
+                                          const float orig_h)
+{
+  dt_iop_lens_global_data_t *gd = (dt_iop_lens_global_data_t *)self->global_data;
+  const lfLens *lens = d->lens;
+
+  dt_hash_t hash = dt_hash(DT_INITHASH, lens->Maker, strlen(lens->Maker));
+  if(lens->Model)
+    hash = dt_hash(hash, lens->Model, strlen(lens->Model));
+  const float geometry[] = { lens->CenterX, lens->CenterY,
+                             lens->CropFactor, lens->AspectRatio };
+  hash = dt_hash(hash, geometry, sizeof(geometry));
+  hash = dt_hash(hash, &lens->Type, sizeof(lens->Type));
+  for(int k = 0; lens->CalibDistortion && lens->CalibDistortion[k]; k++)
+    hash = dt_hash(hash, lens->CalibDistortion[k], sizeof(lfLensCalibDistortion));
+  for(int k = 0; lens->CalibTCA && lens->CalibTCA[k]; k++)
+    hash = dt_hash(hash, lens->CalibTCA[k], sizeof(lfLensCalibTCA));
+
+  const int mods = _modflags_to_lensfun_mods(d->modify_flags) & mods_filter;
+  const int flags[] = { mods, d->inverse, (int)d->target_geom };
+  hash = dt_hash(hash, flags, sizeof(flags));
+  const float settings[] = { d->scale, d->crop, d->focal, d->aperture, d->distance,
+                             orig_w, orig_h };
+  hash = dt_hash(hash, settings, sizeof(settings));
+
+  return dt_distortion_grid_cache_get(&gd->grids, hash,
+                                      (int)ceilf(orig_w), (int)ceilf(orig_h),
+                                      _distortion_lf, modifier);
+}
+
 static void _process_lf(dt_iop_module_t *self,
                         dt_dev_pixelpipe_iop_t *piece,
                         const void *const ivoid,
@@ -1051,6 +1099,7 @@ static void _process_lf(dt_iop_module_t *self,
                         const dt_iop_roi_t *const roi_out)
 {
   const dt_iop_lens_data_t *const d = (dt_iop_lens_data_t *)piece->data;
+  dt_iop_lens_global_data_t *gd = (dt_iop_lens_global_data_t *)self->global_data;
 
   const int ch = piece->colors;
   const int ch_width = ch * roi_in->width;
@@ -1085,6 +1134,11 @@ static void _process_lf(dt_iop_module_t *self,
 
   dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
 
+  dt_distortion_grid_t *grid =
+    (modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE))
+    ? _get_grid_lf(self, d, modifier, used_lf_mask, orig_w, orig_h)
+    : NULL;
+
   const dt_interpolation_t *const interpolation = dt_interpolation_new(DT_INTERPOLATION_USERPREF_WARP);
 
   if(d->inverse)
@@ -1105,8 +1159,8 @@ static void _process_lf(dt_iop_module_t *self,
       for(int y = 0; y < roi_out->height; y++)
       {
         float *bufptr = (float*)dt_get_perthread(buf, padded_bufsize);
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x, roi_out->y + y,
-                                                  roi_out->width, 1, bufptr);
+        dt_distortion_grid_row(grid, roi_out->x, roi_out->y + y, roi_out->width,
+                               _distortion_lf, modifier, bufptr);
 
         // reverse transform the global coords from lf to our buffer
         float *out = ((float *)ovoid) + (size_t)y * roi_out->width * ch;
@@ -1215,10 +1269,8 @@ static void _process_lf(dt_iop_module_t *self,
       for(int y = 0; y < roi_out->height; y++)
       {
         float *buf2ptr = (float*)dt_get_perthread(buf2, padded_buf2size);
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x,
-                                                  roi_out->y + y,
-                                                  roi_out->width,
-                                                  1, buf2ptr);
+        dt_distortion_grid_row(grid, roi_out->x, roi_out->y + y, roi_out->width,
+                               _distortion_lf, modifier, buf2ptr);
         // reverse transform the global coords from lf to our buffer
         float *out = ((float *)ovoid) + (size_t)y * roi_out->width * ch;
         for(int x = 0; x < roi_out->width; x++, buf2ptr += 6, out += ch)
@@ -1276,6 +1328,7 @@ static void _process_lf(dt_iop_module_t *self,
     }
     dt_free_align(buf);
   }
+  dt_distortion_grid_cache_release(&gd->grids, grid);
   delete modifier;
 }
 
@@ -1301,6 +1354,7 @@ static int _process_cl_lf(dt_iop_module_t *self,
 
   float *tmpbuf = NULL;
   lfModifier *modifier = NULL;
+  dt_distortion_grid_t *grid = NULL;
 
   const int devid = piece->pipe->devid;
   const int iwidth = roi_in->width;
@@ -1369,6 +1423,9 @@ static int _process_cl_lf(dt_iop_module_t *self,
   modifier = _get_modifier(&modflags, orig_w, orig_h, d, used_lf_mask, FALSE);
   dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
 
+  if(modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE))
+    grid = _get_grid_lf(self, d, modifier, used_lf_mask, orig_w, orig_h);
+
   if(d->inverse)
   {
     // reverse direction (useful for renderings)
@@ -1381,9 +1438,8 @@ static int _process_cl_lf(dt_iop_module_t *self,
       for(int y = 0; y < roi_out->height; y++)
       {
         float *pi = tmpbuf + (size_t)y * tmpbufwidth;
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x,
-                                                  roi_out->y + y,
-                                                  roi_out->width, 1, pi);
+        dt_distortion_grid_row(grid, roi_out->x, roi_out->y + y, roi_out->width,
+                               _distortion_lf, modifier, pi);
       }
 
       err = dt_opencl_write_buffer_to_device(devid, tmpbuf,
@@ -1492,9 +1548,8 @@ static int _process_cl_lf(dt_iop_module_t *self,
       for(int y = 0; y < roi_out->height; y++)
       {
         float *pi = tmpbuf + (size_t)y * tmpbufwidth;
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x,
-                                                  roi_out->y + y,
-                                                  roi_out->width, 1, pi);
+        dt_distortion_grid_row(grid, roi_out->x, roi_out->y + y, roi_out->width,
+                               _distortion_lf, modifier, pi);
       }
 
       err = dt_opencl_write_buffer_to_device(devid, tmpbuf,
@@ -1521,6 +1576,7 @@ error:
   dt_opencl_release_mem_object(dev_tmp);
   dt_opencl_release_mem_object(dev_tmpbuf);
   dt_free_align(tmpbuf);
+  dt_distortion_grid_cache_release(&gd->grids, grid);
   if(modifier != NULL) delete modifier;
   return err;
 }
@@ -1631,6 +1687,7 @@ static void _distort_mask_lf(dt_iop_module_t *self,
                              const dt_iop_roi_t *const roi_out)
 {
   const dt_iop_lens_data_t *const d = (dt_iop_lens_data_t *)piece->data;
+  dt_iop_lens_global_data_t *gd = (dt_iop_lens_global_data_t *)self->global_data;
 
   if(!d->lens || !d->lens->Maker || d->crop <= 0.0f)
   {
@@ -1641,11 +1698,12 @@ static void _distort_mask_lf(dt_iop_module_t *self,
   const float orig_w = roi_in->scale * piece->buf_in.width;
   const float orig_h = roi_in->scale * piece->buf_in.height;
 
+  const int used_lf_mask = LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE;
+
   dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
   int modflags;
   const lfModifier *modifier =
-    _get_modifier(&modflags, orig_w, orig_h, d,
-                  LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE, FALSE);
+    _get_modifier(&modflags, orig_w, orig_h, d, used_lf_mask, FALSE);
 
   dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
 
@@ -1660,6 +1718,7 @@ static void _distort_mask_lf(dt_iop_module_t *self,
   }
 
   const dt_interpolation_t *const interpolation = dt_interpolation_new(DT_INTERPOLATION_USERPREF_WARP);
+  dt_distortion_grid_t *grid = _get_grid_lf(self, d, modifier, used_lf_mask, orig_w, orig_h);
 
   // acquire temp memory for distorted pixel coords
   const size_t bufsize = (size_t)roi_out->width * 2 * 3;
@@ -1670,8 +1729,8 @@ static void _distort_mask_lf(dt_iop_module_t *self,
   for(int y = 0; y < roi_out->height; y++)
   {
     float *bufptr = (float*)dt_get_perthread(buf, padded_bufsize);
-    modifier->ApplySubpixelGeometryDistortion(roi_out->x, roi_out->y + y,
-                                              roi_out->width, 1, bufptr);
+    dt_distortion_grid_row(grid, roi_out->x, roi_out->y + y, roi_out->width,
+                           _distortion_lf, modifier, bufptr);
 
     // reverse transform the global coords from lf to our buffer
     float *_out = out + (size_t)y * roi_out->width;
@@ -1692,6 +1751,7 @@ static void _distort_mask_lf(dt_iop_module_t *self,
     }
   }
   dt_free_align(buf);
+  dt_distortion_grid_cache_release(&gd->grids, grid);
   delete modifier;
 }
 
@@ -2732,6 +2792,61 @@ static gboolean _distort_backtransform_md(dt_iop_module_t *self,
   return TRUE;
 }
 
+typedef struct dt_iop_lens_md_field_t
+{
+  const dt_iop_lens_data_t *d;
+  float w2;
+  float h2;
+  float r;
+  float inv_scale_md;
+  gboolean pass_mode;
+} dt_iop_lens_md_field_t;
+
+static void _distortion_md(const void *data,
+                           const int x,
+                           const int y,
+                           const int count,
+                           float *out)
+{
+  const dt_iop_lens_md_field_t *f = (const dt_iop_lens_md_field_t *)data;
+  const dt_iop_lens_data_t *d = f->d;
+  const float cy = (y - f->h2) * f->inv_scale_md;
+  for(int k = 0; k < count; k++)
+  {
+    const float cx = (x + k - f->w2) * f->inv_scale_md;
+    const float radius = f->r * dt_fast_hypotf(cx, cy);
+    for(int c = 0; c < 3; c++)
+    {
+      const int plane = f->pass_mode ? 1 : c;
+      const float dr =
+        _interpolate_linear_spline(d->knots_dist, d->cor_rgb[plane], d->nc, radius);
+      out[6 * k + 2 * c] = dr * cx + f->w2;
+      out[6 * k + 2 * c + 1] = dr * cy + f->h2;
+    }
+  }
+}
+
+// the correction splines sampled on a sparse grid, shared by the pipes
+// working at the same scale. Release it after use.
+static dt_distortion_grid_t *_get_grid_md(dt_iop_module_t *self,
+                                          const dt_iop_lens_md_field_t *field)
+{
+  dt_iop_lens_global_data_t *gd = (dt_iop_lens_global_data_t *)self->global_data;
+  const dt_iop_lens_data_t *d = field->d;
+
+  dt_hash_t hash = dt_hash(DT_INITHASH, &d->nc, sizeof(d->nc));
+  hash = dt_hash(hash, d->knots_dist, sizeof(float) * d->nc);
+  for(int c = 0; c < 3; c++)
+    hash = dt_hash(hash, d->cor_rgb[c], sizeof(float) * d->nc);
+  const float settings[] = { field->w2, field->h2, field->inv_scale_md };
+  hash = dt_hash(hash, settings, sizeof(settings));
+  hash = dt_hash(hash, &field->pass_mode, sizeof(field->pass_mode));
+
+  return dt_distortion_grid_cache_get(&gd->grids, hash,
+                                      (int)ceilf(2.0f * field->w2), (int)ceilf(2.0f * field->h2),
+                                      _distortion_md, field);
+}
+
 static void _distort_mask_md(dt_iop_module_t *self,
                              dt_dev_pixelpipe_iop_t *piece,
                              const float *const in,
@@ -2746,33 +2861,39 @@ static void _distort_mask_md(dt_iop_module_t *self,
                                      roi_out->width,
                                      roi_out->height, 1);
 
-  const float inv_scale_md = 1.0f / d->scale_md;
+  dt_iop_lens_global_data_t *gd = (dt_iop_lens_global_data_t *)self->global_data;
   const float w2 = 0.5f * roi_in->scale * piece->buf_in.width;
   const float h2 = 0.5f * roi_in->scale * piece->buf_in.height;
-  const float r = 1.0f / dt_fast_hypotf(w2, h2);
+  // the mask follows green, sharing the grid of the image
+  const dt_iop_lens_md_field_t field = { d, w2, h2, 1.0f / dt_fast_hypotf(w2, h2),
+                                         1.0f / d->scale_md, FALSE };
+  dt_distortion_grid_t *grid = _get_grid_md(self, &field);
 
   const float limw = roi_in->width - 1;
   const float limh = roi_in->height - 1;
 
   const dt_interpolation_t *interpolation = dt_interpolation_new(DT_INTERPOLATION_USERPREF_WARP);
 
-  DT_OMP_FOR(collapse(2))
+  size_t padded_bufsize;
+  float *const buf = dt_alloc_perthread_float((size_t)6 * roi_out->width, &padded_bufsize);
+
+  DT_OMP_FOR()
   for(int y = 0; y < roi_out->height; y++)
   {
+    float *const pos = (float *)dt_get_perthread(buf, padded_bufsize);
+    dt_distortion_grid_row(grid, roi_out->x, roi_out->y + y, roi_out->width,
+                           _distortion_md, &field, pos);
     for(int x = 0; x < roi_out->width; x++)
     {
-      const float cx = (roi_out->x + x - w2) * inv_scale_md;
-      const float cy = (roi_out->y + y - h2) * inv_scale_md;
-      const float dr =
-        _interpolate_linear_spline(d->knots_dist, d->cor_rgb[1],
-                                   d->nc, r*dt_fast_hypotf(cx, cy));
-      const float xs = CLAMP(dr*cx + w2 - roi_in->x, 0.0f, limw);
-      const float ys = CLAMP(dr*cy + h2 - roi_in->y, 0.0f, limh);
+      const float xs = CLAMP(pos[6 * x + 2] - roi_in->x, 0.0f, limw);
+      const float ys = CLAMP(pos[6 * x + 3] - roi_in->y, 0.0f, limh);
       out[y * roi_out->width + x] = CLIP(dt_interpolation_compute_sample(interpolation, in,
                                                                          xs, ys,
                                                                          roi_in->width, roi_in->height, 1, roi_in->width));
     }
   }
+  dt_free_align(buf);
+  dt_distortion_grid_cache_release(&gd->grids, grid);
 }
 
 static void _process_md(dt_iop_module_t *self,
@@ -2784,6 +2905,7 @@ static void _process_md(dt_iop_module_t *self,
                         const gboolean backbuf)
 {
   dt_iop_lens_data_t *d = (dt_iop_lens_data_t *)piece->data;
+  dt_iop_lens_global_data_t *gd = (dt_iop_lens_global_data_t *)self->global_data;
 
   if(!d->nc || d->modify_flags == DT_IOP_LENS_MODFLAG_NONE)
     return dt_iop_copy_image_roi((float *)ovoid, (float *)ivoid, 4,
@@ -2830,27 +2952,29 @@ static void _process_md(dt_iop_module_t *self,
   float *out = ((float *) ovoid);
   // Correct distortion and/or chromatic aberration
 
+  const dt_iop_lens_md_field_t field = { d, w2, h2, r, inv_scale_md, pass_mode };
+  dt_distortion_grid_t *grid = _get_grid_md(self, &field);
+
+  size_t padded_posize;
+  float *const positions = dt_alloc_perthread_float((size_t)6 * roi_out->width, &padded_posize);
+
   const float limw = roi_in->width - 1;
   const float limh = roi_in->height - 1;
-  DT_OMP_FOR(collapse(2))
+  DT_OMP_FOR()
   for(int y = 0; y < roi_out->height; y++)
   {
+    float *const pos = (float *)dt_get_perthread(positions, padded_posize);
+    dt_distortion_grid_row(grid, roi_out->x, roi_out->y + y, roi_out->width,
+                           _distortion_md, &field, pos);
     for(int x = 0; x < roi_out->width; x++)
     {
-      const size_t odx = 4 * (y * roi_out->width + x);
-      const float cx = (roi_out->x + x - w2) * inv_scale_md;
-      const float cy = (roi_out->y + y - h2) * inv_scale_md;
-
-      const float radius = r*dt_fast_hypotf(cx, cy);
-
+      const size_t odx = 4 * ((size_t)y * roi_out->width + x);
       for_each_channel(c)
       {
         // use green data for alpha channel
-        const int plane = (c == 3 || pass_mode) ? 1 : c;
-        const float dr =
-          _interpolate_linear_spline(d->knots_dist, d->cor_rgb[plane], d->nc, radius);
-        const float xs = CLAMP(dr*cx + w2 - roi_in->x, 0.0f, limw);
-        const float ys = CLAMP(dr*cy + h2 - roi_in->y, 0.0f, limh);
+        const int plane = c == 3 ? 1 : c;
+        const float xs = CLAMP(pos[6 * x + 2 * plane] - roi_in->x, 0.0f, limw);
+        const float ys = CLAMP(pos[6 * x + 2 * plane + 1] - roi_in->y, 0.0f, limh);
         out[odx+c] = dt_interpolation_compute_sample(interpolation, buf + c,
                                                      xs, ys,
                                                      roi_in->width, roi_in->height, 4, 4*roi_in->width);
@@ -2858,6 +2982,9 @@ static void _process_md(dt_iop_module_t *self,
     }
   }
 
+  dt_free_align(positions);
+  dt_distortion_grid_cache_release(&gd->grids, grid);
+
   if(!backbuf)
     dt_free_align(buf);
 }
@@ -3386,6 +3513,8 @@ void init_global(dt_iop_module_so_t *self)
   gd->kernel_md_correct =
     dt_opencl_create_kernel(program, "md_lens_correction");
 
+  dt_distortion_grid_cache_init(&gd->grids);
+
   lfDatabase *dt_iop_lensfun_db = new lfDatabase;
   gd->db = (lfDatabase *)dt_iop_lensfun_db;
 
@@ -3626,6 +3755,8 @@ void cleanup_global(dt_iop_module_so_t *self)
   lfDatabase *dt_iop_lensfun_db = (lfDatabase *)gd->db;
   delete dt_iop_lensfun_db;
 
+  dt_distortion_grid_cache_cleanup(&gd->grids);
+
   dt_opencl_free_kernel(gd->kernel_lens_distort_bilinear);
   dt_opencl_free_kernel(gd->kernel_lens_distort_bicubic);
   dt_opencl_free_kernel(gd->kernel_lens_distort_lanczos2);
@@ -46,6 +46,11 @@ DT_MODULE_INTROSPECTION(1, dt_iop_liquify_params_t)
 
 #define MAX_NODES 100 // max of nodes in one instance
 
+#define DT_LIQUIFY_TILE_SIZE 64          // of the cached displacement maps
+#define DT_LIQUIFY_MAP_CACHE_SIZE 3      // scales kept
+#define DT_LIQUIFY_MAP_MAX_TILES 4096    // per scale before pruning, 128 MB
+#define DT_LIQUIFY_MAP_MAX_PROFILES 256
+
 const int   LOOKUP_OVERSAMPLE = 10;
 const int   INTERPOLATION_POINTS = 100; // when interpolating bezier
 const float STAMP_RELOCATION = 0.1;     // how many radii to move
@@ -256,9 +261,40 @@ typedef struct
   dt_liquify_path_data_t nodes[MAX_NODES];
 } dt_iop_liquify_params_t;
 
+// a tile of a cached displacement map, see _fill_global_distortion_map()
+
+typedef struct dt_liquify_tile_t
+{
+  int64_t key;          ///< tile row and column
+  dt_hash_t hash;       ///< of the warps stamped onto the tile
+  uint64_t used;
+  float complex *map;   ///< DT_LIQUIFY_TILE_SIZE rows of as many displacements
+} dt_liquify_tile_t;
+
+typedef struct dt_liquify_profile_t
+{
+  dt_hash_t key;        ///< of radius and controls
+  int iradius;
+  float control1;
+  float control2;
+  uint64_t used;
+  float *weight;        ///< a quarter of the stamp, see _build_profile()
+} dt_liquify_profile_t;
+
+typedef struct dt_liquify_map_t
+{
+  float scale;
+  GHashTable *tiles;    ///< dt_liquify_tile_t by key
+  GHashTable *profiles; ///< dt_liquify_profile_t by key
+  uint64_t used;
+} dt_liquify_map_t;
+
 typedef struct
 {
   int warp_kernel;
+  dt_pthread_mutex_t map_lock;  ///< protects the maps and their contents
+  dt_liquify_map_t *map[DT_LIQUIFY_MAP_CACHE_SIZE];
+  uint64_t map_clock;
 } dt_iop_liquify_global_data_t;
 
 typedef struct
@@ -876,7 +912,10 @@ static float *build_lookup_table(const int distance,
     const float dx2 = x - crealf(cptr[-1]);
     *ptr++ = cimagf(cptr[0]) +(dx2 / dx1) * (cimagf(cptr[0]) - cimagf(cptr[-1]));
   }
-  *ptr++ = 0.0f;
+  // the curve may end before the last entries, the stamps cached in
+  // tiles must not depend on uninitialized memory
+  while(ptr < lookup + distance + 2)
+    *ptr++ = 0.0f;
 
   dt_free_align(clookup);
   return lookup;
@@ -912,15 +951,19 @@ static void compute_round_stamp_extent(cairo_rectangle_int_t *const restrict sta
   circumference get no warp. Between center and circumference the
   warp magnitude follows a curve with maximum at radius / 0.5
 
-  Our stamp is stored in a rectangular region.
+  The displacement map is stored in square tiles of the whole image at
+  the scale of the pipe, only the part of the stamp inside the tile at
+  (tile_x, tile_y) is added here.
 */
 
-static void apply_round_stamp(const dt_liquify_warp_t *const restrict warp,
-                              float complex *global_map,
-                              const cairo_rectangle_int_t *const restrict global_map_extent)
+static void _apply_round_stamp_tile(const dt_liquify_warp_t *const restrict warp,
+                                    const dt_liquify_profile_t *const restrict profile,
+                                    float complex *const restrict tile,
+                                    const int tile_x,
+                                    const int tile_y)
 {
-  const size_t iradius = round(cabsf(warp->radius - warp->point));
-  assert(iradius > 0);
+  const int iradius = profile->iradius;
+  const int side = iradius + 1;
 
   // 0.5 is factored in so the warp starts to degenerate when the
   // strength arrow crosses the warp radius.
@@ -930,36 +973,61 @@ static void apply_round_stamp(const dt_liquify_warp_t *const restrict warp,
   const float abs_strength
     = cabsf(strength) * (warp->type == DT_LIQUIFY_WARP_TYPE_RADIAL_SHRINK ? -1.0f : 1.0f);
 
-  // lookup table: map of distance from center point => warp
-  const size_t table_size = iradius * LOOKUP_OVERSAMPLE;
-  const float *const restrict lookup_table =
-    build_lookup_table(table_size, warp->control1, warp->control2);
-  if(!lookup_table)
+  // the center of the circle and its bounds inside the tile
+  const int stamp_x = round(crealf(warp->point));
+  const int stamp_y = round(cimagf(warp->point));
+  const int min_x = MAX(stamp_x - iradius, tile_x);
+  const int max_x = MIN(stamp_x + iradius, tile_x + DT_LIQUIFY_TILE_SIZE - 1);
+  const int min_y = MAX(stamp_y - iradius, tile_y);
+  const int max_y = MIN(stamp_y + iradius, tile_y + DT_LIQUIFY_TILE_SIZE - 1);
+
+  for(int y = min_y; y <= max_y; y++)
+  {
+    const int dy = y - stamp_y;
+    const float *const restrict weight = profile->weight + (size_t)abs(dy) * side;
+    float complex *const restrict row = tile + (size_t)(y - tile_y) * DT_LIQUIFY_TILE_SIZE - tile_x;
+    // the weights are 0 outside of the circle
+    if(warp->type == DT_LIQUIFY_WARP_TYPE_LINEAR)
+    {
+      for(int x = min_x; x <= max_x; x++)
+        row[x] += -strength * weight[abs(x - stamp_x)];
+    }
+    else
+    {
+      // DT_LIQUIFY_WARP_TYPE_RADIAL_GROW or _SHRINK
+      // abs_strength is negative for _SHRINK
+      for(int x = min_x; x <= max_x; x++)
+      {
+        const int dx = x - stamp_x;
+        const float abs_lookup = abs_strength * weight[abs(dx)] / iradius;
+        row[x] -= abs_lookup * (dx + dy * I);
+      }
+    }
+  }
+}
+
+// the warp intensity at the distances of the pixels of a quarter of
+// the stamp, the same for all the stamps of this radius and controls
+static void _build_profile(dt_liquify_profile_t *profile)
+{
+  const int iradius = profile->iradius;
+  const int side = iradius + 1;
+  const size_t table_size = (size_t)iradius * LOOKUP_OVERSAMPLE;
+  float *const restrict lookup_table =
+    build_lookup_table(table_size, profile->control1, profile->control2);
+  float *const restrict weight = dt_alloc_align_float((size_t)side * side);
+  if(!lookup_table || !weight)
   {
-    dt_free_align((void*)lookup_table);
-    dt_print(DT_DEBUG_ALWAYS,"[liquify] out of memory, round stamp skipped");
+    dt_free_align(lookup_table);
+    dt_free_align(weight);
     return;
   }
 
-  // point into the global distortion map at the center of the circle
-  const size_t global_width = global_map_extent->width;
-  const size_t stamp_x = (size_t) round(crealf(warp->point));
-  const size_t stamp_y = (size_t) round(cimagf(warp->point));
-  float complex *const center
-    = (global_map
-       + (stamp_y - global_map_extent->y) * global_width
-       + stamp_x - global_map_extent->x);
-
-  // The expensive operation here is hypotf ().  By dividing the
-  // circle in quadrants and doing only the inside we have to calculate
-  // hypotf only for PI / 16 = 0.196 of the stamp area.
-  // We don't do octants to avoid false sharing of cache lines between threads.
-  DT_OMP_FOR(dt_omp_sharedconst(LOOKUP_OVERSAMPLE))
-  for(size_t y = 0; y <= iradius; y++)
-  {
-    const float complex y_i = y * I;
-    const float y2 = y*y;
-    for(size_t x = 0; x <= iradius; x++)
+  memset(weight, 0, sizeof(float) * side * side);
+  for(int y = 0; y <= iradius; y++)
+  {
+    const float y2 = y * y;
+    for(int x = 0; x <= iradius; x++)
     {
       // faster than hypotf(), and we know we won't have overflow or denormals
       const float dist = sqrtf((float)x*x + y2);
@@ -967,42 +1035,290 @@ static void apply_round_stamp(const dt_liquify_warp_t *const restrict warp,
       if(idist >= table_size)
         // idist will only grow bigger in this row
         break;
+      weight[(size_t)y * side + x] = lookup_table[idist];
+    }
+  }
+
+  dt_free_align(lookup_table);
+  profile->weight = weight;
+}
+
+static inline int _tile_index(const int x)
+{
+  return x < 0 ? (x - DT_LIQUIFY_TILE_SIZE + 1) / DT_LIQUIFY_TILE_SIZE : x / DT_LIQUIFY_TILE_SIZE;
+}
+
+static inline int64_t _tile_key(const int tx, const int ty)
+{
+  return (int64_t)((uint64_t)(uint32_t)ty << 32 | (uint32_t)tx);
+}
+
+static void _tile_free(gpointer data)
+{
+  dt_liquify_tile_t *tile = (dt_liquify_tile_t *)data;
+  dt_free_align(tile->map);
+  free(tile);
+}
+
+static void _profile_free(gpointer data)
+{
+  dt_liquify_profile_t *profile = (dt_liquify_profile_t *)data;
+  dt_free_align(profile->weight);
+  free(profile);
+}
+
+static gboolean _tile_unused(gpointer key, gpointer value, gpointer clock)
+{
+  return ((dt_liquify_tile_t *)value)->used != *(uint64_t *)clock;
+}
+
+static gboolean _profile_unused(gpointer key, gpointer value, gpointer clock)
+{
+  return ((dt_liquify_profile_t *)value)->used != *(uint64_t *)clock;
+}
+
+static void _map_free(dt_liquify_map_t *map)
+{
+  if(!map) return;
+  g_hash_table_destroy(map->tiles);
+  g_hash_table_destroy(map->profiles);
+  free(map);
+}
+
+// the map of this scale, the least recently used one is dropped for a
+// new scale. Called with gd->map_lock held.
+static dt_liquify_map_t *_get_map(dt_iop_liquify_global_data_t *gd,
+                                  const float scale)
+{
+  dt_liquify_map_t *map = NULL;
+  for(int k = 0; k < DT_LIQUIFY_MAP_CACHE_SIZE && !map; k++)
+    if(gd->map[k] && gd->map[k]->scale == scale)
+      map = gd->map[k];
+
+  if(!map)
+  {
+    int slot = 0;
+    for(int k = 1; k < DT_LIQUIFY_MAP_CACHE_SIZE && gd->map[slot]; k++)
+      if(!gd->map[k] || gd->map[k]->used < gd->map[slot]->used)
+        slot = k;
+    _map_free(gd->map[slot]);
+    gd->map[slot] = NULL;
+
+    map = (dt_liquify_map_t *)calloc(1, sizeof(dt_liquify_map_t));
+    if(!map) return NULL;
+    map->scale = scale;
+    map->tiles = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, _tile_free);
+    map->profiles = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, _profile_free);
+    gd->map[slot] = map;
+  }
+  map->used = ++gd->map_clock;
+  return map;
+}
 
-      // pointers into the 4 quadrants of the circle
-      // quadrant count is ccw from positive x-axis
-      float complex *const q1 = center - y * global_width + x;
-      float complex *const q2 = center - y * global_width - x;
-      float complex *const q3 = center + y * global_width - x;
-      float complex *const q4 = center + y * global_width + x;
+// the profile of the warp, shared by the warps of same radius and
+// controls. A new one is only registered here and built by the caller.
+static dt_liquify_profile_t *_get_profile(dt_liquify_map_t *map,
+                                          const dt_liquify_warp_t *warp,
+                                          GPtrArray *missing)
+{
+  const int iradius = round(cabsf(warp->radius - warp->point));
+  assert(iradius > 0);
+  dt_hash_t hash = dt_hash(DT_INITHASH, &iradius, sizeof(iradius));
+  hash = dt_hash(hash, &warp->control1, sizeof(float));
+  hash = dt_hash(hash, &warp->control2, sizeof(float));
 
-      if(warp->type == DT_LIQUIFY_WARP_TYPE_LINEAR)
+  dt_liquify_profile_t *profile = g_hash_table_lookup(map->profiles, &hash);
+  if(!profile)
+  {
+    profile = (dt_liquify_profile_t *)calloc(1, sizeof(dt_liquify_profile_t));
+    if(!profile) return NULL;
+    profile->key = hash;
+    profile->iradius = iradius;
+    profile->control1 = warp->control1;
+    profile->control2 = warp->control2;
+    g_hash_table_insert(map->profiles, &profile->key, profile);
+    g_ptr_array_add(missing, profile);
+  }
+  profile->used = map->used;
+  return profile;
+}
+
+/*
+  Fills the map covering map_extent, which the caller zeroed, with the
+  tiles of the displacement map at this scale.
+
+  A tile is identified by the hash of the warps touching it, so that
+  only the tiles touched by the warps added, removed or changed since
+  the last call are stamped again. The tiles are kept between the calls
+  of all pipes rendering at the same scale and with the same warps, as
+  the full and preview pipes panning or zooming, or the tiles of an
+  export.
+*/
+
+static void _fill_global_distortion_map(dt_iop_liquify_global_data_t *gd,
+                                        const float scale,
+                                        const GList *interpolated,
+                                        float complex *const global_map,
+                                        const cairo_rectangle_int_t *const map_extent)
+{
+  const double start = dt_get_debug_wtime();
+  const int tx0 = _tile_index(map_extent->x);
+  const int ty0 = _tile_index(map_extent->y);
+  const int nx = _tile_index(map_extent->x + map_extent->width - 1) - tx0 + 1;
+  const int ny = _tile_index(map_extent->y + map_extent->height - 1) - ty0 + 1;
+  const size_t ntiles = (size_t)nx * ny;
+
+  // the warps touching each tile of the extent, in the order they are stamped
+  const int nwarps = g_list_length((GList *)interpolated);
+  const dt_liquify_warp_t **warps = g_new(const dt_liquify_warp_t *, nwarps);
+  GArray **touching = g_new0(GArray *, ntiles);
+  dt_hash_t *hash = g_new(dt_hash_t, ntiles);
+  for(size_t t = 0; t < ntiles; t++)
+    hash[t] = DT_INITHASH;
+
+  int n = 0;
+  for(const GList *i = interpolated; i; i = g_list_next(i), n++)
+  {
+    const dt_liquify_warp_t *warp = ((dt_liquify_warp_t *) i->data);
+    warps[n] = warp;
+    const int iradius = round(cabsf(warp->radius - warp->point));
+    const int stamp_x = round(crealf(warp->point));
+    const int stamp_y = round(cimagf(warp->point));
+    const int min_tx = MAX(_tile_index(stamp_x - iradius), tx0);
+    const int max_tx = MIN(_tile_index(stamp_x + iradius), tx0 + nx - 1);
+    const int min_ty = MAX(_tile_index(stamp_y - iradius), ty0);
+    const int max_ty = MIN(_tile_index(stamp_y + iradius), ty0 + ny - 1);
+    for(int ty = min_ty; ty <= max_ty; ty++)
+      for(int tx = min_tx; tx <= max_tx; tx++)
       {
-        const float complex w_strength = -strength * lookup_table[idist];
-        *q1 += w_strength;
-        if(x!=0)
-          *q2 += w_strength;
-        if(x!=0&&y!=0)
-          *q3 += w_strength;
-        if(y!=0)
-          *q4 += w_strength;
+        const size_t t = (size_t)(ty - ty0) * nx + tx - tx0;
+        if(!touching[t])
+          touching[t] = g_array_new(FALSE, FALSE, sizeof(int));
+        g_array_append_val(touching[t], n);
+        hash[t] = dt_hash(hash[t], warp, sizeof(dt_liquify_warp_t));
       }
-      else
+  }
+
+  dt_pthread_mutex_lock(&gd->map_lock);
+
+  dt_liquify_map_t *map = _get_map(gd, scale);
+  dt_liquify_tile_t **tiles = g_new0(dt_liquify_tile_t *, ntiles);
+  dt_liquify_profile_t **profiles = g_new0(dt_liquify_profile_t *, nwarps);
+  size_t *dirty = g_new(size_t, ntiles);
+  GPtrArray *missing = g_ptr_array_new();
+  size_t ndirty = 0;
+  gboolean oom = !map;
+
+  for(size_t t = 0; t < ntiles && map; t++)
+  {
+    if(!touching[t]) continue;
+
+    const int64_t key = _tile_key(tx0 + t % nx, ty0 + t / nx);
+    dt_liquify_tile_t *tile = g_hash_table_lookup(map->tiles, &key);
+    if(!tile)
+    {
+      tile = (dt_liquify_tile_t *)calloc(1, sizeof(dt_liquify_tile_t));
+      float complex *tile_map
+        = dt_alloc_align_type(float complex, DT_LIQUIFY_TILE_SIZE * DT_LIQUIFY_TILE_SIZE);
+      if(!tile || !tile_map)
       {
-        // DT_LIQUIFY_WARP_TYPE_RADIAL_GROW or _SHRINK
-        // abs_strength is negative for _SHRINK
-        const float abs_lookup = abs_strength * lookup_table[idist] / iradius;
-        *q1 -= abs_lookup * (x - y_i);
-        if(x!=0)
-          *q2 += abs_lookup * (x + y_i);
-        if(x!=0&&y!=0)
-          *q3 += abs_lookup * (x - y_i);
-        if(y!=0)
-          *q4 -= abs_lookup * (x + y_i);
+        free(tile);
+        dt_free_align(tile_map);
+        oom = TRUE;
+        continue;
       }
+      tile->key = key;
+      tile->hash = DT_INVALID_HASH;
+      tile->map = tile_map;
+      g_hash_table_insert(map->tiles, &tile->key, tile);
     }
+    tile->used = map->used;
+    tiles[t] = tile;
+
+    if(tile->hash == hash[t]) continue;
+
+    for(int k = 0; k < touching[t]->len; k++)
+    {
+      const int w = g_array_index(touching[t], int, k);
+      if(!profiles[w])
+        profiles[w] = _get_profile(map, warps[w], missing);
+      oom |= !profiles[w];
+    }
+    dirty[ndirty++] = t;
+  }
+
+  DT_OMP_PRAGMA(parallel for default(firstprivate) schedule(dynamic))
+  for(int k = 0; k < missing->len; k++)
+  {
+    _build_profile(g_ptr_array_index(missing, k));
+  }
+
+  DT_OMP_PRAGMA(parallel for default(firstprivate) schedule(dynamic))
+  for(size_t d = 0; d < ndirty; d++)
+  {
+    const size_t t = dirty[d];
+    dt_liquify_tile_t *tile = tiles[t];
+    const int tile_x = (tx0 + (int)(t % nx)) * DT_LIQUIFY_TILE_SIZE;
+    const int tile_y = (ty0 + (int)(t / nx)) * DT_LIQUIFY_TILE_SIZE;
+    memset(tile->map, 0, sizeof(float complex) * DT_LIQUIFY_TILE_SIZE * DT_LIQUIFY_TILE_SIZE);
+    gboolean complete = TRUE;
+    for(int k = 0; k < touching[t]->len; k++)
+    {
+      const int w = g_array_index(touching[t], int, k);
+      if(profiles[w] && profiles[w]->weight)
+        _apply_round_stamp_tile(warps[w], profiles[w], tile->map, tile_x, tile_y);
+      else
+        complete = FALSE;
+    }
+    // a tile missing a stamp is built again next time
+    tile->hash = complete ? hash[t] : DT_INVALID_HASH;
   }
 
-  dt_free_align((void*) lookup_table);
+  // copy the extent out of the tiles, the others stay at zero
+  DT_OMP_FOR()
+  for(int y = 0; y < map_extent->height; y++)
+  {
+    const int gy = map_extent->y + y;
+    const int ty = _tile_index(gy);
+    for(int tx = tx0; tx < tx0 + nx; tx++)
+    {
+      const dt_liquify_tile_t *tile = tiles[(size_t)(ty - ty0) * nx + tx - tx0];
+      if(!tile) continue;
+      const int tile_x = tx * DT_LIQUIFY_TILE_SIZE;
+      const int min_x = MAX(tile_x, map_extent->x);
+      const int max_x = MIN(tile_x + DT_LIQUIFY_TILE_SIZE, map_extent->x + map_extent->width);
+      memcpy(global_map + (size_t)y * map_extent->width + min_x - map_extent->x,
+             tile->map + (size_t)(gy - ty * DT_LIQUIFY_TILE_SIZE) * DT_LIQUIFY_TILE_SIZE
+                       + min_x - tile_x,
+             sizeof(float complex) * (max_x - min_x));
+    }
+  }
+
+  for(int k = 0; k < missing->len; k++)
+    oom |= !((dt_liquify_profile_t *)g_ptr_array_index(missing, k))->weight;
+
+  // keep only what this extent needs when the map grows too large
+  if(map && g_hash_table_size(map->tiles) > DT_LIQUIFY_MAP_MAX_TILES)
+    g_hash_table_foreach_remove(map->tiles, _tile_unused, &map->used);
+  if(map && g_hash_table_size(map->profiles) > DT_LIQUIFY_MAP_MAX_PROFILES)
+    g_hash_table_foreach_remove(map->profiles, _profile_unused, &map->used);
+
+  dt_pthread_mutex_unlock(&gd->map_lock);
+
+  if(oom)
+    dt_print(DT_DEBUG_ALWAYS, "[liquify] out of memory, round stamps skipped");
+  dt_print(DT_DEBUG_PERF, "[liquify] %d warps, %zu of %zu tiles stamped, %.3fs",
+           nwarps, ndirty, ntiles, dt_get_debug_wtime() - start);
+
+  for(size_t t = 0; t < ntiles; t++)
+    if(touching[t]) g_array_free(touching[t], TRUE);
+  g_free(touching);
+  g_free(hash);
+  g_free(warps);
+  g_free(tiles);
+  g_free(profiles);
+  g_free(dirty);
+  g_ptr_array_free(missing, TRUE);
 }
 
 /*
@@ -1095,8 +1411,10 @@ static GSList *_get_map_extent(const dt_iop_roi_t *roi_out,
   return g_slist_reverse(in_roi);
 }
 
-static float complex *create_global_distortion_map(const cairo_rectangle_int_t *map_extent,
-                                                   const GSList *interpolated,
+static float complex *create_global_distortion_map(dt_iop_liquify_global_data_t *gd,
+                                                   const float scale,
+                                                   const cairo_rectangle_int_t *map_extent,
+                                                   const GList *interpolated,
                                                    const gboolean inverted)
 {
   const int mapsize = map_extent->width * map_extent->height;
@@ -1113,11 +1431,7 @@ static float complex *create_global_distortion_map(const cairo_rectangle_int_t *
   memset(map, 0, sizeof(float complex) * mapsize);
 
   // build map
-  for(const GSList *i = interpolated; i; i = g_slist_next(i))
-  {
-    const dt_liquify_warp_t *warp = ((dt_liquify_warp_t *) i->data);
-    apply_round_stamp(warp, map, map_extent);
-  }
+  _fill_global_distortion_map(gd, scale, interpolated, map, map_extent);
 
   if(inverted)
   {
@@ -1192,7 +1506,8 @@ static void _build_global_distortion_map(const dt_iop_module_t *self,
   GSList *interpolated_in_roi = _get_map_extent(roi, interpolated, map_extent);
 
   if(map)
-    *map = create_global_distortion_map(map_extent, interpolated_in_roi, inverted);
+    *map = create_global_distortion_map(self->global_data, scale, map_extent,
+                                        interpolated, inverted);
 
   g_slist_free(interpolated_in_roi);
   g_list_free_full(interpolated, free);
@@ -1387,6 +1702,17 @@ void distort_mask(dt_iop_module_t *self,
   dt_free_align((void *) map);
 }
 
+void commit_params(dt_iop_module_t *self,
+                   dt_iop_params_t *params,
+                   dt_dev_pixelpipe_t *pipe,
+                   dt_dev_pixelpipe_iop_t *piece)
+{
+  memcpy(piece->data, params, self->params_size);
+
+  // unwarped pixels are copied, the others interpolated along the map
+  piece->distort_resample = DT_DEV_DISTORT_RESAMPLE_WARP;
+}
+
 void process(dt_iop_module_t *self,
              dt_dev_pixelpipe_iop_t *piece,
              const void *const in,
@@ -1587,16 +1913,20 @@ void init_global(dt_iop_module_so_t *self)
 {
   // called once at startup
   const int program = 17; // from programs.conf
-  dt_iop_liquify_global_data_t *gd =  malloc(sizeof(dt_iop_liquify_global_data_t));
+  dt_iop_liquify_global_data_t *gd = calloc(1, sizeof(dt_iop_liquify_global_data_t));
   self->data = gd;
   gd->warp_kernel = dt_opencl_create_kernel(program, "warp_kernel");
+  dt_pthread_mutex_init(&gd->map_lock, NULL);
 }
 
 void cleanup_global(dt_iop_module_so_t *self)
 {
   // called once at shutdown
-  const dt_iop_liquify_global_data_t *gd = self->data;
+  dt_iop_liquify_global_data_t *gd = self->data;
   dt_opencl_free_kernel(gd->warp_kernel);
+  for(int k = 0; k < DT_LIQUIFY_MAP_CACHE_SIZE; k++)
+    _map_free(gd->map[k]);
+  dt_pthread_mutex_destroy(&gd->map_lock);
   free(self->data);
   self->data = NULL;
 }
@@ -19,6 +19,7 @@
 
 #include "bauhaus/bauhaus.h"
 #include "common/imagebuf.h"
+#include "common/clut.h"
 #include "common/colorspaces.h"
 #include "common/colorspaces_inline_conversions.h"
 #include "common/file_location.h"
@@ -40,6 +41,8 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <dirent.h>
+#include <errno.h>
+#include <glib/gstdio.h>
 #if defined (_WIN32)
 #include "win/getdelim.h"
 #include "win/scandir.h"
@@ -51,6 +54,9 @@ DT_MODULE_INTROSPECTION(3, dt_iop_lut3d_params_t)
 #define DT_IOP_LUT3D_MAX_LUTNAME 128
 #define DT_IOP_LUT3D_CLUT_LEVEL 48
 #define DT_IOP_LUT3D_MAX_KEYPOINTS 2048
+#define DT_IOP_LUT3D_CACHE_VERSION 2
+// the least recently used cache files are removed beyond
+#define DT_IOP_LUT3D_CACHE_MAX_BYTES ((size_t)256 << 20)
 
 typedef enum dt_iop_lut3d_colorspace_t
 {
@@ -107,8 +113,22 @@ typedef struct dt_iop_lut3d_data_t
   dt_iop_lut3d_params_t params;
   float *clut;  // cube lut pointer
   uint16_t level; // cube_size
+  GMappedFile *mapped; // the cache file holding clut, if mapped
 } dt_iop_lut3d_data_t;
 
+// header of the binary cache files of the parsed LUT files, followed by
+// the 3 * level^3 + 1 floats of the clut. 64 bytes keep them aligned.
+typedef struct dt_iop_lut3d_cache_header_t
+{
+  char magic[8];        // "dtlut3d"
+  uint32_t version;
+  uint32_t level;
+  dt_hash_t source;     // hash of the contents of the LUT file
+  int64_t source_size;
+  dt_hash_t data;       // hash of the floats
+  uint8_t padding[24];
+} dt_iop_lut3d_cache_header_t;
+
 typedef struct dt_iop_lut3d_global_data_t
 {
   int kernel_lut3d_tetrahedral;
@@ -296,98 +316,18 @@ static void _correct_pixel_trilinear(const float *const in,
  }
 }
 
-// from OpenColorIO
-// https://github.com/imageworks/OpenColorIO/blob/master/src/OpenColorIO/ops/Lut3D/Lut3DOp.cpp
 static void _correct_pixel_tetrahedral(const float *const in,
                                        float *const out,
                                        const size_t pixel_nb,
                                        const float *const restrict clut,
                                        const uint16_t level)
 {
-  const size_t level2 = level * level;
-  const size_t level1_stride = 3 * level;
-  const size_t level2_stride = 3 * level2;
-  const size_t level12_stride = 3 * (level + level2);
-  const float flevel_1 = (float)(level - 1);
-
   DT_OMP_FOR()
   for(size_t k = 0; k < (size_t)(pixel_nb * 4); k+=4)
   {
-    const float *const input = in + k;
-    float *const output = ((float *const)out) + k;
-
-    dt_aligned_pixel_t rgbi;
-    dt_aligned_pixel_t rgbd;
-    for_each_channel(c)
-      rgbd[c] = CLIP(input[c]) * flevel_1;
-
-    for_each_channel(c)
-    {
-      rgbi[c] = CLAMP((int)rgbd[c], 0, level - 2);
-      rgbd[c] = rgbd[c] - rgbi[c]; // delta red/green/blue
-    }
-
-    // indexes of P000 to P111 in clut
-    const size_t color = rgbi[0] + rgbi[1] * level + rgbi[2] * level2;
-    const size_t i000 = color * 3;                     // P000
-    const size_t i100 = i000 + 3;                      // P100
-    const size_t i010 = i000 + level1_stride;          // P010
-    const size_t i110 = i010 + 3;                      // P110
-    const size_t i001 = i000 + level2_stride;          // P001
-    const size_t i101 = i001 + 3;                      // P101
-    const size_t i011 = i000 + level12_stride;         // P011
-    const size_t i111 = i011 + 3;                      // P111
-
-    if(rgbd[0] > rgbd[1])
-    {
-      if(rgbd[1] > rgbd[2])
-      {
-        // rgbd[0] > rgbd[1] > rgbd[2]
-        for_each_channel(c, aligned(output))
-          output[c] = ((1-rgbd[0])*clut[i000+c] + (rgbd[0]-rgbd[1])*clut[i100+c]
-                      + (rgbd[1]-rgbd[2])*clut[i110+c] + rgbd[2]*clut[i111+c]);
-      }
-      else if(rgbd[0] > rgbd[2])
-      {
-        // rgbd[0] > rgbd[2] >= rgbd[1]
-        for_each_channel(c, aligned(output))
-          output[c] = ((1-rgbd[0])*clut[i000+c] + (rgbd[0]-rgbd[2])*clut[i100+c]
-                      + (rgbd[2]-rgbd[1])*clut[i101+c] + rgbd[1]*clut[i111+c]);
-      }
-      else
-      {
-        // rgbd[2] >= rgbd[0] > rgbd[2]
-        for_each_channel(c, aligned(output))
-          output[c] = ((1-rgbd[2])*clut[i000+c] + (rgbd[2]-rgbd[0])*clut[i001+c]
-                      + (rgbd[0]-rgbd[1])*clut[i101+c] + rgbd[1]*clut[i111+c]);
-      }
-    }
-    else
-    {
-      if(rgbd[2] > rgbd[1])
-      {
-        // rgbd[2] > rgbd[1] >= rgbd[0]
-        for_each_channel(c, aligned(output))
-          output[c] = ((1-rgbd[2])*clut[i000+c] + (rgbd[2]-rgbd[1])*clut[i001+c]
-                      + (rgbd[1]-rgbd[0])*clut[i011+c] + rgbd[0]*clut[i111+c]);
-      }
-      else if(rgbd[2] > rgbd[0])
-      {
-        // rgbd[1] >= rgbd[2] > rgbd[0]
-        for_each_channel(c, aligned(output))
-          output[c] = ((1-rgbd[1])*clut[i000+c] + (rgbd[1]-rgbd[2])*clut[i010+c]
-                      + (rgbd[2]-rgbd[0])*clut[i011+c] + rgbd[0]*clut[i111+c]);
-      }
-      else
-      {
-        // rgbd[1] >= rgbd[0] >= rgbd[2]
-        for_each_channel(c, aligned(output))
-          output[c] = ((1-rgbd[1])*clut[i000+c] + (rgbd[1]-rgbd[0])*clut[i010+c]
-                      + (rgbd[0]-rgbd[2])*clut[i110+c] + rgbd[2]*clut[i111+c]);
-      }
-    }
     // not using non-temporal writes here, as those are substantially slower when in==out....
     // (which is the case when performing a colorspace conversion)
+    dt_clut_tetrahedral(in + k, out + k, clut, level);
   }
 }
 
@@ -1212,7 +1152,217 @@ void cleanup_global(dt_iop_module_so_t *self)
   self->data = NULL;
 }
 
-static int _calculate_clut(dt_iop_lut3d_params_t *const p, float **clut)
+
+/* The parsed cube, 3dl and png LUT files are kept in the user cache
+   directory as raw floats. The pipes and the darktable instances using
+   the same LUT map that file instead of parsing the text again, which
+   takes hundreds of milliseconds for large cubes.
+
+   The cache files are named after the hash of the contents of their LUT
+   file, so that any change of the LUT misses the cache, whatever its
+   modification time. Hashing the file is much cheaper than parsing it.
+   A hit refreshes the modification time of the cache file, and the least
+   recently used files are removed when the directory grows beyond
+   DT_IOP_LUT3D_CACHE_MAX_BYTES.
+*/
+static gchar *_get_clut_cache_dir(void)
+{
+  char cachedir[PATH_MAX] = { 0 };
+  dt_loc_get_user_cache_dir(cachedir, sizeof(cachedir));
+  return g_build_filename(cachedir, "lut3d", NULL);
+}
+
+static gchar *_get_clut_cache_filename(const char *const cachedir,
+                                       const dt_hash_t source)
+{
+  gchar *name = g_strdup_printf("%016" PRIx64 ".clut", (uint64_t)source);
+  gchar *filename = g_build_filename(cachedir, name, NULL);
+  g_free(name);
+  return filename;
+}
+
+// hash of the contents of the LUT file, DT_INVALID_HASH if it can't be read
+static dt_hash_t _hash_lut_file(const char *const filepath,
+                                int64_t *size)
+{
+  GMappedFile *file = g_mapped_file_new(filepath, FALSE, NULL);
+  if(!file) return DT_INVALID_HASH;
+  *size = g_mapped_file_get_length(file);
+  const dt_hash_t hash = dt_hash(DT_INITHASH, g_mapped_file_get_contents(file), *size);
+  g_mapped_file_unref(file);
+  return hash;
+}
+
+static uint16_t _read_cached_clut(const char *const cachedir,
+                                  const dt_hash_t source,
+                                  const int64_t source_size,
+                                  float **clut,
+                                  GMappedFile **mapped)
+{
+  gchar *filename = _get_clut_cache_filename(cachedir, source);
+  GMappedFile *file = g_mapped_file_new(filename, FALSE, NULL);
+  if(!file)
+  {
+    g_free(filename);
+    return 0;
+  }
+
+  const size_t length = g_mapped_file_get_length(file);
+  const char *contents = g_mapped_file_get_contents(file);
+  const dt_iop_lut3d_cache_header_t *header = (const dt_iop_lut3d_cache_header_t *)contents;
+  const size_t floats = length >= sizeof(dt_iop_lut3d_cache_header_t)
+    ? 3 * (size_t)header->level * header->level * header->level + 1
+    : 0;
+  const float *data = (const float *)(contents + sizeof(dt_iop_lut3d_cache_header_t));
+
+  const gboolean valid =
+    floats
+    && memcmp(header->magic, "dtlut3d", 8) == 0
+    && header->version == DT_IOP_LUT3D_CACHE_VERSION
+    && header->level >= 2 && header->level <= 256
+    && length == sizeof(dt_iop_lut3d_cache_header_t) + floats * sizeof(float)
+    && header->source == source
+    && header->source_size == source_size
+    // the interpolations read the floats as aligned pixels
+    && ((uintptr_t)data & 63) == 0
+    && header->data == dt_hash(DT_INITHASH, data, floats * sizeof(float));
+
+  if(!valid)
+  {
+    g_mapped_file_unref(file);
+    g_free(filename);
+    return 0;
+  }
+
+  // recently used, kept by the pruning
+  g_utime(filename, NULL);
+  g_free(filename);
+
+  dt_print(DT_DEBUG_DEV, "[lut3d] mapped cached clut %016" PRIx64 ", level %u",
+           (uint64_t)source, header->level);
+  *clut = (float *)data;
+  *mapped = file;
+  return header->level;
+}
+
+typedef struct _cache_file_t
+{
+  gchar *filename;
+  int64_t size;
+  int64_t mtime;
+} _cache_file_t;
+
+static gint _older_first(gconstpointer a,
+                         gconstpointer b)
+{
+  const _cache_file_t *fa = a;
+  const _cache_file_t *fb = b;
+  return (fa->mtime > fb->mtime) - (fa->mtime < fb->mtime);
+}
+
+// removes the least recently used cache files beyond max_bytes, but keep
+static void _prune_clut_cache(const char *const cachedir,
+                              const size_t max_bytes,
+                              const char *const keep)
+{
+  GDir *dir = g_dir_open(cachedir, 0, NULL);
+  if(!dir) return;
+
+  GList *files = NULL;
+  size_t total = 0;
+  const gchar *name;
+  while((name = g_dir_read_name(dir)))
+  {
+    if(!g_str_has_suffix(name, ".clut")) continue;
+    gchar *filename = g_build_filename(cachedir, name, NULL);
+    GStatBuf st;
+    if(g_stat(filename, &st) != 0)
+    {
+      g_free(filename);
+      continue;
+    }
+    total += st.st_size;
+    if(!g_strcmp0(filename, keep))
+    {
+      g_free(filename);
+      continue;
+    }
+    _cache_file_t *file = g_malloc(sizeof(_cache_file_t));
+    file->filename = filename;
+    file->size = st.st_size;
+    file->mtime = st.st_mtime;
+    files = g_list_prepend(files, file);
+  }
+  g_dir_close(dir);
+
+  files = g_list_sort(files, _older_first);
+  for(GList *f = files; f && total > max_bytes; f = g_list_next(f))
+  {
+    _cache_file_t *file = f->data;
+    if(g_unlink(file->filename) == 0)
+    {
+      dt_print(DT_DEBUG_DEV, "[lut3d] removed cached clut `%s'", file->filename);
+      total -= file->size;
+    }
+  }
+
+  for(GList *f = files; f; f = g_list_next(f))
+  {
+    _cache_file_t *file = f->data;
+    g_free(file->filename);
+    g_free(file);
+  }
+  g_list_free(files);
+}
+
+static void _write_cached_clut(const char *const cachedir,
+                               const dt_hash_t source,
+                               const int64_t source_size,
+                               const float *const clut,
+                               const uint16_t level)
+{
+  const size_t floats = 3 * (size_t)level * level * level + 1;
+  const size_t length = sizeof(dt_iop_lut3d_cache_header_t) + floats * sizeof(float);
+  char *contents = g_try_malloc0(length);
+  if(!contents) return;
+
+  dt_iop_lut3d_cache_header_t *header = (dt_iop_lut3d_cache_header_t *)contents;
+  memcpy(header->magic, "dtlut3d", 8);
+  header->version = DT_IOP_LUT3D_CACHE_VERSION;
+  header->level = level;
+  header->source = source;
+  header->source_size = source_size;
+  memcpy(contents + sizeof(dt_iop_lut3d_cache_header_t), clut, floats * sizeof(float));
+  header->data = dt_hash(DT_INITHASH, contents + sizeof(dt_iop_lut3d_cache_header_t),
+                         floats * sizeof(float));
+
+  // written to a temporary file and renamed, a concurrent reader never
+  // maps a partial file
+  gchar *filename = _get_clut_cache_filename(cachedir, source);
+  GError *error = NULL;
+  if(g_mkdir_with_parents(cachedir, 0700) == -1
+     || !g_file_set_contents(filename, contents, length, &error))
+    dt_print(DT_DEBUG_ALWAYS, "[lut3d] can't write the clut cache file `%s': %s",
+             filename, error ? error->message : g_strerror(errno));
+  else
+    _prune_clut_cache(cachedir, DT_IOP_LUT3D_CACHE_MAX_BYTES, filename);
+  g_clear_error(&error);
+  g_free(filename);
+  g_free(contents);
+}
+
+static void _free_clut(dt_iop_lut3d_data_t *d)
+{
+  if(d->mapped)
+    g_mapped_file_unref(d->mapped);
+  else
+    dt_free_align(d->clut);
+  d->mapped = NULL;
+  d->clut = NULL;
+  d->level = 0;
+}
+
+static int _calculate_clut(dt_iop_lut3d_params_t *const p, float **clut, GMappedFile **mapped)
 {
   uint16_t level = 0;
   const char *filepath = p->filepath;
@@ -1229,18 +1379,29 @@ static int _calculate_clut(dt_iop_lut3d_params_t *const p, float **clut)
     if(filepath[0] && lutfolder[0])
     {
       char *fullpath = g_build_filename(lutfolder, filepath, NULL);
-      if(g_str_has_suffix (filepath, ".png") || g_str_has_suffix (filepath, ".PNG"))
-      {
-        level = _calculate_clut_haldclut(p, fullpath, clut);
-      }
-      else if(g_str_has_suffix (filepath, ".cube") || g_str_has_suffix (filepath, ".CUBE"))
-      {
-        level = _calculate_clut_cube(fullpath, clut);
-      }
-      else if(g_str_has_suffix (filepath, ".3dl") || g_str_has_suffix (filepath, ".3DL"))
+      gchar *cachedir = _get_clut_cache_dir();
+      int64_t size = 0;
+      const dt_hash_t source = _hash_lut_file(fullpath, &size);
+      if(source != DT_INVALID_HASH)
+        level = _read_cached_clut(cachedir, source, size, clut, mapped);
+      if(!level)
       {
-        level = _calculate_clut_3dl(fullpath, clut);
+        if(g_str_has_suffix (filepath, ".png") || g_str_has_suffix (filepath, ".PNG"))
+        {
+          level = _calculate_clut_haldclut(p, fullpath, clut);
+        }
+        else if(g_str_has_suffix (filepath, ".cube") || g_str_has_suffix (filepath, ".CUBE"))
+        {
+          level = _calculate_clut_cube(fullpath, clut);
+        }
+        else if(g_str_has_suffix (filepath, ".3dl") || g_str_has_suffix (filepath, ".3DL"))
+        {
+          level = _calculate_clut_3dl(fullpath, clut);
+        }
+        if(level && source != DT_INVALID_HASH)
+          _write_cached_clut(cachedir, source, size, *clut, level);
       }
+      g_free(cachedir);
       g_free(fullpath);
     }
     g_free(lutfolder);
@@ -1425,13 +1586,9 @@ void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_
 
   if(strcmp(p->filepath, d->params.filepath) != 0 || strcmp(p->lutname, d->params.lutname) != 0 )
   { // new clut file
-    if(d->clut)
-    { // reset current clut if any
-      dt_free_align(d->clut);
-      d->clut = NULL;
-      d->level = 0;
-    }
-    d->level = _calculate_clut(p, &d->clut);
+    // reset current clut if any
+    _free_clut(d);
+    d->level = _calculate_clut(p, &d->clut, &d->mapped);
   }
   memcpy(&d->params, p, sizeof(dt_iop_lut3d_params_t));
 }
@@ -1443,16 +1600,14 @@ void init_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe
   memcpy(&d->params, self->default_params, sizeof(dt_iop_lut3d_params_t));
   d->clut = NULL;
   d->level = 0;
+  d->mapped = NULL;
   d->params.filepath[0] = '\0';
 }
 
 void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
   dt_iop_lut3d_data_t *d = piece->data;;
-  if(d->clut)
-    dt_free_align(d->clut);
-  d->clut = NULL;
-  d->level = 0;
+  _free_clut(d);
   free(piece->data);
   piece->data = NULL;
 }
@@ -22,6 +22,7 @@
 #include "common/darktable.h"
 #include "common/debug.h"
 #include "common/tags.h"
+#include "common/tag_tree.h"
 #include "control/conf.h"
 #include "control/control.h"
 #include "dtgtk/button.h"
@@ -56,6 +57,7 @@ typedef struct dt_lib_tagging_t
   GtkListStore *attached_liststore, *dictionary_liststore;
   GtkTreeStore *dictionary_treestore;
   GtkTreeModelFilter *dictionary_listfilter, *dictionary_treefilter;
+  dt_tag_tree_t *tag_tree;
   GtkWidget *floating_tag_window;
   GList *floating_tag_imgs;
   gboolean tree_flag, suggestion_flag, sort_count_flag, hide_path_flag, dttags_flag;
@@ -170,19 +172,20 @@ static void _update_atdetach_buttons(dt_lib_module_t *self)
                            has_act_on && attached_tags_sel);
 }
 
-static void _propagate_sel_to_parents(GtkTreeModel *model,
-                                      GtkTreeIter *iter)
+static gboolean _tag_matches_keyword(const char *keyword,
+                                     const char *tagname,
+                                     const char *synonyms)
 {
-  guint sel;
-  GtkTreeIter parent, child = *iter;
-  while(gtk_tree_model_iter_parent(model, &parent, &child))
-  {
-    gtk_tree_model_get(model, &parent, DT_LIB_TAGGING_COL_SEL, &sel, -1);
-    if(sel == DT_TS_NO_IMAGE)
-      gtk_tree_store_set(GTK_TREE_STORE(model), &parent,
-                         DT_LIB_TAGGING_COL_SEL, DT_TS_SOME_IMAGES, -1);
-    child = parent;
-  }
+  gchar *text = (synonyms && synonyms[0])
+    ? g_strdup_printf("%s, %s", tagname, synonyms)
+    : g_strdup(tagname);
+  gchar *haystack = g_utf8_strdown(text, -1);
+  gchar *needle = g_utf8_strdown(keyword, -1);
+  const gboolean match = (g_strrstr(haystack, needle) != NULL);
+  g_free(haystack);
+  g_free(needle);
+  g_free(text);
+  return match;
 }
 
 static gboolean _set_matching_tag_visibility(GtkTreeModel *model,
@@ -199,15 +202,10 @@ static gboolean _set_matching_tag_visibility(GtkTreeModel *model,
                      DT_LIB_TAGGING_COL_SYNONYM, &synonyms, -1);
   if(!d->keyword[0])
     visible = TRUE;
+  else if(!tagname)
+    visible = FALSE; // fake child of a tree row not filled yet
   else
-  {
-    if(synonyms && synonyms[0]) dt_util_str_cat(&tagname, ", %s", synonyms);
-    gchar *haystack = g_utf8_strdown(tagname, -1);
-    gchar *needle = g_utf8_strdown(d->keyword, -1);
-    visible = (g_strrstr(haystack, needle) != NULL);
-    g_free(haystack);
-    g_free(needle);
-  }
+    visible = _tag_matches_keyword(d->keyword, tagname, synonyms);
   if(d->tree_flag)
     gtk_tree_store_set(GTK_TREE_STORE(model), iter,
                        DT_LIB_TAGGING_COL_VISIBLE, visible, -1);
@@ -280,6 +278,334 @@ static void _sort_dictionary_list(dt_lib_module_t *self,
                                          DT_TAG_SORT_PATH_ID, GTK_SORT_ASCENDING);
 }
 
+// the tree store is filled from the tag tree on demand. A row whose
+// children are not in the store yet gets a fake child (without path)
+// so that it can be expanded, the children are added when it is.
+static void _tree_insert_node(dt_lib_module_t *self,
+                              GtkTreeIter *parent,
+                              const dt_tag_node_t *node,
+                              GtkTreeIter *iter)
+{
+  dt_lib_tagging_t *d = self->data;
+  GtkTreeStore *store = d->dictionary_treestore;
+  gtk_tree_store_insert_with_values(store, iter, parent, -1,
+                                    DT_LIB_TAGGING_COL_TAG, node->name,
+                                    DT_LIB_TAGGING_COL_ID, node->tagid,
+                                    DT_LIB_TAGGING_COL_PATH, node->path,
+                                    DT_LIB_TAGGING_COL_COUNT, node->count,
+                                    DT_LIB_TAGGING_COL_SEL, dt_tag_tree_node_select(node),
+                                    DT_LIB_TAGGING_COL_FLAGS, node->flags,
+                                    DT_LIB_TAGGING_COL_SYNONYM, node->synonym,
+                                    DT_LIB_TAGGING_COL_VISIBLE, TRUE,
+                                    -1);
+  if(d->keyword[0])
+    _set_matching_tag_visibility(GTK_TREE_MODEL(store), NULL, iter, self);
+  if(dt_tag_tree_node_has_children(node))
+    gtk_tree_store_insert_with_values(store, NULL, iter, -1,
+                                      DT_LIB_TAGGING_COL_VISIBLE, !d->keyword[0],
+                                      -1);
+}
+
+static gboolean _tree_has_fake_child(GtkTreeModel *model,
+                                     GtkTreeIter *parent,
+                                     GtkTreeIter *child)
+{
+  if(!gtk_tree_model_iter_children(model, child, parent)) return FALSE;
+  gchar *path = NULL;
+  gtk_tree_model_get(model, child, DT_LIB_TAGGING_COL_PATH, &path, -1);
+  g_free(path);
+  return path == NULL;
+}
+
+// replace the fake child of the row by the children from the tag tree
+static void _tree_fill_children(dt_lib_module_t *self,
+                                GtkTreeIter *parent)
+{
+  dt_lib_tagging_t *d = self->data;
+  GtkTreeModel *model = GTK_TREE_MODEL(d->dictionary_treestore);
+  GtkTreeIter fake;
+  if(!d->tag_tree || !_tree_has_fake_child(model, parent, &fake)) return;
+
+  gchar *path = NULL;
+  gtk_tree_model_get(model, parent, DT_LIB_TAGGING_COL_PATH, &path, -1);
+  const dt_tag_node_t *node = path && path[0] ? dt_tag_tree_find(d->tag_tree, path) : NULL;
+  g_free(path);
+
+  // sort once when all the children are in
+  gint sort_column;
+  GtkSortType sort_order;
+  const gboolean sorted =
+    gtk_tree_sortable_get_sort_column_id(GTK_TREE_SORTABLE(model), &sort_column, &sort_order);
+  if(sorted)
+    gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(model),
+                                         GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID,
+                                         GTK_SORT_ASCENDING);
+  if(node && node->children)
+  {
+    for(guint i = 0; i < node->children->len; i++)
+    {
+      GtkTreeIter iter;
+      _tree_insert_node(self, parent, g_ptr_array_index(node->children, i), &iter);
+    }
+  }
+  gtk_tree_store_remove(d->dictionary_treestore, &fake);
+  if(sorted)
+    gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(model), sort_column, sort_order);
+}
+
+static void _tree_fill_subtree_unsorted(dt_lib_module_t *self,
+                                        GtkTreeIter *parent)
+{
+  dt_lib_tagging_t *d = self->data;
+  GtkTreeModel *model = GTK_TREE_MODEL(d->dictionary_treestore);
+  _tree_fill_children(self, parent);
+  GtkTreeIter child;
+  gboolean valid = gtk_tree_model_iter_children(model, &child, parent);
+  while(valid)
+  {
+    _tree_fill_subtree_unsorted(self, &child);
+    valid = gtk_tree_model_iter_next(model, &child);
+  }
+}
+
+static void _tree_fill_subtree(dt_lib_module_t *self,
+                               GtkTreeIter *parent)
+{
+  // the rows must not move while walking through them
+  dt_lib_tagging_t *d = self->data;
+  GtkTreeSortable *sortable = GTK_TREE_SORTABLE(d->dictionary_treestore);
+  gint sort_column;
+  GtkSortType sort_order;
+  const gboolean sorted = gtk_tree_sortable_get_sort_column_id(sortable, &sort_column, &sort_order);
+  gtk_tree_sortable_set_sort_column_id(sortable, GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID,
+                                       GTK_SORT_ASCENDING);
+  _tree_fill_subtree_unsorted(self, parent);
+  if(sorted)
+    gtk_tree_sortable_set_sort_column_id(sortable, sort_column, sort_order);
+}
+
+// find the row of a direct child with the given path
+static gboolean _tree_find_child(GtkTreeModel *model,
+                                 GtkTreeIter *parent,
+                                 const char *path,
+                                 GtkTreeIter *iter)
+{
+  gboolean valid = parent ? gtk_tree_model_iter_children(model, iter, parent)
+                          : gtk_tree_model_get_iter_first(model, iter);
+  while(valid)
+  {
+    gchar *row_path = NULL;
+    gtk_tree_model_get(model, iter, DT_LIB_TAGGING_COL_PATH, &row_path, -1);
+    const gboolean found = !g_strcmp0(row_path, path);
+    g_free(row_path);
+    if(found) return TRUE;
+    valid = gtk_tree_model_iter_next(model, iter);
+  }
+  return FALSE;
+}
+
+// get the row of a path in the tree store. With fill the missing
+// levels are added from the tag tree.
+static gboolean _tree_get_iter(dt_lib_module_t *self,
+                               const char *path,
+                               const gboolean fill,
+                               GtkTreeIter *iter)
+{
+  dt_lib_tagging_t *d = self->data;
+  GtkTreeModel *model = GTK_TREE_MODEL(d->dictionary_treestore);
+  if(!path || !path[0]) return FALSE;
+
+  gchar **tokens = g_strsplit(path, "|", -1);
+  gchar *prefix = NULL;
+  gboolean found = TRUE;
+  GtkTreeIter parent = { 0 };
+  for(int i = 0; found && tokens[i]; i++)
+  {
+    dt_util_str_cat(&prefix, i ? "|%s" : "%s", tokens[i]);
+    if(i && fill) _tree_fill_children(self, &parent);
+    found = _tree_find_child(model, i ? &parent : NULL, prefix, iter);
+    parent = *iter;
+  }
+  g_free(prefix);
+  g_strfreev(tokens);
+  return found;
+}
+
+// bring the rows of a path and of its ancestors in line with the tag
+// tree, after a tag has been attached, detached, created or removed
+static void _tree_sync_path(dt_lib_module_t *self,
+                            const char *path)
+{
+  dt_lib_tagging_t *d = self->data;
+  GtkTreeModel *model = GTK_TREE_MODEL(d->dictionary_treestore);
+  if(!d->tag_tree || !path || !path[0]) return;
+
+  gchar **tokens = g_strsplit(path, "|", -1);
+  gchar *prefix = NULL;
+  GtkTreeIter iter, parent = { 0 }, fake;
+  for(int i = 0; tokens[i]; i++)
+  {
+    dt_util_str_cat(&prefix, i ? "|%s" : "%s", tokens[i]);
+    const dt_tag_node_t *node = dt_tag_tree_find(d->tag_tree, prefix);
+    const gboolean found = _tree_find_child(model, i ? &parent : NULL, prefix, &iter);
+    if(!node)
+    {
+      // removed with its children
+      if(found) gtk_tree_store_remove(d->dictionary_treestore, &iter);
+      break;
+    }
+    if(!found)
+    {
+      // not shown yet, it will be added with its parent
+      if(i && _tree_has_fake_child(model, &parent, &fake)) break;
+      _tree_insert_node(self, i ? &parent : NULL, node, &iter);
+    }
+    else
+    {
+      gtk_tree_store_set(d->dictionary_treestore, &iter,
+                         DT_LIB_TAGGING_COL_ID, node->tagid,
+                         DT_LIB_TAGGING_COL_COUNT, node->count,
+                         DT_LIB_TAGGING_COL_SEL, dt_tag_tree_node_select(node),
+                         DT_LIB_TAGGING_COL_FLAGS, node->flags,
+                         DT_LIB_TAGGING_COL_SYNONYM, node->synonym,
+                         -1);
+      if(!dt_tag_tree_node_has_children(node) && _tree_has_fake_child(model, &iter, &fake))
+        gtk_tree_store_remove(d->dictionary_treestore, &fake);
+    }
+    parent = iter;
+  }
+  g_free(prefix);
+  g_strfreev(tokens);
+}
+
+// update the cached count and selection state of a tag
+static void _tree_update_tag(dt_lib_module_t *self,
+                             const guint tagid,
+                             const guint count,
+                             const gint select)
+{
+  dt_lib_tagging_t *d = self->data;
+  const dt_tag_node_t *node = d->tag_tree ? dt_tag_tree_find_id(d->tag_tree, tagid) : NULL;
+  if(!node) return;
+  dt_tag_tree_set_count(d->tag_tree, tagid, count);
+  if(select >= 0)
+    dt_tag_tree_set_select(d->tag_tree, tagid, select);
+  _tree_sync_path(self, node->path);
+}
+
+static void _tree_remove_tag(dt_lib_module_t *self,
+                             const guint tagid)
+{
+  dt_lib_tagging_t *d = self->data;
+  const dt_tag_node_t *node = d->tag_tree ? dt_tag_tree_find_id(d->tag_tree, tagid) : NULL;
+  if(!node) return;
+  gchar *path = g_strdup(node->path);
+  dt_tag_tree_remove(d->tag_tree, tagid);
+  _tree_sync_path(self, path);
+  g_free(path);
+}
+
+// move the tags of a family to their new names, keeping their state
+static void _tree_rename_tags(dt_lib_module_t *self,
+                              const GList *tag_family,
+                              const int prefix_len,
+                              const char *new_prefix)
+{
+  dt_lib_tagging_t *d = self->data;
+  if(!d->tag_tree) return;
+  GList *moved = NULL;
+  for(const GList *taglist = tag_family; taglist; taglist = g_list_next(taglist))
+  {
+    const dt_tag_t *tag = taglist->data;
+    const dt_tag_node_t *node = dt_tag_tree_find_id(d->tag_tree, tag->id);
+    if(!node) continue;
+    dt_tag_t *t = g_malloc0(sizeof(dt_tag_t));
+    t->id = node->tagid;
+    t->tag = g_strconcat(new_prefix, &tag->tag[prefix_len], NULL);
+    t->count = node->count;
+    t->select = node->select;
+    t->flags = node->flags;
+    t->synonym = g_strdup(node->synonym);
+    moved = g_list_prepend(moved, t);
+    _tree_remove_tag(self, tag->id);
+  }
+  for(GList *taglist = moved; taglist; taglist = g_list_next(taglist))
+  {
+    dt_tag_tree_insert(d->tag_tree, (dt_tag_t *)taglist->data);
+    _tree_sync_path(self, ((dt_tag_t *)taglist->data)->tag);
+  }
+  dt_tag_free_result(&moved);
+}
+
+static void _tree_fill_matching_node(dt_lib_module_t *self,
+                                     const dt_tag_node_t *node)
+{
+  dt_lib_tagging_t *d = self->data;
+  if(!node->children) return;
+  for(guint i = 0; i < node->children->len; i++)
+  {
+    const dt_tag_node_t *child = g_ptr_array_index(node->children, i);
+    GtkTreeIter iter;
+    if(_tag_matches_keyword(d->keyword, child->path, child->synonym))
+      _tree_get_iter(self, child->path, TRUE, &iter);
+    _tree_fill_matching_node(self, child);
+  }
+}
+
+// make the rows of the tags matching the keyword available to the filter
+static void _tree_fill_matching(dt_lib_module_t *self)
+{
+  dt_lib_tagging_t *d = self->data;
+  if(!d->tree_flag || !d->tag_tree || !d->keyword[0]) return;
+  GtkTreeSortable *sortable = GTK_TREE_SORTABLE(d->dictionary_treestore);
+  gint sort_column;
+  GtkSortType sort_order;
+  const gboolean sorted = gtk_tree_sortable_get_sort_column_id(sortable, &sort_column, &sort_order);
+  gtk_tree_sortable_set_sort_column_id(sortable, GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID,
+                                       GTK_SORT_ASCENDING);
+  _tree_fill_matching_node(self, &d->tag_tree->root);
+  if(sorted)
+    gtk_tree_sortable_set_sort_column_id(sortable, sort_column, sort_order);
+}
+
+static gboolean _dictionary_test_expand_row(GtkTreeView *view,
+                                            GtkTreeIter *iter,
+                                            GtkTreePath *path,
+                                            dt_lib_module_t *self)
+{
+  dt_lib_tagging_t *d = self->data;
+  if(d->tree_flag)
+  {
+    GtkTreeIter store_iter;
+    gtk_tree_model_filter_convert_iter_to_child_iter
+      (GTK_TREE_MODEL_FILTER(gtk_tree_view_get_model(view)), &store_iter, iter);
+    _tree_fill_children(self, &store_iter);
+  }
+  return FALSE;
+}
+
+// test-expand-row is only raised for the row itself, not for its
+// descendants when all are expanded
+static void _tree_expand_row(dt_lib_module_t *self,
+                             GtkTreeView *view,
+                             GtkTreePath *path,
+                             const gboolean open_all)
+{
+  dt_lib_tagging_t *d = self->data;
+  if(d->tree_flag && open_all)
+  {
+    GtkTreeModel *model = gtk_tree_view_get_model(view);
+    GtkTreeIter iter, store_iter;
+    if(gtk_tree_model_get_iter(model, &iter, path))
+    {
+      gtk_tree_model_filter_convert_iter_to_child_iter(GTK_TREE_MODEL_FILTER(model),
+                                                       &store_iter, &iter);
+      _tree_fill_subtree(self, &store_iter);
+    }
+  }
+  gtk_tree_view_expand_row(view, path, open_all);
+}
+
 // find a tag on the tree
 static gboolean _find_tag_iter_tagname(GtkTreeModel *model,
                                        GtkTreeIter *iter,
@@ -292,7 +618,9 @@ static gboolean _find_tag_iter_tagname(GtkTreeModel *model,
   do
   {
     gtk_tree_model_get(model, iter, DT_LIB_TAGGING_COL_PATH, &path, -1);
-    if(needle)
+    if(!path)
+      found = FALSE;
+    else if(needle)
     {
       gchar *haystack = g_utf8_strdown(path, -1);
       found = g_strstr_len(haystack, strlen(haystack), tagname) != NULL;
@@ -332,18 +660,23 @@ static void _show_iter_on_view(GtkTreeView *view,
   }
 }
 
-// make the tag visible on view
-static void _show_tag_on_view(GtkTreeView *view,
+// make the tag visible on dictionary view
+static void _show_tag_on_view(dt_lib_module_t *self,
                               const char *tagname,
                               const gboolean needle,
                               const gboolean select)
 {
+  dt_lib_tagging_t *d = self->data;
+  GtkTreeView *view = d->dictionary_view;
   if(tagname)
   {
     char *lt = g_strdup(tagname);
     char *t = g_strstrip(lt);
     GtkTreeIter iter;
     GtkTreeModel *model = gtk_tree_view_get_model(view);
+    // the matching rows have been added along with the keyword
+    if(d->tree_flag && !needle)
+      _tree_get_iter(self, t, TRUE, &iter);
     if(gtk_tree_model_get_iter_first(model, &iter))
     {
       if(_find_tag_iter_tagname(model, &iter, t, needle))
@@ -353,12 +686,12 @@ static void _show_tag_on_view(GtkTreeView *view,
   }
 }
 
-static void _show_keyword_on_view(GtkTreeView *view,
+static void _show_keyword_on_view(dt_lib_module_t *self,
                                   const char *keyword,
                                   const gboolean select)
 {
   gchar *needle = g_utf8_strdown(keyword, -1);
-  _show_tag_on_view(view, needle, TRUE, select);
+  _show_tag_on_view(self, needle, TRUE, select);
   g_free(needle);
 }
 
@@ -460,81 +793,16 @@ static void _init_treeview(dt_lib_module_t *self,
   if(which && d->tree_flag)
   {
     gtk_tree_store_clear(GTK_TREE_STORE(store));
+    dt_tag_tree_free(d->tag_tree);
+    d->tag_tree = dt_tag_tree_new();
+    dt_tag_tree_insert_list(d->tag_tree, tags);
+    // only the first level goes to the store, the deeper ones are
+    // added when expanded
+    const dt_tag_node_t *root = &d->tag_tree->root;
+    if(root->children)
     {
-      char **last_tokens = NULL;
-      int last_tokens_length = 0;
-      GtkTreeIter last_parent = { 0 };
-      GList *sorted_tags = dt_sort_tag(tags, 0);  // ordered by full tag name
-      tags = sorted_tags;
-      for(GList *taglist = tags; taglist; taglist = g_list_next(taglist))
-      {
-        const gchar *tag = ((dt_tag_t *)taglist->data)->tag;
-        if(tag == NULL) continue;
-        char **tokens;
-        tokens = g_strsplit(tag, "|", -1);
-        if(tokens)
-        {
-          // find the number of common parts at the beginning of tokens and last_tokens
-          GtkTreeIter parent = last_parent;
-          const int tokens_length = g_strv_length(tokens);
-          int common_length = 0;
-          if(last_tokens)
-          {
-            while(tokens[common_length] && last_tokens[common_length] &&
-                  !g_strcmp0(tokens[common_length], last_tokens[common_length]))
-            {
-              common_length++;
-            }
-
-            // point parent iter to where the entries should be added
-            for(int i = common_length; i < last_tokens_length; i++)
-            {
-              gtk_tree_model_iter_parent(GTK_TREE_MODEL(store), &parent, &last_parent);
-              last_parent = parent;
-            }
-          }
-
-          // insert everything from tokens past the common part
-          char *pth = NULL;
-          for(int i = 0; i < common_length; i++)
-            dt_util_str_cat(&pth, "%s|", tokens[i]);
-
-          for(char **token = &tokens[common_length]; *token; token++)
-          {
-            dt_util_str_cat(&pth, "%s|", *token);
-            gchar *pth2 = g_strdup(pth);
-            pth2[strlen(pth2) - 1] = '\0';
-            gtk_tree_store_insert_with_values
-              (GTK_TREE_STORE(store), &iter,
-               common_length > 0 ? &parent : NULL, -1,
-               DT_LIB_TAGGING_COL_TAG, *token,
-               DT_LIB_TAGGING_COL_ID, (token == &tokens[tokens_length-1]) ?
-               ((dt_tag_t *)taglist->data)->id : 0,
-               DT_LIB_TAGGING_COL_PATH, pth2,
-               DT_LIB_TAGGING_COL_COUNT, (token == &tokens[tokens_length-1]) ?
-               ((dt_tag_t *)taglist->data)->count : 0,
-               DT_LIB_TAGGING_COL_SEL, ((dt_tag_t *)taglist->data)->select,
-               DT_LIB_TAGGING_COL_FLAGS, ((dt_tag_t *)taglist->data)->flags,
-               DT_LIB_TAGGING_COL_SYNONYM, ((dt_tag_t *)taglist->data)->synonym,
-               DT_LIB_TAGGING_COL_VISIBLE, TRUE,
-               -1);
-
-            if(((dt_tag_t *)taglist->data)->select)
-              _propagate_sel_to_parents(GTK_TREE_MODEL(store), &iter);
-            common_length++;
-            parent = iter;
-            g_free(pth2);
-          }
-          g_free(pth);
-
-          // remember things for the next round
-          if(last_tokens) g_strfreev(last_tokens);
-          last_tokens = tokens;
-          last_parent = parent;
-          last_tokens_length = tokens_length;
-        }
-      }
-      g_strfreev(last_tokens);
+      for(guint i = 0; i < root->children->len; i++)
+        _tree_insert_node(self, NULL, g_ptr_array_index(root->children, i), &iter);
     }
     // recreate the filter on the freshly populated store
     model = gtk_tree_model_filter_new(store, NULL);
@@ -543,6 +811,7 @@ static void _init_treeview(dt_lib_module_t *self,
     d->dictionary_treefilter = GTK_TREE_MODEL_FILTER(model);
     if(d->keyword[0])
     {
+      _tree_fill_matching(self);
       gtk_tree_model_foreach(store,
                              (GtkTreeModelForeachFunc)_set_matching_tag_visibility, self);
       gtk_tree_model_foreach(store, (GtkTreeModelForeachFunc)_tree_reveal_func, NULL);
@@ -633,7 +902,9 @@ static void _tree_tagname_show(GtkTreeViewColumn *col,
 
   const gboolean istag = !(flags & DT_TF_CATEGORY) && tagid;
 
-  if((dictionary_view && !count) || (!dictionary_view && count <= 1))
+  if(!path)
+    coltext = g_strdup(""); // fake child of a tree row not filled yet
+  else if((dictionary_view && !count) || (!dictionary_view && count <= 1))
   {
     coltext = g_markup_printf_escaped
       (istag ? "%s" : "<i>%s</i>", hide ? name : path);
@@ -774,240 +1045,106 @@ static gboolean _find_tag_iter_tagid(GtkTreeModel *model,
   return FALSE;
 }
 
-// calculate the indeterminated state (1) where needed on the tree
-static void _calculate_sel_on_path(GtkTreeModel *model,
-                                   GtkTreeIter *iter,
-                                   const gboolean root)
+// reset the selection on the list
+static void _reset_sel_on_list(GtkTreeModel *model)
 {
-  GtkTreeIter child, parent = *iter;
-  do
-  {
-    gint sel = DT_TS_NO_IMAGE;
-    gtk_tree_model_get(model, &parent, DT_LIB_TAGGING_COL_SEL, &sel, -1);
-    if(sel == DT_TS_ALL_IMAGES)
-    {
-      _propagate_sel_to_parents(model, &parent);
-    }
-    if(gtk_tree_model_iter_children(model, &child, &parent))
-      _calculate_sel_on_path(model, &child, FALSE);
-  } while(!root && gtk_tree_model_iter_next(model, &parent));
-}
-
-// reset the indeterminated selection (1) on the tree
-static void _reset_sel_on_path(GtkTreeModel *model,
-                               GtkTreeIter *iter,
-                               const gboolean root)
-{
-  GtkTreeIter child, parent = *iter;
-  do
-  {
-    if(gtk_tree_model_iter_children(model, &child, &parent))
-    {
-      gint sel = DT_TS_NO_IMAGE;
-      gtk_tree_model_get(model, &parent, DT_LIB_TAGGING_COL_SEL, &sel, -1);
-      if(sel == DT_TS_SOME_IMAGES)
-      {
-        gtk_tree_store_set(GTK_TREE_STORE(model), &parent,
-                           DT_LIB_TAGGING_COL_SEL, DT_TS_NO_IMAGE, -1);
-      }
-      _reset_sel_on_path(model, &child, FALSE);
-    }
-  } while(!root && gtk_tree_model_iter_next(model, &parent));
-}
-
-// reset all selection (1 & 2) on the tree
-static void _reset_sel_on_path_full(GtkTreeModel *model,
-                                    GtkTreeIter *iter,
-                                    const gboolean root)
-{
-  GtkTreeIter child, parent = *iter;
-  do
-  {
-    if(GTK_IS_TREE_STORE(model))
-    {
-      gtk_tree_store_set(GTK_TREE_STORE(model), &parent,
-                         DT_LIB_TAGGING_COL_SEL, DT_TS_NO_IMAGE, -1);
-      if(gtk_tree_model_iter_children(model, &child, &parent))
-        _reset_sel_on_path_full(model, &child, FALSE);
-    }
-    else
-    {
-      gtk_list_store_set(GTK_LIST_STORE(model), &parent,
-                         DT_LIB_TAGGING_COL_SEL, DT_TS_NO_IMAGE, -1);
-    }
-  } while(!root && gtk_tree_model_iter_next(model, &parent));
-}
-
-//  try to find a node fully attached (2) which is the root of the
-//  update loop. If not the full tree will be used
-static void _find_root_iter_iter(GtkTreeModel *model,
-                                 GtkTreeIter *iter,
-                                 GtkTreeIter *parent)
-{
-  guint sel;
-  GtkTreeIter child = *iter;
-  while(gtk_tree_model_iter_parent(model, parent, &child))
-  {
-    gtk_tree_model_get(model, parent, DT_LIB_TAGGING_COL_SEL, &sel, -1);
-    if(sel == DT_TS_ALL_IMAGES)
-    {
-      char *path = NULL;
-      gtk_tree_model_get(model, parent, DT_LIB_TAGGING_COL_PATH, &path, -1);
-      g_free(path);
-      return; // no need to go further
-    }
-    child = *parent;
-  }
-  *parent = child;  // last before root
-  char *path = NULL;
-  gtk_tree_model_get(model, parent, DT_LIB_TAGGING_COL_PATH, &path, -1);
-  g_free(path);
-}
-
-// with tag detach update the tree selection
-static void _calculate_sel_on_tree(GtkTreeModel *model,
-                                   GtkTreeIter *iter)
-{
-  GtkTreeIter parent;
-  if(iter)
-  {
-    // only on sub-tree
-    _find_root_iter_iter(model, iter, &parent);
-    _reset_sel_on_path(model, &parent, TRUE);
-    _calculate_sel_on_path(model, &parent, TRUE);
-  }
-  else
+  GtkTreeIter iter;
+  gboolean valid = gtk_tree_model_get_iter_first(model, &iter);
+  while(valid)
   {
-    // on full tree
-    if(gtk_tree_model_get_iter_first(model, &parent))
-    {
-      _reset_sel_on_path(model, &parent, FALSE);
-      _calculate_sel_on_path(model, &parent, FALSE);
-    }
+    gtk_list_store_set(GTK_LIST_STORE(model), &iter,
+                       DT_LIB_TAGGING_COL_SEL, DT_TS_NO_IMAGE, -1);
+    valid = gtk_tree_model_iter_next(model, &iter);
   }
 }
 
-// get the new selected images and update the tree selection
-static void _update_sel_on_tree(GtkTreeModel *model)
+// get the new selected images and update the list selection
+static void _update_sel_on_list(GtkTreeModel *model)
 {
   GList *tags = NULL;
   dt_tag_get_attached(-1, &tags, TRUE);
-  GtkTreeIter parent;
-  if(gtk_tree_model_get_iter_first(model, &parent))
+  GtkTreeIter first;
+  if(gtk_tree_model_get_iter_first(model, &first))
   {
-    _reset_sel_on_path_full(model, &parent, FALSE);
+    _reset_sel_on_list(model);
     for(GList *tag = tags; tag; tag = g_list_next(tag))
     {
-      GtkTreeIter iter = parent;
+      GtkTreeIter iter = first;
       if(_find_tag_iter_tagid(model, &iter, ((dt_tag_t *)tag->data)->id))
-      {
-        if(GTK_IS_TREE_STORE(model))
-        {
-          gtk_tree_store_set(GTK_TREE_STORE(model), &iter,
-                             DT_LIB_TAGGING_COL_SEL, ((dt_tag_t *)tag->data)->select, -1);
-          _propagate_sel_to_parents(model, &iter);
-        }
-        else
-        {
-          gtk_list_store_set(GTK_LIST_STORE(model), &iter,
-                             DT_LIB_TAGGING_COL_SEL, ((dt_tag_t *)tag->data)->select, -1);
-        }
-      }
+        gtk_list_store_set(GTK_LIST_STORE(model), &iter,
+                           DT_LIB_TAGGING_COL_SEL, ((dt_tag_t *)tag->data)->select, -1);
     }
   }
   if(tags)
     dt_tag_free_result(&tags);
 }
 
-// delete a tag in the tree (tree or list)
-static void _delete_tree_tag(GtkTreeModel *model,
-                             GtkTreeIter *iter,
-                             const gboolean tree)
+static gboolean _tree_update_sel_func(GtkTreeModel *model,
+                                      GtkTreePath *path,
+                                      GtkTreeIter *iter,
+                                      dt_lib_module_t *self)
 {
-  guint tagid = 0;
-  gtk_tree_model_get(model, iter, DT_LIB_TAGGING_COL_ID, &tagid, -1);
-  if(tree)
-  {
-    if(tagid)
-    {
-      gtk_tree_store_set(GTK_TREE_STORE(model), iter,
-                         DT_LIB_TAGGING_COL_SEL, DT_TS_NO_IMAGE,
-                         DT_LIB_TAGGING_COL_ID, 0,
-                         DT_LIB_TAGGING_COL_COUNT, 0, -1);
-      _calculate_sel_on_tree(model, iter);
-      GtkTreeIter child, parent = *iter;
-      if(!gtk_tree_model_iter_children(model, &child, &parent))
-        gtk_tree_store_remove(GTK_TREE_STORE(model), iter);
-    }
-  }
-  else
+  dt_lib_tagging_t *d = self->data;
+  gchar *tagpath = NULL;
+  gtk_tree_model_get(model, iter, DT_LIB_TAGGING_COL_PATH, &tagpath, -1);
+  if(tagpath && tagpath[0])
   {
-    gtk_list_store_remove(GTK_LIST_STORE(model), iter);
+    const dt_tag_node_t *node = dt_tag_tree_find(d->tag_tree, tagpath);
+    gtk_tree_store_set(GTK_TREE_STORE(model), iter,
+                       DT_LIB_TAGGING_COL_SEL,
+                       node ? dt_tag_tree_node_select(node) : DT_TS_NO_IMAGE, -1);
   }
+  g_free(tagpath);
+  return FALSE;
 }
 
-// delete a branch of the tag tree
-static void _delete_tree_path(GtkTreeModel *model,
-                              GtkTreeIter *iter,
-                              const gboolean root,
-                              const gboolean tree)
+// get the new selected images and update the selection state of the
+// tag tree and of the rows in the store
+static void _update_sel_on_tree(dt_lib_module_t *self)
 {
-  if(tree) // the treeview is tree. It handles the hierarchy itself (parent / child)
-  {
-    GtkTreeIter child, parent = *iter;
-    gboolean valid = TRUE;
-    do
-    {
-      if(gtk_tree_model_iter_children(model, &child, &parent))
-        _delete_tree_path(model, &child, FALSE, tree);
-      GtkTreeIter tobedel = parent;
-      valid = gtk_tree_model_iter_next(model, &parent);
-      if(root)
-      {
-        gtk_tree_store_set(GTK_TREE_STORE(model), &tobedel,
-                           DT_LIB_TAGGING_COL_SEL, DT_TS_NO_IMAGE,
-                           DT_LIB_TAGGING_COL_COUNT, 0, -1);
-
-        char *path2 = NULL;
-        gtk_tree_model_get(model, &tobedel, DT_LIB_TAGGING_COL_PATH, &path2, -1);
-        g_free(path2);
+  dt_lib_tagging_t *d = self->data;
+  if(!d->tag_tree) return;
+  GList *tags = NULL;
+  dt_tag_get_attached(-1, &tags, TRUE);
+  dt_tag_tree_reset_select(d->tag_tree);
+  for(GList *tag = tags; tag; tag = g_list_next(tag))
+    dt_tag_tree_set_select(d->tag_tree, ((dt_tag_t *)tag->data)->id,
+                           ((dt_tag_t *)tag->data)->select);
+  if(tags)
+    dt_tag_free_result(&tags);
+  gtk_tree_model_foreach(GTK_TREE_MODEL(d->dictionary_treestore),
+                         (GtkTreeModelForeachFunc)_tree_update_sel_func, self);
+}
 
-        _calculate_sel_on_tree(model, &tobedel);
-      }
-      char *path = NULL;
-      gtk_tree_model_get(model, &tobedel, DT_LIB_TAGGING_COL_PATH, &path, -1);
-      g_free(path);
-      gtk_tree_store_remove(GTK_TREE_STORE(model), &tobedel);
-    } while(!root && valid);
-  }
-  else  // treeview is a list. The hierarchy of tags is found with the
-        // root (left part) of tagname
+// delete a branch of the tag list. The hierarchy of tags is found
+// with the root (left part) of tagname
+static void _delete_list_path(GtkTreeModel *model,
+                              GtkTreeIter *iter)
+{
+  GtkTreeIter child;
+  char *path = NULL;
+  gtk_tree_model_get(model, iter, DT_LIB_TAGGING_COL_PATH, &path, -1);
+  guint pathlen = strlen(path);
+  gboolean valid = gtk_tree_model_get_iter_first(model, &child);
+  while(valid)
   {
-    GtkTreeIter child;
-    char *path = NULL;
-    gtk_tree_model_get(model, iter, DT_LIB_TAGGING_COL_PATH, &path, -1);
-    guint pathlen = strlen(path);
-    gboolean valid = gtk_tree_model_get_iter_first(model, &child);
-    while(valid)
-    {
-      char *path2 = NULL;
-      gtk_tree_model_get(model, &child, DT_LIB_TAGGING_COL_PATH, &path2, -1);
-      GtkTreeIter tobedel = child;
-      valid = gtk_tree_model_iter_next (model, &child);
-      if(strlen(path2) >= pathlen)
+    char *path2 = NULL;
+    gtk_tree_model_get(model, &child, DT_LIB_TAGGING_COL_PATH, &path2, -1);
+    GtkTreeIter tobedel = child;
+    valid = gtk_tree_model_iter_next (model, &child);
+    if(strlen(path2) >= pathlen)
+    {
+      char letter = path2[pathlen];
+      path2[pathlen] = '\0';
+      if(g_strcmp0(path, path2) == 0)
       {
-        char letter = path2[pathlen];
-        path2[pathlen] = '\0';
-        if(g_strcmp0(path, path2) == 0)
-        {
-          path2[pathlen] = letter;
-          gtk_list_store_remove(GTK_LIST_STORE(model), &tobedel);
-        }
+        path2[pathlen] = letter;
+        gtk_list_store_remove(GTK_LIST_STORE(model), &tobedel);
       }
-      g_free(path2);
     }
-    g_free(path);
+    g_free(path2);
   }
+  g_free(path);
 }
 
 static void _lib_selection_changed_callback(gpointer instance,
@@ -1018,9 +1155,10 @@ static void _lib_selection_changed_callback(gpointer instance,
   {
     _init_treeview(self, 1);
   }
+  else if(d->tree_flag)
+    _update_sel_on_tree(self);
   else
-    _update_sel_on_tree(d->tree_flag ? GTK_TREE_MODEL(d->dictionary_treestore)
-                                     : GTK_TREE_MODEL(d->dictionary_liststore));
+    _update_sel_on_list(GTK_TREE_MODEL(d->dictionary_liststore));
 
   d->update_selected_tags = TRUE;
   dt_lib_gui_queue_update(self);
@@ -1093,31 +1231,24 @@ static gboolean _update_tag_name_per_name(GtkTreeModel *model,
   return FALSE;
 }
 
-static void _update_attached_count(const int tagid, GtkTreeView *view,
-                                   const gboolean tree_flag)
+static void _update_attached_count(dt_lib_module_t *self,
+                                   const int tagid)
 {
+  dt_lib_tagging_t *d = self->data;
   const guint count = dt_tag_images_count(tagid);
-  GtkTreeModel *model = gtk_tree_view_get_model(view);
-  GtkTreeModel *store = gtk_tree_model_filter_get_model(GTK_TREE_MODEL_FILTER(model));
+  if(d->tree_flag)
+  {
+    _tree_update_tag(self, tagid, count, DT_TS_ALL_IMAGES);
+    return;
+  }
+  GtkTreeModel *store = GTK_TREE_MODEL(d->dictionary_liststore);
   GtkTreeIter iter;
-  if(gtk_tree_model_get_iter_first(store, &iter))
+  if(gtk_tree_model_get_iter_first(store, &iter)
+     && _find_tag_iter_tagid(store, &iter, tagid))
   {
-    if(_find_tag_iter_tagid(store, &iter, tagid))
-    {
-      if(tree_flag)
-      {
-        gtk_tree_store_set(GTK_TREE_STORE(store), &iter,
-                           DT_LIB_TAGGING_COL_COUNT, count,
-                           DT_LIB_TAGGING_COL_SEL, DT_TS_ALL_IMAGES, -1);
-        _calculate_sel_on_tree(GTK_TREE_MODEL(store), &iter);
-      }
-      else
-      {
-        gtk_list_store_set(GTK_LIST_STORE(store), &iter,
-                           DT_LIB_TAGGING_COL_COUNT, count,
-                           DT_LIB_TAGGING_COL_SEL, DT_TS_ALL_IMAGES, -1);
-      }
-    }
+    gtk_list_store_set(GTK_LIST_STORE(store), &iter,
+                       DT_LIB_TAGGING_COL_COUNT, count,
+                       DT_LIB_TAGGING_COL_SEL, DT_TS_ALL_IMAGES, -1);
   }
 }
 
@@ -1177,9 +1308,7 @@ int set_params(dt_lib_module_t *self,
       gboolean change = FALSE;
       for(GList *tag = tags; tag; tag = g_list_next(tag))
       {
-        _update_attached_count(GPOINTER_TO_INT(tag->data),
-                               d->dictionary_view,
-                               d->tree_flag);
+        _update_attached_count(self, GPOINTER_TO_INT(tag->data));
         change = TRUE;
       }
 
@@ -1225,10 +1354,7 @@ static void _attach_selected_tag(dt_lib_module_t *self,
                                                        &store_iter, &iter);
       if(d->tree_flag)
       {
-        gtk_tree_store_set(GTK_TREE_STORE(store), &store_iter,
-                           DT_LIB_TAGGING_COL_COUNT, count,
-                           DT_LIB_TAGGING_COL_SEL, DT_TS_ALL_IMAGES, -1);
-        _propagate_sel_to_parents(GTK_TREE_MODEL(store), &store_iter);
+        _tree_update_tag(self, tagid, count, DT_TS_ALL_IMAGES);
       }
       else
       {
@@ -1277,29 +1403,20 @@ static void _detach_selected_tag(GtkTreeView *view,
     if(!_select_next_user_attached_tag(index, view))
       gtk_widget_grab_focus(GTK_WIDGET(d->entry));
 
-    if(d->tree_flag || !d->suggestion_flag)
+    if(d->tree_flag)
+    {
+      _tree_update_tag(self, tagid, dt_tag_images_count(tagid), DT_TS_NO_IMAGE);
+    }
+    else if(!d->suggestion_flag)
     {
       const guint count = dt_tag_images_count(tagid);
-      model = gtk_tree_view_get_model(d->dictionary_view);
-      GtkTreeModel *store = gtk_tree_model_filter_get_model(GTK_TREE_MODEL_FILTER(model));
-      if(gtk_tree_model_get_iter_first(store, &iter))
+      GtkTreeModel *store = GTK_TREE_MODEL(d->dictionary_liststore);
+      if(gtk_tree_model_get_iter_first(store, &iter)
+         && _find_tag_iter_tagid(store, &iter, tagid))
       {
-        if(_find_tag_iter_tagid(store, &iter, tagid))
-        {
-          if(d->tree_flag)
-          {
-            gtk_tree_store_set(GTK_TREE_STORE(store), &iter,
-                               DT_LIB_TAGGING_COL_COUNT, count,
-                               DT_LIB_TAGGING_COL_SEL, DT_TS_NO_IMAGE, -1);
-            _calculate_sel_on_tree(GTK_TREE_MODEL(store), &iter);
-          }
-          else
-          {
-            gtk_list_store_set(GTK_LIST_STORE(store), &iter,
-                               DT_LIB_TAGGING_COL_COUNT, count,
-                               DT_LIB_TAGGING_COL_SEL, DT_TS_NO_IMAGE, -1);
-          }
-        }
+        gtk_list_store_set(GTK_LIST_STORE(store), &iter,
+                           DT_LIB_TAGGING_COL_COUNT, count,
+                           DT_LIB_TAGGING_COL_SEL, DT_TS_NO_IMAGE, -1);
       }
     }
     else
@@ -1355,25 +1472,22 @@ static void _pop_menu_attached_attach_to_all(GtkWidget *menuitem,
   _init_treeview(self, 0);
 
   const uint32_t count = dt_tag_images_count(tagid);
-  model = gtk_tree_view_get_model(GTK_TREE_VIEW(d->dictionary_view));
-  if(gtk_tree_model_get_iter_first(model, &iter))
+  if(d->tree_flag)
+  {
+    _tree_update_tag(self, tagid, count, -1);
+  }
+  else
   {
-    if(_find_tag_iter_tagid(model, &iter, tagid))
+    model = gtk_tree_view_get_model(GTK_TREE_VIEW(d->dictionary_view));
+    if(gtk_tree_model_get_iter_first(model, &iter)
+       && _find_tag_iter_tagid(model, &iter, tagid))
     {
       GtkTreeIter store_iter;
       GtkTreeModel *store = gtk_tree_model_filter_get_model(GTK_TREE_MODEL_FILTER(model));
       gtk_tree_model_filter_convert_iter_to_child_iter(GTK_TREE_MODEL_FILTER(model),
                                                        &store_iter, &iter);
-      if(d->tree_flag)
-      {
-        gtk_tree_store_set(GTK_TREE_STORE(store), &store_iter,
-                           DT_LIB_TAGGING_COL_COUNT, count, -1);
-      }
-      else
-      {
-        gtk_list_store_set(GTK_LIST_STORE(store), &store_iter,
-                           DT_LIB_TAGGING_COL_COUNT, count, -1);
-      }
+      gtk_list_store_set(GTK_LIST_STORE(store), &store_iter,
+                         DT_LIB_TAGGING_COL_COUNT, count, -1);
     }
   }
 
@@ -1607,7 +1721,7 @@ static void _new_button_clicked(GtkButton *button, dt_lib_module_t *self)
   _init_treeview(self, 1);
   char *tagname = strrchr(d->last_tag, ',');
   if(res) _raise_signal_tag_changed(self);
-  _show_tag_on_view(GTK_TREE_VIEW(d->dictionary_view),
+  _show_tag_on_view(self,
                     tagname ? tagname + 1 : d->last_tag, FALSE, TRUE);
 }
 
@@ -1634,7 +1748,7 @@ static gboolean _enter_key_pressed(GtkEventControllerKey *controller,
     {
       _unselect_all_in_view(d->attached_view);
       if(d->keyword[0])
-        _show_keyword_on_view(d->dictionary_view, d->keyword, TRUE);
+        _show_keyword_on_view(self, d->keyword, TRUE);
       gtk_widget_grab_focus(GTK_WIDGET(d->dictionary_view));
       return TRUE;
     }
@@ -1672,6 +1786,7 @@ static void _tag_name_changed(GtkEntry *entry,
 {
   dt_lib_tagging_t *d = self->data;
   _set_keyword(self);
+  _tree_fill_matching(self);
   GtkTreeModel *model = gtk_tree_view_get_model(d->dictionary_view);
   GtkTreeModel *store = gtk_tree_model_filter_get_model(GTK_TREE_MODEL_FILTER(model));
   gtk_tree_model_foreach(store,
@@ -1679,7 +1794,7 @@ static void _tag_name_changed(GtkEntry *entry,
   if(d->tree_flag && d->keyword[0])
   {
     gtk_tree_model_foreach(store, (GtkTreeModelForeachFunc)_tree_reveal_func, NULL);
-    _show_keyword_on_view(d->dictionary_view, d->keyword, FALSE);
+    _show_keyword_on_view(self, d->keyword, FALSE);
   }
 }
 
@@ -1759,11 +1874,19 @@ static void _pop_menu_dictionary_delete_tag(GtkWidget *menuitem,
   dt_tag_remove(tagid, TRUE);
   dt_control_log(_("tag %s removed"), tagname);
 
-  GtkTreeIter store_iter;
-  GtkTreeModel *store = gtk_tree_model_filter_get_model(GTK_TREE_MODEL_FILTER(model));
-  gtk_tree_model_filter_convert_iter_to_child_iter(GTK_TREE_MODEL_FILTER(model),
-                                                   &store_iter, &iter);
-  _delete_tree_tag(GTK_TREE_MODEL(store), &store_iter, d->tree_flag);
+  if(d->tree_flag)
+  {
+    // the row stays as a path if there are tags below
+    _tree_remove_tag(self, tagid);
+  }
+  else
+  {
+    GtkTreeIter store_iter;
+    GtkTreeModel *store = gtk_tree_model_filter_get_model(GTK_TREE_MODEL_FILTER(model));
+    gtk_tree_model_filter_convert_iter_to_child_iter(GTK_TREE_MODEL_FILTER(model),
+                                                     &store_iter, &iter);
+    gtk_list_store_remove(GTK_LIST_STORE(store), &store_iter);
+  }
   _init_treeview(self, 0);
 
   dt_image_synch_xmps(tagged_images);
@@ -1847,11 +1970,19 @@ static void _pop_menu_dictionary_delete_node(GtkWidget *menuitem,
                                     G_CALLBACK(_lib_tagging_tags_changed_callback), self);
   dt_control_log(_("%d tags removed"), tag_count);
 
-  GtkTreeIter store_iter;
-  GtkTreeModel *store = gtk_tree_model_filter_get_model(GTK_TREE_MODEL_FILTER(model));
-  gtk_tree_model_filter_convert_iter_to_child_iter(GTK_TREE_MODEL_FILTER(model),
-                            &store_iter, &iter);
-  _delete_tree_path(GTK_TREE_MODEL(store), &store_iter, TRUE, d->tree_flag);
+  if(d->tree_flag)
+  {
+    for(GList *taglist = tag_family; taglist; taglist = g_list_next(taglist))
+      _tree_remove_tag(self, ((dt_tag_t *)taglist->data)->id);
+  }
+  else
+  {
+    GtkTreeIter store_iter;
+    GtkTreeModel *store = gtk_tree_model_filter_get_model(GTK_TREE_MODEL_FILTER(model));
+    gtk_tree_model_filter_convert_iter_to_child_iter(GTK_TREE_MODEL_FILTER(model),
+                                                     &store_iter, &iter);
+    _delete_list_path(GTK_TREE_MODEL(store), &store_iter);
+  }
   _init_treeview(self, 0);
 
   dt_tag_free_result(&tag_family);
@@ -1977,7 +2108,7 @@ static void _pop_menu_dictionary_create_tag(GtkWidget *menuitem,
         dt_tag_set_synonyms(new_tagid, new_synonyms_list);
       g_free(new_synonyms_list);
       _init_treeview(self, 1);
-      _show_tag_on_view(view, new_tagname, FALSE, TRUE);
+      _show_tag_on_view(self, new_tagname, FALSE, TRUE);
     }
     g_free(new_tagname);
   }
@@ -2162,8 +2293,13 @@ static void _pop_menu_dictionary_edit_tag(GtkWidget *menuitem,
 
       // update the store
       GtkTreeModel *store = gtk_tree_model_filter_get_model(GTK_TREE_MODEL_FILTER(model));
-      dt_tag_op_t *to = g_malloc(sizeof(dt_tag_op_t));
-      if(to)
+      dt_tag_op_t *to = d->tree_flag ? NULL : g_malloc(sizeof(dt_tag_op_t));
+      if(d->tree_flag)
+      {
+        _tree_rename_tags(self, tag_family, tagname_len, new_prefix_tag);
+        _show_tag_on_view(self, new_prefix_tag, FALSE, TRUE);
+      }
+      else if(to)
       {
         to->tree_flag = d->tree_flag;
         to->oldtagname = tagname;
@@ -2201,31 +2337,41 @@ static void _pop_menu_dictionary_edit_tag(GtkWidget *menuitem,
       gtk_text_buffer_get_start_iter(buffer, &start);
       gtk_text_buffer_get_end_iter(buffer, &end);
       gchar *new_synonyms_list = gtk_text_buffer_get_text(buffer, &start, &end, FALSE);
-      // refresh iter
-      gtk_tree_selection_get_selected(selection, &model, &iter);
-      GtkTreeIter store_iter;
-      GtkTreeModel *store = gtk_tree_model_filter_get_model(GTK_TREE_MODEL_FILTER(model));
-      gtk_tree_model_filter_convert_iter_to_child_iter(GTK_TREE_MODEL_FILTER(model),
-                                                       &store_iter, &iter);
-      if(new_flags != (flags & (DT_TF_CATEGORY | DT_TF_PRIVATE)))
-      {
-        new_flags = (flags & ~(DT_TF_CATEGORY | DT_TF_PRIVATE)) | new_flags;
+      const gboolean new_flags_set = new_flags != (flags & (DT_TF_CATEGORY | DT_TF_PRIVATE));
+      const gboolean new_synonyms_set =
+        new_synonyms_list && g_strcmp0(synonyms_list, new_synonyms_list) != 0;
+      new_flags = (flags & ~(DT_TF_CATEGORY | DT_TF_PRIVATE)) | new_flags;
+      if(new_flags_set)
         dt_tag_set_flags(tagid, new_flags);
-        if(!d->tree_flag)
-          gtk_list_store_set(GTK_LIST_STORE(store), &store_iter,
-                             DT_LIB_TAGGING_COL_FLAGS, new_flags, -1);
-        else
-          gtk_tree_store_set(GTK_TREE_STORE(store), &store_iter,
-                             DT_LIB_TAGGING_COL_FLAGS, new_flags, -1);
+      if(new_synonyms_set)
+        dt_tag_set_synonyms(tagid, new_synonyms_list);
+
+      dt_tag_node_t *node = d->tree_flag && d->tag_tree
+        ? dt_tag_tree_find_id(d->tag_tree, tagid) : NULL;
+      if(node)
+      {
+        // the row may have been moved by the rename
+        if(new_flags_set)
+          node->flags = new_flags;
+        if(new_synonyms_set)
+        {
+          g_free(node->synonym);
+          node->synonym = g_strdup(new_synonyms_list);
+        }
+        _tree_sync_path(self, node->path);
       }
-      if(new_synonyms_list && g_strcmp0(synonyms_list, new_synonyms_list) != 0)
+      else if(!d->tree_flag && gtk_tree_selection_get_selected(selection, &model, &iter))
       {
-        dt_tag_set_synonyms(tagid, new_synonyms_list);
-        if(!d->tree_flag)
+        // refresh iter
+        GtkTreeIter store_iter;
+        GtkTreeModel *store = gtk_tree_model_filter_get_model(GTK_TREE_MODEL_FILTER(model));
+        gtk_tree_model_filter_convert_iter_to_child_iter(GTK_TREE_MODEL_FILTER(model),
+                                                         &store_iter, &iter);
+        if(new_flags_set)
+          gtk_list_store_set(GTK_LIST_STORE(store), &store_iter,
+                             DT_LIB_TAGGING_COL_FLAGS, new_flags, -1);
+        if(new_synonyms_set)
           gtk_list_store_set(GTK_LIST_STORE(store), &store_iter,
-                             DT_LIB_TAGGING_COL_SYNONYM, new_synonyms_list, -1);
-        else
-          gtk_tree_store_set(GTK_TREE_STORE(store), &store_iter,
                              DT_LIB_TAGGING_COL_SYNONYM, new_synonyms_list, -1);
       }
       g_free(new_synonyms_list);
@@ -2291,10 +2437,13 @@ static gboolean _apply_rename_path(GtkWidget *dialog,
       g_free(new_tagname);
     }
     _init_treeview(self, 0);
-    _init_treeview(self, 1);
+    if(d->tree_flag)
+      _tree_rename_tags(self, tag_family, tagname_len, newtag);
+    else
+      _init_treeview(self, 1);
     dt_image_synch_xmps(tagged_images);
     _raise_signal_tag_changed(self);
-    _show_tag_on_view(d->dictionary_view, newtag, FALSE, TRUE);
+    _show_tag_on_view(self, newtag, FALSE, TRUE);
     success = TRUE;
   }
   dt_tag_free_result(&tag_family);
@@ -2508,7 +2657,7 @@ static void _pop_menu_dictionary_set_as_tag(GtkWidget *menuitem,
   dt_control_log(_("tag %s created"), tagname);
 
   _init_treeview(self, 1);
-  _show_tag_on_view(d->dictionary_view, tagname, FALSE, TRUE);
+  _show_tag_on_view(self, tagname, FALSE, TRUE);
   g_free(tagname);
 
 }
@@ -2707,7 +2856,7 @@ static void _click_on_view_dictionary(GtkGestureSingle *gesture,
                 && shift_pressed)
         {
           dt_gui_claim(gesture);
-          gtk_tree_view_expand_row(GTK_TREE_VIEW(view), path, TRUE);
+          _tree_expand_row(self, GTK_TREE_VIEW(view), path, TRUE);
           gtk_tree_path_free(path);
           /* event is borrowed (gesture) */
           return;
@@ -2771,8 +2920,8 @@ static gboolean _dictionary_key_pressed(GtkEventControllerKey *controller,
       case GDK_KEY_Right:
         if(path)
         {
-          gtk_tree_view_expand_row(GTK_TREE_VIEW(view), path,
-                                   dt_modifier_is(state, GDK_SHIFT_MASK));
+          _tree_expand_row(self, GTK_TREE_VIEW(view), path,
+                           dt_modifier_is(state, GDK_SHIFT_MASK));
           res = TRUE;
         }
         break;
@@ -3355,7 +3504,7 @@ static void _event_dnd_received(GtkWidget *widget,
       if(tagid)
         dt_tag_attach_images(tagid, imgs, TRUE);
       g_list_free(imgs);
-      _update_attached_count(tagid, d->dictionary_view, d->tree_flag);
+      _update_attached_count(self, tagid);
       _init_treeview(self, 0);
       _raise_signal_tag_changed(self);
       dt_image_synch_xmp(-1);
@@ -3704,6 +3853,8 @@ void gui_init(dt_lib_module_t *self)
                    G_CALLBACK(_row_tooltip_setup), (gpointer)self);
   g_signal_connect(gtk_tree_view_get_selection(view), "changed",
                    G_CALLBACK(_tree_selection_changed), self);
+  g_signal_connect(G_OBJECT(view), "test-expand-row",
+                   G_CALLBACK(_dictionary_test_expand_row), self);
 
   // drag & drop
   {
@@ -3784,6 +3935,7 @@ void gui_cleanup(dt_lib_module_t *self)
   dt_lib_tagging_t *d = self->data;
 
   g_free(d->collection);
+  dt_tag_tree_free(d->tag_tree);
   if(d->drag.tagname) g_free(d->drag.tagname);
   if(d->drag.path) gtk_tree_path_free(d->drag.path);
   free(self->data);
@@ -0,0 +1,770 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  darktable-bench-catalog: populate a library with synthetic images and time
+  the lighttable code paths which scale with the size of the catalog.
+
+    darktable-bench-catalog generate <images> --library <db> [--core ...]
+    darktable-bench-catalog run [--reps <n>] --library <db> [--core ...]
+
+  see src/tests/benchmark/README.txt
+*/
+
+#include "common/collection.h"
+#include "common/darktable.h"
+#include "common/database.h"
+#include "common/datetime.h"
+#include "common/debug.h"
+#include "common/geo.h"
+#include "common/geo_cluster.h"
+#include "common/geo_index.h"
+#include "common/image.h"
+#include "common/map_locations.h"
+#include "common/math.h"
+#include "common/metadata.h"
+#include "common/mipmap_cache.h"
+#include "common/tags.h"
+#include "control/conf.h"
+#include "imageio/imageio_jpeg.h"
+
+#include <glib/gstdio.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+#define IMAGES_PER_FILMROLL 500
+#define NB_CITIES 24
+
+typedef struct dt_bench_catalog_t
+{
+  int images;
+  int tags;
+  int tags_per_image;
+  float edited_ratio;
+  float geotagged_ratio;
+  int mip_levels;
+  int reps;
+} dt_bench_catalog_t;
+
+static void _usage(const char *progname)
+{
+  fprintf(stderr,
+          "usage: %s generate <images> [options] --library <db> [--core <darktable options>]\n"
+          "       %s run [options] --library <db> [--core <darktable options>]\n"
+          "\n"
+          "generate options:\n"
+          "   --tags <n>            size of the tag dictionary, default 30000\n"
+          "   --tags-per-image <n>  default 5\n"
+          "   --edited <ratio>      part of the images with a history stack, default 0.6\n"
+          "   --geotagged <ratio>   part of the images with a location, default 0.7\n"
+          "   --mipmaps <n>         write fake thumbnails for the n smallest mip sizes, default 1\n"
+          "\n"
+          "run options:\n"
+          "   --reps <n>            run each measurement n times, default 5\n",
+          progname, progname);
+}
+
+static void _exec(const char *query)
+{
+  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), query, NULL, NULL, NULL);
+}
+
+// ---------------------------------------------------------------------------
+// generator
+// ---------------------------------------------------------------------------
+
+// a small valid thumbnail, written once and copied for every image
+static gboolean _fake_mipmap(const dt_mipmap_size_t mip,
+                             gchar **data,
+                             gsize *length)
+{
+  const int width = 8 << mip, height = 6 << mip;
+  uint8_t *buf = g_malloc(sizeof(uint8_t) * 4 * width * height);
+  for(int k = 0; k < width * height; k++)
+  {
+    buf[4 * k + 0] = buf[4 * k + 1] = buf[4 * k + 2] = 64 + (k % width) * 128 / width;
+    buf[4 * k + 3] = 0;
+  }
+
+  gchar *filename = g_build_filename(g_get_tmp_dir(), "dt-bench-catalog-mip.jpg", NULL);
+  const gboolean ok =
+    !dt_imageio_jpeg_write(filename, buf, width, height, 80, NULL, 0)
+    && g_file_get_contents(filename, data, length, NULL);
+  g_unlink(filename);
+  g_free(filename);
+  g_free(buf);
+  return ok;
+}
+
+static void _generate_mipmaps(const dt_bench_catalog_t *p)
+{
+  const dt_mipmap_cache_t *cache = darktable.mipmap_cache;
+  if(!cache || !cache->cachedir[0] || p->mip_levels <= 0) return;
+
+  for(dt_mipmap_size_t mip = DT_MIPMAP_0; mip < MIN(p->mip_levels, DT_MIPMAP_LDR_MAX); mip++)
+  {
+    gchar *data = NULL;
+    gsize length = 0;
+    if(!_fake_mipmap(mip, &data, &length))
+    {
+      fprintf(stderr, "[bench catalog] can't create fake thumbnail for mip %d\n", mip);
+      return;
+    }
+
+    gchar *dirname = g_strdup_printf("%s.d/%d", cache->cachedir, (int)mip);
+    g_mkdir_with_parents(dirname, 0750);
+    for(int id = 1; id <= p->images; id++)
+    {
+      gchar *filename = g_strdup_printf("%s/%d.jpg", dirname, id);
+      g_file_set_contents(filename, data, length, NULL);
+      g_free(filename);
+    }
+    g_free(dirname);
+    g_free(data);
+  }
+}
+
+static void _generate_tags(const dt_bench_catalog_t *p)
+{
+  static const char *roots[] = { "places", "people", "subjects", "events", "projects" };
+
+  // three to five levels deep, the way hierarchical keyword sets usually look
+  dt_database_start_transaction(darktable.db);
+  for(int k = 0; k < p->tags; k++)
+  {
+    gchar *name = k % 3
+      ? g_strdup_printf("%s|group %02d|set %03d|tag %06d",
+                        roots[k % 5], k % 37, k % 211, k)
+      : g_strdup_printf("%s|group %02d|set %03d|sub %04d|leaf %06d",
+                        roots[k % 5], k % 37, k % 211, k % 1999, k);
+    guint tagid;
+    dt_tag_new(name, &tagid);
+    g_free(name);
+  }
+  dt_database_release_transaction(darktable.db);
+}
+
+static void _generate_images(const dt_bench_catalog_t *p)
+{
+  sqlite3 *db = dt_database_get(darktable.db);
+  GRand *rand = g_rand_new_with_seed(p->images);
+
+  const int32_t makers[3] = { dt_image_get_camera_maker_id("Canon"),
+                              dt_image_get_camera_maker_id("Nikon"),
+                              dt_image_get_camera_maker_id("Fujifilm") };
+  const int32_t models[3] = { dt_image_get_camera_model_id("EOS R5"),
+                              dt_image_get_camera_model_id("Z 8"),
+                              dt_image_get_camera_model_id("X-T5") };
+  const int32_t cameras[3] = { dt_image_get_camera_id("Canon", "EOS R5"),
+                               dt_image_get_camera_id("Nikon", "Z 8"),
+                               dt_image_get_camera_id("Fujifilm", "X-T5") };
+  const int32_t lenses[4] = { dt_image_get_camera_lens_id("24-70mm"),
+                              dt_image_get_camera_lens_id("50mm"),
+                              dt_image_get_camera_lens_id("100-400mm"),
+                              dt_image_get_camera_lens_id("16mm") };
+  const uint32_t title_key = dt_metadata_get_keyid("Xmp.dc.title");
+  const uint32_t description_key = dt_metadata_get_keyid("Xmp.dc.description");
+
+  float city_lon[NB_CITIES], city_lat[NB_CITIES];
+  for(int c = 0; c < NB_CITIES; c++)
+  {
+    city_lon[c] = g_rand_double_range(rand, -170.0, 170.0);
+    city_lat[c] = g_rand_double_range(rand, -60.0, 70.0);
+  }
+
+  // the history stacks are built from the default presets so that the
+  // parameters are valid for the modules of this build
+  sqlite3_stmt *stmt;
+  // clang-format off
+  DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                              "SELECT COUNT(DISTINCT operation)"
+                              " FROM data.presets"
+                              " WHERE operation IN ('exposure', 'colorbalancergb',"
+                              "                     'sharpen', 'denoiseprofile', 'lens')"
+                              "   AND op_params IS NOT NULL",
+                              -1, &stmt, NULL);
+  // clang-format on
+  const int stack_size = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int(stmt, 0) : 0;
+  sqlite3_finalize(stmt);
+
+  const GTimeSpan now = dt_datetime_now_to_gtimespan();
+  const dt_datetime_t first_shot = { .year = 2005, .month = 1, .day = 1 };
+  const GTimeSpan first_taken = dt_datetime_numbers_to_gtimespan(&first_shot);
+
+  sqlite3_stmt *film_stmt, *img_stmt, *tag_stmt, *meta_stmt, *hist_stmt, *hash_stmt;
+  // clang-format off
+  DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                              "INSERT INTO main.film_rolls (id, access_timestamp, folder)"
+                              " VALUES (?1, ?2, ?3)",
+                              -1, &film_stmt, NULL);
+  DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                              "INSERT INTO main.images"
+                              " (id, group_id, film_id, width, height, filename,"
+                              "  maker_id, model_id, lens_id, camera_id, exposure, aperture, iso,"
+                              "  focal_length, datetime_taken, flags, version, max_version,"
+                              "  longitude, latitude, altitude, position, aspect_ratio,"
+                              "  history_end, import_timestamp, change_timestamp,"
+                              "  thumb_timestamp, thumb_maxmip, orientation, exposure_bias)"
+                              " VALUES"
+                              " (?1, ?1, ?2, 6000, 4000, ?3, ?4, ?5, ?6, ?21, ?7, ?8, ?9, ?10, ?11,"
+                              "  ?12, 0, 0, ?13, ?14, NULL, ?15, 1.5, ?16, ?17, ?18, ?17, ?19, 0, ?20)",
+                              -1, &img_stmt, NULL);
+  DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                              "INSERT OR IGNORE INTO main.tagged_images (imgid, tagid, position)"
+                              " VALUES (?1, ?2, ?3)",
+                              -1, &tag_stmt, NULL);
+  DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                              "INSERT INTO main.meta_data (id, key, value) VALUES (?1, ?2, ?3)",
+                              -1, &meta_stmt, NULL);
+  DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                              "INSERT INTO main.history"
+                              " (imgid, num, module, operation, op_params, enabled,"
+                              "  blendop_params, blendop_version, multi_priority, multi_name,"
+                              "  multi_name_hand_edited)"
+                              " SELECT ?1, ?2 + (ROW_NUMBER() OVER (ORDER BY operation)) - 1,"
+                              "        MAX(op_version), operation, op_params, 1,"
+                              "        blendop_params, blendop_version, 0, '', 0"
+                              " FROM data.presets"
+                              " WHERE operation IN ('exposure', 'colorbalancergb',"
+                              "                     'sharpen', 'denoiseprofile', 'lens')"
+                              "   AND op_params IS NOT NULL"
+                              " GROUP BY operation",
+                              -1, &hist_stmt, NULL);
+  DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                              "INSERT INTO main.history_hash (imgid, basic_hash, auto_hash, current_hash)"
+                              " VALUES (?1, NULL, NULL, randomblob(16))",
+                              -1, &hash_stmt, NULL);
+  // clang-format on
+
+  // the generated tags have consecutive ids
+  int first_tag = 0, tag_count = 0;
+  DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                              "SELECT MIN(id), COUNT(*) FROM data.tags"
+                              " WHERE name NOT LIKE 'darktable|%'",
+                              -1, &stmt, NULL);
+  if(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    first_tag = sqlite3_column_int(stmt, 0);
+    tag_count = sqlite3_column_int(stmt, 1);
+  }
+  sqlite3_finalize(stmt);
+
+  dt_database_start_transaction(darktable.db);
+  for(int id = 1; id <= p->images; id++)
+  {
+    const int film_id = 1 + (id - 1) / IMAGES_PER_FILMROLL;
+    const GTimeSpan taken = first_taken
+      + (GTimeSpan)(film_id * 7) * G_TIME_SPAN_DAY
+      + (GTimeSpan)((id - 1) % IMAGES_PER_FILMROLL) * 20 * G_TIME_SPAN_SECOND;
+
+    if((id - 1) % IMAGES_PER_FILMROLL == 0)
+    {
+      GDateTime *gdt = dt_datetime_gtimespan_to_gdatetime(taken);
+      gchar *date = gdt ? g_date_time_format(gdt, "%Y/%Y-%m-%d") : g_strdup("unknown");
+      gchar *folder = g_strdup_printf("/synthetic/%s-roll-%06d", date, film_id);
+      DT_DEBUG_SQLITE3_BIND_INT(film_stmt, 1, film_id);
+      DT_DEBUG_SQLITE3_BIND_INT64(film_stmt, 2, now);
+      DT_DEBUG_SQLITE3_BIND_TEXT(film_stmt, 3, folder, -1, SQLITE_TRANSIENT);
+      sqlite3_step(film_stmt);
+      sqlite3_reset(film_stmt);
+      g_free(folder);
+      g_free(date);
+      if(gdt) g_date_time_unref(gdt);
+    }
+
+    const int camera = g_rand_int_range(rand, 0, 3);
+    const gboolean edited = g_rand_double(rand) < p->edited_ratio;
+    const gboolean geotagged = g_rand_double(rand) < p->geotagged_ratio;
+    const int rating = g_rand_int_range(rand, 0, 6);
+    gchar *filename = g_strdup_printf("DSC_%06d.%s", id, camera == 2 ? "RAF" : "NEF");
+
+    DT_DEBUG_SQLITE3_BIND_INT(img_stmt, 1, id);
+    DT_DEBUG_SQLITE3_BIND_INT(img_stmt, 2, film_id);
+    DT_DEBUG_SQLITE3_BIND_TEXT(img_stmt, 3, filename, -1, SQLITE_TRANSIENT);
+    DT_DEBUG_SQLITE3_BIND_INT(img_stmt, 4, makers[camera]);
+    DT_DEBUG_SQLITE3_BIND_INT(img_stmt, 5, models[camera]);
+    DT_DEBUG_SQLITE3_BIND_INT(img_stmt, 6, lenses[g_rand_int_range(rand, 0, 4)]);
+    DT_DEBUG_SQLITE3_BIND_DOUBLE(img_stmt, 7, 1.0 / (15 << g_rand_int_range(rand, 0, 8)));
+    DT_DEBUG_SQLITE3_BIND_DOUBLE(img_stmt, 8, 1.4 * (1 << g_rand_int_range(rand, 0, 4)));
+    DT_DEBUG_SQLITE3_BIND_DOUBLE(img_stmt, 9, 100 << g_rand_int_range(rand, 0, 7));
+    DT_DEBUG_SQLITE3_BIND_DOUBLE(img_stmt, 10, g_rand_int_range(rand, 16, 400));
+    DT_DEBUG_SQLITE3_BIND_INT64(img_stmt, 11, taken);
+    DT_DEBUG_SQLITE3_BIND_INT(img_stmt, 12, rating | DT_IMAGE_RAW | DT_IMAGE_NO_LEGACY_PRESETS);
+    if(geotagged)
+    {
+      const int c = g_rand_int_range(rand, 0, NB_CITIES);
+      DT_DEBUG_SQLITE3_BIND_DOUBLE(img_stmt, 13, city_lon[c] + g_rand_double_range(rand, -0.5, 0.5));
+      DT_DEBUG_SQLITE3_BIND_DOUBLE(img_stmt, 14, city_lat[c] + g_rand_double_range(rand, -0.5, 0.5));
+    }
+    else
+    {
+      sqlite3_bind_null(img_stmt, 13);
+      sqlite3_bind_null(img_stmt, 14);
+    }
+    DT_DEBUG_SQLITE3_BIND_INT64(img_stmt, 15, (int64_t)id << 32);
+    DT_DEBUG_SQLITE3_BIND_INT(img_stmt, 16, edited ? stack_size : 0);
+    DT_DEBUG_SQLITE3_BIND_INT64(img_stmt, 17, now);
+    if(edited)
+      DT_DEBUG_SQLITE3_BIND_INT64(img_stmt, 18, now);
+    else
+      sqlite3_bind_null(img_stmt, 18);
+    DT_DEBUG_SQLITE3_BIND_INT(img_stmt, 19, MAX(0, MIN(p->mip_levels, DT_MIPMAP_LDR_MAX) - 1));
+    DT_DEBUG_SQLITE3_BIND_DOUBLE(img_stmt, 20, 0.3 * g_rand_int_range(rand, -3, 4));
+    DT_DEBUG_SQLITE3_BIND_INT(img_stmt, 21, cameras[camera]);
+    sqlite3_step(img_stmt);
+    sqlite3_reset(img_stmt);
+    g_free(filename);
+
+    for(int k = 0; tag_count && k < p->tags_per_image; k++)
+    {
+      DT_DEBUG_SQLITE3_BIND_INT(tag_stmt, 1, id);
+      DT_DEBUG_SQLITE3_BIND_INT(tag_stmt, 2, first_tag + g_rand_int_range(rand, 0, tag_count));
+      DT_DEBUG_SQLITE3_BIND_INT64(tag_stmt, 3, ((int64_t)id << 32) + k);
+      sqlite3_step(tag_stmt);
+      sqlite3_reset(tag_stmt);
+    }
+
+    gchar *title = g_strdup_printf("synthetic image %d", id);
+    DT_DEBUG_SQLITE3_BIND_INT(meta_stmt, 1, id);
+    DT_DEBUG_SQLITE3_BIND_INT(meta_stmt, 2, title_key);
+    DT_DEBUG_SQLITE3_BIND_TEXT(meta_stmt, 3, title, -1, SQLITE_TRANSIENT);
+    sqlite3_step(meta_stmt);
+    sqlite3_reset(meta_stmt);
+    g_free(title);
+    if(id % 4 == 0)
+    {
+      DT_DEBUG_SQLITE3_BIND_INT(meta_stmt, 1, id);
+      DT_DEBUG_SQLITE3_BIND_INT(meta_stmt, 2, description_key);
+      DT_DEBUG_SQLITE3_BIND_TEXT(meta_stmt, 3, "generated by darktable-bench-catalog",
+                                 -1, SQLITE_STATIC);
+      sqlite3_step(meta_stmt);
+      sqlite3_reset(meta_stmt);
+    }
+
+    if(edited && stack_size > 0)
+    {
+      DT_DEBUG_SQLITE3_BIND_INT(hist_stmt, 1, id);
+      DT_DEBUG_SQLITE3_BIND_INT(hist_stmt, 2, 0);
+      sqlite3_step(hist_stmt);
+      sqlite3_reset(hist_stmt);
+      DT_DEBUG_SQLITE3_BIND_INT(hash_stmt, 1, id);
+      sqlite3_step(hash_stmt);
+      sqlite3_reset(hash_stmt);
+    }
+
+    // keep the transactions reasonably small
+    if(id % 10000 == 0)
+    {
+      dt_database_release_transaction(darktable.db);
+      fprintf(stderr, "\r[bench catalog] %d / %d images", id, p->images);
+      dt_database_start_transaction(darktable.db);
+    }
+  }
+  dt_database_release_transaction(darktable.db);
+  fprintf(stderr, "\r[bench catalog] %d / %d images\n", p->images, p->images);
+
+  sqlite3_finalize(film_stmt);
+  sqlite3_finalize(img_stmt);
+  sqlite3_finalize(tag_stmt);
+  sqlite3_finalize(meta_stmt);
+  sqlite3_finalize(hist_stmt);
+  sqlite3_finalize(hash_stmt);
+  g_rand_free(rand);
+}
+
+static int _generate(const dt_bench_catalog_t *p)
+{
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT COUNT(*) FROM main.images", -1, &stmt, NULL);
+  const int existing = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int(stmt, 0) : -1;
+  sqlite3_finalize(stmt);
+  if(existing != 0)
+  {
+    fprintf(stderr, "[bench catalog] the library must be empty, it has %d images\n", existing);
+    return 1;
+  }
+
+  const double start = dt_get_wtime();
+  _generate_tags(p);
+  const double tags_done = dt_get_wtime();
+  _generate_images(p);
+  const double images_done = dt_get_wtime();
+  _generate_mipmaps(p);
+  _exec("ANALYZE");
+  const double end = dt_get_wtime();
+
+  printf("generated %d images, %d tags in %.3fs (tags %.3fs, images %.3fs, thumbnails %.3fs)\n",
+         p->images, p->tags, end - start, tags_done - start, images_done - tags_done,
+         end - images_done);
+  return 0;
+}
+
+// ---------------------------------------------------------------------------
+// benchmark
+// ---------------------------------------------------------------------------
+
+typedef struct dt_bench_timing_t
+{
+  double min, sum;
+  int n;
+  int64_t result;
+} dt_bench_timing_t;
+
+static void _timing_add(dt_bench_timing_t *t, const double seconds, const int64_t result)
+{
+  t->min = t->n ? MIN(t->min, seconds) : seconds;
+  t->sum += seconds;
+  t->n++;
+  t->result = result;
+}
+
+static void _timing_print(const char *name, const dt_bench_timing_t *t)
+{
+  printf("  %-36s %10.2f ms  %10.2f ms  %10" PRId64 "\n",
+         name, 1000.0 * t->min, 1000.0 * t->sum / MAX(1, t->n), t->result);
+}
+
+static void _set_collection(const dt_collection_properties_t property,
+                            const char *text)
+{
+  dt_conf_set_int("plugins/lighttable/collect/num_rules", 1);
+  dt_conf_set_int("plugins/lighttable/collect/item0", property);
+  dt_conf_set_string("plugins/lighttable/collect/string0", text);
+  dt_conf_set_int("plugins/lighttable/collect/mode0", 0);
+  dt_conf_set_int("plugins/lighttable/filtering/num_rules", 0);
+}
+
+static int64_t _count_rows(const char *query)
+{
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+  int64_t rows = 0;
+  while(sqlite3_step(stmt) == SQLITE_ROW) rows++;
+  sqlite3_finalize(stmt);
+  return rows;
+}
+
+static dt_geo_index_t *_map_index(void)
+{
+  // the spatial index of the map view, see _view_map_get_index()
+  sqlite3_stmt *stmt;
+  // clang-format off
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT id, longitude, latitude"
+                              " FROM main.images i INNER JOIN memory.collected_images c ON i.id = c.imgid"
+                              " WHERE longitude NOT NULL AND latitude NOT NULL",
+                              -1, &stmt, NULL);
+  // clang-format on
+  dt_geo_index_t *index = dt_geo_index_new();
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+    dt_geo_index_add(index,
+                     sqlite3_column_int(stmt, 0),
+                     sqlite3_column_double(stmt, 1),
+                     sqlite3_column_double(stmt, 2));
+  sqlite3_finalize(stmt);
+  return index;
+}
+
+static int64_t _map_clusters(dt_geo_index_t *index,
+                             const dt_map_box_t *bbox,
+                             const int zoom)
+{
+  // the clustering of the map view at a zoom level, with the default
+  // preferences, see _view_map_changed_callback_delayed()
+  const double epsilon = 128 * (((unsigned int)(156412000 >> zoom)) * 25 * 0.01 * 0.000001 / 6371);
+  const int level = dt_geo_index_level(rad2deg(epsilon * 0.66) * 0.25);
+  GArray *cells = g_array_new(FALSE, FALSE, sizeof(guint32));
+  dt_geo_index_query(index, level, bbox->lon1, bbox->lon2, bbox->lat2, bbox->lat1, cells);
+  guint32 nb_cells = 0;
+  const dt_geo_index_cell_t *c = dt_geo_index_get_cells(index, level, &nb_cells);
+
+  int64_t clusters = 0;
+  dt_geo_position_t *p = cells->len ? calloc(cells->len, sizeof(dt_geo_position_t)) : NULL;
+  if(p)
+  {
+    for(int i = 0; i < cells->len; i++)
+    {
+      const guint32 cell = g_array_index(cells, guint32, i);
+      p[i].cell = cell;
+      p[i].first = c[cell].first;
+      p[i].count = c[cell].count;
+      p[i].same_loc = c[cell].same_loc;
+      p[i].imgid = dt_geo_index_get_point(index, c[cell].first)->imgid;
+      p[i].x = deg2rad(c[cell].lon);
+      p[i].y = deg2rad(c[cell].lat);
+      p[i].cluster_id = DT_GEO_CLUSTER_UNCLASSIFIED;
+    }
+    clusters = dt_geo_cluster_dbscan(p, cells->len, bbox, epsilon, 1);
+    free(p);
+  }
+  g_array_free(cells, TRUE);
+  return clusters;
+}
+
+static int64_t _tag_dictionary(void)
+{
+  // what the tagging module fetches before filling its tree store
+  GList *tags = NULL;
+  const uint32_t count = dt_tag_get_with_usage(&tags);
+  tags = dt_sort_tag(tags, 0);
+  dt_tag_free_result(&tags);
+  return count;
+}
+
+static int64_t _filter_counts(void)
+{
+  // the range graphs of the filtering module, see src/libs/filters/
+  static const char *filters[] =
+  {
+    "SELECT CASE WHEN (flags & 8) == 8 THEN -1 ELSE (flags & 7) END AS rating,"
+    " COUNT(*) AS count FROM main.images AS mi WHERE %s GROUP BY rating ORDER BY rating",
+    "SELECT exposure, COUNT(*) AS count FROM main.images AS mi WHERE %s GROUP BY exposure",
+    "SELECT ROUND(aperture,1), COUNT(*) AS count FROM main.images AS mi WHERE %s"
+    " GROUP BY ROUND(aperture,1)",
+    "SELECT strftime('%%Y:%%m:%%d', datetime_taken / 1000000 - 62135596800, 'unixepoch') AS date,"
+    " COUNT(*) AS count FROM main.images AS mi WHERE %s GROUP BY date ORDER BY date",
+  };
+
+  gchar *where_ext = dt_collection_get_extended_where(darktable.collection, 99999);
+  int64_t rows = 0;
+  for(int k = 0; k < G_N_ELEMENTS(filters); k++)
+  {
+    gchar *query = g_strdup_printf(filters[k], where_ext);
+    rows += _count_rows(query);
+    g_free(query);
+  }
+  g_free(where_ext);
+  return rows;
+}
+
+static int _run(const dt_bench_catalog_t *p)
+{
+  sqlite3_stmt *stmt;
+  gchar *folder = NULL, *tag = NULL;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT folder FROM main.film_rolls"
+                              " ORDER BY id LIMIT 1 OFFSET (SELECT COUNT(*) / 2 FROM main.film_rolls)",
+                              -1, &stmt, NULL);
+  if(sqlite3_step(stmt) == SQLITE_ROW)
+    folder = g_strdup((const char *)sqlite3_column_text(stmt, 0));
+  sqlite3_finalize(stmt);
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT name FROM data.tags"
+                              " WHERE name NOT LIKE 'darktable|%' ORDER BY id LIMIT 1",
+                              -1, &stmt, NULL);
+  if(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    // collect the whole second level of the first tag
+    gchar **tokens = g_strsplit((const char *)sqlite3_column_text(stmt, 0), "|", 3);
+    tag = tokens[0] && tokens[1] ? g_strdup_printf("%s|%s|%%", tokens[0], tokens[1]) : NULL;
+    g_strfreev(tokens);
+  }
+  sqlite3_finalize(stmt);
+
+  if(!folder)
+  {
+    fprintf(stderr, "[bench catalog] the library is empty, use `generate' first\n");
+    return 1;
+  }
+
+  gchar *folders = g_path_get_dirname(folder);
+  gchar *folders_rule = g_strdup_printf("%s*", folders);
+  const struct
+  {
+    const char *name;
+    dt_collection_properties_t property;
+    const char *text;
+  } collections[] =
+  {
+    { "film roll", DT_COLLECTION_PROP_FILMROLL, folder },
+    { "folders", DT_COLLECTION_PROP_FOLDERS, folders_rule },
+    { "tag", DT_COLLECTION_PROP_TAG, tag ? tag : "%" },
+    { "rating", DT_COLLECTION_PROP_RATING_RANGE, "[2;5]" },
+    { "all images", DT_COLLECTION_PROP_FILMROLL, "%" },
+  };
+
+  const dt_map_box_t world = { .lon1 = -180.0f, .lat1 = 90.0f, .lon2 = 180.0f, .lat2 = -90.0f };
+  const dt_map_box_t region = { .lon1 = -10.0f, .lat1 = 60.0f, .lon2 = 30.0f, .lat2 = 35.0f };
+
+  printf("%d reps, %s\n", p->reps, dt_database_get_path(darktable.db));
+  printf("  %-36s %13s  %13s  %10s\n", "", "min", "avg", "result");
+
+  for(int c = 0; c < G_N_ELEMENTS(collections); c++)
+  {
+    dt_bench_timing_t update = { 0 }, count = { 0 }, filters = { 0 };
+    dt_bench_timing_t map_index = { 0 }, map = { 0 }, map_region = { 0 };
+    _set_collection(collections[c].property, collections[c].text);
+    for(int r = 0; r < p->reps; r++)
+    {
+      double start = dt_get_wtime();
+      dt_collection_update_query(darktable.collection, DT_COLLECTION_CHANGE_NEW_QUERY,
+                                 DT_COLLECTION_PROP_UNDEF, NULL);
+      _timing_add(&update, dt_get_wtime() - start, dt_collection_get_collected_count());
+
+      start = dt_get_wtime();
+      const uint32_t n = dt_collection_get_count(darktable.collection);
+      _timing_add(&count, dt_get_wtime() - start, n);
+
+      start = dt_get_wtime();
+      const int64_t filter_rows = _filter_counts();
+      _timing_add(&filters, dt_get_wtime() - start, filter_rows);
+
+      start = dt_get_wtime();
+      dt_geo_index_t *index = _map_index();
+      _timing_add(&map_index, dt_get_wtime() - start, dt_geo_index_count(index));
+
+      // the first query of a level aggregates its cells, the map view
+      // pays it once per zoom level
+      start = dt_get_wtime();
+      const int64_t world_clusters = _map_clusters(index, &world, 2);
+      _timing_add(&map, dt_get_wtime() - start, world_clusters);
+
+      start = dt_get_wtime();
+      const int64_t region_clusters = _map_clusters(index, &region, 6);
+      _timing_add(&map_region, dt_get_wtime() - start, region_clusters);
+      dt_geo_index_free(index);
+    }
+
+    printf("collection: %s\n", collections[c].name);
+    _timing_print("dt_collection_update_query", &update);
+    _timing_print("dt_collection_get_count", &count);
+    _timing_print("filtering module counts", &filters);
+    _timing_print("map spatial index", &map_index);
+    _timing_print("map clusters (world)", &map);
+    _timing_print("map clusters (region)", &map_region);
+  }
+
+  dt_bench_timing_t dictionary = { 0 }, locations = { 0 };
+  for(int r = 0; r < p->reps; r++)
+  {
+    double start = dt_get_wtime();
+    const int64_t ntags = _tag_dictionary();
+    _timing_add(&dictionary, dt_get_wtime() - start, ntags);
+
+    start = dt_get_wtime();
+    GList *locs = dt_map_location_get_locations_on_map(&world);
+    _timing_add(&locations, dt_get_wtime() - start, g_list_length(locs));
+    dt_map_location_free_result(&locs);
+  }
+  printf("library\n");
+  _timing_print("tag dictionary (tagging module)", &dictionary);
+  _timing_print("map locations", &locations);
+
+  g_free(folders_rule);
+  g_free(folders);
+  g_free(folder);
+  g_free(tag);
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  if(argc < 2 || (strcmp(argv[1], "generate") && strcmp(argv[1], "run")))
+  {
+    _usage(argv[0]);
+    exit(1);
+  }
+
+  const gboolean generate = !strcmp(argv[1], "generate");
+  dt_bench_catalog_t p = { .images = 0, .tags = 30000, .tags_per_image = 5,
+                           .edited_ratio = 0.6f, .geotagged_ratio = 0.7f,
+                           .mip_levels = 1, .reps = 5 };
+  const char *library = NULL;
+
+  int k = 2;
+  if(generate)
+  {
+    if(argc < 3 || (p.images = atoi(argv[2])) <= 0)
+    {
+      _usage(argv[0]);
+      exit(1);
+    }
+    k = 3;
+  }
+
+  for(; k < argc; k++)
+  {
+    if(!strcmp(argv[k], "--library") && argc > k + 1)
+      library = argv[++k];
+    else if(!strcmp(argv[k], "--tags") && argc > k + 1)
+      p.tags = MAX(0, atoi(argv[++k]));
+    else if(!strcmp(argv[k], "--tags-per-image") && argc > k + 1)
+      p.tags_per_image = MAX(0, atoi(argv[++k]));
+    else if(!strcmp(argv[k], "--edited") && argc > k + 1)
+      p.edited_ratio = g_ascii_strtod(argv[++k], NULL);
+    else if(!strcmp(argv[k], "--geotagged") && argc > k + 1)
+      p.geotagged_ratio = g_ascii_strtod(argv[++k], NULL);
+    else if(!strcmp(argv[k], "--mipmaps") && argc > k + 1)
+      p.mip_levels = MAX(0, atoi(argv[++k]));
+    else if(!strcmp(argv[k], "--reps") && argc > k + 1)
+      p.reps = MAX(1, atoi(argv[++k]));
+    else if(!strcmp(argv[k], "--core"))
+    {
+      k++;
+      break;
+    }
+    else
+    {
+      fprintf(stderr, "unknown option '%s'\n", argv[k]);
+      _usage(argv[0]);
+      exit(1);
+    }
+  }
+
+  if(!library || !strcmp(library, ":memory:"))
+  {
+    fprintf(stderr, "a library file is required\n");
+    _usage(argv[0]);
+    exit(1);
+  }
+
+  int m_argc = 0;
+  char **m_arg = malloc(sizeof(char *) * (5 + argc - k + 1));
+  m_arg[m_argc++] = "darktable-bench-catalog";
+  m_arg[m_argc++] = "--library";
+  m_arg[m_argc++] = (char *)library;
+  m_arg[m_argc++] = "--conf";
+  m_arg[m_argc++] = "write_sidecar_files=never";
+  for(; k < argc; k++) m_arg[m_argc++] = argv[k];
+  m_arg[m_argc] = NULL;
+
+  // init dt without gui but with data.db, the presets provide the history stacks
+  if(dt_init(m_argc, m_arg, FALSE, TRUE, NULL))
+  {
+    free(m_arg);
+    exit(1);
+  }
+
+  const int res = generate ? _generate(&p) : _run(&p);
+
+  dt_cleanup();
+  free(m_arg);
+  return res;
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,698 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  darktable-bench-kernels: time the image processing primitives of
+  src/common and the cpu demosaicers on synthetic images of several sizes
+  and thread counts.
+
+    darktable-bench-kernels [--sizes <mp,...>] [--threads <n,...>] [--reps <n>]
+                            [--kernels <name,...>] [--json <file>] [--list]
+                            [--core <darktable options>]
+
+  see src/tests/benchmark/README.txt
+*/
+
+#include "config.h"
+#include "common/bilateral.h"
+#include "common/box_filters.h"
+#include "common/darktable.h"
+#include "common/dwt.h"
+#include "common/eaw.h"
+#include "common/fast_guided_filter.h"
+#include "common/gaussian.h"
+#include "common/guided_filter.h"
+#include "common/interpolation.h"
+#include "common/locallaplacian.h"
+#include "common/nlmeans_core.h"
+
+// the demosaicers are private to the module, its source is included as
+// the unit tests of src/tests/unittests/iop do. AMaZE is built from
+// iop/demosaicing/amaze.cc along with this file.
+#include "iop/demosaic.c"
+
+#include <json-glib/json-glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+// the synthetic input, in the formats expected by the kernels
+typedef struct dt_bench_image_t
+{
+  int width, height;
+  float *rgb;    // 4 channels, scene-referred rgb in [0; 1]
+  float *lab;    // 4 channels, L in [0; 100]
+  float *gray;   // 1 channel, luminance of rgb
+  float *bayer;  // 1 channel, rgb sampled by an RGGB color filter array
+  float *xtrans; // 1 channel, rgb sampled by an X-Trans color filter array
+  float *out;    // 4 channels, output of the kernels
+  float *tmp;    // 4 channels, scratch / in-place copies
+} dt_bench_image_t;
+
+// a kernel runs once on the image and returns the time of the
+// measured part in seconds, the setup is not timed. bytes is the
+// nominal memory traffic of the measured part: the buffers read and
+// written once, not the intermediate buffers of the kernel.
+typedef double (*dt_bench_kernel_func_t)(const dt_bench_image_t *img, size_t *bytes);
+
+typedef struct dt_bench_kernel_t
+{
+  const char *name;
+  dt_bench_kernel_func_t run;
+} dt_bench_kernel_t;
+
+static double _gaussian_blur_4c(const dt_bench_image_t *img, size_t *bytes)
+{
+  const dt_aligned_pixel_t max = { 1.0f, 1.0f, 1.0f, 1.0f };
+  const dt_aligned_pixel_t min = { 0.0f, 0.0f, 0.0f, 0.0f };
+  dt_gaussian_t *g = dt_gaussian_init(img->width, img->height, 4, max, min, 8.0f, DT_IOP_GAUSSIAN_ZERO);
+  if(!g) return -1.0;
+  const double start = dt_get_wtime();
+  dt_gaussian_blur_4c(g, img->rgb, img->out);
+  const double end = dt_get_wtime();
+  dt_gaussian_free(g);
+  *bytes = (size_t)img->width * img->height * 4 * sizeof(float) * 2;
+  return end - start;
+}
+
+static dt_bilateral_t *_bilateral_init(const dt_bench_image_t *img)
+{
+  // the settings of the local contrast module in bilateral mode
+  return dt_bilateral_init(img->width, img->height, 8.0f, 20.0f);
+}
+
+static size_t _bilateral_grid_bytes(const dt_bilateral_t *b)
+{
+  return b->size_x * b->size_y * b->size_z * sizeof(float);
+}
+
+static double _bilateral_splat(const dt_bench_image_t *img, size_t *bytes)
+{
+  dt_bilateral_t *b = _bilateral_init(img);
+  if(!b) return -1.0;
+  const double start = dt_get_wtime();
+  dt_bilateral_splat(b, img->lab);
+  const double end = dt_get_wtime();
+  *bytes = (size_t)img->width * img->height * 4 * sizeof(float) + _bilateral_grid_bytes(b);
+  dt_bilateral_free(b);
+  return end - start;
+}
+
+static double _bilateral_blur(const dt_bench_image_t *img, size_t *bytes)
+{
+  dt_bilateral_t *b = _bilateral_init(img);
+  if(!b) return -1.0;
+  dt_bilateral_splat(b, img->lab);
+  const double start = dt_get_wtime();
+  dt_bilateral_blur(b);
+  const double end = dt_get_wtime();
+  *bytes = 2 * _bilateral_grid_bytes(b);
+  dt_bilateral_free(b);
+  return end - start;
+}
+
+static double _bilateral_slice(const dt_bench_image_t *img, size_t *bytes)
+{
+  dt_bilateral_t *b = _bilateral_init(img);
+  if(!b) return -1.0;
+  dt_bilateral_splat(b, img->lab);
+  dt_bilateral_blur(b);
+  const double start = dt_get_wtime();
+  dt_bilateral_slice(b, img->lab, img->out, 1.0f);
+  const double end = dt_get_wtime();
+  *bytes = (size_t)img->width * img->height * 4 * sizeof(float) * 2 + _bilateral_grid_bytes(b);
+  dt_bilateral_free(b);
+  return end - start;
+}
+
+static double _guided_filter(const dt_bench_image_t *img, size_t *bytes)
+{
+  // as used by the haze removal module: rgb guide, gray input
+  const double start = dt_get_wtime();
+  guided_filter(img->rgb, img->gray, img->tmp, img->width, img->height, 4, 8, 0.1f, 1.0f,
+                -FLT_MAX, FLT_MAX);
+  const double end = dt_get_wtime();
+  *bytes = (size_t)img->width * img->height * sizeof(float) * (4 + 1 + 1);
+  return end - start;
+}
+
+static double _fast_guided_filter(const dt_bench_image_t *img, size_t *bytes)
+{
+  // in-place on a gray image, as the tone equalizer does
+  const size_t npixels = (size_t)img->width * img->height;
+  memcpy(img->tmp, img->gray, npixels * sizeof(float));
+  const double start = dt_get_wtime();
+  fast_surface_blur(img->tmp, img->width, img->height, 32, 0.05f, 1, DT_GF_BLENDING_LINEAR,
+                    1.0f, 0.0f, exp2f(-14.0f), 4.0f);
+  const double end = dt_get_wtime();
+  *bytes = npixels * sizeof(float) * 2;
+  return end - start;
+}
+
+static double _local_laplacian(const dt_bench_image_t *img, size_t *bytes)
+{
+  const double start = dt_get_wtime();
+  local_laplacian_internal(img->lab, img->out, img->width, img->height,
+                           0.2f, 0.5f, 0.5f, 0.2f, NULL);
+  const double end = dt_get_wtime();
+  *bytes = (size_t)img->width * img->height * 4 * sizeof(float) * 2;
+  return end - start;
+}
+
+static double _dwt_denoise(const dt_bench_image_t *img, size_t *bytes)
+{
+  // in-place on one channel, as raw denoise does for each CFA color
+  const size_t npixels = (size_t)img->width * img->height;
+  const float noise[5] = { 0.02f, 0.01f, 0.005f, 0.0025f, 0.001f };
+  memcpy(img->tmp, img->gray, npixels * sizeof(float));
+  const double start = dt_get_wtime();
+  dwt_denoise(img->tmp, img->width, img->height, 5, noise);
+  const double end = dt_get_wtime();
+  *bytes = npixels * sizeof(float) * 2;
+  return end - start;
+}
+
+static double _eaw(const dt_bench_image_t *img, size_t *bytes)
+{
+  // the five scales of the contrast equalizer
+  const size_t npixels = (size_t)img->width * img->height;
+  float *const restrict buf = dt_alloc_align_float(npixels * 4 * 2);
+  if(!buf) return -1.0;
+  const dt_aligned_pixel_t threshold = { 0.0f, 0.0f, 0.0f, 0.0f };
+  const dt_aligned_pixel_t boost = { 1.2f, 1.0f, 1.0f, 1.0f };
+  memset(img->out, 0, npixels * 4 * sizeof(float));
+  const float *in = img->lab;
+  float *out = buf;
+  float *other = buf + npixels * 4;
+  const double start = dt_get_wtime();
+  for(int scale = 0; scale < 5; scale++)
+  {
+    eaw_decompose_and_synthesize(out, in, img->out, scale, 0.001f, threshold, boost,
+                                 img->width, img->height);
+    in = out;
+    out = other;
+    other = (float *)in;
+  }
+  const double end = dt_get_wtime();
+  dt_free_align(buf);
+  *bytes = npixels * 4 * sizeof(float) * 3 * 5;
+  return end - start;
+}
+
+static double _nlmeans_denoise(const dt_bench_image_t *img, size_t *bytes)
+{
+  // the defaults of the denoise (profiled) module in non-local means mode
+  const dt_aligned_pixel_t norm = { 1.0f, 1.0f, 1.0f, 1.0f };
+  const dt_nlmeans_param_t params = { .scattering = 0.0f,
+                                      .scale = 1.0f,
+                                      .luma = 1.0f,
+                                      .chroma = 1.0f,
+                                      .center_weight = -1.0f,
+                                      .sharpness = 0.001f,
+                                      .patch_radius = 1,
+                                      .search_radius = 7,
+                                      .decimate = 0,
+                                      .norm = norm,
+                                      .pipetype = DT_DEV_PIXELPIPE_EXPORT };
+  const dt_iop_roi_t roi = { .x = 0, .y = 0, .width = img->width, .height = img->height,
+                             .scale = 1.0f };
+  const double start = dt_get_wtime();
+  nlmeans_denoise(img->rgb, img->out, &roi, &roi, &params);
+  const double end = dt_get_wtime();
+  *bytes = (size_t)img->width * img->height * 4 * sizeof(float) * 2;
+  return end - start;
+}
+
+static double _box_mean(const dt_bench_image_t *img, size_t *bytes)
+{
+  const size_t npixels = (size_t)img->width * img->height;
+  memcpy(img->tmp, img->rgb, npixels * 4 * sizeof(float));
+  const double start = dt_get_wtime();
+  dt_box_mean(img->tmp, img->height, img->width, 4, 8, 1);
+  const double end = dt_get_wtime();
+  *bytes = npixels * 4 * sizeof(float) * 2;
+  return end - start;
+}
+
+static double _box_max(const dt_bench_image_t *img, size_t *bytes)
+{
+  const size_t npixels = (size_t)img->width * img->height;
+  memcpy(img->tmp, img->gray, npixels * sizeof(float));
+  const double start = dt_get_wtime();
+  dt_box_max(img->tmp, img->height, img->width, 1, 8);
+  const double end = dt_get_wtime();
+  *bytes = npixels * sizeof(float) * 2;
+  return end - start;
+}
+
+static double _resample(const dt_bench_image_t *img, size_t *bytes)
+{
+  // downscale to half size, as for an export
+  const dt_interpolation_t *itor = dt_interpolation_new(DT_INTERPOLATION_LANCZOS3);
+  const dt_iop_roi_t roi_in = { .x = 0, .y = 0, .width = img->width, .height = img->height,
+                                .scale = 1.0f };
+  const dt_iop_roi_t roi_out = { .x = 0, .y = 0, .width = img->width / 2,
+                                 .height = img->height / 2, .scale = 0.5f };
+  const double start = dt_get_wtime();
+  dt_interpolation_resample(itor, img->out, &roi_out, img->rgb, &roi_in);
+  const double end = dt_get_wtime();
+  *bytes = ((size_t)roi_in.width * roi_in.height + (size_t)roi_out.width * roi_out.height)
+           * 4 * sizeof(float);
+  return end - start;
+}
+
+// the RGGB pattern and the X-Trans pattern of the Fujifilm sensors
+#define BENCH_BAYER_FILTERS 0x94949494u
+static const uint8_t _bench_xtrans[6][6] =
+{
+  { 1, 1, 0, 1, 1, 2 },
+  { 1, 1, 2, 1, 1, 0 },
+  { 2, 0, 1, 0, 2, 1 },
+  { 1, 1, 2, 1, 1, 0 },
+  { 1, 1, 0, 1, 1, 2 },
+  { 0, 2, 1, 2, 0, 1 },
+};
+
+// a mosaic in, rgb out
+static size_t _demosaic_bytes(const dt_bench_image_t *img)
+{
+  return (size_t)img->width * img->height * (1 + 4) * sizeof(float);
+}
+
+static double _demosaic_ppg(const dt_bench_image_t *img, size_t *bytes)
+{
+  const double start = dt_get_wtime();
+  demosaic_ppg(img->out, img->bayer, img->width, img->height, BENCH_BAYER_FILTERS, 0.0f, 100000);
+  const double end = dt_get_wtime();
+  *bytes = _demosaic_bytes(img);
+  return end - start;
+}
+
+static double _demosaic_rcd(const dt_bench_image_t *img, size_t *bytes)
+{
+  const double start = dt_get_wtime();
+  rcd_demosaic(img->out, img->bayer, img->width, img->height, BENCH_BAYER_FILTERS, 1.0f);
+  const double end = dt_get_wtime();
+  *bytes = _demosaic_bytes(img);
+  return end - start;
+}
+
+static double _demosaic_lmmse(const dt_bench_image_t *img, size_t *bytes)
+{
+  // the gamma tables are built on the first run, as in the module
+  const double start = dt_get_wtime();
+  lmmse_demosaic(img->out, img->bayer, img->width, img->height, BENCH_BAYER_FILTERS,
+                 DT_LMMSE_REFINE_1, 1.0f);
+  const double end = dt_get_wtime();
+  *bytes = _demosaic_bytes(img);
+  return end - start;
+}
+
+static double _demosaic_amaze(const dt_bench_image_t *img, size_t *bytes)
+{
+  const double start = dt_get_wtime();
+  amaze_demosaic(img->bayer, img->out, img->width, img->height, BENCH_BAYER_FILTERS, 1.0f);
+  const double end = dt_get_wtime();
+  *bytes = _demosaic_bytes(img);
+  return end - start;
+}
+
+static double _demosaic_vng(const dt_bench_image_t *img, size_t *bytes)
+{
+  const double start = dt_get_wtime();
+  vng_interpolate(img->out, img->bayer, img->width, img->height, BENCH_BAYER_FILTERS,
+                  _bench_xtrans, FALSE);
+  const double end = dt_get_wtime();
+  *bytes = _demosaic_bytes(img);
+  return end - start;
+}
+
+static double _demosaic_vng_xtrans(const dt_bench_image_t *img, size_t *bytes)
+{
+  const double start = dt_get_wtime();
+  vng_interpolate(img->out, img->xtrans, img->width, img->height, 9u, _bench_xtrans, FALSE);
+  const double end = dt_get_wtime();
+  *bytes = _demosaic_bytes(img);
+  return end - start;
+}
+
+static double _demosaic_markesteijn(const dt_bench_image_t *img, size_t *bytes)
+{
+  const double start = dt_get_wtime();
+  xtrans_markesteijn_interpolate(img->out, img->xtrans, img->width, img->height,
+                                 _bench_xtrans, 1, 9u);
+  const double end = dt_get_wtime();
+  *bytes = _demosaic_bytes(img);
+  return end - start;
+}
+
+static const dt_bench_kernel_t _kernels[] =
+{
+  { "gaussian_blur_4c", _gaussian_blur_4c },
+  { "bilateral_splat", _bilateral_splat },
+  { "bilateral_blur", _bilateral_blur },
+  { "bilateral_slice", _bilateral_slice },
+  { "guided_filter", _guided_filter },
+  { "fast_guided_filter", _fast_guided_filter },
+  { "local_laplacian", _local_laplacian },
+  { "dwt_denoise", _dwt_denoise },
+  { "eaw", _eaw },
+  { "nlmeans_denoise", _nlmeans_denoise },
+  { "box_mean", _box_mean },
+  { "box_max", _box_max },
+  { "resample_lanczos3", _resample },
+  { "demosaic_ppg", _demosaic_ppg },
+  { "demosaic_rcd", _demosaic_rcd },
+  { "demosaic_lmmse", _demosaic_lmmse },
+  { "demosaic_amaze", _demosaic_amaze },
+  { "demosaic_vng", _demosaic_vng },
+  { "demosaic_vng_xtrans", _demosaic_vng_xtrans },
+  { "demosaic_markesteijn", _demosaic_markesteijn },
+};
+
+static float _hash(const uint32_t x, const uint32_t y)
+{
+  uint32_t h = x * 0x8da6b343u ^ y * 0xd8163841u;
+  h ^= h >> 13;
+  h *= 0x5bd1e995u;
+  h ^= h >> 15;
+  return (h & 0xffffff) / (float)0xffffff;
+}
+
+// smooth gradients, hard edges and some noise, so that the edge-aware
+// kernels have some work to do
+static gboolean _image_init(dt_bench_image_t *img, const double megapixels)
+{
+  img->width = (int)sqrt(megapixels * 1e6 * 1.5) & ~7;
+  img->height = (int)(img->width / 1.5) & ~7;
+  const size_t npixels = (size_t)img->width * img->height;
+  img->rgb = dt_alloc_align_float(npixels * 4);
+  img->lab = dt_alloc_align_float(npixels * 4);
+  img->gray = dt_alloc_align_float(npixels);
+  img->bayer = dt_alloc_align_float(npixels);
+  img->xtrans = dt_alloc_align_float(npixels);
+  img->out = dt_alloc_align_float(npixels * 4);
+  img->tmp = dt_alloc_align_float(npixels * 4);
+  if(!img->rgb || !img->lab || !img->gray || !img->bayer || !img->xtrans
+     || !img->out || !img->tmp)
+    return FALSE;
+
+  const int width = img->width;
+  const int height = img->height;
+  float *const rgb = img->rgb;
+  float *const lab = img->lab;
+  float *const gray = img->gray;
+  float *const bayer = img->bayer;
+  float *const xtrans = img->xtrans;
+  DT_OMP_FOR()
+  for(int j = 0; j < height; j++)
+  {
+    for(int i = 0; i < width; i++)
+    {
+      const size_t k = (size_t)j * width + i;
+      const float u = (float)i / width;
+      const float v = (float)j / height;
+      const float tile = ((i / 97) + (j / 61)) & 1 ? 0.25f : 0.0f;
+      const float noise = 0.05f * (_hash(i, j) - 0.5f);
+      rgb[4 * k + 0] = CLAMP(0.1f + 0.6f * u + tile + noise, 0.0f, 1.0f);
+      rgb[4 * k + 1] = CLAMP(0.1f + 0.5f * v + tile + noise, 0.0f, 1.0f);
+      rgb[4 * k + 2] = CLAMP(0.6f - 0.4f * u * v + tile + noise, 0.0f, 1.0f);
+      rgb[4 * k + 3] = 0.0f;
+      const float y = 0.2126f * rgb[4 * k] + 0.7152f * rgb[4 * k + 1] + 0.0722f * rgb[4 * k + 2];
+      gray[k] = y;
+      bayer[k] = rgb[4 * k + FC(j, i, BENCH_BAYER_FILTERS)];
+      xtrans[k] = rgb[4 * k + FCxtrans(j, i, NULL, _bench_xtrans)];
+      lab[4 * k + 0] = 100.0f * y;
+      lab[4 * k + 1] = 50.0f * (rgb[4 * k] - rgb[4 * k + 1]);
+      lab[4 * k + 2] = 50.0f * (rgb[4 * k + 1] - rgb[4 * k + 2]);
+      lab[4 * k + 3] = 0.0f;
+    }
+  }
+  return TRUE;
+}
+
+static void _image_cleanup(dt_bench_image_t *img)
+{
+  dt_free_align(img->rgb);
+  dt_free_align(img->lab);
+  dt_free_align(img->gray);
+  dt_free_align(img->bayer);
+  dt_free_align(img->xtrans);
+  dt_free_align(img->out);
+  dt_free_align(img->tmp);
+  memset(img, 0, sizeof(dt_bench_image_t));
+}
+
+static void _set_threads(const int threads)
+{
+  darktable.num_openmp_threads = threads;
+#ifdef _OPENMP
+  omp_set_num_threads(threads);
+#endif
+}
+
+static GArray *_parse_list(const char *list, const gboolean is_float)
+{
+  GArray *values = g_array_new(FALSE, FALSE, sizeof(double));
+  gchar **tokens = g_strsplit(list, ",", -1);
+  for(gchar **t = tokens; *t; t++)
+  {
+    double v;
+    if(!is_float && !g_strcmp0(*t, "max"))
+      v = dt_get_num_procs();
+    else
+      v = g_ascii_strtod(*t, NULL);
+    if(v > 0.0) g_array_append_val(values, v);
+  }
+  g_strfreev(tokens);
+  return values;
+}
+
+static void _usage(const char *progname)
+{
+  fprintf(stderr,
+          "usage: %s [options] [--core <darktable options>]\n"
+          "\n"
+          "options:\n"
+          "   --sizes <mp,...>      image sizes in megapixels, default 1,6,24\n"
+          "   --threads <n,...>     thread counts, 'max' for all cores, default 1,max\n"
+          "   --reps <n>            run each kernel n times after a warm-up, default 3\n"
+          "   --kernels <name,...>  only run these kernels\n"
+          "   --json <file>         write the results to file, '-' for stdout\n"
+          "                         with the table on stderr\n"
+          "   --list                list the kernels\n",
+          progname);
+}
+
+int main(int argc, char *argv[])
+{
+  const char *sizes_arg = "1,6,24";
+  const char *threads_arg = "1,max";
+  const char *kernels_arg = NULL;
+  const char *json_file = NULL;
+  int reps = 3;
+
+  int k = 1;
+  for(; k < argc; k++)
+  {
+    if(!strcmp(argv[k], "--sizes") && argc > k + 1)
+      sizes_arg = argv[++k];
+    else if(!strcmp(argv[k], "--threads") && argc > k + 1)
+      threads_arg = argv[++k];
+    else if(!strcmp(argv[k], "--kernels") && argc > k + 1)
+      kernels_arg = argv[++k];
+    else if(!strcmp(argv[k], "--json") && argc > k + 1)
+      json_file = argv[++k];
+    else if(!strcmp(argv[k], "--reps") && argc > k + 1)
+      reps = MAX(1, atoi(argv[++k]));
+    else if(!strcmp(argv[k], "--list"))
+    {
+      for(int i = 0; i < G_N_ELEMENTS(_kernels); i++)
+        printf("%s\n", _kernels[i].name);
+      exit(0);
+    }
+    else if(!strcmp(argv[k], "--core"))
+    {
+      k++;
+      break;
+    }
+    else
+    {
+      fprintf(stderr, "unknown option '%s'\n", argv[k]);
+      _usage(argv[0]);
+      exit(1);
+    }
+  }
+
+  int m_argc = 0;
+  char **m_arg = malloc(sizeof(char *) * (5 + argc - k + 1));
+  m_arg[m_argc++] = "darktable-bench-kernels";
+  m_arg[m_argc++] = "--library";
+  m_arg[m_argc++] = ":memory:";
+  m_arg[m_argc++] = "--conf";
+  m_arg[m_argc++] = "write_sidecar_files=never";
+  for(; k < argc; k++) m_arg[m_argc++] = argv[k];
+  m_arg[m_argc] = NULL;
+
+  if(dt_init(m_argc, m_arg, FALSE, FALSE, NULL))
+  {
+    free(m_arg);
+    exit(1);
+  }
+
+  GArray *sizes = _parse_list(sizes_arg, TRUE);
+  GArray *threads = _parse_list(threads_arg, FALSE);
+  gchar **selected = kernels_arg ? g_strsplit(kernels_arg, ",", -1) : NULL;
+  const int max_threads = darktable.num_openmp_threads;
+
+  JsonBuilder *builder = json_builder_new();
+  json_builder_begin_object(builder);
+  json_builder_set_member_name(builder, "darktable");
+  json_builder_add_string_value(builder, darktable_package_version);
+  json_builder_set_member_name(builder, "processors");
+  json_builder_add_int_value(builder, dt_get_num_procs());
+  json_builder_set_member_name(builder, "reps");
+  json_builder_add_int_value(builder, reps);
+  json_builder_set_member_name(builder, "results");
+  json_builder_begin_array(builder);
+
+  // keep stdout clean for the json when it is written there
+  FILE *table = json_file && !strcmp(json_file, "-") ? stderr : stdout;
+  fprintf(table, "%d reps, %d processors\n", reps, (int)dt_get_num_procs());
+  fprintf(table, "  %-20s %11s %7s %12s %12s %10s %9s\n",
+          "kernel", "size", "threads", "min", "avg", "MP/s", "GB/s");
+
+  int res = 0;
+  for(int s = 0; s < sizes->len; s++)
+  {
+    dt_bench_image_t img = { 0 };
+    if(!_image_init(&img, g_array_index(sizes, double, s)))
+    {
+      fprintf(stderr, "can't allocate a %.1f MP image\n", g_array_index(sizes, double, s));
+      _image_cleanup(&img);
+      res = 1;
+      break;
+    }
+    const double mp = (double)img.width * img.height * 1e-6;
+
+    for(int i = 0; i < G_N_ELEMENTS(_kernels); i++)
+    {
+      const dt_bench_kernel_t *kernel = &_kernels[i];
+      if(selected && !g_strv_contains((const gchar *const *)selected, kernel->name))
+        continue;
+
+      for(int t = 0; t < threads->len; t++)
+      {
+        const int nthreads = MAX(1, (int)g_array_index(threads, double, t));
+        _set_threads(nthreads);
+
+        size_t bytes = 0;
+        double min = 0.0, sum = 0.0;
+        // warm-up: page faults of the buffers, lazy initializations
+        gboolean ok = kernel->run(&img, &bytes) >= 0.0;
+        for(int r = 0; ok && r < reps; r++)
+        {
+          const double seconds = kernel->run(&img, &bytes);
+          ok = seconds >= 0.0;
+          min = r ? MIN(min, seconds) : seconds;
+          sum += seconds;
+        }
+        if(!ok)
+        {
+          fprintf(stderr, "%s failed on %dx%d\n", kernel->name, img.width, img.height);
+          res = 1;
+          continue;
+        }
+
+        const double mps = min > 0.0 ? mp / min : 0.0;
+        const double gbs = min > 0.0 ? bytes / min * 1e-9 : 0.0;
+        fprintf(table, "  %-20s %5dx%-5d %7d %9.2f ms %9.2f ms %10.1f %9.2f\n",
+                kernel->name, img.width, img.height, nthreads,
+                1000.0 * min, 1000.0 * sum / reps, mps, gbs);
+
+        json_builder_begin_object(builder);
+        json_builder_set_member_name(builder, "kernel");
+        json_builder_add_string_value(builder, kernel->name);
+        json_builder_set_member_name(builder, "width");
+        json_builder_add_int_value(builder, img.width);
+        json_builder_set_member_name(builder, "height");
+        json_builder_add_int_value(builder, img.height);
+        json_builder_set_member_name(builder, "threads");
+        json_builder_add_int_value(builder, nthreads);
+        json_builder_set_member_name(builder, "min_ms");
+        json_builder_add_double_value(builder, 1000.0 * min);
+        json_builder_set_member_name(builder, "avg_ms");
+        json_builder_add_double_value(builder, 1000.0 * sum / reps);
+        json_builder_set_member_name(builder, "mp_per_s");
+        json_builder_add_double_value(builder, mps);
+        json_builder_set_member_name(builder, "gb_per_s");
+        json_builder_add_double_value(builder, gbs);
+        json_builder_end_object(builder);
+      }
+    }
+    _image_cleanup(&img);
+  }
+  _set_threads(max_threads);
+
+  json_builder_end_array(builder);
+  json_builder_end_object(builder);
+
+  if(json_file)
+  {
+    JsonGenerator *generator = json_generator_new();
+    json_generator_set_pretty(generator, TRUE);
+    JsonNode *root = json_builder_get_root(builder);
+    json_generator_set_root(generator, root);
+    GError *error = NULL;
+    if(!strcmp(json_file, "-"))
+    {
+      gchar *json = json_generator_to_data(generator, NULL);
+      printf("%s\n", json);
+      g_free(json);
+    }
+    else if(!json_generator_to_file(generator, json_file, &error))
+    {
+      fprintf(stderr, "can't write %s: %s\n", json_file, error->message);
+      g_error_free(error);
+      res = 1;
+    }
+    json_node_free(root);
+    g_object_unref(generator);
+  }
+  g_object_unref(builder);
+
+  g_strfreev(selected);
+  g_array_free(sizes, TRUE);
+  g_array_free(threads, TRUE);
+
+  dt_cleanup();
+  free(m_arg);
+  return res;
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,119 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Unit tests for the line detection of iop/ashift.c on the tiles of a
+ * synthetic image holding edges across the seams: the lines found on one
+ * thread and on several ones must be the same, and the pieces of the
+ * edges cut by the seams must be joined.
+ *
+ * Following test_filmicrgb.c, the implementation is #included directly
+ * for static access. */
+
+#include <math.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <cmocka.h>
+
+#include "iop/ashift.c"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+#define TEST_W 1300
+#define TEST_H 900
+#define TEST_THREADS 4
+
+// a dark background with a bright block, a bright band and a slanted
+// edge, all of them crossing seams of the tiles, and some noise
+static double *_test_image(void)
+{
+  double *grey = malloc(sizeof(double) * TEST_W * TEST_H);
+  uint32_t state = 12345;
+  for(int j = 0; j < TEST_H; j++)
+    for(int i = 0; i < TEST_W; i++)
+    {
+      double v = 60.0;
+      if(j > 450 && i > 100 && i < 1200) v = 180.0;
+      if(i > 700 && i < 760 && j > 480 && j < 850) v = 230.0;
+      if(j < 0.3 * i + 40.0) v += 50.0;
+      state = state * 1664525u + 1013904223u;
+      grey[(size_t)j * TEST_W + i] = v + 4.0 * (state >> 8) / (double)(1 << 24);
+    }
+  return grey;
+}
+
+static double *_detect(int *count,
+                       double *grey,
+                       const int threads)
+{
+  darktable.num_openmp_threads = threads;
+#ifdef _OPENMP
+  omp_set_num_threads(threads);
+#endif
+  return _lsd_tiled(count, grey, TEST_W, TEST_H);
+}
+
+static void test_threads(void **state)
+{
+  double *grey = _test_image();
+
+  int single_count = 0;
+  double *single = _detect(&single_count, grey, 1);
+  int multi_count = 0;
+  double *multi = _detect(&multi_count, grey, TEST_THREADS);
+
+  assert_non_null(single);
+  assert_non_null(multi);
+  assert_true(single_count > 0);
+  assert_int_equal(single_count, multi_count);
+  assert_memory_equal(single, multi, sizeof(double) * 7 * single_count);
+
+  // the edge of the block crosses two seams in a single line
+  double longest = 0.0;
+  for(int n = 0; n < single_count; n++)
+  {
+    const double *l = single + 7 * n;
+    longest = MAX(longest, hypot(l[2] - l[0], l[3] - l[1]));
+  }
+  assert_true(longest > 2 * LSD_TILE_SIZE);
+
+  free(single);
+  free(multi);
+  free(grey);
+}
+
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  (void)argv;
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_threads),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
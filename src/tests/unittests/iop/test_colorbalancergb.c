@@ -0,0 +1,187 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Unit tests for the kernel variants of the pixel loop of
+ * iop/colorbalancergb.c. The loop is run at every level supported by the
+ * host and compared with the baseline variant, as test_cpu_dispatch.c
+ * does for the kernels of lib_darktable. It lives apart because the
+ * module API of two included module sources would clash.
+ *
+ * Following test_filmicrgb.c, the implementation is #included directly
+ * for static access. */
+
+#include <math.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <cmocka.h>
+
+#include "../util/assert.h"
+#include "iop/colorbalancergb.c"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+#define TEST_W 203
+#define TEST_H 117
+#define TEST_NPIX ((size_t)TEST_W * TEST_H)
+
+// linear Rec2020 with its D50 adapted primaries
+static const dt_colormatrix_t _rec2020_to_xyz
+    = { {  0.6734241f,  0.1656411f,  0.1251286f, 0.0f },
+        {  0.2790177f,  0.6753402f,  0.0456377f, 0.0f },
+        { -0.0019300f,  0.0299784f,  0.7973330f, 0.0f } };
+static const dt_colormatrix_t _xyz_to_rec2020
+    = { {  1.6473542f, -0.3935678f, -0.2359961f, 0.0f },
+        { -0.6826000f,  1.6475887f,  0.0128190f, 0.0f },
+        {  0.0296519f, -0.0628912f,  1.2533700f, 0.0f } };
+
+// some grading in every control, as commit_params() would set it
+static dt_iop_colorbalancergb_data_t *_data(const dt_iop_colorbalancrgb_saturation_t formula)
+{
+  dt_iop_colorbalancergb_data_t *d = dt_calloc1_align_type(dt_iop_colorbalancergb_data_t);
+  const float global[4] = { 0.01f, 0.0f, -0.01f, 0.0f };
+  const float shadows[4] = { 1.1f, 1.0f, 0.95f, 1.0f };
+  const float highlights[4] = { 0.9f, 1.0f, 1.05f, 1.0f };
+  const float midtones[4] = { 1.0f / 1.05f, 1.0f, 1.0f / 0.97f, 1.0f };
+  for(int c = 0; c < 4; c++)
+  {
+    d->global[c] = global[c];
+    d->shadows[c] = shadows[c];
+    d->highlights[c] = highlights[c];
+    d->midtones[c] = midtones[c];
+  }
+  d->midtones_Y = 1.0f / 1.1f;
+  d->chroma_global = 0.1f;
+  d->chroma[0] = 0.2f;
+  d->chroma[1] = -0.1f;
+  d->chroma[2] = 0.05f;
+  d->vibrance = 0.2f;
+  d->contrast = 1.1f;
+  d->saturation_global = 0.15f;
+  d->saturation[0] = -0.1f;
+  d->saturation[1] = 0.2f;
+  d->saturation[2] = 0.1f;
+  d->brilliance_global = 0.05f;
+  d->brilliance[0] = 0.1f;
+  d->brilliance[1] = -0.05f;
+  d->brilliance[2] = 0.0f;
+  d->hue_angle = 0.1f;
+  d->shadows_weight = 2.0f;
+  d->highlights_weight = 2.0f;
+  d->midtones_weight = sqf(d->shadows_weight) * sqf(d->highlights_weight)
+                       / (sqf(d->shadows_weight) + sqf(d->highlights_weight));
+  d->grey_fulcrum = 0.1845f;
+  d->mask_grey_fulcrum = powf(d->grey_fulcrum, 0.4101205819200422f);
+  d->white_fulcrum = 1.0f;
+  const float checker_1[4] = { 0.1f, 0.1f, 0.1f, 1.0f };
+  const float checker_2[4] = { 0.9f, 0.9f, 0.9f, 1.0f };
+  copy_pixel(d->checker_color_1, checker_1);
+  copy_pixel(d->checker_color_2, checker_2);
+  d->saturation_formula = formula;
+  // a flat gamut boundary: only the agreement of the variants is checked
+  d->gamut_LUT = dt_alloc_align_float(LUT_ELEM);
+  for(int k = 0; k < LUT_ELEM; k++) d->gamut_LUT[k] = 0.5f;
+  return d;
+}
+
+// the variants are built without floating point contraction, they must
+// agree to the last bit
+static void _compare(const dt_iop_colorbalancrgb_saturation_t formula,
+                     const gboolean mask_display)
+{
+  const size_t nfloats = 4 * TEST_NPIX;
+  const dt_iop_roi_t roi = { 0, 0, TEST_W, TEST_H, 1.0f };
+  dt_iop_order_iccprofile_info_t *profile = dt_calloc1_align_type(dt_iop_order_iccprofile_info_t);
+  memcpy(profile->matrix_in, _rec2020_to_xyz, sizeof(dt_colormatrix_t));
+  memcpy(profile->matrix_out, _xyz_to_rec2020, sizeof(dt_colormatrix_t));
+  dt_iop_colorbalancergb_data_t *d = _data(formula);
+
+  // colorful pixels within the working gamut
+  float *in = dt_alloc_align_float(nfloats);
+  uint32_t state = 4242u;
+  for(size_t k = 0; k < nfloats; k++)
+  {
+    state = state * 1664525u + 1013904223u;
+    in[k] = 0.05f + 0.8f * (float)((state >> 8) & 0xFFFFFF) / (float)0xFFFFFF;
+  }
+
+  const size_t checker_1 = mask_display ? 8 : 0;
+  const int mask_type = mask_display ? MASK_MIDTONES : 0;
+  float *ref = NULL;
+  const dt_cpu_level_t detected = dt_cpu_detect_level();
+  for(int level = DT_CPU_LEVEL_BASELINE; level <= detected; level++)
+  {
+    darktable.codepath.cpu_level = level;
+    float *out = dt_calloc_align_float(nfloats);
+    DT_CPU_DISPATCH(_process_pixels)(d, profile, in, out, &roi, mask_display, checker_1, mask_type);
+    if(!ref)
+    {
+      ref = out;
+      continue;
+    }
+    assert_floats_within_ulps(ref, out, nfloats, 1);
+    dt_free_align(out);
+  }
+  darktable.codepath.cpu_level = detected;
+
+  dt_free_align(ref);
+  dt_free_align(in);
+  dt_free_align(d->gamut_LUT);
+  dt_free_align(d);
+  dt_free_align(profile);
+}
+
+static void test_jzazbz(void **state)
+{
+  _compare(DT_COLORBALANCE_SATURATION_JZAZBZ, FALSE);
+}
+
+static void test_dtucs(void **state)
+{
+  _compare(DT_COLORBALANCE_SATURATION_DTUCS, FALSE);
+}
+
+static void test_mask_display(void **state)
+{
+  _compare(DT_COLORBALANCE_SATURATION_DTUCS, TRUE);
+}
+
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  (void)argv;
+  // the pixels are processed without dt_init()
+  darktable.num_openmp_threads = dt_get_num_procs();
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_jzazbz),
+    cmocka_unit_test(test_dtucs),
+    cmocka_unit_test(test_mask_display),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
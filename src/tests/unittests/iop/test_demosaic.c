@@ -0,0 +1,113 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Unit tests for the kernel variants of the RCD and AMaZE demosaicers of
+ * iop/demosaic.c. Both are run at every level supported by the host and
+ * compared with the baseline variant, as test_cpu_dispatch.c does for the
+ * kernels of lib_darktable.
+ *
+ * Following test_filmicrgb.c, the implementation is #included directly
+ * for static access. */
+
+#include <math.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <cmocka.h>
+
+#include "../util/assert.h"
+#include "iop/demosaic.c"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+#define TEST_W 203
+#define TEST_H 117
+#define TEST_NPIX ((size_t)TEST_W * TEST_H)
+// an RGGB color filter array
+#define TEST_FILTERS 0x94949494u
+
+static float *_random_mosaic(void)
+{
+  float *img = dt_alloc_align_float(TEST_NPIX);
+  uint32_t state = 4242u;
+  for(size_t k = 0; k < TEST_NPIX; k++)
+  {
+    state = state * 1664525u + 1013904223u;
+    img[k] = (float)((state >> 8) & 0xFFFFFF) / (float)0xFFFFFF;
+  }
+  return img;
+}
+
+static void test_rcd_amaze(void **state)
+{
+  const size_t nfloats = 4 * TEST_NPIX;
+  float *in = _random_mosaic();
+  float *ref_rcd = NULL;
+  float *ref_amaze = NULL;
+
+  const dt_cpu_level_t detected = dt_cpu_detect_level();
+  for(int level = DT_CPU_LEVEL_BASELINE; level <= detected; level++)
+  {
+    darktable.codepath.cpu_level = level;
+    float *rcd = dt_calloc_align_float(nfloats);
+    float *amaze = dt_calloc_align_float(nfloats);
+    rcd_demosaic(rcd, in, TEST_W, TEST_H, TEST_FILTERS, 1.0f);
+    amaze_demosaic(in, amaze, TEST_W, TEST_H, TEST_FILTERS, 1.0f);
+    if(!ref_rcd)
+    {
+      ref_rcd = rcd;
+      ref_amaze = amaze;
+      continue;
+    }
+    // the variants are built without floating point contraction: the
+    // interpolation directions picked on thresholds must agree, and with
+    // them every pixel
+    assert_floats_within_ulps(ref_rcd, rcd, nfloats, 1);
+    assert_floats_within_ulps(ref_amaze, amaze, nfloats, 1);
+    dt_free_align(rcd);
+    dt_free_align(amaze);
+  }
+  darktable.codepath.cpu_level = detected;
+
+  dt_free_align(ref_rcd);
+  dt_free_align(ref_amaze);
+  dt_free_align(in);
+}
+
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  (void)argv;
+  // the demosaicers are run without dt_init()
+  darktable.num_openmp_threads = dt_get_num_procs();
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_rcd_amaze),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
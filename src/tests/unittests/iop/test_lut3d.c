@@ -0,0 +1,200 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Unit tests for the binary cache of the parsed LUT files of
+ * iop/lut3d.c, in a temporary directory: a clut written for a LUT file
+ * is mapped back unchanged, a change of the LUT file misses the cache
+ * even if it keeps its size and modification time, and the least
+ * recently used cache files are pruned beyond the size limit.
+ *
+ * Following test_filmicrgb.c, the implementation is #included directly
+ * for static access. */
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#ifdef _WIN32
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#endif
+
+#include <cmocka.h>
+
+#include "iop/lut3d.c"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+#define TEST_LEVEL 5
+#define TEST_FLOATS (3 * TEST_LEVEL * TEST_LEVEL * TEST_LEVEL + 1)
+
+typedef struct _test_dir_t
+{
+  gchar *cachedir;
+  gchar *lutfile;
+} _test_dir_t;
+
+static int _setup(void **state)
+{
+  _test_dir_t *dir = g_malloc0(sizeof(_test_dir_t));
+  gchar *tmp = g_dir_make_tmp("dt-lut3d-XXXXXX", NULL);
+  if(!tmp) return -1;
+  dir->cachedir = g_build_filename(tmp, "lut3d", NULL);
+  dir->lutfile = g_build_filename(tmp, "test.cube", NULL);
+  g_free(tmp);
+  *state = dir;
+  return 0;
+}
+
+static int _teardown(void **state)
+{
+  _test_dir_t *dir = *state;
+  GDir *cache = g_dir_open(dir->cachedir, 0, NULL);
+  const gchar *name;
+  while(cache && (name = g_dir_read_name(cache)))
+  {
+    gchar *filename = g_build_filename(dir->cachedir, name, NULL);
+    g_unlink(filename);
+    g_free(filename);
+  }
+  if(cache) g_dir_close(cache);
+  g_rmdir(dir->cachedir);
+  g_unlink(dir->lutfile);
+  gchar *tmp = g_path_get_dirname(dir->lutfile);
+  g_rmdir(tmp);
+  g_free(tmp);
+  g_free(dir->cachedir);
+  g_free(dir->lutfile);
+  g_free(dir);
+  return 0;
+}
+
+static void _write_lut(const char *const filename,
+                       const char *const contents,
+                       const int64_t mtime)
+{
+  assert_true(g_file_set_contents(filename, contents, -1, NULL));
+  struct utimbuf times = { mtime, mtime };
+  assert_int_equal(g_utime(filename, &times), 0);
+}
+
+static int _cache_files(const char *const cachedir)
+{
+  int count = 0;
+  GDir *dir = g_dir_open(cachedir, 0, NULL);
+  const gchar *name;
+  while(dir && (name = g_dir_read_name(dir)))
+    count += g_str_has_suffix(name, ".clut");
+  if(dir) g_dir_close(dir);
+  return count;
+}
+
+static void test_hit_and_miss(void **state)
+{
+  _test_dir_t *dir = *state;
+  float *clut = dt_alloc_align_float(TEST_FLOATS);
+  for(int k = 0; k < TEST_FLOATS; k++) clut[k] = 0.001f * k;
+
+  _write_lut(dir->lutfile, "LUT_3D_SIZE 5\n0.0 0.0 0.0\n", 1000000000);
+  int64_t size = 0;
+  const dt_hash_t source = _hash_lut_file(dir->lutfile, &size);
+  assert_int_not_equal(source, DT_INVALID_HASH);
+
+  float *mapped_clut = NULL;
+  GMappedFile *mapped = NULL;
+  assert_int_equal(_read_cached_clut(dir->cachedir, source, size, &mapped_clut, &mapped), 0);
+
+  _write_cached_clut(dir->cachedir, source, size, clut, TEST_LEVEL);
+  assert_int_equal(_read_cached_clut(dir->cachedir, source, size, &mapped_clut, &mapped), TEST_LEVEL);
+  assert_non_null(mapped);
+  assert_memory_equal(mapped_clut, clut, TEST_FLOATS * sizeof(float));
+  g_mapped_file_unref(mapped);
+
+  // same size and modification time, other contents
+  _write_lut(dir->lutfile, "LUT_3D_SIZE 5\n1.0 0.0 0.0\n", 1000000000);
+  int64_t changed_size = 0;
+  const dt_hash_t changed = _hash_lut_file(dir->lutfile, &changed_size);
+  assert_int_equal(changed_size, size);
+  assert_int_not_equal(changed, source);
+  mapped = NULL;
+  assert_int_equal(_read_cached_clut(dir->cachedir, changed, changed_size, &mapped_clut, &mapped), 0);
+  assert_null(mapped);
+
+  dt_free_align(clut);
+}
+
+static void test_prune(void **state)
+{
+  _test_dir_t *dir = *state;
+  float *clut = dt_calloc_align_float(TEST_FLOATS);
+  const size_t file_size = sizeof(dt_iop_lut3d_cache_header_t) + TEST_FLOATS * sizeof(float);
+
+  // four cache files, the first one the oldest
+  for(int k = 0; k < 4; k++)
+  {
+    _write_cached_clut(dir->cachedir, 100 + k, 0, clut, TEST_LEVEL);
+    gchar *filename = _get_clut_cache_filename(dir->cachedir, 100 + k);
+    struct utimbuf times = { 1000000000 + k, 1000000000 + k };
+    assert_int_equal(g_utime(filename, &times), 0);
+    g_free(filename);
+  }
+  assert_int_equal(_cache_files(dir->cachedir), 4);
+
+  // a hit makes the oldest one the most recent
+  float *mapped_clut = NULL;
+  GMappedFile *mapped = NULL;
+  assert_int_equal(_read_cached_clut(dir->cachedir, 100, 0, &mapped_clut, &mapped), TEST_LEVEL);
+  g_mapped_file_unref(mapped);
+
+  // room for two files, the one kept included
+  gchar *keep = _get_clut_cache_filename(dir->cachedir, 102);
+  _prune_clut_cache(dir->cachedir, 2 * file_size, keep);
+  assert_int_equal(_cache_files(dir->cachedir), 2);
+  assert_true(g_file_test(keep, G_FILE_TEST_EXISTS));
+  gchar *recent = _get_clut_cache_filename(dir->cachedir, 100);
+  assert_true(g_file_test(recent, G_FILE_TEST_EXISTS));
+  g_free(recent);
+  g_free(keep);
+
+  // under the limit nothing goes
+  _prune_clut_cache(dir->cachedir, 2 * file_size, NULL);
+  assert_int_equal(_cache_files(dir->cachedir), 2);
+
+  dt_free_align(clut);
+}
+
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  (void)argv;
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test_setup_teardown(test_hit_and_miss, _setup, _teardown),
+    cmocka_unit_test_setup_teardown(test_prune, _setup, _teardown),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
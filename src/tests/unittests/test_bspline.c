@@ -0,0 +1,223 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Unit tests for the detail scales of the B-spline wavelets
+ * (common/bspline.h), decomposed and kept through the common wavelets
+ * code (common/wavelets.h), and the half floats they can be stored as
+ * (common/half.h). The details and the residual of a decomposition add up
+ * to the input whatever the storage, up to the precision of the storage. */
+
+#include <math.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <cmocka.h>
+
+#include "common/bspline.h"
+#include "common/darktable.h"
+#include "common/half.h"
+#include "common/wavelets.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+#define TEST_W 151
+#define TEST_H 97
+#define TEST_SCALES 6
+// unit roundoff of the half floats, 11 significant bits
+#define TEST_HALF_EPSILON (1.0f / 2048.0f)
+
+static unsigned int _rng = 1234u;
+static float _frand(void)
+{
+  _rng = _rng * 1664525u + 1013904223u;
+  return (float)((_rng >> 8) & 0xFFFFFF) / (float)0xFFFFFF;
+}
+
+static void test_half_round_trip(void **state)
+{
+  // every half but the NaNs comes back unchanged
+  for(uint32_t h = 0; h < 0x10000; h++)
+  {
+    if((h & 0x7c00) == 0x7c00 && (h & 0x03ff)) continue;
+    const float f = dt_half_to_float((uint16_t)h);
+    if(dt_float_to_half(f) != h)
+      fail_msg("half 0x%04x read as %g written as 0x%04x", h, f, dt_float_to_half(f));
+  }
+  assert_true(isnan(dt_half_to_float(dt_float_to_half(NAN))));
+  assert_true(isinf(dt_half_to_float(dt_float_to_half(1e6f))));
+  assert_float_equal(dt_half_to_float(dt_float_to_half(65504.0f)), 65504.0f, 0.0f);
+  assert_float_equal(dt_half_to_float(dt_float_to_half(-2.0f)), -2.0f, 0.0f);
+  // smallest half denormal
+  assert_float_equal(dt_half_to_float(dt_float_to_half(5.9604645e-8f)), 5.9604645e-8f, 0.0f);
+}
+
+static void test_half_rounding(void **state)
+{
+  for(int k = 0; k < 100000; k++)
+  {
+    const float f = (_frand() - 0.5f) * exp2f(30.0f * _frand() - 14.0f);
+    const float h = dt_half_to_float(dt_float_to_half(f));
+    if(fabsf(h - f) > TEST_HALF_EPSILON * fabsf(f) + 3e-8f)
+      fail_msg("%g rounded to %g", f, h);
+  }
+  // ties go to even
+  assert_float_equal(dt_half_to_float(dt_float_to_half(1.0f + TEST_HALF_EPSILON)), 1.0f, 0.0f);
+  assert_float_equal(dt_half_to_float(dt_float_to_half(1.0f + 3.0f * TEST_HALF_EPSILON)),
+                     1.0f + 4.0f * TEST_HALF_EPSILON, 0.0f);
+}
+
+typedef struct _decompose_data_t
+{
+  const dt_wavelet_bands_t *bands;
+  float *tempbuf;
+  size_t padded_size;
+} _decompose_data_t;
+
+static void _decompose_scale(const float *const in, float *const LF, const int s, void *const data)
+{
+  const _decompose_data_t *const d = data;
+  dt_bspline_decompose_band(in, d->bands, s, LF, d->tempbuf, d->padded_size);
+}
+
+static void _check_bands(const dt_wavelet_storage_t storage, const float tolerance)
+{
+  const size_t nfloats = (size_t)4 * TEST_W * TEST_H;
+  float *in = dt_alloc_align_float(nfloats);
+  for(size_t k = 0; k < nfloats; k++)
+    in[k] = 2.0f * _frand();
+  float *LF_odd = dt_alloc_align_float(nfloats);
+  float *LF_even = dt_alloc_align_float(nfloats);
+  size_t padded_size;
+  float *tempbuf = dt_alloc_perthread_float(4 * TEST_W, &padded_size);
+
+  dt_wavelet_bands_t bands;
+  assert_true(dt_wavelet_bands_alloc(&bands, TEST_W, TEST_H, 4, TEST_SCALES, FALSE, storage));
+
+  _decompose_data_t data = { &bands, tempbuf, padded_size };
+  const float *residual = dt_wavelet_decompose(in, LF_odd, LF_even, TEST_SCALES, _decompose_scale, &data);
+  // the coarsest scale is odd
+  assert_ptr_equal(residual, LF_even);
+
+  for(size_t k = 0; k < nfloats; k += 4)
+  {
+    dt_aligned_pixel_t sum = { residual[k], residual[k + 1], residual[k + 2], residual[k + 3] };
+    for(int s = 0; s < TEST_SCALES; s++)
+    {
+      dt_aligned_pixel_t detail;
+      dt_wavelet_band_load(bands.band[s], storage, k, detail);
+      for_four_channels(c)
+        sum[c] += detail[c];
+    }
+    for_four_channels(c)
+      if(fabsf(sum[c] - in[k + c]) > tolerance)
+        fail_msg("value %zu: %g recomposed to %g", k + c, in[k + c], sum[c]);
+  }
+
+  dt_wavelet_bands_free(&bands);
+  for(int s = 0; s < DT_WAVELET_MAX_SCALES; s++)
+    assert_null(bands.band[s]);
+  dt_free_align(tempbuf);
+  dt_free_align(LF_odd);
+  dt_free_align(LF_even);
+  dt_free_align(in);
+}
+
+static void test_bands(void **state)
+{
+  _check_bands(DT_WAVELET_STORAGE_FLOAT, 1e-5f);
+  // each detail is below 2, so rounded by 1/1024 at worst
+  _check_bands(DT_WAVELET_STORAGE_HALF, 2.0f * TEST_SCALES * TEST_HALF_EPSILON);
+}
+
+static void test_bands_memory(void **state)
+{
+  const size_t full
+      = dt_wavelet_bands_memory(TEST_W, TEST_H, 4, TEST_SCALES, FALSE, DT_WAVELET_STORAGE_FLOAT);
+  assert_int_equal(full, (size_t)TEST_W * TEST_H * TEST_SCALES * 4 * sizeof(float));
+  assert_int_equal(2 * dt_wavelet_bands_memory(TEST_W, TEST_H, 4, TEST_SCALES, FALSE, DT_WAVELET_STORAGE_HALF),
+                   full);
+  assert_int_equal(dt_wavelet_lf_memory(TEST_W, TEST_H, 4), (size_t)2 * TEST_W * TEST_H * 4 * sizeof(float));
+
+  // the equalizer weights: one channel, halved at each scale
+  size_t decimated = 0;
+  for(int s = 0; s < TEST_SCALES; s++)
+    decimated += (size_t)(1 + (TEST_W >> s)) * (1 + (TEST_H >> s)) * sizeof(float);
+  assert_int_equal(dt_wavelet_bands_memory(TEST_W, TEST_H, 1, TEST_SCALES, TRUE, DT_WAVELET_STORAGE_FLOAT),
+                   decimated);
+}
+
+typedef struct _record_t
+{
+  int scales;
+  const float *in[TEST_SCALES];
+  float *LF[TEST_SCALES];
+} _record_t;
+
+static void _record_scale(const float *const in, float *const LF, const int s, void *const data)
+{
+  _record_t *const r = data;
+  assert_int_equal(s, r->scales);
+  r->in[s] = in;
+  r->LF[s] = LF;
+  r->scales++;
+}
+
+static void test_decompose(void **state)
+{
+  // the low frequencies ping-pong between the buffers, the finest scale
+  // reading the input
+  float in[4] = { 0.0f }, LF_odd[4], LF_even[4];
+  for(int scales = 1; scales <= TEST_SCALES; scales++)
+  {
+    _record_t r = { 0 };
+    const float *residual = dt_wavelet_decompose(in, LF_odd, LF_even, scales, _record_scale, &r);
+    assert_int_equal(r.scales, scales);
+    assert_ptr_equal(residual, r.LF[scales - 1]);
+    for(int s = 0; s < scales; s++)
+    {
+      assert_ptr_equal(r.in[s], s == 0 ? in : r.LF[s - 1]);
+      assert_ptr_equal(r.LF[s], s % 2 ? LF_even : LF_odd);
+    }
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  (void)argv;
+  // the kernels are run without dt_init()
+  darktable.num_openmp_threads = dt_get_num_procs();
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_half_round_trip),
+    cmocka_unit_test(test_half_rounding),
+    cmocka_unit_test(test_bands),
+    cmocka_unit_test(test_bands_memory),
+    cmocka_unit_test(test_decompose),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
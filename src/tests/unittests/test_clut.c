@@ -0,0 +1,186 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Unit tests for the LittleCMS transforms baked into 3D LUTs by
+ * common/clut.c. The interpolated RGB to Lab and Lab to RGB conversions
+ * are compared to the transforms they were baked from, and the cache is
+ * checked to share its LUTs. */
+
+#include <math.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <cmocka.h>
+#include <lcms2.h>
+
+#include "common/darktable.h"
+#include "common/clut.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+#define TEST_PIXELS 100000
+
+// the differences of the first 3 channels between the LUT and the transform
+static void _check(const dt_clut_icc_t *lut,
+                   cmsHTRANSFORM xform,
+                   const float *in,
+                   const float max_error,
+                   const float mean_error)
+{
+  float *exact = dt_alloc_align_float((size_t)4 * TEST_PIXELS);
+  float *baked = dt_alloc_align_float((size_t)4 * TEST_PIXELS);
+  cmsDoTransform(xform, in, exact, TEST_PIXELS);
+  dt_clut_icc_apply(lut, in, baked, TEST_PIXELS);
+
+  float error = 0.0f;
+  double sum = 0.0;
+  for(size_t k = 0; k < TEST_PIXELS; k++)
+  {
+    for(int c = 0; c < 3; c++)
+    {
+      const float e = fabsf(baked[4 * k + c] - exact[4 * k + c]);
+      error = fmaxf(error, e);
+      sum += e;
+    }
+    // the alpha channel is passed through
+    assert_float_equal(baked[4 * k + 3], in[4 * k + 3], 0.0f);
+  }
+  dt_free_align(exact);
+  dt_free_align(baked);
+  assert_true(error < max_error);
+  assert_true(sum / (3 * TEST_PIXELS) < mean_error);
+}
+
+static void test_rgb_to_lab(void **state)
+{
+  cmsHPROFILE srgb = cmsCreate_sRGBProfile();
+  cmsHPROFILE lab = cmsCreateLab4Profile(NULL);
+  cmsHTRANSFORM xform = cmsCreateTransform(srgb, TYPE_RGBA_FLT, lab, TYPE_LabA_FLT,
+                                           INTENT_PERCEPTUAL, 0);
+  assert_non_null(xform);
+  dt_clut_icc_t *lut = dt_clut_icc_new(DT_CLUT_ICC_RGB, xform, NULL);
+  assert_non_null(lut);
+
+  // random pixels, then the dark ones getting the most of the nodes
+  float *in = dt_alloc_align_float((size_t)4 * TEST_PIXELS);
+  srand(42);
+  for(size_t k = 0; k < 4 * TEST_PIXELS; k++)
+    in[k] = (float)rand() / RAND_MAX;
+  _check(lut, xform, in, 0.2f, 0.02f);
+  for(size_t k = 0; k < 4 * TEST_PIXELS; k++)
+    in[k] = 0.01f * rand() / RAND_MAX;
+  _check(lut, xform, in, 0.2f, 0.02f);
+
+  dt_free_align(in);
+  dt_clut_icc_free(lut);
+  cmsDeleteTransform(xform);
+  cmsCloseProfile(srgb);
+  cmsCloseProfile(lab);
+}
+
+static void test_lab_to_rgb(void **state)
+{
+  cmsHPROFILE srgb = cmsCreate_sRGBProfile();
+  cmsHPROFILE lab = cmsCreateLab4Profile(NULL);
+  cmsHTRANSFORM xform = cmsCreateTransform(lab, TYPE_LabA_FLT, srgb, TYPE_RGBA_FLT,
+                                           INTENT_PERCEPTUAL, 0);
+  assert_non_null(xform);
+  dt_clut_icc_t *lut = dt_clut_icc_new(DT_CLUT_ICC_LAB, xform, NULL);
+  assert_non_null(lut);
+
+  // colors of the sRGB gamut, the largest errors are met along its
+  // boundary where the encoding of the channels close to 0 is steepest
+  float *in = dt_alloc_align_float((size_t)4 * TEST_PIXELS);
+  cmsHTRANSFORM to_lab = cmsCreateTransform(srgb, TYPE_RGBA_FLT, lab, TYPE_LabA_FLT,
+                                            INTENT_PERCEPTUAL, 0);
+  srand(42);
+  for(size_t k = 0; k < 4 * TEST_PIXELS; k++)
+    in[k] = (float)rand() / RAND_MAX;
+  cmsDoTransform(to_lab, in, in, TEST_PIXELS);
+  for(size_t k = 0; k < TEST_PIXELS; k++)
+    in[4 * k + 3] = 1.0f;
+  _check(lut, xform, in, 0.2f, 0.004f);
+
+  dt_free_align(in);
+  dt_clut_icc_free(lut);
+  cmsDeleteTransform(to_lab);
+  cmsDeleteTransform(xform);
+  cmsCloseProfile(srgb);
+  cmsCloseProfile(lab);
+}
+
+static void test_cache(void **state)
+{
+  cmsHPROFILE srgb = cmsCreate_sRGBProfile();
+  cmsHPROFILE lab = cmsCreateLab4Profile(NULL);
+  cmsHTRANSFORM xform = cmsCreateTransform(srgb, TYPE_RGBA_FLT, lab, TYPE_LabA_FLT,
+                                           INTENT_PERCEPTUAL, 0);
+  const dt_hash_t hash = dt_clut_icc_hash_profile(DT_INITHASH, srgb);
+  assert_int_not_equal(hash, DT_INITHASH);
+  assert_int_equal(hash, dt_clut_icc_hash_profile(DT_INITHASH, srgb));
+  assert_int_not_equal(hash, dt_clut_icc_hash_profile(DT_INITHASH, lab));
+
+  dt_clut_icc_cache_t cache;
+  dt_clut_icc_cache_init(&cache);
+
+  dt_clut_icc_t *first = dt_clut_icc_cache_get(&cache, hash, DT_CLUT_ICC_RGB, xform, NULL);
+  dt_clut_icc_t *same = dt_clut_icc_cache_get(&cache, hash, DT_CLUT_ICC_RGB, xform, NULL);
+  assert_non_null(first);
+  assert_ptr_equal(first, same);
+  dt_clut_icc_cache_release(&cache, same);
+
+  // the LUT in use survives its eviction
+  for(int k = 0; k < DT_CLUT_ICC_CACHE_SIZE; k++)
+    dt_clut_icc_cache_release(&cache,
+                              dt_clut_icc_cache_get(&cache, hash + 1 + k, DT_CLUT_ICC_RGB,
+                                                    xform, NULL));
+  assert_false(first->item.cached);
+  float DT_ALIGNED_PIXEL px[4] = { 0.5f, 0.5f, 0.5f, 1.0f };
+  dt_clut_icc_apply(first, px, px, 1);
+  assert_float_equal(px[1], 0.0f, 0.01f);
+  dt_clut_icc_cache_release(&cache, first);
+
+  dt_clut_icc_cache_cleanup(&cache);
+  cmsDeleteTransform(xform);
+  cmsCloseProfile(srgb);
+  cmsCloseProfile(lab);
+}
+
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  (void)argv;
+  // the LUTs are baked without dt_init()
+  darktable.num_openmp_threads = dt_get_num_procs();
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_rgb_to_lab),
+    cmocka_unit_test(test_lab_to_rgb),
+    cmocka_unit_test(test_cache),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
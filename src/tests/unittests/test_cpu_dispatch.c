@@ -0,0 +1,400 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Unit tests for the runtime selection of the kernel variants
+ * (common/cpu_dispatch). Each kernel is run at every level supported by
+ * the host and compared with the baseline variant: the variants are
+ * compiled from the same code without floating point contraction, they
+ * may only differ by the last bit of a reduction. The demosaicers are
+ * checked with the modules in iop/test_demosaic.c. */
+
+#include <math.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <cmocka.h>
+
+include "util/assert.h"
+#include "common/cpu_dispatch.h"
+#include "common/eaw.h"
+#include "control/control.h"
+#include "common/dwt.h"
+#include "common/nlmeans_core.h"
+#include "develop/blend.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+#define TEST_W 203
+#define TEST_H 117
+#define TEST_NPIX ((size_t)TEST_W * TEST_H)
+// rounding difference allowed against the baseline
+#define TEST_MAX_ULPS 1
+// the blended region inside the input of a module
+#define TEST_BORDER 3
+
+static unsigned int _rng = 4242u;
+static float _frand(void)
+{
+  _rng = _rng * 1664525u + 1013904223u;
+  return (float)((_rng >> 8) & 0xFFFFFF) / (float)0xFFFFFF;
+}
+
+static float *_random_image(const size_t nfloats)
+{
+  float *img = dt_alloc_align_float(nfloats);
+  for(size_t k = 0; k < nfloats; k++)
+    img[k] = _frand();
+  return img;
+}
+
+static float *_copy_image(const float *img, const size_t nfloats)
+{
+  float *copy = dt_alloc_align_float(nfloats);
+  memcpy(copy, img, nfloats * sizeof(float));
+  return copy;
+}
+
+static void _assert_close(const float *ref, const float *img, const size_t nfloats)
+{
+  assert_floats_within_ulps(ref, img, nfloats, TEST_MAX_ULPS);
+}
+
+static void test_select_level(void **state)
+{
+  assert_int_equal(dt_cpu_select_level(DT_CPU_LEVEL_AVX512, "auto"), DT_CPU_LEVEL_AVX512);
+  assert_int_equal(dt_cpu_select_level(DT_CPU_LEVEL_AVX512, NULL), DT_CPU_LEVEL_AVX512);
+  assert_int_equal(dt_cpu_select_level(DT_CPU_LEVEL_AVX512, "avx2"), DT_CPU_LEVEL_AVX2);
+  assert_int_equal(dt_cpu_select_level(DT_CPU_LEVEL_AVX512, "baseline"), DT_CPU_LEVEL_BASELINE);
+  // never above what the cpu supports
+  assert_int_equal(dt_cpu_select_level(DT_CPU_LEVEL_BASELINE, "avx512"), DT_CPU_LEVEL_BASELINE);
+  assert_int_equal(dt_cpu_select_level(DT_CPU_LEVEL_AVX2, "bogus"), DT_CPU_LEVEL_AVX2);
+  assert_string_equal(dt_cpu_level_name(DT_CPU_LEVEL_AVX2), "avx2");
+#if !DT_CPU_DISPATCH_X86
+  assert_int_equal(dt_cpu_detect_level(), DT_CPU_LEVEL_BASELINE);
+#endif
+}
+
+static void test_eaw(void **state)
+{
+  const size_t nfloats = 4 * TEST_NPIX;
+  float *in = _random_image(nfloats);
+  const dt_aligned_pixel_t threshold = { 0.01f, 0.02f, 0.02f, 0.0f };
+  const dt_aligned_pixel_t boost = { 1.2f, 1.1f, 1.1f, 1.0f };
+
+  float *ref_out = dt_alloc_align_float(nfloats);
+  float *ref_accum = dt_alloc_align_float(nfloats);
+  float *ref_dn_out = dt_alloc_align_float(nfloats);
+  float *ref_dn_detail = dt_alloc_align_float(nfloats);
+  dt_aligned_pixel_t ref_sum_sq;
+
+  float *out = dt_alloc_align_float(nfloats);
+  float *accum = dt_alloc_align_float(nfloats);
+  float *dn_out = dt_alloc_align_float(nfloats);
+  float *dn_detail = dt_alloc_align_float(nfloats);
+  dt_aligned_pixel_t sum_sq;
+
+  const dt_cpu_level_t detected = dt_cpu_detect_level();
+  for(int level = DT_CPU_LEVEL_BASELINE; level <= detected; level++)
+  {
+    darktable.codepath.cpu_level = level;
+    const gboolean baseline = level == DT_CPU_LEVEL_BASELINE;
+    float *const o = baseline ? ref_out : out;
+    float *const a = baseline ? ref_accum : accum;
+    float *const dno = baseline ? ref_dn_out : dn_out;
+    float *const dnd = baseline ? ref_dn_detail : dn_detail;
+
+    memset(a, 0, nfloats * sizeof(float));
+    // scale 2 reaches past the borders on the short side
+    for(int scale = 0; scale < 3; scale++)
+      eaw_decompose_and_synthesize(o, in, a, scale, 0.5f, threshold, boost, TEST_W, TEST_H);
+    eaw_synthesize(o, o, a, threshold, boost, TEST_W, TEST_H);
+    eaw_dn_decompose(dno, in, dnd, baseline ? ref_sum_sq : sum_sq, 1, 20.0f, TEST_W, TEST_H);
+
+    if(baseline) continue;
+    _assert_close(ref_out, out, nfloats);
+    _assert_close(ref_accum, accum, nfloats);
+    _assert_close(ref_dn_out, dn_out, nfloats);
+    _assert_close(ref_dn_detail, dn_detail, nfloats);
+    _assert_close(ref_sum_sq, sum_sq, 3);
+  }
+  darktable.codepath.cpu_level = detected;
+
+  dt_free_align(in);
+  dt_free_align(ref_out);
+  dt_free_align(ref_accum);
+  dt_free_align(ref_dn_out);
+  dt_free_align(ref_dn_detail);
+  dt_free_align(out);
+  dt_free_align(accum);
+  dt_free_align(dn_out);
+  dt_free_align(dn_detail);
+}
+
+static void test_dwt_denoise(void **state)
+{
+  const float noise[5] = { 0.05f, 0.03f, 0.02f, 0.01f, 0.005f };
+  float *in = _random_image(TEST_NPIX);
+  float *ref = NULL;
+
+  const dt_cpu_level_t detected = dt_cpu_detect_level();
+  for(int level = DT_CPU_LEVEL_BASELINE; level <= detected; level++)
+  {
+    darktable.codepath.cpu_level = level;
+    float *img = _copy_image(in, TEST_NPIX);
+    dwt_denoise(img, TEST_W, TEST_H, 5, noise);
+    if(!ref)
+      ref = img;
+    else
+    {
+      _assert_close(ref, img, TEST_NPIX);
+      dt_free_align(img);
+    }
+  }
+  darktable.codepath.cpu_level = detected;
+
+  dt_free_align(ref);
+  dt_free_align(in);
+}
+
+static void test_nlmeans(void **state)
+{
+  const size_t nfloats = 4 * TEST_NPIX;
+  float *in = _random_image(nfloats);
+  const float norm[4] = { 1.0f, 0.5f, 0.5f, 1.0f };
+  const dt_iop_roi_t roi = { 0, 0, TEST_W, TEST_H, 1.0f };
+  float *ref = dt_alloc_align_float(nfloats);
+  float *out = dt_alloc_align_float(nfloats);
+
+  // as denoise(non-local) with chroma blending, then as denoiseprofile
+  for(int profile = 0; profile < 2; profile++)
+  {
+    const dt_nlmeans_param_t params = { .scattering = 0.0f,
+                                        .scale = 1.0f,
+                                        .luma = profile ? 1.0f : 0.6f,
+                                        .chroma = profile ? 1.0f : 0.8f,
+                                        .center_weight = profile ? 0.5f : -1.0f,
+                                        .sharpness = profile ? 30.0f : 10.0f,
+                                        .patch_radius = 2,
+                                        .search_radius = 3,
+                                        .decimate = 0,
+                                        .norm = norm };
+
+    const dt_cpu_level_t detected = dt_cpu_detect_level();
+    for(int level = DT_CPU_LEVEL_BASELINE; level <= detected; level++)
+    {
+      darktable.codepath.cpu_level = level;
+      nlmeans_denoise(in, level == DT_CPU_LEVEL_BASELINE ? ref : out, &roi, &roi, &params);
+      if(level != DT_CPU_LEVEL_BASELINE)
+        _assert_close(ref, out, nfloats);
+    }
+    darktable.codepath.cpu_level = detected;
+  }
+
+  dt_free_align(in);
+  dt_free_align(ref);
+  dt_free_align(out);
+}
+
+// linear Rec2020 with its D50 adapted primaries, for the masks in RGB
+static const dt_colormatrix_t _rec2020_to_xyz
+    = { {  0.6734241f,  0.1656411f,  0.1251286f, 0.0f },
+        {  0.2790177f,  0.6753402f,  0.0456377f, 0.0f },
+        { -0.0019300f,  0.0299784f,  0.7973330f, 0.0f } };
+static const dt_colormatrix_t _xyz_to_rec2020
+    = { {  1.6473542f, -0.3935678f, -0.2359961f, 0.0f },
+        { -0.6826000f,  1.6475887f,  0.0128190f, 0.0f },
+        {  0.0296519f, -0.0628912f,  1.2533700f, 0.0f } };
+
+typedef void(_make_mask_func)(dt_dev_pixelpipe_iop_t *piece,
+                              const float *const restrict a,
+                              const float *const restrict b,
+                              const dt_iop_roi_t *const roi_in,
+                              const dt_iop_roi_t *const roi_out,
+                              float *const restrict mask);
+typedef void(_blend_func)(dt_dev_pixelpipe_iop_t *piece,
+                          const float *const restrict a,
+                          float *const restrict b,
+                          const dt_iop_roi_t *const roi_in,
+                          const dt_iop_roi_t *const roi_out,
+                          const float *const restrict mask,
+                          const dt_dev_pixelpipe_display_mask_t request_mask_display);
+
+static void _blend_levels(_blend_func *blend,
+                          dt_dev_pixelpipe_iop_t *piece,
+                          const float *const a,
+                          const float *const b,
+                          const dt_iop_roi_t *const roi_in,
+                          const dt_iop_roi_t *const roi_out,
+                          const float *const mask,
+                          const dt_dev_pixelpipe_display_mask_t request,
+                          float *const ref,
+                          float *const out)
+{
+  const size_t nfloats = (size_t)roi_out->width * roi_out->height * piece->colors;
+  const dt_cpu_level_t detected = dt_cpu_detect_level();
+  for(int level = DT_CPU_LEVEL_BASELINE; level <= detected; level++)
+  {
+    darktable.codepath.cpu_level = level;
+    float *const o = level == DT_CPU_LEVEL_BASELINE ? ref : out;
+    memcpy(o, b, nfloats * sizeof(float));
+    blend(piece, a, o, roi_in, roi_out, mask, request);
+    if(level != DT_CPU_LEVEL_BASELINE)
+      _assert_close(ref, out, nfloats);
+  }
+  darktable.codepath.cpu_level = detected;
+}
+
+// the parametric masks, blend operators and displayed channels of one
+// color space, on all channels with every combination of the masks
+static void _blendif(const dt_develop_blend_colorspace_t cst,
+                     const int ch,
+                     _make_mask_func *make_mask,
+                     _blend_func *blend)
+{
+  const dt_iop_roi_t roi_in = { 0, 0, TEST_W, TEST_H, 1.0f };
+  const dt_iop_roi_t roi_out = { TEST_BORDER, TEST_BORDER,
+                                 TEST_W - 2 * TEST_BORDER, TEST_H - 2 * TEST_BORDER, 1.0f };
+  const size_t npix_out = (size_t)roi_out.width * roi_out.height;
+
+  dt_iop_order_iccprofile_info_t *profile = dt_calloc1_align_type(dt_iop_order_iccprofile_info_t);
+  dt_ioppr_init_profile_info(profile, 0);
+  for(int i = 0; i < 3; i++)
+    for(int j = 0; j < 3; j++)
+    {
+      profile->matrix_in[i][j] = profile->matrix_in_transposed[j][i] = _rec2020_to_xyz[i][j];
+      profile->matrix_out[i][j] = profile->matrix_out_transposed[j][i] = _xyz_to_rec2020[i][j];
+    }
+
+  // the pieces of a module without history, its profile taken from the pipe
+  dt_develop_t *dev = calloc(1, sizeof(dt_develop_t));
+  dt_iop_module_t *module = calloc(1, sizeof(dt_iop_module_t));
+  dt_dev_pixelpipe_t *pipe = calloc(1, sizeof(dt_dev_pixelpipe_t));
+  dt_dev_pixelpipe_iop_t *piece = calloc(1, sizeof(dt_dev_pixelpipe_iop_t));
+  module->dev = dev;
+  pipe->input_profile_info = pipe->work_profile_info = profile;
+  dt_develop_blend_params_t params = { .mask_mode = DEVELOP_MASK_ENABLED | DEVELOP_MASK_CONDITIONAL,
+                                       .blend_cst = cst,
+                                       .opacity = 80.0f,
+                                       .blendif = (1u << DEVELOP_BLENDIF_SIZE) - 1 };
+  for(int k = 0; k < DEVELOP_BLENDIF_SIZE; k++)
+  {
+    params.blendif_parameters[4 * k + 0] = 0.1f;
+    params.blendif_parameters[4 * k + 1] = 0.3f;
+    params.blendif_parameters[4 * k + 2] = 0.6f;
+    params.blendif_parameters[4 * k + 3] = 0.9f;
+  }
+  piece->module = module;
+  piece->pipe = pipe;
+  piece->blendop_data = &params;
+  piece->colors = ch;
+
+  float *a = _random_image(ch * TEST_NPIX);
+  float *b = _random_image(ch * npix_out);
+  float *drawn = _random_image(npix_out);
+  // L in [0; 100] and a, b in [-100; 100], the alpha channel left alone
+  for(size_t k = 0; cst == DEVELOP_BLEND_CS_LAB && k < ch * TEST_NPIX; k++)
+    if(k % 4 < 3) a[k] = (k % 4) ? 200.0f * a[k] - 100.0f : 100.0f * a[k];
+  for(size_t k = 0; cst == DEVELOP_BLEND_CS_LAB && k < ch * npix_out; k++)
+    if(k % 4 < 3) b[k] = (k % 4) ? 200.0f * b[k] - 100.0f : 100.0f * b[k];
+  float *ref = dt_alloc_align_float(ch * npix_out);
+  float *out = dt_alloc_align_float(ch * npix_out);
+
+  const dt_cpu_level_t detected = dt_cpu_detect_level();
+  // the raw mask is only scaled by the opacity, it is not dispatched
+  for(int combine = 0; make_mask && combine < 4; combine++)
+  {
+    params.mask_combine = ((combine & 1) ? DEVELOP_COMBINE_INV : 0)
+                          | ((combine & 2) ? DEVELOP_COMBINE_INCL : 0);
+    for(int level = DT_CPU_LEVEL_BASELINE; level <= detected; level++)
+    {
+      darktable.codepath.cpu_level = level;
+      float *const m = level == DT_CPU_LEVEL_BASELINE ? ref : out;
+      memcpy(m, drawn, npix_out * sizeof(float));
+      make_mask(piece, a, b, &roi_in, &roi_out, m);
+      if(level != DT_CPU_LEVEL_BASELINE)
+        _assert_close(ref, out, npix_out);
+    }
+    darktable.codepath.cpu_level = detected;
+  }
+
+  // the modes past the last one fall back to normal
+  for(unsigned int mode = 0; mode <= DEVELOP_BLEND_RGB_B; mode++)
+  {
+    params.blend_mode = mode;
+    _blend_levels(blend, piece, a, b, &roi_in, &roi_out, drawn, DT_DEV_PIXELPIPE_DISPLAY_NONE, ref, out);
+    params.blend_mode = mode | DEVELOP_BLEND_REVERSE;
+    _blend_levels(blend, piece, a, b, &roi_in, &roi_out, drawn, DT_DEV_PIXELPIPE_DISPLAY_NONE, ref, out);
+  }
+
+  for(int channel = DT_DEV_PIXELPIPE_DISPLAY_L; channel <= DT_DEV_PIXELPIPE_DISPLAY_JzCzhz_hz;
+      channel += DT_DEV_PIXELPIPE_DISPLAY_L)
+  {
+    _blend_levels(blend, piece, a, b, &roi_in, &roi_out, drawn, channel, ref, out);
+    _blend_levels(blend, piece, a, b, &roi_in, &roi_out, drawn, channel | DT_DEV_PIXELPIPE_DISPLAY_OUTPUT,
+                  ref, out);
+  }
+
+  dt_free_align(a);
+  dt_free_align(b);
+  dt_free_align(drawn);
+  dt_free_align(ref);
+  dt_free_align(out);
+  free(piece);
+  free(pipe);
+  free(module);
+  free(dev);
+  dt_ioppr_cleanup_profile_info(profile);
+  dt_free_align(profile);
+}
+
+static void test_blendif(void **state)
+{
+  _blendif(DEVELOP_BLEND_CS_RAW, 1, NULL, dt_develop_blendif_raw_blend);
+  _blendif(DEVELOP_BLEND_CS_RGB_DISPLAY, 4, dt_develop_blendif_rgb_hsl_make_mask,
+           dt_develop_blendif_rgb_hsl_blend);
+  _blendif(DEVELOP_BLEND_CS_RGB_SCENE, 4, dt_develop_blendif_rgb_jzczhz_make_mask,
+           dt_develop_blendif_rgb_jzczhz_blend);
+  _blendif(DEVELOP_BLEND_CS_LAB, 4, dt_develop_blendif_lab_make_mask,
+           dt_develop_blendif_lab_blend);
+}
+
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  (void)argv;
+  // the kernels are run without dt_init()
+  darktable.num_openmp_threads = dt_get_num_procs();
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_select_level),
+    cmocka_unit_test(test_eaw),
+    cmocka_unit_test(test_dwt_denoise),
+    cmocka_unit_test(test_nlmeans),
+    cmocka_unit_test(test_blendif),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,234 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Unit tests for the single resampling of consecutive geometry modules
+ * in develop/pixelpipe_hb.c. A chain of mirrors and shifts is resampled
+ * once and compared to its pieces processed one after the other, and
+ * the chain is checked to use the interpolator of its pieces.
+ *
+ * Following test_filmicrgb.c, the implementation is #included directly
+ * for static access. */
+
+#include <math.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "develop/pixelpipe_hb.c"
+
+#include <cmocka.h>
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+// more points than one strip of the chain
+#define TEST_W 1201
+#define TEST_H 901
+// the borders are interpolated differently by the single resampling
+#define TEST_MARGIN 8
+
+static const dt_interpolation_t *_itor;
+
+typedef struct _shift_t
+{
+  float dx, dy;
+} _shift_t;
+
+// a translation processed like rotatepixels: each output pixel is
+// interpolated at its backtransformed position
+static gboolean _shift_backtransform(dt_iop_module_t *self,
+                                     dt_dev_pixelpipe_iop_t *piece,
+                                     float *const restrict points,
+                                     size_t points_count)
+{
+  const _shift_t *d = piece->data;
+  for(size_t k = 0; k < points_count; k++)
+  {
+    points[2 * k] += d->dx;
+    points[2 * k + 1] += d->dy;
+  }
+  return TRUE;
+}
+
+static void _shift_process(dt_iop_module_t *self,
+                           dt_dev_pixelpipe_iop_t *piece,
+                           const void *const ivoid,
+                           void *const ovoid,
+                           const dt_iop_roi_t *const roi_in,
+                           const dt_iop_roi_t *const roi_out)
+{
+  const _shift_t *d = piece->data;
+  float *const out = ovoid;
+  for(int j = 0; j < roi_out->height; j++)
+    for(int i = 0; i < roi_out->width; i++)
+      dt_interpolation_compute_pixel4c(_itor, ivoid, out + 4 * ((size_t)j * roi_out->width + i),
+                                       i + d->dx, j + d->dy,
+                                       roi_in->width, roi_in->height, 4 * roi_in->width);
+}
+
+// a horizontal mirror processed like flip: a permutation of the pixels
+static gboolean _mirror_backtransform(dt_iop_module_t *self,
+                                      dt_dev_pixelpipe_iop_t *piece,
+                                      float *const restrict points,
+                                      size_t points_count)
+{
+  for(size_t k = 0; k < points_count; k++)
+    points[2 * k] = TEST_W - points[2 * k];
+  return TRUE;
+}
+
+static void _mirror_process(dt_iop_module_t *self,
+                            dt_dev_pixelpipe_iop_t *piece,
+                            const void *const ivoid,
+                            void *const ovoid,
+                            const dt_iop_roi_t *const roi_in,
+                            const dt_iop_roi_t *const roi_out)
+{
+  const float *const in = ivoid;
+  float *const out = ovoid;
+  for(int j = 0; j < roi_out->height; j++)
+    for(int i = 0; i < roi_out->width; i++)
+      for_four_channels(c)
+        out[4 * ((size_t)j * TEST_W + i) + c] = in[4 * ((size_t)j * TEST_W + TEST_W - 1 - i) + c];
+}
+
+typedef struct _chain_t
+{
+  dt_iop_module_t modules[DT_DISTORT_CHAIN_MAX];
+  dt_dev_pixelpipe_iop_t pieces[DT_DISTORT_CHAIN_MAX];
+  _shift_t shifts[DT_DISTORT_CHAIN_MAX];
+  dt_dev_pixelpipe_iop_t *chain[DT_DISTORT_CHAIN_MAX];
+  int count;
+} _chain_t;
+
+// append a piece at the start of the chain, chain[0] being the last one
+static void _push(_chain_t *c, const float dx, const float dy, const gboolean mirror)
+{
+  const int k = c->count++;
+  dt_iop_module_t *module = &c->modules[k];
+  dt_dev_pixelpipe_iop_t *piece = &c->pieces[k];
+  memset(module, 0, sizeof(*module));
+  memset(piece, 0, sizeof(*piece));
+  module->process = mirror ? _mirror_process : _shift_process;
+  module->distort_backtransform = mirror ? _mirror_backtransform : _shift_backtransform;
+  c->shifts[k] = (_shift_t){ dx, dy };
+  piece->module = module;
+  piece->data = &c->shifts[k];
+  piece->colors = 4;
+  piece->distort_resample = mirror ? DT_DEV_DISTORT_RESAMPLE_CENTER : DT_DEV_DISTORT_RESAMPLE_SCALE;
+  for(int i = c->count - 1; i > 0; i--) c->chain[i] = c->chain[i - 1];
+  c->chain[0] = piece;
+}
+
+static void _compare(_chain_t *c, const float tolerance)
+{
+  const size_t npixels = (size_t)TEST_W * TEST_H;
+  float *input = dt_alloc_align_float(4 * npixels);
+  float *single = dt_alloc_align_float(4 * npixels);
+  float *sequential = dt_alloc_align_float(4 * npixels);
+  assert_non_null(input);
+  assert_non_null(single);
+  assert_non_null(sequential);
+
+  // smooth structures and noise
+  uint32_t state = 0x2545F491u;
+  for(size_t k = 0; k < 4 * npixels; k++)
+  {
+    state = state * 1664525u + 1013904223u;
+    const size_t p = k / 4;
+    const float x = p % TEST_W, y = p / TEST_W;
+    input[k] = 0.5f + 0.3f * sinf(0.05f * x + 0.4f * (k & 3)) * cosf(0.03f * y)
+               + 0.1f * (state >> 8) / 16777216.0f;
+  }
+
+  dt_iop_roi_t rois[DT_DISTORT_CHAIN_MAX];
+  for(int k = 0; k < c->count; k++) rois[k] = (dt_iop_roi_t){ 0, 0, TEST_W, TEST_H, 1.0f };
+
+  assert_true(_distort_chain_resample(c->chain, c->count, _itor, rois, rois, input, single));
+  assert_true(_distort_chain_sequential(c->chain, c->count, rois, rois, input, sequential));
+
+  float max_diff = 0.0f;
+  for(int j = TEST_MARGIN; j < TEST_H - TEST_MARGIN; j++)
+    for(int i = TEST_MARGIN; i < TEST_W - TEST_MARGIN; i++)
+      for_four_channels(ch)
+      {
+        const size_t k = 4 * ((size_t)j * TEST_W + i) + ch;
+        max_diff = fmaxf(max_diff, fabsf(single[k] - sequential[k]));
+      }
+  assert_true(max_diff <= tolerance);
+
+  dt_free_align(input);
+  dt_free_align(single);
+  dt_free_align(sequential);
+}
+
+static void test_mirror_shift_mirror(void **state)
+{
+  // one interpolation between two permutations
+  _chain_t c = { .count = 0 };
+  _push(&c, 0.0f, 0.0f, TRUE);
+  _push(&c, 0.37f, -0.61f, FALSE);
+  _push(&c, 0.0f, 0.0f, TRUE);
+  _compare(&c, 1e-5f);
+}
+
+static void test_integer_shifts(void **state)
+{
+  // interpolations at the pixels are exact, so the shifts compose
+  _chain_t c = { .count = 0 };
+  _push(&c, 2.0f, -1.0f, FALSE);
+  _push(&c, 0.0f, 0.0f, TRUE);
+  _push(&c, -3.0f, 4.0f, FALSE);
+  _compare(&c, 1e-5f);
+}
+
+static void test_interpolation(void **state)
+{
+  // the chain interpolates like its pieces would have on their own
+  _chain_t c = { .count = 0 };
+  _push(&c, 0.0f, 0.0f, TRUE);
+  assert_int_equal(_distort_chain_interpolation(c.chain, c.count), DT_INTERPOLATION_USERPREF_WARP);
+  _push(&c, 0.5f, 0.5f, FALSE);
+  assert_int_equal(_distort_chain_interpolation(c.chain, c.count), DT_INTERPOLATION_USERPREF);
+  c.pieces[1].distort_resample = DT_DEV_DISTORT_RESAMPLE_WARP;
+  assert_int_equal(_distort_chain_interpolation(c.chain, c.count), DT_INTERPOLATION_USERPREF_WARP);
+}
+
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  (void)argv;
+  // the chains are resampled without dt_init()
+  darktable.num_openmp_threads = dt_get_num_procs();
+  _itor = dt_interpolation_new(DT_INTERPOLATION_BICUBIC);
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_mirror_shift_mirror),
+    cmocka_unit_test(test_integer_shifts),
+    cmocka_unit_test(test_interpolation),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,162 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Unit tests for the sparse distortion grids of common/distortion_grid.c.
+ * The interpolated field of a radial lens distortion with lateral
+ * chromatic aberration is compared to its exact evaluation, also where
+ * the field is undefined, and the cache is checked to share its grids. */
+
+#include <math.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <cmocka.h>
+
+#include "common/darktable.h"
+#include "common/distortion_grid.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+#define TEST_W 1503
+#define TEST_H 1001
+
+typedef struct _field_t
+{
+  float k1;
+  float k2;
+  float tca[3];
+  float max_radius; // undefined beyond, relative to the half diagonal
+} _field_t;
+
+static void _eval(const void *data, const int x, const int y, const int count, float *out)
+{
+  const _field_t *f = (const _field_t *)data;
+  const float cx = 0.5f * TEST_W;
+  const float cy = 0.5f * TEST_H;
+  const float norm = 1.0f / hypotf(cx, cy);
+  for(int k = 0; k < count; k++)
+  {
+    const float dx = (x + k - cx) * norm;
+    const float dy = (y - cy) * norm;
+    const float r2 = dx * dx + dy * dy;
+    const float s = r2 > f->max_radius * f->max_radius ? NAN : 1.0f + f->k1 * r2 + f->k2 * r2 * r2;
+    for(int c = 0; c < 3; c++)
+    {
+      out[6 * k + 2 * c] = cx + (x + k - cx) * s * f->tca[c];
+      out[6 * k + 2 * c + 1] = cy + (y - cy) * s * f->tca[c];
+    }
+  }
+}
+
+static void _check(const _field_t *f, const float tolerance)
+{
+  dt_distortion_grid_t *grid = dt_distortion_grid_new(TEST_W, TEST_H, _eval, f);
+  assert_non_null(grid);
+
+  float *grid_row = dt_alloc_align_float((size_t)6 * TEST_W);
+  float *exact_row = dt_alloc_align_float((size_t)6 * TEST_W);
+  for(int y = 0; y < TEST_H; y++)
+  {
+    // rows of an roi starting inside a cell and ending in another
+    const int x = y % 37;
+    const int count = TEST_W - x - y % 23;
+    dt_distortion_grid_row(grid, x, y, count, _eval, f, grid_row);
+    _eval(f, x, y, count, exact_row);
+    for(int k = 0; k < 6 * count; k++)
+    {
+      if(isfinite(grid_row[k]) != isfinite(exact_row[k]))
+        fail_msg("pixel (%d, %d): %g instead of %g", x + k / 6, y, grid_row[k], exact_row[k]);
+      if(isfinite(exact_row[k]) && fabsf(grid_row[k] - exact_row[k]) > tolerance)
+        fail_msg("pixel (%d, %d): %g instead of %g", x + k / 6, y, grid_row[k], exact_row[k]);
+    }
+  }
+
+  // beyond the grid the field is evaluated
+  dt_distortion_grid_row(grid, TEST_W - 10, 5, 20, _eval, f, grid_row);
+  _eval(f, TEST_W - 10, 5, 20, exact_row);
+  assert_memory_equal(grid_row, exact_row, 6 * 20 * sizeof(float));
+
+  dt_free_align(grid_row);
+  dt_free_align(exact_row);
+  dt_distortion_grid_free(grid);
+}
+
+static void test_distortion(void **state)
+{
+  const _field_t barrel = { -0.08f, 0.02f, { 1.0004f, 1.0f, 0.9995f }, INFINITY };
+  _check(&barrel, 2.0f * DT_DISTORTION_GRID_TOLERANCE);
+  const _field_t strong = { 0.6f, -0.2f, { 1.002f, 1.0f, 0.998f }, INFINITY };
+  _check(&strong, 2.0f * DT_DISTORTION_GRID_TOLERANCE);
+}
+
+static void test_undefined(void **state)
+{
+  // the cells along the border of the defined area are evaluated exactly
+  const _field_t cropped = { -0.08f, 0.02f, { 1.0f, 1.0f, 1.0f }, 0.9f };
+  _check(&cropped, 2.0f * DT_DISTORTION_GRID_TOLERANCE);
+}
+
+static void test_cache(void **state)
+{
+  const _field_t barrel = { -0.08f, 0.02f, { 1.0f, 1.0f, 1.0f }, INFINITY };
+  dt_distortion_grid_cache_t cache;
+  dt_distortion_grid_cache_init(&cache);
+
+  dt_distortion_grid_t *first = dt_distortion_grid_cache_get(&cache, 1, 300, 200, _eval, &barrel);
+  dt_distortion_grid_t *same = dt_distortion_grid_cache_get(&cache, 1, 300, 200, _eval, &barrel);
+  dt_distortion_grid_t *other_scale = dt_distortion_grid_cache_get(&cache, 1, 150, 100, _eval, &barrel);
+  assert_ptr_equal(first, same);
+  assert_ptr_not_equal(first, other_scale);
+  dt_distortion_grid_cache_release(&cache, same);
+  dt_distortion_grid_cache_release(&cache, other_scale);
+
+  // the grid in use survives its eviction
+  for(int k = 0; k < 2 * DT_DISTORTION_GRID_CACHE_SIZE; k++)
+    dt_distortion_grid_cache_release(&cache,
+                                     dt_distortion_grid_cache_get(&cache, 100 + k, 30, 20, _eval, &barrel));
+  assert_false(first->item.cached);
+  float row[6 * 300];
+  dt_distortion_grid_row(first, 0, 199, 300, _eval, &barrel, row);
+  dt_distortion_grid_cache_release(&cache, first);
+
+  dt_distortion_grid_cache_cleanup(&cache);
+}
+
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  (void)argv;
+  // the grids are sampled without dt_init()
+  darktable.num_openmp_threads = dt_get_num_procs();
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_distortion),
+    cmocka_unit_test(test_undefined),
+    cmocka_unit_test(test_cache),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
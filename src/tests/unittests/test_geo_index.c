@@ -0,0 +1,181 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Unit tests for the spatial index of the image positions
+ * (common/geo_index) used by the map view. The box queries are checked
+ * against a brute force scan of the same points. */
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <cmocka.h>
+
+#include "common/geo_index.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+#define NB_POINTS 5000
+
+static unsigned int _rng = 12345u;
+static double _rand(const double min, const double max)
+{
+  _rng = _rng * 1664525u + 1013904223u;
+  return min + (max - min) * ((_rng >> 8) & 0xFFFFFF) / (double)0xFFFFFF;
+}
+
+static dt_geo_index_t *_make_index(double *lon, double *lat)
+{
+  dt_geo_index_t *index = dt_geo_index_new();
+  for(int i = 0; i < NB_POINTS; i++)
+  {
+    // half of the images around a city, the others anywhere
+    lon[i] = i & 1 ? _rand(-180.0, 180.0) : _rand(2.2, 2.5);
+    lat[i] = i & 1 ? _rand(-90.0, 90.0) : _rand(48.8, 48.9);
+    dt_geo_index_add(index, i + 1, lon[i], lat[i]);
+  }
+  return index;
+}
+
+static void test_query_points(void **state)
+{
+  double *lon = malloc(sizeof(double) * NB_POINTS);
+  double *lat = malloc(sizeof(double) * NB_POINTS);
+  dt_geo_index_t *index = _make_index(lon, lat);
+  assert_int_equal(dt_geo_index_count(index), NB_POINTS);
+
+  const double boxes[][4] = { { 2.3, 2.4, 48.82, 48.85 },
+                              { -10.0, 30.0, 35.0, 60.0 },
+                              { -180.0, 180.0, -90.0, 90.0 },
+                              { 100.0, 100.001, 0.0, 0.001 } };
+  for(int b = 0; b < 4; b++)
+  {
+    int expected = 0;
+    for(int i = 0; i < NB_POINTS; i++)
+      if(lon[i] >= boxes[b][0] && lon[i] <= boxes[b][1]
+         && lat[i] >= boxes[b][2] && lat[i] <= boxes[b][3])
+        expected++;
+
+    // at the finest level a cell is a position
+    GArray *cells = g_array_new(FALSE, FALSE, sizeof(guint32));
+    dt_geo_index_query(index, DT_GEO_INDEX_MAX_LEVEL,
+                       boxes[b][0], boxes[b][1], boxes[b][2], boxes[b][3], cells);
+    guint32 nb_cells = 0;
+    const dt_geo_index_cell_t *c =
+      dt_geo_index_get_cells(index, DT_GEO_INDEX_MAX_LEVEL, &nb_cells);
+    int found = 0;
+    for(guint i = 0; i < cells->len; i++)
+    {
+      const guint32 cell = g_array_index(cells, guint32, i);
+      assert_true(cell < nb_cells);
+      if(i) assert_true(cell > g_array_index(cells, guint32, i - 1));
+      found += c[cell].count;
+    }
+    assert_int_equal(found, expected);
+    g_array_free(cells, TRUE);
+  }
+
+  dt_geo_index_free(index);
+  free(lon);
+  free(lat);
+}
+
+static void test_cells(void **state)
+{
+  double *lon = malloc(sizeof(double) * NB_POINTS);
+  double *lat = malloc(sizeof(double) * NB_POINTS);
+  dt_geo_index_t *index = _make_index(lon, lat);
+
+  // cells of about 1 degree wide
+  const int level = dt_geo_index_level(1.0);
+  assert_int_equal(level, 9);
+
+  guint32 nb_cells = 0;
+  const dt_geo_index_cell_t *c = dt_geo_index_get_cells(index, level, &nb_cells);
+  guint32 total = 0;
+  for(guint32 i = 0; i < nb_cells; i++)
+  {
+    assert_int_equal(c[i].first, total);
+    total += c[i].count;
+  }
+  assert_int_equal(total, NB_POINTS);
+
+  // the images around the city are in one or a few cells
+  GArray *cells = g_array_new(FALSE, FALSE, sizeof(guint32));
+  dt_geo_index_query(index, level, 2.2, 2.5, 48.8, 48.9, cells);
+  assert_true(cells->len >= 1 && cells->len <= 4);
+  g_array_free(cells, TRUE);
+
+  // each image is found in the cell holding it
+  for(dt_imgid_t imgid = 1; imgid <= NB_POINTS; imgid += 97)
+  {
+    const gint64 point = dt_geo_index_find_image(index, imgid);
+    assert_true(point >= 0);
+    assert_int_equal(dt_geo_index_get_point(index, point)->imgid, imgid);
+    const guint32 cell = dt_geo_index_find_cell(index, level, point);
+    assert_true(point >= c[cell].first && point < c[cell].first + c[cell].count);
+  }
+  assert_true(dt_geo_index_find_image(index, NB_POINTS + 1) < 0);
+
+  dt_geo_index_free(index);
+  free(lon);
+  free(lat);
+}
+
+static void test_same_location(void **state)
+{
+  dt_geo_index_t *index = dt_geo_index_new();
+  dt_geo_index_add(index, 1, 10.0, 20.0);
+  dt_geo_index_add(index, 2, 10.0, 20.0);
+  dt_geo_index_add(index, 3, 10.00001, 20.0);
+
+  guint32 nb_cells = 0;
+  const dt_geo_index_cell_t *c =
+    dt_geo_index_get_cells(index, DT_GEO_INDEX_MAX_LEVEL, &nb_cells);
+  assert_int_equal(nb_cells, 2);
+  assert_int_equal(c[0].count, 2);
+  assert_true(c[0].same_loc);
+
+  c = dt_geo_index_get_cells(index, 10, &nb_cells);
+  assert_int_equal(nb_cells, 1);
+  assert_int_equal(c[0].count, 3);
+  assert_false(c[0].same_loc);
+
+  dt_geo_index_free(index);
+}
+
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  (void)argv;
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_query_points),
+    cmocka_unit_test(test_cells),
+    cmocka_unit_test(test_same_location),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
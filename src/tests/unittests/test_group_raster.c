@@ -0,0 +1,147 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Unit tests for the key of the rasters of the shapes of a group in
+ * develop/masks/group.c. A shape is used by a module after a crop: the
+ * raster of the shape made while the crop has the focus, showing the
+ * full image, must not be reused once the crop loses it.
+ *
+ * Following test_filmicrgb.c, the implementation is #included directly
+ * for static access. */
+
+#include <math.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "develop/masks/group.c"
+
+#include <cmocka.h>
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+static int _distort_tags(void)
+{
+  return IOP_TAG_DISTORT;
+}
+
+static int _tags(void)
+{
+  return 0;
+}
+
+typedef struct _chain_t
+{
+  dt_develop_t dev;
+  dt_dev_pixelpipe_t pipe;
+  dt_iop_module_t crop, module;
+  dt_dev_pixelpipe_iop_t crop_piece, piece;
+  dt_masks_form_t form;
+} _chain_t;
+
+// a crop in front of a module using a circle
+static _chain_t *_chain_new(void)
+{
+  _chain_t *c = calloc(1, sizeof(_chain_t));
+  dt_pthread_mutex_init(&c->dev.history_mutex, NULL);
+  c->dev.gui_attached = TRUE;
+  darktable.develop = &c->dev;
+
+  c->crop.operation_tags = _distort_tags;
+  c->crop.iop_order = 1.0;
+  c->crop.dev = &c->dev;
+  c->module.operation_tags = _tags;
+  c->module.iop_order = 2.0;
+  c->module.dev = &c->dev;
+  c->crop_piece.enabled = TRUE;
+  c->crop_piece.hash = 7;
+  c->piece.enabled = TRUE;
+  c->piece.pipe = &c->pipe;
+  c->pipe.iop = g_list_append(g_list_append(NULL, &c->crop), &c->module);
+  c->pipe.nodes = g_list_append(g_list_append(NULL, &c->crop_piece), &c->piece);
+
+  c->form.type = DT_MASKS_CIRCLE;
+  c->form.formid = 1;
+  return c;
+}
+
+static void _chain_free(_chain_t *c)
+{
+  g_list_free(c->pipe.iop);
+  g_list_free(c->pipe.nodes);
+  dt_pthread_mutex_destroy(&c->dev.history_mutex);
+  darktable.develop = NULL;
+  free(c);
+}
+
+static void test_crop_focus(void **state)
+{
+  _chain_t *c = _chain_new();
+
+  const dt_hash_t unfocused = _group_raster_hash(&c->module, &c->piece, &c->form);
+  assert_int_not_equal(unfocused, DT_INVALID_HASH);
+
+  c->dev.gui_module = &c->crop;
+  const dt_hash_t focused = _group_raster_hash(&c->module, &c->piece, &c->form);
+  assert_int_not_equal(focused, DT_INVALID_HASH);
+  assert_int_not_equal(focused, unfocused);
+
+  // the focus of the module itself or of a later one doesn't matter
+  c->dev.gui_module = &c->module;
+  assert_int_equal(_group_raster_hash(&c->module, &c->piece, &c->form), unfocused);
+
+  // a raster of the focused crop isn't served once it lost the focus
+  dt_mask_raster_cache_t cache;
+  dt_mask_raster_cache_init(&cache);
+  const dt_iop_roi_t roi = { 0, 0, 64, 64, 1.0f };
+  float buffer[64 * 64];
+  for(int k = 0; k < 64 * 64; k++) buffer[k] = (k % 64) / 63.0f;
+  dt_mask_raster_cache_put(&cache, focused, &roi, buffer);
+  assert_false(dt_mask_raster_cache_get(&cache, unfocused, &roi, buffer));
+  assert_true(dt_mask_raster_cache_get(&cache, focused, &roi, buffer));
+  dt_mask_raster_cache_cleanup(&cache);
+
+  // new parameters of the crop
+  c->dev.gui_module = NULL;
+  c->crop_piece.hash = 8;
+  assert_int_not_equal(_group_raster_hash(&c->module, &c->piece, &c->form), unfocused);
+
+  _chain_free(c);
+}
+
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  (void)argv;
+  // the rasters are interpolated without dt_init()
+  darktable.num_openmp_threads = dt_get_num_procs();
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_crop_focus),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
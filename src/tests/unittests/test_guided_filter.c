@@ -0,0 +1,222 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Unit tests for the streaming guided filter of common/box_filters.cc.
+ * The box means are evaluated by brute force over each window, in double
+ * precision, on images small enough for radii reaching past the borders
+ * and, with several threads, for strips of a few rows. */
+
+#include <math.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <cmocka.h>
+
+#include "common/box_filters.h"
+#include "common/darktable.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+#define TEST_TOLERANCE 1e-4
+
+static unsigned int _rng = 1234u;
+static float _frand(void)
+{
+  _rng = _rng * 1664525u + 1013904223u;
+  return (float)((_rng >> 8) & 0xFFFFFF) / (float)0xFFFFFF;
+}
+
+// box mean of channel c of an n-channel plane over the window of (x, y)
+static double _box(const double *img, const int n, const int c,
+                   const int width, const int height, const int radius,
+                   const int x, const int y)
+{
+  double sum = 0.0;
+  int count = 0;
+  for(int j = MAX(y - radius, 0); j <= MIN(y + radius, height - 1); j++)
+    for(int i = MAX(x - radius, 0); i <= MIN(x + radius, width - 1); i++)
+    {
+      sum += img[n * (j * width + i) + c];
+      count++;
+    }
+  return sum / count;
+}
+
+static void _check_gray(const int width, const int height, const int radius)
+{
+  const size_t npix = (size_t)width * height;
+  const float eps = 0.01f;
+  float *guide = dt_alloc_align_float(npix);
+  float *mask = dt_alloc_align_float(npix);
+  float *ab = dt_alloc_align_float(2 * npix);
+  double *stats = calloc(4 * npix, sizeof(double));
+  double *coef = calloc(2 * npix, sizeof(double));
+  for(size_t k = 0; k < npix; k++)
+  {
+    guide[k] = _frand();
+    mask[k] = 0.5f * guide[k] + 0.5f * _frand();
+    stats[4 * k] = guide[k];
+    stats[4 * k + 1] = mask[k];
+    stats[4 * k + 2] = (double)guide[k] * guide[k];
+    stats[4 * k + 3] = (double)guide[k] * mask[k];
+  }
+
+  dt_box_guided_coefficients(guide, mask, ab, width, height, radius, eps);
+
+  for(int y = 0; y < height; y++)
+    for(int x = 0; x < width; x++)
+    {
+      double m[4];
+      for(int c = 0; c < 4; c++)
+        m[c] = _box(stats, 4, c, width, height, radius, x, y);
+      const double a = (m[3] - m[0] * m[1]) / (m[2] - m[0] * m[0] + eps);
+      coef[2 * (y * width + x)] = a;
+      coef[2 * (y * width + x) + 1] = m[1] - a * m[0];
+    }
+  for(int y = 0; y < height; y++)
+    for(int x = 0; x < width; x++)
+      for(int c = 0; c < 2; c++)
+      {
+        const double ref = _box(coef, 2, c, width, height, radius, x, y);
+        const float val = ab[2 * (y * width + x) + c];
+        if(fabs(ref - val) > TEST_TOLERANCE)
+          fail_msg("%dx%d radius %d: coefficient %d of (%d, %d) is %g instead of %g",
+                   width, height, radius, c, x, y, val, ref);
+      }
+
+  dt_free_align(guide);
+  dt_free_align(mask);
+  dt_free_align(ab);
+  free(stats);
+  free(coef);
+}
+
+static void _check_rgb(const int width, const int height, const int radius)
+{
+  const size_t npix = (size_t)width * height;
+  const float eps = 0.01f;
+  const float guide_weight = 2.0f;
+  float *guide = dt_alloc_align_float(4 * npix);
+  float *in = dt_alloc_align_float(npix);
+  float *out = dt_alloc_align_float(npix);
+  double *stats = calloc(13 * npix, sizeof(double));
+  double *coef = calloc(4 * npix, sizeof(double));
+  for(size_t k = 0; k < npix; k++)
+  {
+    for(int c = 0; c < 4; c++)
+      guide[4 * k + c] = _frand();
+    in[k] = _frand();
+    const double g[3] = { guide_weight * guide[4 * k], guide_weight * guide[4 * k + 1],
+                          guide_weight * guide[4 * k + 2] };
+    double *s = stats + 13 * k;
+    s[0] = in[k];
+    for(int c = 0; c < 3; c++)
+    {
+      s[1 + c] = g[c];
+      s[4 + c] = g[c] * in[k];
+    }
+    s[7] = g[0] * g[0];
+    s[8] = g[0] * g[1];
+    s[9] = g[0] * g[2];
+    s[10] = g[1] * g[1];
+    s[11] = g[1] * g[2];
+    s[12] = g[2] * g[2];
+  }
+
+  dt_box_guided_filter(guide, 4, in, out, width, height, radius, eps, guide_weight, -10.0f, 10.0f);
+
+  for(int y = 0; y < height; y++)
+    for(int x = 0; x < width; x++)
+    {
+      double m[13];
+      for(int c = 0; c < 13; c++)
+        m[c] = _box(stats, 13, c, width, height, radius, x, y);
+      // solve (Sigma + eps I) a = cov by Cramer's rule
+      const double S00 = m[7] - m[1] * m[1] + eps, S01 = m[8] - m[1] * m[2], S02 = m[9] - m[1] * m[3];
+      const double S11 = m[10] - m[2] * m[2] + eps, S12 = m[11] - m[2] * m[3];
+      const double S22 = m[12] - m[3] * m[3] + eps;
+      const double cr = m[4] - m[1] * m[0], cg = m[5] - m[2] * m[0], cb = m[6] - m[3] * m[0];
+      const double det = S00 * (S11 * S22 - S12 * S12) - S01 * (S01 * S22 - S02 * S12)
+                         + S02 * (S01 * S12 - S02 * S11);
+      double *a = coef + 4 * (y * width + x);
+      a[0] = (cr * (S11 * S22 - S12 * S12) - S01 * (cg * S22 - cb * S12) + S02 * (cg * S12 - cb * S11)) / det;
+      a[1] = (S00 * (cg * S22 - cb * S12) - cr * (S01 * S22 - S02 * S12) + S02 * (S01 * cb - S02 * cg)) / det;
+      a[2] = (S00 * (S11 * cb - S12 * cg) - S01 * (S01 * cb - S02 * cg) + cr * (S01 * S12 - S02 * S11)) / det;
+      a[3] = m[0] - a[0] * m[1] - a[1] * m[2] - a[2] * m[3];
+    }
+  for(int y = 0; y < height; y++)
+    for(int x = 0; x < width; x++)
+    {
+      const float *g = guide + 4 * (y * width + x);
+      double m[4];
+      for(int c = 0; c < 4; c++)
+        m[c] = _box(coef, 4, c, width, height, radius, x, y);
+      const double ref = guide_weight * (m[0] * g[0] + m[1] * g[1] + m[2] * g[2]) + m[3];
+      const float val = out[y * width + x];
+      if(fabs(ref - val) > TEST_TOLERANCE)
+        fail_msg("%dx%d radius %d: pixel (%d, %d) is %g instead of %g", width, height, radius, x, y, val, ref);
+    }
+
+  dt_free_align(guide);
+  dt_free_align(in);
+  dt_free_align(out);
+  free(stats);
+  free(coef);
+}
+
+static void test_gray_coefficients(void **state)
+{
+  _check_gray(41, 29, 1);
+  _check_gray(41, 29, 6);
+  _check_gray(41, 29, 40);
+  _check_gray(3, 50, 2);
+  _check_gray(50, 2, 3);
+  _check_gray(1, 1, 1);
+}
+
+static void test_rgb_filter(void **state)
+{
+  _check_rgb(37, 23, 1);
+  _check_rgb(37, 23, 4);
+  _check_rgb(37, 23, 30);
+  _check_rgb(2, 40, 3);
+  _check_rgb(40, 2, 3);
+}
+
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  (void)argv;
+  // the filters are run without dt_init()
+  darktable.num_openmp_threads = dt_get_num_procs();
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_gray_coefficients),
+    cmocka_unit_test(test_rgb_filter),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
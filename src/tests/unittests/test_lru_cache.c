@@ -0,0 +1,194 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Unit tests for the reference counted cache of common/lru_cache.c used
+ * by the distortion grids, the baked color transforms and the mask
+ * rasters. Items are counted as they are freed to check that evicted
+ * items in use live until their last release, and that none leaks. */
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <cmocka.h>
+
+#include "common/lru_cache.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+#define TEST_SIZE 4
+
+typedef struct _item_t
+{
+  dt_lru_item_t item;
+  int key;
+} _item_t;
+
+static int _freed = 0;
+
+static void _free(dt_lru_item_t *item)
+{
+  _freed++;
+  free(item);
+}
+
+static _item_t *_new(const int key,
+                     const size_t bytes)
+{
+  _item_t *item = calloc(1, sizeof(_item_t));
+  item->key = key;
+  item->item.bytes = bytes;
+  return item;
+}
+
+// the item of the key, else the closest larger key
+static float _match(const dt_lru_item_t *item,
+                    const void *key)
+{
+  const int wanted = *(const int *)key;
+  const int have = ((const _item_t *)item)->key;
+  return have < wanted ? -1.0f : (float)(have - wanted);
+}
+
+static _item_t *_put(dt_lru_cache_t *cache,
+                     const dt_hash_t hash,
+                     const int key,
+                     const size_t bytes)
+{
+  return (_item_t *)dt_lru_cache_put(cache, hash, _match, &key, &_new(key, bytes)->item);
+}
+
+static _item_t *_get(dt_lru_cache_t *cache,
+                     const dt_hash_t hash,
+                     const int key)
+{
+  return (_item_t *)dt_lru_cache_get(cache, hash, _match, &key);
+}
+
+static void test_lookup(void **state)
+{
+  _freed = 0;
+  dt_lru_cache_t cache;
+  dt_lru_cache_init(&cache, TEST_SIZE, 0, _free);
+
+  dt_lru_cache_release(&cache, &_put(&cache, 1, 10, 0)->item);
+  dt_lru_cache_release(&cache, &_put(&cache, 1, 20, 0)->item);
+  dt_lru_cache_release(&cache, &_put(&cache, 2, 10, 0)->item);
+
+  // exact, closest, none and another hash
+  _item_t *item = _get(&cache, 1, 10);
+  assert_non_null(item);
+  assert_int_equal(item->key, 10);
+  dt_lru_cache_release(&cache, &item->item);
+  item = _get(&cache, 1, 15);
+  assert_non_null(item);
+  assert_int_equal(item->key, 20);
+  dt_lru_cache_release(&cache, &item->item);
+  assert_null(_get(&cache, 1, 25));
+  assert_null(_get(&cache, 3, 10));
+
+  // a second put of the same key gives the cached item back
+  _item_t *first = _get(&cache, 2, 10);
+  _item_t *second = _put(&cache, 2, 10, 0);
+  assert_ptr_equal(first, second);
+  assert_int_equal(_freed, 1);
+  assert_int_equal(first->item.users, 2);
+  dt_lru_cache_release(&cache, &first->item);
+  dt_lru_cache_release(&cache, &second->item);
+
+  dt_lru_cache_cleanup(&cache);
+  assert_int_equal(_freed, 4);
+}
+
+static void test_eviction(void **state)
+{
+  _freed = 0;
+  dt_lru_cache_t cache;
+  dt_lru_cache_init(&cache, TEST_SIZE, 0, _free);
+
+  _item_t *kept = _put(&cache, 1, 0, 0);
+  for(int k = 0; k < TEST_SIZE; k++)
+    dt_lru_cache_release(&cache, &_put(&cache, 100 + k, 0, 0)->item);
+
+  // evicted but in use
+  assert_false(kept->item.cached);
+  assert_int_equal(_freed, 0);
+  assert_null(_get(&cache, 1, 0));
+
+  // the least recently used goes first
+  dt_lru_cache_release(&cache, &_get(&cache, 100, 0)->item);
+  dt_lru_cache_release(&cache, &_put(&cache, 200, 0, 0)->item);
+  assert_int_equal(_freed, 1);
+  assert_null(_get(&cache, 101, 0));
+  _item_t *recent = _get(&cache, 100, 0);
+  assert_non_null(recent);
+  dt_lru_cache_release(&cache, &recent->item);
+
+  // freed by its last user
+  dt_lru_cache_release(&cache, &kept->item);
+  assert_int_equal(_freed, 2);
+
+  dt_lru_cache_cleanup(&cache);
+  assert_int_equal(_freed, 2 + TEST_SIZE);
+}
+
+static void test_budget(void **state)
+{
+  _freed = 0;
+  dt_lru_cache_t cache;
+  dt_lru_cache_init(&cache, TEST_SIZE, 100, _free);
+
+  dt_lru_cache_release(&cache, &_put(&cache, 1, 0, 40)->item);
+  dt_lru_cache_release(&cache, &_put(&cache, 2, 0, 40)->item);
+  assert_int_equal(cache.bytes, 80);
+  dt_lru_cache_release(&cache, &_put(&cache, 3, 0, 40)->item);
+  assert_int_equal(cache.bytes, 80);
+  assert_null(_get(&cache, 1, 0));
+
+  // larger than the budget, not cached, freed on release
+  _item_t *large = _put(&cache, 4, 0, 200);
+  assert_false(large->item.cached);
+  assert_int_equal(cache.bytes, 80);
+  dt_lru_cache_release(&cache, &large->item);
+  assert_int_equal(_freed, 2);
+  assert_null(_get(&cache, 4, 0));
+
+  dt_lru_cache_cleanup(&cache);
+  assert_int_equal(_freed, 4);
+}
+
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  (void)argv;
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_lookup),
+    cmocka_unit_test(test_eviction),
+    cmocka_unit_test(test_budget),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
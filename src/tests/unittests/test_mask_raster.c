@@ -0,0 +1,179 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Unit tests for the cache of the rasterised mask shapes of
+ * common/mask_raster.c. A feathered disc is rasterised over rois at
+ * several scales, the rasters given back by the cache are compared to
+ * the disc rasterised directly. Stripes check that the rasters are
+ * averaged rather than sampled far below their scale. */
+
+#include <math.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <cmocka.h>
+
+#include "common/darktable.h"
+#include "common/mask_raster.h"
+#include "develop/pixelpipe.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+// a disc of radius 300 px at full scale, feathered over 100 px
+static void _disc(const dt_iop_roi_t *roi, float *buffer)
+{
+  for(int j = 0; j < roi->height; j++)
+    for(int i = 0; i < roi->width; i++)
+    {
+      const float x = (roi->x + i) / roi->scale - 1000.0f;
+      const float y = (roi->y + j) / roi->scale - 800.0f;
+      const float r = sqrtf(x * x + y * y);
+      buffer[(size_t)j * roi->width + i] = CLAMP((400.0f - r) / 100.0f, 0.0f, 1.0f);
+    }
+}
+
+static void _check(dt_mask_raster_cache_t *cache,
+                   const dt_hash_t hash,
+                   const dt_iop_roi_t *roi,
+                   const float tolerance)
+{
+  const size_t npixels = (size_t)roi->width * roi->height;
+  float *cached = dt_alloc_align_float(npixels);
+  float *exact = dt_alloc_align_float(npixels);
+  assert_true(dt_mask_raster_cache_get(cache, hash, roi, cached));
+  _disc(roi, exact);
+  for(size_t k = 0; k < npixels; k++)
+    if(fabsf(cached[k] - exact[k]) > tolerance)
+      fail_msg("pixel %zu: %g instead of %g", k, cached[k], exact[k]);
+  dt_free_align(cached);
+  dt_free_align(exact);
+}
+
+static void test_reuse(void **state)
+{
+  dt_mask_raster_cache_t cache;
+  dt_mask_raster_cache_init(&cache);
+
+  const dt_iop_roi_t full = { 200, 100, 1700, 1500, 1.0f };
+  float *buffer = dt_alloc_align_float((size_t)full.width * full.height);
+  _disc(&full, buffer);
+  dt_mask_raster_cache_put(&cache, 1, &full, buffer);
+  dt_free_align(buffer);
+
+  // the same roi is copied, only the bounding box of the disc is kept
+  _check(&cache, 1, &full, 0.0f);
+  assert_true(cache.lru.bytes <= sizeof(float) * 801 * 801);
+
+  // lower scales are interpolated
+  const dt_iop_roi_t half = { 120, 60, 800, 700, 0.5f };
+  _check(&cache, 1, &half, 1e-4f);
+  const dt_iop_roi_t small = { 90, 60, 290, 270, 0.3f };
+  _check(&cache, 1, &small, 0.01f);
+
+  // neither a higher scale, another shape nor a roi out of the raster
+  float px[100 * 100];
+  const dt_iop_roi_t zoomed = { 1800, 1400, 100, 100, 2.0f };
+  const dt_iop_roi_t outside = { 0, 0, 100, 100, 0.5f };
+  assert_false(dt_mask_raster_cache_get(&cache, 1, &zoomed, px));
+  assert_false(dt_mask_raster_cache_get(&cache, 2, &half, px));
+  assert_false(dt_mask_raster_cache_get(&cache, 1, &outside, px));
+
+  dt_mask_raster_cache_cleanup(&cache);
+}
+
+static void test_average(void **state)
+{
+  dt_mask_raster_cache_t cache;
+  dt_mask_raster_cache_init(&cache);
+
+  // stripes of one pixel, a single sample per pixel would see only one
+  // of them at a quarter of the scale
+  const dt_iop_roi_t full = { 0, 0, 400, 400, 1.0f };
+  float *buffer = dt_alloc_align_float((size_t)full.width * full.height);
+  for(int j = 0; j < full.height; j++)
+    for(int i = 0; i < full.width; i++)
+      buffer[(size_t)j * full.width + i] = (i & 1) ? 0.0f : 1.0f;
+  dt_mask_raster_cache_put(&cache, 1, &full, buffer);
+  dt_free_align(buffer);
+
+  const dt_iop_roi_t quarter = { 10, 10, 80, 80, 0.25f };
+  float px[80 * 80];
+  assert_true(dt_mask_raster_cache_get(&cache, 1, &quarter, px));
+  for(int k = 0; k < 80 * 80; k++)
+    if(fabsf(px[k] - 0.5f) > 1e-6f)
+      fail_msg("pixel %d: %g instead of 0.5", k, px[k]);
+
+  dt_mask_raster_cache_cleanup(&cache);
+}
+
+static void test_eviction(void **state)
+{
+  dt_mask_raster_cache_t cache;
+  dt_mask_raster_cache_init(&cache);
+
+  const dt_iop_roi_t roi = { 500, 300, 1000, 1000, 1.0f };
+  float *buffer = dt_alloc_align_float((size_t)roi.width * roi.height);
+  _disc(&roi, buffer);
+  for(int k = 0; k < 2 * DT_MASK_RASTER_CACHE_SIZE; k++)
+    dt_mask_raster_cache_put(&cache, 100 + k, &roi, buffer);
+  dt_free_align(buffer);
+
+  // the least recently used rasters are gone
+  float *px = dt_alloc_align_float((size_t)roi.width * roi.height);
+  assert_false(dt_mask_raster_cache_get(&cache, 100, &roi, px));
+  assert_true(dt_mask_raster_cache_get(&cache, 100 + 2 * DT_MASK_RASTER_CACHE_SIZE - 1, &roi, px));
+  assert_true(cache.lru.bytes <= DT_MASK_RASTER_CACHE_BYTES);
+  dt_free_align(px);
+
+  // an empty raster takes no memory
+  const size_t bytes = cache.lru.bytes;
+  const dt_iop_roi_t empty_roi = { 0, 0, 64, 64, 1.0f };
+  float empty[64 * 64] = { 0.0f };
+  dt_mask_raster_cache_put(&cache, 1, &empty_roi, empty);
+  float out[64 * 64];
+  memset(out, 0xff, sizeof(out));
+  assert_true(dt_mask_raster_cache_get(&cache, 1, &empty_roi, out));
+  assert_memory_equal(out, empty, sizeof(empty));
+  assert_true(cache.lru.bytes <= bytes);
+
+  dt_mask_raster_cache_cleanup(&cache);
+}
+
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  (void)argv;
+  // the rasters are interpolated without dt_init()
+  darktable.num_openmp_threads = dt_get_num_procs();
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_reuse),
+    cmocka_unit_test(test_average),
+    cmocka_unit_test(test_eviction),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,232 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Regression tests for the non-local means of common/nlmeans_core.c.
+ * The sliding patch distances are checked against a direct evaluation of
+ * every patch, which only differs by rounding, and the denoising itself by
+ * the PSNR gained on a noisy synthetic image. Images of a few slices
+ * exercise the borders of the RoI and of the slices processed by the
+ * threads. */
+
+#include <math.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <cmocka.h>
+
+#include "common/darktable.h"
+#include "common/math.h"
+#include "common/nlmeans_core.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+// agreement with the direct evaluation
+#define TEST_MIN_PSNR_REF 80.0
+// improvement over the noisy input
+#define TEST_MIN_PSNR_GAIN 2.0
+
+static unsigned int _rng = 777u;
+static float _frand(void)
+{
+  _rng = _rng * 1664525u + 1013904223u;
+  return (float)((_rng >> 8) & 0xFFFFFF) / (float)0xFFFFFF;
+}
+
+// smooth rgb gradients with a few edges
+static float *_clean_image(const int width, const int height)
+{
+  float *img = dt_alloc_align_float((size_t)4 * width * height);
+  for(int y = 0; y < height; y++)
+    for(int x = 0; x < width; x++)
+    {
+      float *px = img + 4 * ((size_t)y * width + x);
+      const float edge = (x / 11 + y / 7) & 1 ? 0.2f : 0.0f;
+      px[0] = 0.3f + 0.4f * x / width + edge;
+      px[1] = 0.5f + 0.2f * sinf(0.1f * y) - edge;
+      px[2] = 0.4f + 0.3f * y / height;
+      px[3] = 0.0f;
+    }
+  return img;
+}
+
+static float *_add_noise(const float *clean, const int width, const int height, const float sigma)
+{
+  const size_t nfloats = (size_t)4 * width * height;
+  float *img = dt_alloc_align_float(nfloats);
+  for(size_t k = 0; k < nfloats; k++)
+    img[k] = (k & 3) == 3 ? 0.0f : clean[k] + sigma * (_frand() + _frand() + _frand() - 1.5f);
+  return img;
+}
+
+static double _psnr(const float *a, const float *b, const int width, const int height)
+{
+  double sum = 0.0;
+  for(size_t k = 0; k < (size_t)width * height; k++)
+    for(int c = 0; c < 3; c++)
+    {
+      const double d = a[4 * k + c] - b[4 * k + c];
+      sum += d * d;
+    }
+  const double mse = sum / (3.0 * width * height);
+  return mse > 0.0 ? -10.0 * log10(mse) : INFINITY;
+}
+
+static double _pixel_difference(const float *a, const float *b, const float *norm)
+{
+  double sum = 0.0;
+  for(int c = 0; c < 3; c++)
+    sum += (double)(a[c] - b[c]) * (a[c] - b[c]) * norm[c];
+  return sum;
+}
+
+static gboolean _inside(const int x, const int y, const int width, const int height)
+{
+  return x >= 0 && y >= 0 && x < width && y < height;
+}
+
+// every patch evaluated on its own; patch pixels whose counterpart lies outside the RoI do not count
+static void _reference(const float *in, float *out, const int width, const int height,
+                       const dt_nlmeans_param_t *p)
+{
+  const int pr = p->patch_radius;
+  const int sr = p->search_radius;
+  const float cp_norm = p->center_weight * (2 * pr + 1) * (2 * pr + 1);
+  const float center_norm[4] = { cp_norm, cp_norm, cp_norm, 1.0f };
+  for(int y = 0; y < height; y++)
+    for(int x = 0; x < width; x++)
+    {
+      double acc[4] = { 0.0, 0.0, 0.0, 0.0 };
+      const float *center = in + 4 * ((size_t)y * width + x);
+      for(int sy = -sr; sy <= sr; sy++)
+        for(int sx = -sr; sx <= sr; sx++)
+        {
+          if(!_inside(x + sx, y + sy, width, height)) continue;
+          double distortion = 0.0;
+          for(int dy = -pr; dy <= pr; dy++)
+            for(int dx = -pr; dx <= pr; dx++)
+            {
+              if(!_inside(x + dx, y + dy, width, height)
+                 || !_inside(x + dx + sx, y + dy + sy, width, height))
+                continue;
+              const float *a = in + 4 * ((size_t)(y + dy) * width + x + dx);
+              const float *b = in + 4 * ((size_t)(y + dy + sy) * width + x + dx + sx);
+              distortion += _pixel_difference(a, b, p->norm);
+            }
+          const float *other = in + 4 * ((size_t)(y + sy) * width + x + sx);
+          float wt;
+          if(p->center_weight < 0.0f)
+            wt = dt_fast_mexp2f((float)distortion * p->sharpness);
+          else
+          {
+            const float dissimilarity = (float)(distortion + _pixel_difference(center, other, center_norm))
+                                        / (1.0f + p->center_weight);
+            wt = dt_fast_mexp2f(fmaxf(0.0f, dissimilarity * p->sharpness - 2.0f));
+          }
+          for(int c = 0; c < 3; c++)
+            acc[c] += (double)other[c] * wt;
+          acc[3] += wt;
+        }
+      float *px = out + 4 * ((size_t)y * width + x);
+      for(int c = 0; c < 3; c++)
+        px[c] = acc[c] / acc[3];
+      px[3] = 1.0f;
+    }
+}
+
+static void _check(const int width, const int height, const int patch_radius, const int search_radius,
+                   const float center_weight)
+{
+  const float norm[4] = { 1.0f, 0.8f, 1.2f, 0.0f };
+  // the same strength whatever the patch size
+  const float sharpness = 625.0f / ((2 * patch_radius + 1) * (2 * patch_radius + 1));
+  const dt_nlmeans_param_t params = { .scattering = 0.0f,
+                                      .scale = 1.0f,
+                                      .luma = 1.0f,
+                                      .chroma = 1.0f,
+                                      .center_weight = center_weight,
+                                      .sharpness = sharpness,
+                                      .patch_radius = patch_radius,
+                                      .search_radius = search_radius,
+                                      .decimate = 0,
+                                      .norm = norm,
+                                      .pipetype = DT_DEV_PIXELPIPE_FULL };
+  const dt_iop_roi_t roi = { .x = 0, .y = 0, .width = width, .height = height, .scale = 1.0f };
+  float *clean = _clean_image(width, height);
+  float *noisy = _add_noise(clean, width, height, 0.05f);
+  float *out = dt_alloc_align_float((size_t)4 * width * height);
+  float *ref = dt_alloc_align_float((size_t)4 * width * height);
+
+  nlmeans_denoise(noisy, out, &roi, &roi, &params);
+  _reference(noisy, ref, width, height, &params);
+
+  const double psnr_ref = _psnr(out, ref, width, height);
+  if(psnr_ref < TEST_MIN_PSNR_REF)
+    fail_msg("%dx%d patch %d search %d center %g: %.1f dB from the direct evaluation",
+             width, height, patch_radius, search_radius, center_weight, psnr_ref);
+
+  const double psnr_noisy = _psnr(noisy, clean, width, height);
+  const double psnr_out = _psnr(out, clean, width, height);
+  if(width * height > 1000 && psnr_out < psnr_noisy + TEST_MIN_PSNR_GAIN)
+    fail_msg("%dx%d patch %d search %d center %g: denoised to %.1f dB from %.1f dB",
+             width, height, patch_radius, search_radius, center_weight, psnr_out, psnr_noisy);
+
+  dt_free_align(clean);
+  dt_free_align(noisy);
+  dt_free_align(out);
+  dt_free_align(ref);
+}
+
+static void test_nlmeans(void **state)
+{
+  // several slices in both directions
+  _check(163, 131, 2, 7, -1.0f);
+  _check(163, 131, 1, 3, -1.0f);
+  // search area reaching past the whole RoI
+  _check(9, 6, 2, 7, -1.0f);
+  _check(1, 40, 3, 5, -1.0f);
+}
+
+static void test_nlmeans_center_weight(void **state)
+{
+  _check(163, 131, 2, 7, 0.5f);
+  _check(90, 17, 4, 6, 0.1f);
+  _check(6, 9, 2, 7, 0.5f);
+}
+
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  (void)argv;
+  // the kernels are run without dt_init()
+  darktable.num_openmp_threads = dt_get_num_procs();
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_nlmeans),
+    cmocka_unit_test(test_nlmeans_center_weight),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,223 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Unit tests for the falloff of the path masks of develop/masks/path.c.
+ * Wavy closed paths are filled and feathered by the triangles between
+ * their points and border points, merged along the smooth parts of the
+ * paths. They are compared to the triangles between each pair of points,
+ * within 1/255, and to the former falloff which drew a line from each
+ * path point to its border point.
+ *
+ * Following test_filmicrgb.c, the implementation is #included directly
+ * for static access. */
+
+#include <math.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "develop/masks/path.c"
+
+#include <cmocka.h>
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+#define TEST_W 2000
+#define TEST_H 1500
+// about one path point per pixel, as for the paths of the masks
+#define TEST_POINTS 8000
+
+// the former falloff: a line from the path point to the border point,
+// widened by one pixel against the gaps of the rounding
+static void _falloff_line(float *buffer, const int *p0, const int *p1, const int bw, const int bh)
+{
+  const int l = sqrtf((p1[0] - p0[0]) * (p1[0] - p0[0])
+                      + (p1[1] - p0[1]) * (p1[1] - p0[1])) + 1;
+  const float lx = p1[0] - p0[0];
+  const float ly = p1[1] - p0[1];
+  const int dx = lx < 0 ? -1 : 1;
+  const int dy = ly < 0 ? -1 : 1;
+  for(int i = 0; i < l; i++)
+  {
+    const int x = (int)((float)i * lx / (float)l) + p0[0];
+    const int y = (int)((float)i * ly / (float)l) + p0[1];
+    const float op = 1.0f - (float)i / (float)l;
+    if(x >= 0 && x < bw && y >= 0 && y < bh)
+      buffer[(size_t)y * bw + x] = MAX(buffer[(size_t)y * bw + x], op);
+    if(x + dx >= 0 && x + dx < bw && y >= 0 && y < bh)
+      buffer[(size_t)y * bw + x + dx] = MAX(buffer[(size_t)y * bw + x + dx], op);
+    if(x >= 0 && x < bw && y + dy >= 0 && y + dy < bh)
+      buffer[(size_t)(y + dy) * bw + x] = MAX(buffer[(size_t)(y + dy) * bw + x], op);
+  }
+}
+
+static void _falloff_lines(float *buffer, const float *pairs, const int npairs)
+{
+  int last[4] = { -100, -100, -100, -100 };
+  for(int k = 0; k < npairs; k++)
+  {
+    const int p[4] = { floorf(pairs[4 * k] + 0.5f), ceilf(pairs[4 * k + 1]),
+                       pairs[4 * k + 2], pairs[4 * k + 3] };
+    if(memcmp(p, last, sizeof(p)))
+      _falloff_line(buffer, p, p + 2, TEST_W, TEST_H);
+    memcpy(last, p, sizeof(p));
+  }
+}
+
+// the triangles between each pair of path and border points, as many
+// as the pairs, which the merged quadrangles must stay within 1/255 of
+static void _feather_unmerged(float *buffer, const float *pairs, const int npairs)
+{
+  _path_ramp_t *ramps = dt_alloc_align_type(_path_ramp_t, (size_t)2 * npairs);
+  assert_non_null(ramps);
+  int nramps = 0;
+  for(int k = 0; k < npairs; k++)
+  {
+    const float *const q0 = pairs + 4 * k;
+    const float *const q1 = pairs + 4 * ((k + 1) % npairs);
+    nramps += _path_ramp_init(ramps + nramps, q0, q1, q0 + 2, 1.0f, 1.0f, 0.0f, TEST_H);
+    nramps += _path_ramp_init(ramps + nramps, q1, q1 + 2, q0 + 2, 1.0f, 0.0f, 0.0f, TEST_H);
+  }
+  _path_feather_roi(buffer, ramps, nramps, TEST_W, TEST_H);
+  dt_free_align(ramps);
+}
+
+// a closed path with wiggles waves, its border feather pixels away
+// along the outward normal, the feather varying along the path
+static void _compare(const int wiggles,
+                     const float feather,
+                     const float max_tolerance,
+                     const float mean_tolerance)
+{
+  float *points = dt_alloc_align_float(2 * TEST_POINTS);
+  float *pairs = dt_alloc_align_float(4 * TEST_POINTS);
+  float *former = dt_calloc_align_float((size_t)TEST_W * TEST_H);
+  float *triangles = dt_calloc_align_float((size_t)TEST_W * TEST_H);
+  float *unmerged = dt_calloc_align_float((size_t)TEST_W * TEST_H);
+  assert_non_null(points);
+  assert_non_null(pairs);
+  assert_non_null(former);
+  assert_non_null(triangles);
+  assert_non_null(unmerged);
+
+  for(int k = 0; k < TEST_POINTS; k++)
+  {
+    const double t = 2.0 * M_PI * k / TEST_POINTS;
+    const double r = 500.0 + 80.0 * sin(wiggles * t);
+    const double dr = 80.0 * wiggles * cos(wiggles * t);
+    const double x = 0.5 * TEST_W + r * cos(t);
+    const double y = 0.5 * TEST_H + r * sin(t);
+    double tx = dr * cos(t) - r * sin(t);
+    double ty = dr * sin(t) + r * cos(t);
+    const double l = hypot(tx, ty);
+    tx /= l;
+    ty /= l;
+    const double f = feather * (1.0 + 0.5 * sin(3.0 * t));
+    points[2 * k] = pairs[4 * k] = x;
+    points[2 * k + 1] = pairs[4 * k + 1] = y;
+    pairs[4 * k + 2] = x + ty * f;
+    pairs[4 * k + 3] = y - tx * f;
+  }
+
+  assert_true(_path_fill_roi(former, points, 0, TEST_POINTS, TEST_W, TEST_H,
+                             0, TEST_W - 1, 0, TEST_H - 1));
+  memcpy(triangles, former, sizeof(float) * TEST_W * TEST_H);
+  memcpy(unmerged, former, sizeof(float) * TEST_W * TEST_H);
+
+  _falloff_lines(former, pairs, TEST_POINTS);
+  assert_true(_path_feather_pairs(triangles, pairs, TEST_POINTS, TEST_W, TEST_H));
+  _feather_unmerged(unmerged, pairs, TEST_POINTS);
+
+  // the pairs merged into quadrangles
+  for(size_t k = 0; k < (size_t)TEST_W * TEST_H; k++)
+    if(fabsf(triangles[k] - unmerged[k]) > 1.0f / 255.0f)
+      fail_msg("pixel %zu: %g merged, %g unmerged", k, triangles[k], unmerged[k]);
+
+  // the mean over the pixels of the mask. The former lines leave gaps
+  // where the border points spread apart, which the triangles fill, so
+  // the largest difference is taken where the lines reach
+  double max_diff = 0.0, sum = 0.0;
+  size_t count = 0;
+  for(size_t k = 0; k < (size_t)TEST_W * TEST_H; k++)
+  {
+    if(former[k] == 0.0f && triangles[k] == 0.0f) continue;
+    const double diff = fabs(former[k] - triangles[k]);
+    if(former[k] > 0.0f) max_diff = MAX(max_diff, diff);
+    sum += diff;
+    count++;
+  }
+  assert_true(count > 0);
+  assert_true(max_diff <= max_tolerance);
+  assert_true(sum / count <= mean_tolerance);
+
+  dt_free_align(points);
+  dt_free_align(pairs);
+  dt_free_align(former);
+  dt_free_align(triangles);
+  dt_free_align(unmerged);
+}
+
+static void test_circle(void **state)
+{
+  _compare(0, 50.0f, 0.1f, 0.003f);
+}
+
+static void test_wiggles(void **state)
+{
+  _compare(5, 50.0f, 0.1f, 0.003f);
+  // bends tighter than the feather
+  _compare(20, 50.0f, 0.1f, 0.005f);
+}
+
+static void test_wide_feather(void **state)
+{
+  // the feather folds over itself in the bends
+  _compare(5, 200.0f, 0.3f, 0.003f);
+}
+
+static void test_narrow_feather(void **state)
+{
+  // the former lines set the rounded path points and their neighbours
+  // to 1, so single pixels along the path differ by up to 1
+  _compare(20, 5.0f, 1.0f, 0.006f);
+}
+
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  (void)argv;
+  // the masks are rasterised without dt_init()
+  darktable.num_openmp_threads = dt_get_num_procs();
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_circle),
+    cmocka_unit_test(test_wiggles),
+    cmocka_unit_test(test_wide_feather),
+    cmocka_unit_test(test_narrow_feather),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
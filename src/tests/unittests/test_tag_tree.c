@@ -0,0 +1,157 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Unit tests for the in-memory tag hierarchy (common/tag_tree) used by the
+ * tagging module to update its dictionary tree without reloading it. */
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cmocka.h>
+
+#include "common/tag_tree.h"
+#include "common/tags.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+static dt_tag_node_t *_insert(dt_tag_tree_t *tree, const guint id, const char *name,
+                              const guint count, const guint select)
+{
+  dt_tag_t tag = { .id = id, .tag = (gchar *)name, .count = count, .select = select };
+  return dt_tag_tree_insert(tree, &tag);
+}
+
+static void test_insert_find(void **state)
+{
+  dt_tag_tree_t *tree = dt_tag_tree_new();
+  _insert(tree, 1, "places|europe|paris", 3, DT_TS_NO_IMAGE);
+  _insert(tree, 2, "places|europe", 5, DT_TS_NO_IMAGE);
+  _insert(tree, 3, "people", 1, DT_TS_NO_IMAGE);
+
+  assert_ptr_equal(dt_tag_tree_find(tree, ""), &tree->root);
+  assert_int_equal(tree->root.children->len, 2);
+
+  // "places" is only a level of the path
+  dt_tag_node_t *places = dt_tag_tree_find(tree, "places");
+  assert_non_null(places);
+  assert_int_equal(places->tagid, 0);
+  assert_string_equal(places->name, "places");
+
+  dt_tag_node_t *europe = dt_tag_tree_find(tree, "places|europe");
+  assert_non_null(europe);
+  assert_int_equal(europe->tagid, 2);
+  assert_int_equal(europe->count, 5);
+  assert_ptr_equal(europe->parent, places);
+
+  dt_tag_node_t *paris = dt_tag_tree_find_id(tree, 1);
+  assert_non_null(paris);
+  assert_string_equal(paris->path, "places|europe|paris");
+  assert_ptr_equal(paris->parent, europe);
+
+  assert_null(dt_tag_tree_find(tree, "places|asia"));
+  assert_null(dt_tag_tree_find_id(tree, 42));
+
+  dt_tag_tree_free(tree);
+}
+
+static void test_remove_prunes(void **state)
+{
+  dt_tag_tree_t *tree = dt_tag_tree_new();
+  _insert(tree, 1, "a|b|c", 1, DT_TS_NO_IMAGE);
+  _insert(tree, 2, "a|b", 1, DT_TS_NO_IMAGE);
+  _insert(tree, 3, "a|d", 1, DT_TS_NO_IMAGE);
+
+  // a tag with children stays as a path
+  dt_tag_node_t *node = dt_tag_tree_remove(tree, 2);
+  assert_ptr_equal(node, dt_tag_tree_find(tree, "a|b"));
+  assert_int_equal(node->tagid, 0);
+  assert_null(dt_tag_tree_find_id(tree, 2));
+
+  // removing the last tag below "a|b" prunes both levels
+  node = dt_tag_tree_remove(tree, 1);
+  assert_ptr_equal(node, dt_tag_tree_find(tree, "a"));
+  assert_null(dt_tag_tree_find(tree, "a|b"));
+  assert_int_equal(node->children->len, 1);
+
+  node = dt_tag_tree_remove(tree, 3);
+  assert_ptr_equal(node, &tree->root);
+  assert_false(dt_tag_tree_node_has_children(&tree->root));
+
+  assert_null(dt_tag_tree_remove(tree, 3));
+
+  dt_tag_tree_free(tree);
+}
+
+static void test_select_aggregation(void **state)
+{
+  dt_tag_tree_t *tree = dt_tag_tree_new();
+  _insert(tree, 1, "a|b|c", 1, DT_TS_ALL_IMAGES);
+  _insert(tree, 2, "a|b|d", 1, DT_TS_NO_IMAGE);
+  _insert(tree, 3, "a", 1, DT_TS_NO_IMAGE);
+
+  dt_tag_node_t *a = dt_tag_tree_find_id(tree, 3);
+  dt_tag_node_t *b = dt_tag_tree_find(tree, "a|b");
+  assert_int_equal(dt_tag_tree_node_select(b), DT_TS_SOME_IMAGES);
+  assert_int_equal(dt_tag_tree_node_select(a), DT_TS_SOME_IMAGES);
+
+  // the own state of a tag wins over the state of its children
+  dt_tag_tree_set_select(tree, 3, DT_TS_ALL_IMAGES);
+  assert_int_equal(dt_tag_tree_node_select(a), DT_TS_ALL_IMAGES);
+  dt_tag_tree_set_select(tree, 3, DT_TS_NO_IMAGE);
+
+  dt_tag_tree_set_select(tree, 2, DT_TS_SOME_IMAGES);
+  assert_int_equal(b->selected_below, 2);
+  dt_tag_tree_set_select(tree, 1, DT_TS_NO_IMAGE);
+  dt_tag_tree_set_select(tree, 2, DT_TS_NO_IMAGE);
+  assert_int_equal(dt_tag_tree_node_select(b), DT_TS_NO_IMAGE);
+  assert_int_equal(dt_tag_tree_node_select(a), DT_TS_NO_IMAGE);
+
+  // removing a selected tag updates the ancestors
+  dt_tag_tree_set_select(tree, 1, DT_TS_ALL_IMAGES);
+  dt_tag_tree_remove(tree, 1);
+  assert_int_equal(dt_tag_tree_node_select(b), DT_TS_NO_IMAGE);
+  assert_int_equal(a->selected_below, 0);
+
+  dt_tag_tree_set_select(tree, 2, DT_TS_ALL_IMAGES);
+  dt_tag_tree_reset_select(tree);
+  assert_int_equal(dt_tag_tree_node_select(a), DT_TS_NO_IMAGE);
+  assert_int_equal(dt_tag_tree_node_select(b), DT_TS_NO_IMAGE);
+
+  dt_tag_tree_free(tree);
+}
+
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  (void)argv;
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_insert_find),
+    cmocka_unit_test(test_remove_prunes),
+    cmocka_unit_test(test_select_aggregation),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
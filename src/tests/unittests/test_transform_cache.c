@@ -0,0 +1,195 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2026 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Unit tests for the cache of the points transformed through the
+ * distorting modules in develop/develop.c. A batch of points is run
+ * through a one module chain shifting them, and the calls of the module
+ * are counted: the same points are served from the cache, other points
+ * or a changed chain are transformed again, and an entry whose hash
+ * matches is not served for other points.
+ *
+ * Following test_filmicrgb.c, the implementation is #included directly
+ * for static access. */
+
+#include <math.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "develop/develop.c"
+
+#include <cmocka.h>
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+#define TEST_POINTS 100
+
+static int _calls = 0;
+
+static gboolean _shift_transform(dt_iop_module_t *self,
+                                 dt_dev_pixelpipe_iop_t *piece,
+                                 float *const restrict points,
+                                 size_t points_count)
+{
+  const float *shift = piece->data;
+  for(size_t k = 0; k < points_count; k++)
+  {
+    points[2 * k] += shift[0];
+    points[2 * k + 1] += shift[1];
+  }
+  _calls++;
+  return TRUE;
+}
+
+typedef struct _chain_t
+{
+  dt_develop_t dev;
+  dt_dev_pixelpipe_t pipe;
+  dt_iop_module_t module;
+  dt_dev_pixelpipe_iop_t piece;
+  float shift[2];
+} _chain_t;
+
+static _chain_t *_chain_new(void)
+{
+  _chain_t *c = calloc(1, sizeof(_chain_t));
+  c->module.distort_transform = _shift_transform;
+  c->shift[0] = 3.0f;
+  c->shift[1] = -2.0f;
+  c->piece.enabled = TRUE;
+  c->piece.data = c->shift;
+  c->piece.hash = 1;
+  c->pipe.type = DT_DEV_PIXELPIPE_FULL;
+  c->pipe.iop = g_list_append(NULL, &c->module);
+  c->pipe.nodes = g_list_append(NULL, &c->piece);
+  return c;
+}
+
+static void _chain_free(_chain_t *c)
+{
+  for(int k = 0; k < DT_DEV_TRANSFORM_CACHE_SIZE; k++)
+  {
+    dt_free_align(c->dev.transform_cache.entry[k].input);
+    dt_free_align(c->dev.transform_cache.entry[k].points);
+  }
+  g_list_free(c->pipe.iop);
+  g_list_free(c->pipe.nodes);
+  free(c);
+}
+
+// transforms a copy of the points and checks it against the shift
+static void _transform(_chain_t *c,
+                       const float *points,
+                       const int calls)
+{
+  float out[2 * TEST_POINTS];
+  memcpy(out, points, sizeof(out));
+  assert_true(_dev_distort_transform_locked(&c->dev, &c->pipe, FALSE, 0.0,
+                                            DT_DEV_TRANSFORM_DIR_ALL, out, TEST_POINTS));
+  assert_int_equal(_calls, calls);
+  for(int k = 0; k < TEST_POINTS; k++)
+  {
+    assert_float_equal(out[2 * k], points[2 * k] + c->shift[0], 0.0f);
+    assert_float_equal(out[2 * k + 1], points[2 * k + 1] + c->shift[1], 0.0f);
+  }
+}
+
+static void test_hit_and_miss(void **state)
+{
+  _calls = 0;
+  _chain_t *c = _chain_new();
+  float points[2 * TEST_POINTS];
+  for(int k = 0; k < 2 * TEST_POINTS; k++) points[k] = 0.5f * k;
+
+  _transform(c, points, 1);
+  // the same points
+  _transform(c, points, 1);
+  // other points
+  points[2 * TEST_POINTS - 1] += 1.0f;
+  _transform(c, points, 2);
+  _transform(c, points, 2);
+
+  _chain_free(c);
+}
+
+static void test_invalidated_chain(void **state)
+{
+  _calls = 0;
+  _chain_t *c = _chain_new();
+  float points[2 * TEST_POINTS];
+  for(int k = 0; k < 2 * TEST_POINTS; k++) points[k] = 0.25f * k;
+
+  _transform(c, points, 1);
+  // new parameters of the piece
+  c->shift[0] = -1.0f;
+  c->piece.hash = 2;
+  _transform(c, points, 2);
+  // the piece disabled, the points are left alone
+  c->piece.enabled = FALSE;
+  float out[2 * TEST_POINTS];
+  memcpy(out, points, sizeof(out));
+  assert_true(_dev_distort_transform_locked(&c->dev, &c->pipe, FALSE, 0.0,
+                                            DT_DEV_TRANSFORM_DIR_ALL, out, TEST_POINTS));
+  assert_int_equal(_calls, 2);
+  assert_memory_equal(out, points, sizeof(out));
+
+  _chain_free(c);
+}
+
+static void test_collision(void **state)
+{
+  _calls = 0;
+  _chain_t *c = _chain_new();
+  float points[2 * TEST_POINTS];
+  for(int k = 0; k < 2 * TEST_POINTS; k++) points[k] = (float)k;
+  _transform(c, points, 1);
+
+  // an entry with the hash asked for but other points is not served
+  dt_dev_transform_cache_entry_t *entry = NULL;
+  for(int k = 0; k < DT_DEV_TRANSFORM_CACHE_SIZE; k++)
+    if(c->dev.transform_cache.entry[k].points) entry = &c->dev.transform_cache.entry[k];
+  assert_non_null(entry);
+  float other[2 * TEST_POINTS];
+  for(int k = 0; k < 2 * TEST_POINTS; k++) other[k] = -1.0f * k;
+  assert_false(_dev_transform_cache_get(&c->dev.transform_cache, entry->hash, other, TEST_POINTS));
+  assert_float_equal(other[2], -2.0f, 0.0f);
+
+  _chain_free(c);
+}
+
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  (void)argv;
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_hit_and_miss),
+    cmocka_unit_test(test_invalidated_chain),
+    cmocka_unit_test(test_collision),
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -20,6 +20,12 @@
  *
  * Please see ../README.md for more detailed documentation.
  */
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
 #include <cmocka.h>
 
 // assert_float_equal() is not available on Ubuntu 18.04 (state 2020-01):
@@ -30,6 +36,31 @@
   assert_true(a > (b - epsilon));\
 }
 #endif
+
+// distance of two floats in units in the last place: their bits are mapped
+// onto integers ordered as the floats, so that neighbours differ by one
+static inline int64_t float_ulps(const float a, const float b)
+{
+  int32_t ia, ib;
+  memcpy(&ia, &a, sizeof(ia));
+  memcpy(&ib, &b, sizeof(ib));
+  const int64_t la = ia < 0 ? (int64_t)INT32_MIN - ia : ia;
+  const int64_t lb = ib < 0 ? (int64_t)INT32_MIN - ib : ib;
+  return la > lb ? la - lb : lb - la;
+}
+
+// compare two buffers of n floats, allowing max_ulps of rounding difference
+#define assert_floats_within_ulps(expected, actual, n, max_ulps)\
+{\
+  for(size_t _k = 0; _k < (n); _k++)\
+  {\
+    const float _e = (expected)[_k];\
+    const float _a = (actual)[_k];\
+    if(!(isnan(_e) && isnan(_a)) && float_ulps(_e, _a) > (max_ulps))\
+      fail_msg("value %zu differs: %.9g (expected) vs %.9g", _k, _e, _a);\
+  }\
+}
+
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
@@ -22,6 +22,8 @@
 #include "common/debug.h"
 #include "common/gpx.h"
 #include "common/geo.h"
+#include "common/geo_cluster.h"
+#include "common/geo_index.h"
 #include "common/image_cache.h"
 #include "common/math.h"
 #include "common/mipmap_cache.h"
@@ -43,15 +45,6 @@
 
 DT_MODULE(1)
 
-typedef struct dt_geo_position_t
-{
-  double x, y;
-  unsigned int x_bin, y_bin;
-  unsigned int next;
-  int cluster_id;
-  dt_imgid_t imgid;
-} dt_geo_position_t;
-
 typedef struct dt_map_image_t
 {
   dt_imgid_t imgid;
@@ -75,6 +68,7 @@ typedef struct dt_map_t
   GSList *images;
   dt_geo_position_t *points;
   int nb_points;
+  dt_geo_index_t *geo_index;
   GdkPixbuf *image_pin, *place_pin;
   GList *selected_images;
   gboolean start_drag;
@@ -99,16 +93,6 @@ typedef struct dt_map_t
   } loc;
 } dt_map_t;
 
-#define UNCLASSIFIED -1
-#define NOISE -2
-
-#define CORE_POINT 1
-#define NOT_CORE_POINT 0
-
-#define NO_NEXT_POINT (~((unsigned int)0))
-
-#define EXPAND_LIMIT 250
-
 static const int thumb_size = 128;
 static const int thumb_border = 2;
 static const int image_pin_size = 13;
@@ -251,14 +235,10 @@ static void _view_map_dnd_remove_callback(GtkWidget *widget,
                                           const guint target_type,
                                           const guint time,
                                           gpointer data);
-// find the images clusters on the map
-static int _dbscan(const dt_map_t *lib,
-                   dt_geo_position_t *points,
-                   const unsigned int num_points,
-                   const double epsilon,
-                   const unsigned int minpts);
 static gboolean _view_map_prefs_changed(dt_map_t *lib);
 static void _view_map_build_main_query(dt_map_t *lib);
+static void _view_map_reset_index(dt_map_t *lib);
+static dt_geo_index_t *_view_map_get_index(dt_map_t *lib);
 
 /* center map to on the baricenter of the image list */
 static gboolean _view_map_center_on_image_list(dt_view_t *self,
@@ -889,6 +869,7 @@ void cleanup(dt_view_t *self)
     // segfaults.  g_object_unref(G_OBJECT(lib->map));
   }
   if(lib->main_query) sqlite3_finalize(lib->main_query);
+  _view_map_reset_index(lib);
   free(self->data);
 }
 
@@ -1431,7 +1412,6 @@ static void _view_map_changed_callback_delayed(const gpointer user_data)
 {
   dt_view_t *self = (dt_view_t *)user_data;
   dt_map_t *lib = self->data;
-  const gboolean all_good = TRUE;
   gboolean needs_redraw = FALSE;
   const gboolean prefs_changed = _view_map_prefs_changed(lib);
 
@@ -1474,127 +1454,146 @@ static void _view_map_changed_callback_delayed(const gpointer user_data)
     dt_conf_set_float("plugins/map/latitude", center_lat);
     dt_conf_set_int("plugins/map/zoom", zoom);
 
-    /* let's reset and reuse the main_query statement */
-    DT_DEBUG_SQLITE3_CLEAR_BINDINGS(lib->main_query);
-    DT_DEBUG_SQLITE3_RESET(lib->main_query);
-
-    /* bind bounding box coords for the main query */
-    DT_DEBUG_SQLITE3_BIND_DOUBLE(lib->main_query, 1, lib->bbox.lon1);
-    DT_DEBUG_SQLITE3_BIND_DOUBLE(lib->main_query, 2, lib->bbox.lon2);
-    DT_DEBUG_SQLITE3_BIND_DOUBLE(lib->main_query, 3, lib->bbox.lat1);
-    DT_DEBUG_SQLITE3_BIND_DOUBLE(lib->main_query, 4, lib->bbox.lat2);
-
-    // count the images
-    int img_count = 0;
-    while(sqlite3_step(lib->main_query) == SQLITE_ROW)
-    {
-      img_count++;
-    }
+    const float epsilon_factor = dt_conf_get_int("plugins/map/epsilon_factor");
+    const int min_images = dt_conf_get_int("plugins/map/min_images_per_group");
+    // zoom varies from 0 (156412 m/pixel) to 20 (0.149 m/pixel)
+    // https://wiki.openstreetmap.org/wiki/Zoom_levels
+    // each time zoom increases by 1 the size is divided by 2
+    // epsilon factor = 100 => epsilon covers more or less a thumbnail surface
+    #define R 6371   // earth radius (km)
+    const double epsilon = thumb_size * (((unsigned int)(156412000 >> zoom))
+                                * epsilon_factor * 0.01 * 0.000001 / R);
+
+    // the images of the viewport are taken from the spatial index by
+    // cells a quarter of the dbscan bins wide, so that the clustering
+    // works on a number of positions bounded by the size of the map
+    // and not by the number of images
+    dt_geo_index_t *index = _view_map_get_index(lib);
+    const int level = dt_geo_index_level(rad2deg(epsilon * 0.66) * 0.25);
+    dt_times_t start;
+    dt_get_perf_times(&start);
+    GArray *cells = g_array_new(FALSE, FALSE, sizeof(guint32));
+    dt_geo_index_query(index, level,
+                       lib->bbox.lon1, lib->bbox.lon2, lib->bbox.lat2, lib->bbox.lat1,
+                       cells);
+    guint32 nb_cells = 0;
+    const dt_geo_index_cell_t *c = dt_geo_index_get_cells(index, level, &nb_cells);
 
     if(lib->points)
       g_free(lib->points);
     lib->points = NULL;
-    lib->nb_points = img_count;
-    if(img_count > 0)
-      lib->points = (dt_geo_position_t *)calloc(img_count, sizeof(dt_geo_position_t));
+    lib->nb_points = cells->len;
+    if(cells->len > 0)
+      lib->points = (dt_geo_position_t *)calloc(cells->len, sizeof(dt_geo_position_t));
     dt_geo_position_t *p = lib->points;
     if(p)
     {
-      DT_DEBUG_SQLITE3_RESET(lib->main_query);
-      /* make the image list */
-      dt_times_t start;
-      dt_get_perf_times(&start);
-      int i = 0;
-      while(sqlite3_step(lib->main_query) == SQLITE_ROW && all_good && i < img_count)
+      const int nb_pos = cells->len;
+      for(int i = 0; i < nb_pos; i++)
       {
-        p[i].imgid = sqlite3_column_int(lib->main_query, 0);
-        p[i].x = deg2rad(sqlite3_column_double(lib->main_query, 1));
-        p[i].y = deg2rad(sqlite3_column_double(lib->main_query, 2));
-        p[i].cluster_id = UNCLASSIFIED;
-        i++;
+        const guint32 cell = g_array_index(cells, guint32, i);
+        p[i].cell = cell;
+        p[i].first = c[cell].first;
+        p[i].count = c[cell].count;
+        p[i].same_loc = c[cell].same_loc;
+        p[i].imgid = dt_geo_index_get_point(index, c[cell].first)->imgid;
+        p[i].x = deg2rad(c[cell].lon);
+        p[i].y = deg2rad(c[cell].lat);
+        p[i].cluster_id = DT_GEO_CLUSTER_UNCLASSIFIED;
       }
       dt_show_times(&start, "[map] retrieve image geolocations");
 
-      const float epsilon_factor = dt_conf_get_int("plugins/map/epsilon_factor");
-      const int min_images = dt_conf_get_int("plugins/map/min_images_per_group");
-      // zoom varies from 0 (156412 m/pixel) to 20 (0.149 m/pixel)
-      // https://wiki.openstreetmap.org/wiki/Zoom_levels
-      // each time zoom increases by 1 the size is divided by 2
-      // epsilon factor = 100 => epsilon covers more or less a thumbnail surface
-      #define R 6371   // earth radius (km)
-      const double epsilon = thumb_size * (((unsigned int)(156412000 >> zoom))
-                                  * epsilon_factor * 0.01 * 0.000001 / R);
-
       dt_get_perf_times(&start);
-      const int num_clusters = _dbscan(lib, p, img_count, epsilon, min_images);
+      const int num_clusters = dt_geo_cluster_dbscan(p, nb_pos, &lib->bbox, epsilon, min_images);
       dt_show_times(&start, "[map] dbscan calculation");
 
-      // set the clusters
-      gboolean *processed = calloc(num_clusters+1,sizeof(gboolean));
       GList *sel_imgs = dt_act_on_get_images(FALSE, FALSE, FALSE);
-      int group = -1;
-      for(i = 0; i< img_count; i++)
+      GHashTable *selected = g_hash_table_new(NULL, NULL);
+      for(const GList *l = sel_imgs; l; l = g_list_next(l))
+        g_hash_table_add(selected, l->data);
+
+      // sum up the clusters
+      dt_map_image_t **groups = calloc(num_clusters + 1, sizeof(dt_map_image_t *));
+      int *first_pos = calloc(num_clusters + 1, sizeof(int));
+      for(int i = 0; i < nb_pos; i++)
       {
-        if(p[i].cluster_id == NOISE)
+        if(p[i].cluster_id == DT_GEO_CLUSTER_NOISE)
         {
-          dt_map_image_t *entry = calloc(1, sizeof(dt_map_image_t));
-          if(entry)
+          // no cluster, each image of the cell is shown alone
+          for(guint32 j = p[i].first; j < p[i].first + p[i].count; j++)
           {
-            entry->imgid = p[i].imgid;
-            entry->group = p[i].cluster_id;
-            entry->group_count = 1;
-            entry->longitude = rad2deg(p[i].x);
-            entry->latitude = rad2deg(p[i].y);
-            entry->group_same_loc = TRUE;
-            if(sel_imgs)
-              entry->selected_in_group = g_list_find((GList *)sel_imgs,
-                                                     GINT_TO_POINTER(entry->imgid))
-                                         ? TRUE : FALSE;
-            lib->images = g_slist_prepend(lib->images, entry);
+            const dt_geo_index_point_t *pt = dt_geo_index_get_point(index, j);
+            dt_map_image_t *entry = calloc(1, sizeof(dt_map_image_t));
+            if(entry)
+            {
+              entry->imgid = pt->imgid;
+              entry->group = DT_GEO_CLUSTER_NOISE;
+              entry->group_count = 1;
+              entry->longitude = pt->lon;
+              entry->latitude = pt->lat;
+              entry->group_same_loc = TRUE;
+              entry->selected_in_group =
+                g_hash_table_contains(selected, GINT_TO_POINTER(entry->imgid));
+              lib->images = g_slist_prepend(lib->images, entry);
+            }
           }
         }
-        else if(!processed[p[i].cluster_id])
+        else if(p[i].cluster_id >= 0)
         {
-          processed[p[i].cluster_id] = TRUE;
-          group = p[i].cluster_id;
-          dt_map_image_t *entry = calloc(1, sizeof(dt_map_image_t));
-          if(entry)
+          dt_map_image_t *entry = groups[p[i].cluster_id];
+          if(!entry)
           {
+            entry = calloc(1, sizeof(dt_map_image_t));
+            if(!entry) continue;
+            groups[p[i].cluster_id] = entry;
+            first_pos[p[i].cluster_id] = i;
             entry->imgid = p[i].imgid;
             entry->group = p[i].cluster_id;
             entry->group_same_loc = TRUE;
-            entry->selected_in_group = (sel_imgs && g_list_find((GList *)sel_imgs,
-                                                                GINT_TO_POINTER(p[i].imgid)))
-                                       ? TRUE : FALSE;
-            const double lon = p[i].x, lat = p[i].y;
-
-            for(int j = 0; j < img_count; j++)
-            {
-              if(p[j].cluster_id == group)
-              {
-                entry->group_count++;
-                entry->longitude += p[j].x;
-                entry->latitude += p[j].y;
-                if(entry->group_same_loc && (p[j].x != lon || p[j].y != lat))
-                {
-                  entry->group_same_loc = FALSE;
-                }
-                if(sel_imgs && !entry->selected_in_group)
-                {
-                  if(g_list_find((GList *)sel_imgs, GINT_TO_POINTER(p[j].imgid)))
-                    entry->selected_in_group = TRUE;
-                }
-              }
-            }
-            entry->latitude = rad2deg(entry->latitude) / entry->group_count;
-            entry->longitude = rad2deg(entry->longitude) / entry->group_count;
             lib->images = g_slist_prepend(lib->images, entry);
           }
+          const dt_geo_position_t *first = &p[first_pos[p[i].cluster_id]];
+          if(entry->group_same_loc
+             && (!p[i].same_loc || p[i].x != first->x || p[i].y != first->y))
+            entry->group_same_loc = FALSE;
+          entry->group_count += p[i].count;
+          entry->longitude += p[i].x * p[i].count;
+          entry->latitude += p[i].y * p[i].count;
         }
       }
-      free(processed);
+      for(int k = 0; k < num_clusters; k++)
+      {
+        dt_map_image_t *entry = groups[k];
+        if(!entry) continue;
+        entry->latitude = rad2deg(entry->latitude) / entry->group_count;
+        entry->longitude = rad2deg(entry->longitude) / entry->group_count;
+      }
+
+      // flag the groups holding selected images
+      for(const GList *l = sel_imgs; l; l = g_list_next(l))
+      {
+        const dt_imgid_t imgid = GPOINTER_TO_INT(l->data);
+        const gint64 point = dt_geo_index_find_image(index, imgid);
+        if(point < 0) continue;
+        const guint32 cell = dt_geo_index_find_cell(index, level, point);
+        // the positions are sorted by cell
+        int lo = 0, hi = nb_pos;
+        while(lo < hi)
+        {
+          const int mid = lo + (hi - lo) / 2;
+          if(p[mid].cell < cell) lo = mid + 1;
+          else hi = mid;
+        }
+        if(lo < nb_pos && p[lo].cell == cell && p[lo].cluster_id >= 0
+           && groups[p[lo].cluster_id])
+          groups[p[lo].cluster_id]->selected_in_group = TRUE;
+      }
+      free(groups);
+      free(first_pos);
+      g_hash_table_destroy(selected);
       g_list_free(sel_imgs);
     }
+    g_array_free(cells, TRUE);
 
     needs_redraw = _view_map_draw_images(self);
     _view_map_draw_main_location(lib, &lib->loc.main);
@@ -1687,6 +1686,26 @@ static dt_map_image_t *_view_map_get_entry_at_pos(const dt_view_t *self,
   return NULL;
 }
 
+// the images of a cluster, in the order of the spatial index
+static GList *_view_map_get_group_imgs(const dt_map_t *lib,
+                                       const int group)
+{
+  GList *imgs = NULL;
+  if(!lib->points || !lib->geo_index) return imgs;
+
+  const dt_geo_position_t *p = lib->points;
+  for(int i = lib->nb_points - 1; i >= 0; i--)
+  {
+    if(p[i].cluster_id != group) continue;
+    for(gint64 j = (gint64)p[i].first + p[i].count - 1; j >= p[i].first; j--)
+    {
+      const dt_geo_index_point_t *pt = dt_geo_index_get_point(lib->geo_index, j);
+      imgs = g_list_prepend(imgs, GINT_TO_POINTER(pt->imgid));
+    }
+  }
+  return imgs;
+}
+
 static GList *_view_map_get_imgs_at_pos(const dt_view_t *self,
                                         const float x,
                                         const float y,
@@ -1724,22 +1743,10 @@ static GList *_view_map_get_imgs_at_pos(const dt_view_t *self,
     }
   }
 
-  if(dt_is_valid_imgid(imgid) && !first_on && entry->group_count > 1 && lib->points)
+  if(dt_is_valid_imgid(imgid) && !first_on && entry->group_count > 1)
   {
-    const dt_geo_position_t *p = lib->points;
-    int count = 1;
-    for(int i = 0; i < lib->nb_points; i++)
-    {
-      if(p[i].cluster_id == entry->group && p[i].imgid != imgid)
-      {
-        imgs = g_list_prepend(imgs, GINT_TO_POINTER(p[i].imgid));
-        count++;
-        if(count >= entry->group_count)
-        {
-          break;
-        }
-      }
-    }
+    imgs = _view_map_get_group_imgs(lib, entry->group);
+    imgs = g_list_remove(imgs, GINT_TO_POINTER(imgid));
   }
   if(dt_is_valid_imgid(imgid))
     // it's necessary to have the visible image as the first one of the list
@@ -1772,61 +1779,18 @@ static gboolean _display_next_image(const dt_view_t *self,
     return TRUE;
   }
 
-  const dt_geo_position_t *p = lib->points;
-  int index = -1;
-  for(int i = 0; i < lib->nb_points; i++)
+  GList *imgs = _view_map_get_group_imgs(lib, entry->group);
+  GList *current = g_list_find(imgs, GINT_TO_POINTER(entry->imgid));
+  if(!current || !imgs->next)
   {
-    if(p[i].imgid == GPOINTER_TO_INT(entry->imgid))
-    {
-      if(next)
-      {
-        for(int j = i + 1; j < lib->nb_points; j++)
-        {
-          if(p[j].cluster_id == entry->group)
-          {
-            index = j;
-            break;
-          }
-        }
-        if(index == -1)
-        {
-          for(int j = 0; j < i; j++)
-          {
-            if(p[j].cluster_id == entry->group)
-            {
-              index = j;
-              break;
-            }
-          }
-        }
-      }
-      else
-      {
-        for(int j = i - 1; j >= 0; j--)
-        {
-          if(p[j].cluster_id == entry->group)
-          {
-            index = j;
-            break;
-          }
-        }
-        if(index == -1)
-        {
-          for(int j = lib->nb_points - 1; j > i; j--)
-          {
-            if(p[j].cluster_id == entry->group)
-            {
-              index = j;
-              break;
-            }
-          }
-        }
-      }
-      break;
-    }
+    g_list_free(imgs);
+    return FALSE;
   }
-  if(index == -1) return FALSE;
-  entry->imgid = p[index].imgid;
+  GList *other = next
+    ? (current->next ? current->next : imgs)
+    : (current->prev ? current->prev : g_list_last(imgs));
+  entry->imgid = GPOINTER_TO_INT(other->data);
+  g_list_free(imgs);
   if(entry->image)
   {
     osm_gps_map_image_remove(lib->map, entry->image);
@@ -2354,6 +2318,8 @@ void enter(dt_view_t *self)
   lib->start_drag_offset_y = 0;
   lib->loc.drag = FALSE;
   lib->entering = TRUE;
+  // geotags may have been changed in other views
+  _view_map_reset_index(lib);
 
   /* set the correct map source */
   _view_map_set_map_source_g_object(self, lib->map_source);
@@ -2951,7 +2917,9 @@ static void _view_map_collection_changed(gpointer instance,
                                          const gpointer user_data)
 {
   dt_view_t *self = (dt_view_t *)user_data;
-  const dt_map_t *lib = self->data;
+  dt_map_t *lib = self->data;
+  // images may have been imported or removed
+  _view_map_reset_index(lib);
   // avoid to centre the map on collection while a location is active
   if(darktable.view_manager->proxy.map.view && !lib->loc.main.id)
   {
@@ -2985,7 +2953,8 @@ static void _view_map_geotag_changed(gpointer instance, GList *imgs,
   if(!locid)
   {
     const dt_view_t *self = (dt_view_t *)user_data;
-    const dt_map_t *lib = self->data;
+    dt_map_t *lib = self->data;
+    _view_map_reset_index(lib);
     if(darktable.view_manager->proxy.map.view)
       g_signal_emit_by_name(lib->map, "changed");
   }
@@ -3277,20 +3246,50 @@ static gboolean _view_map_prefs_changed(dt_map_t *lib)
   return prefs_changed;
 }
 
+// the spatial index is loaded from the main query on first use after
+// images have been added, removed or moved
+static void _view_map_reset_index(dt_map_t *lib)
+{
+  dt_geo_index_free(lib->geo_index);
+  lib->geo_index = NULL;
+  g_free(lib->points);
+  lib->points = NULL;
+  lib->nb_points = 0;
+}
+
+static dt_geo_index_t *_view_map_get_index(dt_map_t *lib)
+{
+  if(lib->geo_index) return lib->geo_index;
+
+  dt_times_t start;
+  dt_get_perf_times(&start);
+  lib->geo_index = dt_geo_index_new();
+  DT_DEBUG_SQLITE3_RESET(lib->main_query);
+  while(sqlite3_step(lib->main_query) == SQLITE_ROW)
+  {
+    dt_geo_index_add(lib->geo_index,
+                     sqlite3_column_int(lib->main_query, 0),
+                     sqlite3_column_double(lib->main_query, 1),
+                     sqlite3_column_double(lib->main_query, 2));
+  }
+  dt_show_times_f(&start, "[map]", "build spatial index of %u images",
+                  dt_geo_index_count(lib->geo_index));
+  return lib->geo_index;
+}
+
 static void _view_map_build_main_query(dt_map_t *lib)
 {
   char *geo_query;
 
   if(lib->main_query) sqlite3_finalize(lib->main_query);
+  _view_map_reset_index(lib);
 
   lib->filter_images_drawn = dt_conf_get_bool("plugins/map/filter_images_drawn");
   // clang-format off
   geo_query =
-    g_strdup_printf("SELECT * FROM"
-                    " (SELECT id, longitude, latitude "
-                    "   FROM %s WHERE longitude >= ?1 AND longitude <= ?2"
-                    "           AND latitude <= ?3 AND latitude >= ?4 "
-                    "           AND longitude NOT NULL AND latitude NOT NULL)",
+    g_strdup_printf("SELECT id, longitude, latitude"
+                    " FROM %s"
+                    " WHERE longitude NOT NULL AND latitude NOT NULL",
                     lib->filter_images_drawn
                     ? "main.images i INNER JOIN memory.collected_images c ON i.id = c.imgid"
                     : "main.images");
@@ -3315,298 +3314,6 @@ GSList *mouse_actions(const dt_view_t *self)
   return lm;
 }
 
-// starting point taken from https://github.com/gyaikhom/dbscan
-// Copyright 2015 Gagarine Yaikhom (MIT License)
-
-typedef struct geo_bin_t
-{
-  unsigned int points;
-  unsigned int num_points;
-} geo_bin_t;
-
-typedef struct dt_dbscan_t
-{
-  dt_geo_position_t *points;
-  geo_bin_t **geo_bins;
-  unsigned int num_points;
-  unsigned int num_lon_bins;
-  unsigned int num_lat_bins;
-  double epsilon;
-  unsigned int minpts;
-  unsigned int index;
-  unsigned int cluster_id;
-} dt_dbscan_t;
-
-static dt_dbscan_t db;
-
-static double round_down(const double x,
-                         const double binsize)
-{
-  const double scaled = floor(x / binsize);
-  return scaled * binsize;
-}
-
-static void _bin_points(const dt_map_t *lib,
-                        const double epsilon)
-{
-  const double lat_north = deg2rad(lib->bbox.lat1) ; // UI uses degrees, we compute in radians
-  const double lat_south = round_down(deg2rad(lib->bbox.lat2), epsilon) ;
-  const double lon_east = deg2rad(lib->bbox.lon2);
-  const double lon_west = round_down(deg2rad(lib->bbox.lon1), epsilon) ;
-  const double lat_range = lat_north - lat_south;
-  const double lon_range = lon_east - lon_west;
-  const unsigned int num_lat_bins = ceil(lat_range / db.epsilon) + 1;
-  const unsigned int num_lon_bins = ceil(lon_range / db.epsilon) + 1;
-  for(unsigned int i = 0; i < db.num_points; i++)
-    db.points[i].next = NO_NEXT_POINT;
-  db.geo_bins = (geo_bin_t**)calloc(num_lon_bins, sizeof(geo_bin_t*));
-  db.num_lat_bins = num_lat_bins;
-  db.num_lon_bins = num_lon_bins;
-  if(!db.geo_bins)
-    return;
-
-  // bin the coordinates for the points, making a linked list of points in each bin
-  for(unsigned int i = 0; i < db.num_points; i++)
-  {
-    const unsigned int lon_bin =
-      (CLAMP(db.points[i].x, lon_west,lon_east) - lon_west) / db.epsilon ;
-    const unsigned int lat_bin =
-      (CLAMP(db.points[i].y, lat_south,lat_north) - lat_south) / db.epsilon ;
-    db.points[i].x_bin = lon_bin;
-    db.points[i].y_bin = lat_bin;
-    if(!db.geo_bins[lon_bin])
-    {
-      // we haven't yet seen any points in this longitude bin, so
-      // allocate pointers for all of the latitude bins at this
-      // longitude
-      db.geo_bins[lon_bin] = (geo_bin_t*)calloc(num_lat_bins, sizeof(geo_bin_t));
-      if(db.geo_bins[lon_bin])
-      {
-        for(int l = 0; l < num_lat_bins; l++)
-          db.geo_bins[lon_bin][l].points = NO_NEXT_POINT;
-      }
-    }
-    // push the point on the front of the linked list for its bin
-    db.points[i].next = db.geo_bins[lon_bin][lat_bin].points;
-    db.geo_bins[lon_bin][lat_bin].points = i;
-    // and update the count of points in the bin
-    db.geo_bins[lon_bin][lat_bin].num_points++;
-  }
-}
-
-static gboolean _not_clustered(const unsigned int lon,
-                               const unsigned int lat)
-{
-  if(!db.geo_bins[lon] || db.geo_bins[lon][lat].num_points == 0)
-    return FALSE;
-  return db.points[db.geo_bins[lon][lat].points].cluster_id < 0;
-}
-
-static void _add_expand_cluster(const unsigned int lon,
-                                const unsigned int lat,
-                                const int id,
-                                int iter)
-{
-  // add the current bin to the cluster
-  if(iter >= 0)
-  {
-    for(unsigned int pt = db.geo_bins[lon][lat].points;
-        pt != NO_NEXT_POINT;
-        pt = db.points[pt].next)
-    {
-      db.points[pt].cluster_id = id;
-    }
-  }
-  if(iter == 0)
-    return;
-  if(iter == -1)
-    iter = 1;
-  // now look at the adjacent bins in all eight directions and add
-  // them if not already in a cluster
-  if(lon > 0 && db.geo_bins[lon-1])
-  {
-    for(int lat2 = lat > 0 ? lat - 1 : lat;
-        lat2 + 1 < MIN(db.num_lat_bins, lat + 2);
-        lat2++)
-    {
-      if(_not_clustered(lon-1,lat2))
-      {
-        _add_expand_cluster(lon-1, lat2, id, iter-1);
-      }
-    }
-  }
-  if(lat > 0 && _not_clustered(lon,lat-1))
-  {
-    _add_expand_cluster(lon, lat-1, id, iter-1);
-  }
-  if(lat+1 < db.num_lat_bins && _not_clustered(lon,lat+1))
-  {
-    _add_expand_cluster(lon, lat+1, id, iter-1);
-  }
-  if(lon+1 < db.num_lon_bins && db.geo_bins[lon+1])
-  {
-    for(int lat2 = lat > 0 ? lat-1 : lat;
-        lat2 + 1 < MIN(db.num_lat_bins, lat + 2);
-        lat2++)
-    {
-      if(_not_clustered(lon+1,lat2))
-      {
-        _add_expand_cluster(lon+1, lat2, id, iter-1);
-      }
-    }
-  }
-}
-
-static gboolean _identical_positions(const unsigned int lon,
-                                     const unsigned int lat)
-{
-  if(db.geo_bins[lon][lat].num_points < 2)
-    return FALSE;
-  unsigned int pt = db.geo_bins[lon][lat].points;
-  const double x = db.points[pt].x;
-  const double y = db.points[pt].y;
-
-  for(pt = db.points[pt].next;
-      pt != NO_NEXT_POINT;
-      pt = db.points[pt].next)
-  {
-    if(db.points[pt].x != x || db.points[pt].y != y)
-      return FALSE;
-  }
-  return TRUE;
-}
-
-static gboolean _can_form_cluster(const unsigned int lon,
-                                  const unsigned int lat)
-{
-  // look at the current bin, plus the adjacent ones in all eight
-  // directions which do not yet belong to a cluster
-  unsigned int points = db.geo_bins[lon][lat].num_points;
-  if(lat > 0 && _not_clustered(lon, lat-1))
-    points += db.geo_bins[lon][lat-1].num_points;
-
-  if(lat+1 < db.num_lat_bins && _not_clustered(lon, lat+1))
-    points += db.geo_bins[lon][lat+1].num_points;
-
-  if(lon > 0 && db.geo_bins[lon-1])
-  {
-    if(lat > 0 && _not_clustered(lon-1, lat-1))
-      points += db.geo_bins[lon-1][lat-1].num_points;
-    if(_not_clustered(lon-1, lat))
-      points += db.geo_bins[lon-1][lat].num_points;
-    if(lat+1 < db.num_lat_bins && _not_clustered(lon-1, lat+1))
-      points += db.geo_bins[lon-1][lat+1].num_points;
-  }
-
-  if(lon+1 < db.num_lon_bins && db.geo_bins[lon+1])
-  {
-    if(lat > 0 && _not_clustered(lon+1, lat-1))
-      points += db.geo_bins[lon+1][lat-1].num_points;
-    if(_not_clustered(lon+1, lat))
-      points += db.geo_bins[lon+1][lat].num_points;
-    if(lat+1 < db.num_lat_bins && _not_clustered(lon+1, lat+1))
-      points += db.geo_bins[lon+1][lat+1].num_points;
-  }
-  return points >= db.minpts;
-}
-
-static int _dbscan(const dt_map_t *lib,
-                   dt_geo_position_t *points,
-                   const unsigned int num_points,
-                   const double epsilon,
-                   const unsigned int minpts)
-{
-  db.points = points;
-  db.num_points = num_points;
-  db.epsilon = epsilon * 0.66;
-  // remove the pivot from target
-  db.minpts = minpts > 1 ? minpts - 1 : minpts;
-  db.cluster_id = 0;
-
-  // quantize the location coordinates and collect points into bins
-  _bin_points(lib, db.epsilon);
-  // now that we've binned the points, process by bins instead of individual points
-  // first, check if individual bins have enough points to form a cluster
-  for(unsigned int lon = 0; lon < db.num_lon_bins; lon++)
-  {
-    if(!db.geo_bins[lon])
-      continue;
-    for(unsigned int lat = 0; lat < db.num_lat_bins; lat++)
-    {
-      if(db.geo_bins[lon][lat].num_points >= db.minpts)
-      {
-        _add_expand_cluster(lon, lat, db.cluster_id, EXPAND_LIMIT);
-        ++db.cluster_id;
-      }
-    }
-  }
-  // next, check if groups of adjacent bins can form a cluster
-  for(unsigned int lon = 0; lon < db.num_lon_bins; lon++)
-  {
-    if(!db.geo_bins[lon])
-      continue;
-    for(unsigned int lat = 0; lat < db.num_lat_bins; lat++)
-    {
-      if(_can_form_cluster(lon, lat))
-      {
-        _add_expand_cluster(lon, lat, db.cluster_id, EXPAND_LIMIT);
-        ++db.cluster_id;
-      }
-    }
-  }
-  // now that we've found the cluster cores, expand all of the clusters
-  // into neighboring bins where possible
-  for(unsigned int iter = 0; iter < 20; iter++)
-  {
-    for(unsigned int lon = 0; lon < db.num_lon_bins; lon++)
-    {
-      if(!db.geo_bins[lon])
-        continue;
-      for(unsigned int lat = 0; lat < db.num_lat_bins; lat++)
-      {
-        int id ;
-        if(db.geo_bins[lon][lat].num_points > 0
-           && (id = db.points[db.geo_bins[lon][lat].points].cluster_id) >= 0) // already in cluster?
-        {
-          _add_expand_cluster(lon, lat, id, -1);
-        }
-      }
-    }
-  }
-  // if we still have any unclustered images, treat them as a cluster
-  // if they are at identical positions, otherwise flag them as
-  // "noise"
-  for(unsigned int lon = 0; lon < db.num_lon_bins; lon++)
-  {
-    if(!db.geo_bins[lon])
-      continue;
-    for(unsigned int lat = 0; lat < db.num_lat_bins; lat++)
-    {
-      if(db.geo_bins[lon][lat].num_points > 1
-         && db.points[db.geo_bins[lon][lat].points].cluster_id == UNCLASSIFIED
-         && _identical_positions(lon,lat))
-      {
-        _add_expand_cluster(lon,lat, db.cluster_id++, 0);
-      }
-      else if(db.geo_bins[lon][lat].num_points > 0
-              && db.points[db.geo_bins[lon][lat].points].cluster_id == UNCLASSIFIED)
-      {
-        _add_expand_cluster(lon, lat, NOISE, 0);
-      }
-    }
-  }
-  // free allocated memory
-  for(unsigned int  lon = 0; lon < db.num_lon_bins; lon++)
-  {
-    if(db.geo_bins[lon])
-      free(db.geo_bins[lon]);
-  }
-  free(db.geo_bins);
-  db.geo_bins = NULL;
-  return db.cluster_id;
-}
-
-
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent